@@ -0,0 +1,331 @@
+#include <gl/glew.h>
+
+#include <elk/core/elk_engine.h>
+#include <elk/window/application_window_headless.h>
+#include "elk/core/cpu_profiler.h"
+#include "elk/core/create_mesh.h"
+#include "elk/core/create_texture.h"
+#include "elk/core/deferred_shading_renderer.h"
+#include "elk/core/render_state.h"
+#include "elk/object_extensions/renderable_model.h"
+#include "elk/object_extensions/light_source.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <map>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+// Renders a procedurally generated scene headless along a fixed camera path
+// and reports frame times, per pass times and draw calls as JSON. The scene
+// only depends on the options, so runs can be compared between versions.
+// The report is written to a file since the library logs to stdout.
+
+using namespace elk::core;
+using namespace elk::window;
+
+namespace {
+
+struct Options
+{
+  int objects = 500;
+  int lights = 64;
+  int shadowed_lights = 0;
+  int materials = 8;
+  int frames = 600;
+  int warmup = 60;
+  int width = 1280;
+  int height = 720;
+  unsigned int seed = 1;
+  bool parallel_recording = false;
+  std::string output = "elk_bench.json";
+};
+
+bool parseOptions(int argc, char const *argv[], Options& options)
+{
+  for (int i = 1; i < argc; ++i)
+  {
+    const char* name = argv[i];
+    if (i + 1 >= argc)
+    {
+      fprintf(stderr, "ERROR : Missing value for %s\n", name);
+      return false;
+    }
+    const char* value = argv[++i];
+    if (!strcmp(name, "--objects")) options.objects = atoi(value);
+    else if (!strcmp(name, "--lights")) options.lights = atoi(value);
+    else if (!strcmp(name, "--shadowed-lights")) options.shadowed_lights = atoi(value);
+    else if (!strcmp(name, "--materials")) options.materials = std::max(atoi(value), 1);
+    else if (!strcmp(name, "--frames")) options.frames = std::max(atoi(value), 1);
+    else if (!strcmp(name, "--warmup")) options.warmup = std::max(atoi(value), 0);
+    else if (!strcmp(name, "--width")) options.width = atoi(value);
+    else if (!strcmp(name, "--height")) options.height = atoi(value);
+    else if (!strcmp(name, "--seed")) options.seed = unsigned(strtoul(value, nullptr, 10));
+    else if (!strcmp(name, "--parallel-recording")) options.parallel_recording = atoi(value) != 0;
+    else if (!strcmp(name, "--output")) options.output = value;
+    else
+    {
+      fprintf(stderr, "ERROR : Unknown option %s\n", name);
+      return false;
+    }
+  }
+  return true;
+}
+
+class BenchmarkEngine : public ElkEngine
+{
+public:
+  BenchmarkEngine(const Options& options);
+
+  void update(double dt);
+  //! Places the camera on an orbit around the scene, \param t in [0, 1)
+  void moveCamera(double t);
+  DeferredShadingRenderer& renderer() { return _renderer; };
+
+private:
+  DeferredShadingRenderer _renderer;
+  float _extent;
+
+  std::vector<std::unique_ptr<RenderableModel>> _models;
+  std::vector<std::unique_ptr<PointLightSource>> _lights;
+  DirectionalLightSource _sun;
+};
+
+BenchmarkEngine::BenchmarkEngine(const Options& options) :
+  ElkEngine(),
+  _renderer(perspective_camera, options.width, options.height),
+  _extent(std::sqrt(float(std::max(options.objects, 1))) * 1.5f),
+  _sun(glm::vec3(1.0,0.8,0.7), 0.15)
+{
+  std::mt19937 random(options.seed);
+  std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+  _renderer.setParallelRecording(options.parallel_recording);
+
+  const std::shared_ptr<Mesh> meshes[] = {
+    CreateMesh::lonLatSphere(32,16),
+    CreateMesh::box(glm::vec3(-0.5f), glm::vec3(0.5f)),
+    CreateMesh::cylinder(24),
+    CreateMesh::cone(24) };
+  const int number_of_meshes = sizeof(meshes) / sizeof(meshes[0]);
+
+  std::vector<std::shared_ptr<Material>> materials;
+  for (int i = 0; i < options.materials; ++i)
+  {
+    glm::u8vec4 albedo(
+      64 + 191 * unit(random), 64 + 191 * unit(random), 64 + 191 * unit(random), 255);
+    GLubyte roughness = 255 * unit(random);
+    GLubyte metalness = unit(random) < 0.3f ? 255 : 0;
+    materials.push_back(std::make_shared<Material>(
+      CreateTexture::color(4, 4, albedo),
+      CreateTexture::color(4, 4, glm::u8vec4(roughness, roughness, roughness, 255)),
+      CreateTexture::white(4, 4),
+      CreateTexture::color(4, 4, glm::u8vec4(metalness, metalness, metalness, 255))));
+  }
+
+  for (int i = 0; i < options.objects; ++i)
+  {
+    _models.emplace_back(new RenderableModel(
+      meshes[i % number_of_meshes], materials[i % materials.size()]));
+    glm::vec3 position(
+      (unit(random) - 0.5f) * 2.0f * _extent,
+      unit(random) * 2.0f,
+      (unit(random) - 0.5f) * 2.0f * _extent);
+    _models.back()->setTransform(
+      glm::translate(position) *
+      glm::rotate(unit(random) * 2.0f * float(M_PI), glm::vec3(0.0f, 1.0f, 0.0f)) *
+      glm::scale(glm::vec3(0.5f + unit(random))));
+    scene.addChild(*_models.back());
+  }
+
+  for (int i = 0; i < options.lights; ++i)
+  {
+    glm::vec3 color(0.5f + 0.5f * unit(random), 0.5f + 0.5f * unit(random), 0.5f + 0.5f * unit(random));
+    _lights.emplace_back(new PointLightSource(color, 0.5f + 2.0f * unit(random)));
+    glm::vec3 position(
+      (unit(random) - 0.5f) * 2.0f * _extent,
+      0.5f + unit(random) * 3.0f,
+      (unit(random) - 0.5f) * 2.0f * _extent);
+    _lights.back()->setTransform(glm::translate(position));
+    _lights.back()->setCastsShadows(i < options.shadowed_lights);
+    scene.addChild(*_lights.back());
+  }
+
+  _sun.setTransform(glm::rotate(float(M_PI) * 0.4f, glm::vec3(1.0f, 0.0f, -0.65f)));
+  _sun.setCastsShadows(true);
+  scene.addChild(_sun);
+  scene.addChild(camera());
+}
+
+void BenchmarkEngine::update(double dt)
+{
+  ElkEngine::update(dt);
+
+  _renderer.render(scene);
+}
+
+void BenchmarkEngine::moveCamera(double t)
+{
+  const float angle = float(2.0 * M_PI * t);
+  const float radius = _extent * 1.2f;
+  glm::vec3 eye(radius * std::cos(angle), 2.0f + _extent * 0.3f, radius * std::sin(angle));
+  perspective_camera.setTransform(
+    glm::inverse(glm::lookAt(eye, glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f))));
+}
+
+// Nearest rank percentile of sorted values
+double percentile(const std::vector<double>& sorted, double p)
+{
+  if (sorted.empty())
+    return 0.0;
+  size_t rank = size_t(std::ceil(p / 100.0 * sorted.size()));
+  return sorted[std::min(std::max(rank, size_t(1)), sorted.size()) - 1];
+}
+
+void writeDistribution(FILE* file, const char* name, std::vector<double> values)
+{
+  std::sort(values.begin(), values.end());
+  double sum = 0.0;
+  for (double value : values)
+    sum += value;
+  fprintf(file,
+    "  \"%s\": {\"samples\": %d, \"mean\": %.4f, \"min\": %.4f, \"p50\": %.4f, "
+    "\"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f},\n",
+    name, int(values.size()), values.empty() ? 0.0 : sum / values.size(),
+    values.empty() ? 0.0 : values.front(),
+    percentile(values, 50.0), percentile(values, 95.0), percentile(values, 99.0),
+    values.empty() ? 0.0 : values.back());
+}
+
+} // namespace
+
+int main(int argc, char const *argv[])
+{
+  Options options;
+  if (!parseOptions(argc, argv, options))
+  {
+    fprintf(stderr,
+      "Usage : elk_bench [--objects N] [--lights M] [--shadowed-lights S] "
+      "[--materials K] [--frames F] [--warmup W] [--width X] [--height Y] "
+      "[--seed R] [--parallel-recording 0|1] [--output path]\n"
+      "The JSON report is written to elk_bench.json by default.\n");
+    return 1;
+  }
+
+  ApplicationWindowHeadless window("elk_bench", options.width, options.height);
+  if (!window.valid())
+    return 1;
+  BenchmarkEngine e(options);
+  e.renderer().setGpuProfiling(true);
+  CpuProfiler::setWindow(options.frames);
+
+  // Frames are equally spaced in time regardless of how long they take
+  const int total_frames = options.warmup + options.frames;
+  window.setFrameLimit(total_frames);
+  window.setFixedTimeStep(1.0 / 60.0);
+
+  std::vector<double> cpu_frame_times;
+  std::vector<double> gpu_frame_times;
+  std::vector<double> draw_calls;
+  int frame = 0;
+  std::function<void(double)> loop = [&](double dt)
+  {
+    if (frame == options.warmup)
+    {
+      // Zones of the warmup are collected before they are dropped
+      ELK_PROFILE_FRAME();
+      e.renderer().gpuProfiler().reset();
+      CpuProfiler::reset();
+    }
+    e.moveCamera(double(frame) / total_frames);
+
+    auto begin = std::chrono::steady_clock::now();
+    e.update(dt);
+    auto end = std::chrono::steady_clock::now();
+
+    // Results arrive a few frames late, each is recorded once. The renderer
+    // counts frames like this loop, results of the last frames are missing.
+    for (const auto& result : e.renderer().takeGpuFrameTimes())
+    {
+      if (result.index >= unsigned(options.warmup))
+        gpu_frame_times.push_back(result.milliseconds);
+    }
+
+    if (frame >= options.warmup)
+    {
+      cpu_frame_times.push_back(
+        std::chrono::duration<double, std::milli>(end - begin).count());
+      unsigned int calls = 0;
+      for (const auto& pass : RenderState::frameStatistics())
+        calls += pass.issued[static_cast<int>(RenderState::Category::DrawCall)];
+      draw_calls.push_back(calls);
+    }
+    frame++;
+  };
+  window.run(loop);
+  // Collects the zones of the last frame
+  ELK_PROFILE_FRAME();
+
+  FILE* file = fopen(options.output.c_str(), "w");
+  if (!file)
+  {
+    fprintf(stderr, "ERROR : Could not write %s\n", options.output.c_str());
+    return 1;
+  }
+
+  fprintf(file, "{\n");
+  fprintf(file, "  \"renderer\": \"%s\",\n", glGetString(GL_RENDERER));
+  fprintf(file,
+    "  \"scene\": {\"objects\": %d, \"lights\": %d, \"shadowed_lights\": %d, "
+    "\"materials\": %d, \"width\": %d, \"height\": %d, \"seed\": %u, "
+    "\"parallel_recording\": %s},\n",
+    options.objects, options.lights, options.shadowed_lights, options.materials,
+    options.width, options.height, options.seed,
+    options.parallel_recording ? "true" : "false");
+  fprintf(file, "  \"frames\": %d,\n  \"warmup\": %d,\n", options.frames, options.warmup);
+  writeDistribution(file, "cpu_frame_ms", cpu_frame_times);
+  writeDistribution(file, "gpu_frame_ms", gpu_frame_times);
+  writeDistribution(file, "draw_calls", draw_calls);
+
+  // Statistics of the GPU profiler cover its window of the last frames
+  fprintf(file, "  \"gpu_passes_ms\": [");
+  const auto& gpu_passes = e.renderer().gpuProfiler().statistics();
+  for (size_t i = 0; i < gpu_passes.size(); ++i)
+  {
+    fprintf(file,
+      "%s\n    {\"name\": \"%s\", \"mean\": %.4f, \"min\": %.4f, \"max\": %.4f, \"samples\": %d}",
+      i ? "," : "", gpu_passes[i].name.c_str(), gpu_passes[i].average,
+      gpu_passes[i].min, gpu_passes[i].max, gpu_passes[i].number_of_samples);
+  }
+  fprintf(file, "\n  ],\n");
+
+  // Empty unless the library is built with ELK_ENABLE_PROFILING
+  std::map<std::string, std::pair<double, int>> cpu_zones;
+  for (const auto& zone : CpuProfiler::zones())
+  {
+    auto& total = cpu_zones[zone.name];
+    total.first += (zone.end - zone.begin) / 1.0e6;
+    total.second++;
+  }
+  fprintf(file, "  \"cpu_zones_ms_per_frame\": [");
+  bool first = true;
+  for (const auto& zone : cpu_zones)
+  {
+    fprintf(file,
+      "%s\n    {\"name\": \"%s\", \"mean\": %.4f, \"calls\": %.2f}",
+      first ? "" : ",", zone.first.c_str(),
+      zone.second.first / options.frames, double(zone.second.second) / options.frames);
+    first = false;
+  }
+  fprintf(file, "\n  ]\n}\n");
+
+  fclose(file);
+  fprintf(stderr, "Wrote %s\n", options.output.c_str());
+  return 0;
+}
@@ -0,0 +1,268 @@
+#include <gl/glew.h>
+
+#include <benchmark/benchmark.h>
+
+#include <elk/core/elk_engine.h>
+#include "elk/core/bounding_box.h"
+#include "elk/core/camera.h"
+#include "elk/core/create_mesh.h"
+#include "elk/core/image_processing.h"
+#include "elk/core/parallel_for.h"
+#include "elk/core/renderer.h"
+#include "elk/core/worker_pool.h"
+#ifdef ELK_USE_EGL
+#include <elk/window/application_window_headless.h>
+#endif
+
+#include <memory>
+#include <random>
+#include <vector>
+
+// Micro benchmarks of CPU side building blocks, each parameterized by the
+// size of its input. Benchmarks that create meshes need an OpenGL context
+// and only run when built with ELK_USE_EGL.
+
+using namespace elk::core;
+
+namespace {
+
+class NullRenderable : public RenderableDeferred
+{
+public:
+  virtual void render(const UsefulRenderData& render_data) override { };
+};
+
+// Only collects submitted objects
+class NullRenderer : public Renderer
+{
+public:
+  NullRenderer(PerspectiveCamera& camera) : Renderer(camera, 1, 1) { };
+  virtual void render(Object3D& scene) override
+  {
+    scene.submit(*this);
+    _renderables_deferred_to_render.clear();
+  };
+};
+
+std::vector<glm::vec3> randomPoints(size_t n, float extent)
+{
+  std::mt19937 random(1);
+  std::uniform_real_distribution<float> coordinate(-extent, extent);
+  std::vector<glm::vec3> points(n);
+  for (auto& point : points)
+    point = glm::vec3(coordinate(random), coordinate(random), coordinate(random));
+  return points;
+}
+
+// A chain of objects where each is the child of the previous one
+void BM_UpdateTransformDeep(benchmark::State& state)
+{
+  std::vector<NullRenderable> objects(state.range(0));
+  for (size_t i = 1; i < objects.size(); ++i)
+  {
+    objects[i].setTransform(glm::translate(glm::vec3(0.0f, 1.0f, 0.0f)));
+    objects[i - 1].addChild(objects[i]);
+  }
+  for (auto _ : state)
+  {
+    objects[0].updateTransform(glm::mat4(1.0f));
+    benchmark::DoNotOptimize(objects.back().absoluteTransform());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+// Recursion depth is bounded by the stack
+BENCHMARK(BM_UpdateTransformDeep)->RangeMultiplier(4)->Range(16, 4096);
+
+// One root with all other objects as children
+void BM_UpdateTransformWide(benchmark::State& state)
+{
+  Object3D root;
+  std::vector<NullRenderable> objects(state.range(0));
+  for (auto& object : objects)
+    root.addChild(object);
+  for (auto _ : state)
+  {
+    root.updateTransform(glm::mat4(1.0f));
+    benchmark::DoNotOptimize(objects.back().absoluteTransform());
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_UpdateTransformWide)->RangeMultiplier(4)->Range(16, 1 << 16);
+
+void BM_Submit(benchmark::State& state)
+{
+  PerspectiveCamera camera(1.0, 0.01, 100);
+  NullRenderer renderer(camera);
+  Object3D root;
+  std::vector<NullRenderable> objects(state.range(0));
+  for (auto& object : objects)
+    root.addChild(object);
+  for (auto _ : state)
+    renderer.render(root);
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Submit)->RangeMultiplier(4)->Range(16, 1 << 16);
+
+void BM_BoundingBoxIntersectsPoint(benchmark::State& state)
+{
+  BoundingBox box(glm::vec3(-1.0f), glm::vec3(1.0f));
+  std::vector<glm::vec3> points = randomPoints(state.range(0), 2.0f);
+  for (auto _ : state)
+  {
+    int hits = 0;
+    for (const auto& point : points)
+      hits += box.intersects(point);
+    benchmark::DoNotOptimize(hits);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BoundingBoxIntersectsPoint)->RangeMultiplier(8)->Range(64, 1 << 18);
+
+void BM_BoundingBoxIntersectsRay(benchmark::State& state)
+{
+  BoundingBox box(glm::vec3(-1.0f), glm::vec3(1.0f));
+  std::vector<glm::vec3> origins = randomPoints(state.range(0), 4.0f);
+  std::vector<glm::vec3> directions = randomPoints(state.range(0), 1.0f);
+  for (auto _ : state)
+  {
+    int hits = 0;
+    for (size_t i = 0; i < origins.size(); ++i)
+      hits += box.intersects(origins[i], directions[i]).first;
+    benchmark::DoNotOptimize(hits);
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_BoundingBoxIntersectsRay)->RangeMultiplier(8)->Range(64, 1 << 18);
+
+void BM_Unproject(benchmark::State& state)
+{
+  PerspectiveCamera camera(1.0, 0.01, 100);
+  camera.updateTransform(glm::translate(glm::vec3(0.0f, 1.0f, 5.0f)));
+  std::vector<glm::vec3> points = randomPoints(state.range(0), 1.0f);
+  for (auto _ : state)
+  {
+    for (const auto& point : points)
+      benchmark::DoNotOptimize(camera.unproject(glm::vec2(point)));
+  }
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_Unproject)->RangeMultiplier(8)->Range(64, 1 << 15);
+
+void BM_CreateGridPlane(benchmark::State& state)
+{
+  for (auto _ : state)
+    benchmark::DoNotOptimize(CreateMesh::createGridPlane(state.range(0), state.range(0) / 2));
+  state.SetItemsProcessed(state.iterations() * state.range(0) * (state.range(0) / 2));
+}
+BENCHMARK(BM_CreateGridPlane)->RangeMultiplier(2)->Range(8, 256);
+
+void BM_LonLatSphere(benchmark::State& state)
+{
+  for (auto _ : state)
+    benchmark::DoNotOptimize(CreateMesh::lonLatSphere(state.range(0), state.range(0) / 2));
+  state.SetItemsProcessed(state.iterations() * state.range(0) * (state.range(0) / 2));
+}
+
+void BM_ComputeMinMaxPosition(benchmark::State& state)
+{
+  std::shared_ptr<Mesh> sphere = CreateMesh::lonLatSphere(state.range(0), state.range(0) / 2);
+  for (auto _ : state)
+  {
+    benchmark::DoNotOptimize(sphere->computeMinPosition());
+    benchmark::DoNotOptimize(sphere->computeMaxPosition());
+  }
+  state.SetItemsProcessed(state.iterations() * sphere->positions()->size());
+}
+
+// The conversion done by loadTexture_freeimage after decoding
+void BM_SwizzleBGRAToRGBA(benchmark::State& state)
+{
+  const size_t number_of_pixels = state.range(0) * state.range(0);
+  std::vector<GLubyte> source(number_of_pixels * 4, 128);
+  std::vector<GLubyte> destination(number_of_pixels * 4);
+  for (auto _ : state)
+  {
+    swizzleBGRAToRGBA(source.data(), destination.data(), number_of_pixels);
+    benchmark::ClobberMemory();
+  }
+  state.SetBytesProcessed(state.iterations() * number_of_pixels * 4);
+}
+BENCHMARK(BM_SwizzleBGRAToRGBA)->RangeMultiplier(2)->Range(64, 4096);
+
+void BM_GenerateMipMapChain(benchmark::State& state)
+{
+  const glm::uvec2 size(state.range(0), state.range(0));
+  std::vector<GLubyte> pixels(size.x * size.y * 4, 128);
+  for (auto _ : state)
+  {
+    std::vector<GLubyte*> chain = generateMipMapChain(
+      pixels.data(), size, MipMapFilter::Box, ColorSpace::sRGB);
+    for (auto level : chain)
+      delete[] level;
+  }
+  state.SetBytesProcessed(state.iterations() * pixels.size());
+}
+BENCHMARK(BM_GenerateMipMapChain)->RangeMultiplier(2)->Range(64, 4096)->UseRealTime();
+
+// Overhead of splitting small per frame work over all hardware threads,
+// each task only sums a few numbers
+void BM_ParallelForSpawn(benchmark::State& state)
+{
+  const int n_tasks = std::max(1u, std::thread::hardware_concurrency());
+  const int n = state.range(0);
+  std::vector<float> sums(n_tasks);
+  for (auto _ : state)
+  {
+    parallelFor(n_tasks, [&](int begin, int end)
+    {
+      for (int task = begin; task < end; ++task)
+        for (int i = 0; i < n; ++i)
+          sums[task] += float(i);
+    }, 1);
+    benchmark::DoNotOptimize(sums.data());
+  }
+}
+BENCHMARK(BM_ParallelForSpawn)->RangeMultiplier(16)->Range(16, 1 << 16)->UseRealTime();
+
+void BM_WorkerPoolRun(benchmark::State& state)
+{
+  WorkerPool pool;
+  const int n = state.range(0);
+  std::vector<float> sums(pool.numberOfThreads());
+  for (auto _ : state)
+  {
+    pool.run(pool.numberOfThreads(), [&](int task)
+    {
+      for (int i = 0; i < n; ++i)
+        sums[task] += float(i);
+    });
+    benchmark::DoNotOptimize(sums.data());
+  }
+}
+BENCHMARK(BM_WorkerPoolRun)->RangeMultiplier(16)->Range(16, 1 << 16)->UseRealTime();
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+#ifdef ELK_USE_EGL
+  elk::window::ApplicationWindowHeadless window("elk_micro_bench", 16, 16);
+  std::unique_ptr<ElkEngine> engine;
+  if (window.valid())
+  {
+    // Initializes GLEW
+    engine.reset(new ElkEngine());
+    // Indices are 16 bit, which limits the size of the sphere
+    benchmark::RegisterBenchmark("BM_LonLatSphere", BM_LonLatSphere)
+      ->RangeMultiplier(2)->Range(8, 256);
+    benchmark::RegisterBenchmark("BM_ComputeMinMaxPosition", BM_ComputeMinMaxPosition)
+      ->RangeMultiplier(2)->Range(8, 256);
+  }
+#endif
+
+  benchmark::Initialize(&argc, argv);
+  if (benchmark::ReportUnrecognizedArguments(argc, argv))
+    return 1;
+  benchmark::RunSpecifiedBenchmarks();
+  return 0;
+}
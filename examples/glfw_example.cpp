@@ -12,6 +12,7 @@
 #include "elk/core/renderer.h"
 #include "elk/object_extensions/renderable_cube_map.h"
 #include "elk/core/deferred_shading_renderer.h"
+#include "elk/core/cpu_profiler.h"
 #include "elk/object_extensions/renderable_model.h"
 #include "elk/object_extensions/framebuffer_quad.h"
 #include "elk/object_extensions/renderable_grid.h"
@@ -33,7 +34,8 @@ public:
   MyEngine();
   ~MyEngine();
 
-  void update(double dt);
+  void simulate(double dt);
+  void render(double alpha);
   DeferredShadingRenderer& renderer() { return _renderer; };
 
 private:
@@ -66,39 +68,39 @@ MyEngine::MyEngine() :
       CreateTexture::white(100,100))),
   _earth(CreateMesh::lonLatSphere(64,32),
     std::make_shared<Material>(
-      CreateTexture::load("../../data/textures/earth-albedo-highres.jpg"),
+      CreateTexture::load("../../data/textures/earth-albedo-highres.jpg", ColorSpace::sRGB),
       CreateTexture::load("../../data/textures/earth-roughness-highres.png"))),
   _gold_ball(CreateMesh::lonLatSphere(64,32),
     std::make_shared<Material>(
-      CreateTexture::load("../../data/textures/gold-scuffed-Unreal-Engine/gold-scuffed_basecolor.png"),
+      CreateTexture::load("../../data/textures/gold-scuffed-Unreal-Engine/gold-scuffed_basecolor.png", ColorSpace::sRGB),
       CreateTexture::load("../../data/textures/gold-scuffed-Unreal-Engine/gold-scuffed_roughness.png"),
       CreateTexture::white(100,100),
       CreateTexture::load("../../data/textures/gold-scuffed-Unreal-Engine/gold-scuffed_metallic.png"),
       nullptr)),
   _granite_ball(CreateMesh::lonLatSphere(64,32),
     std::make_shared<Material>(
-      CreateTexture::load("../../data/textures/granitesmooth1-Unreal-Engine/granitesmooth1-albedo.png"),
+      CreateTexture::load("../../data/textures/granitesmooth1-Unreal-Engine/granitesmooth1-albedo.png", ColorSpace::sRGB),
       CreateTexture::load("../../data/textures/granitesmooth1-Unreal-Engine/granitesmooth1-roughness3.png"),
       CreateTexture::white(100,100),
       CreateTexture::load("../../data/textures/granitesmooth1-Unreal-Engine/granitesmooth1-metalness.png"),
       nullptr)),
   _greasy_metal_ball(CreateMesh::lonLatSphere(64,32),
     std::make_shared<Material>(
-      CreateTexture::load("../../data/textures/greasy-metal-pan1-Unreal-Engine/greasy-metal-pan1-albedo.png"),
+      CreateTexture::load("../../data/textures/greasy-metal-pan1-Unreal-Engine/greasy-metal-pan1-albedo.png", ColorSpace::sRGB),
       CreateTexture::load("../../data/textures/greasy-metal-pan1-Unreal-Engine/greasy-metal-pan1-roughness.png"),
       CreateTexture::white(100,100),
       CreateTexture::load("../../data/textures/greasy-metal-pan1-Unreal-Engine/greasy-metal-pan1-metal.png"),
       CreateTexture::load("../../data/textures/greasy-metal-pan1-Unreal-Engine/greasy-metal-pan1-normal.png"))),
   _rusted_iron_ball(CreateMesh::lonLatSphere(64,32),
     std::make_shared<Material>(
-      CreateTexture::load("../../data/textures/rustediron1-alt2-Unreal-Engine/rustediron2_basecolor.png"),
+      CreateTexture::load("../../data/textures/rustediron1-alt2-Unreal-Engine/rustediron2_basecolor.png", ColorSpace::sRGB),
       CreateTexture::load("../../data/textures/rustediron1-alt2-Unreal-Engine/rustediron2_roughness.png"),
       CreateTexture::white(100,100),
       CreateTexture::load("../../data/textures/rustediron1-alt2-Unreal-Engine/rustediron2_metallic.png"),
       nullptr)),
   _worn_painted_ball(CreateMesh::lonLatSphere(64,32),
     std::make_shared<Material>(
-      CreateTexture::load("../../data/textures/wornpaintedcement-Unreal_Engine/wornpaintedcement-albedo.png"),
+      CreateTexture::load("../../data/textures/wornpaintedcement-Unreal_Engine/wornpaintedcement-albedo.png", ColorSpace::sRGB),
       CreateTexture::load("../../data/textures/wornpaintedcement-Unreal_Engine/wornpaintedcement-roughness.png"),
       CreateTexture::white(100,100),
       CreateTexture::load("../../data/textures/wornpaintedcement-Unreal_Engine/wornpaintedcement-metalness.png"),
@@ -127,7 +129,9 @@ MyEngine::MyEngine() :
       "../../data/textures/mp_marvelous/bloody-marvelous_ft.tga")));
 
   _lamp.setTransform(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, 1.0f, 0.0f)));
+  _lamp.setCastsShadows(true);
   _lamp2.setTransform(glm::rotate(float(M_PI) * 0.4f, glm::vec3(1.0f, 0.0f, -0.65f)));
+  _lamp2.setCastsShadows(true);
   _monkey.setTransform(glm::translate(glm::vec3(1.5f, 0.0f, 0.0f)));
   _earth.setTransform(glm::translate(glm::vec3(0.0f, 2.0f, 0.0f)));
   _plane.setTransform(glm::scale(glm::vec3(1000.0f, 1000.0f, 1000.0f)));
@@ -169,9 +173,14 @@ MyEngine::~MyEngine()
   
 }
 
-void MyEngine::update(double dt)
+void MyEngine::simulate(double dt)
 {
-  ElkEngine::update(dt);
+  ElkEngine::step(dt);
+}
+
+void MyEngine::render(double alpha)
+{
+  ElkEngine::interpolate(alpha);
 
   _renderer.render(scene);
 }
@@ -303,6 +312,40 @@ void DebugInputController::step(float dt)
   {
     _engine.camera().setFocalLength(_engine.camera().focalLength() * (1.0 - dt));
   }
+
+  if (_keys_pressed.count(Key::KEY_Z))
+  {
+    _engine._renderer.setScreenSpaceReflections(
+      DeferredShadingRenderer::ScreenSpaceReflections::Off);
+  }
+  if (_keys_pressed.count(Key::KEY_X))
+  {
+    _engine._renderer.setScreenSpaceReflections(
+      DeferredShadingRenderer::ScreenSpaceReflections::Linear);
+  }
+  if (_keys_pressed.count(Key::KEY_C))
+  {
+    _engine._renderer.setScreenSpaceReflections(
+      DeferredShadingRenderer::ScreenSpaceReflections::HierarchicalZ);
+  }
+
+  if (_keys_pressed.count(Key::KEY_V))
+  {
+    _engine._renderer.setOcclusionCulling(true);
+  }
+  if (_keys_pressed.count(Key::KEY_B))
+  {
+    _engine._renderer.setOcclusionCulling(false);
+  }
+
+  if (_keys_pressed.count(Key::KEY_P))
+  {
+    _engine._renderer.setGpuProfiling(true);
+  }
+  if (_keys_pressed.count(Key::KEY_T))
+  {
+    CpuProfiler::writeChromeTrace("elk_trace.json", &_engine._renderer.gpuProfiler());
+  }
 }
 
 int main(int argc, char const *argv[])
@@ -320,12 +363,22 @@ int main(int argc, char const *argv[])
   window.addController(window_controller);
   window.addController(debug_controller);
   
-  std::function<void(double)> loop = [&](double dt)
+  std::function<void(double)> simulate = [&](double dt)
+  {
+    e.simulate(dt);
+  };
+  std::function<void(double)> render = [&](double alpha)
   {
-    e.update(dt);
+    e.render(alpha);
   };
   
-  window.run(loop);
+  window.setGpuTimeSource([&]() { return e.renderer().takeGpuFrameTimes(); });
+
+  // The simulation runs at 120 Hz whatever the frame rate
+  window.run(1.0 / 120.0, simulate, render);
+
+  window.frameStatistics().printSummary();
+  window.frameStatistics().printHistogram(FrameStatistics::Metric::PresentInterval);
 
   return 0;
 }
@@ -0,0 +1,93 @@
+#include <gl/glew.h>
+
+#include <elk/core/elk_engine.h>
+#include <elk/window/application_window_headless.h>
+#include "elk/core/create_mesh.h"
+#include "elk/core/create_texture.h"
+#include "elk/core/deferred_shading_renderer.h"
+#include "elk/object_extensions/renderable_model.h"
+#include "elk/object_extensions/light_source.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <functional>
+#include <memory>
+
+using namespace elk::core;
+using namespace elk::window;
+
+// Renders a few frames without a display and writes the last one to a file.
+// Only generated textures are used so that no data files are needed.
+class HeadlessEngine : public ElkEngine
+{
+public:
+  HeadlessEngine(int width, int height);
+
+  void update(double dt);
+  DeferredShadingRenderer& renderer() { return _renderer; };
+
+private:
+  DeferredShadingRenderer _renderer;
+
+  RenderableModel _ball;
+  RenderableModel _plane;
+  DirectionalLightSource _sun;
+};
+
+HeadlessEngine::HeadlessEngine(int width, int height) :
+  ElkEngine(),
+  _renderer(perspective_camera, width, height),
+  _ball(CreateMesh::lonLatSphere(64,32),
+    std::make_shared<Material>(
+      CreateTexture::white(100,100),
+      CreateTexture::white(100,100))),
+  _plane(CreateMesh::quad(),
+    std::make_shared<Material>(
+      CreateTexture::white(100,100),
+      CreateTexture::white(100,100))),
+  _sun(glm::vec3(1.0,0.8,0.7), 0.15)
+{
+  _sun.setTransform(glm::rotate(float(M_PI) * 0.4f, glm::vec3(1.0f, 0.0f, -0.65f)));
+  _sun.setCastsShadows(true);
+  _plane.setTransform(glm::scale(glm::vec3(10.0f, 10.0f, 10.0f)));
+  _plane.setTransform(glm::rotate(-float(M_PI / 2), glm::vec3(1.0f, 0.0f, 0.0f)) * _plane.relativeTransform());
+  _plane.setTransform(glm::translate(glm::vec3(0.0f, -1.0f, 0.0f)) * _plane.relativeTransform());
+  perspective_camera.setTransform(glm::translate(glm::vec3(0.0f, 0.5f, 4.0f)));
+
+  scene.addChild(_ball);
+  scene.addChild(_plane);
+  scene.addChild(camera());
+  scene.addChild(_sun);
+}
+
+void HeadlessEngine::update(double dt)
+{
+  ElkEngine::update(dt);
+
+  _renderer.render(scene);
+}
+
+int main(int argc, char const *argv[])
+{
+  const int frames = argc > 1 ? std::atoi(argv[1]) : 10;
+  const char* output = argc > 2 ? argv[2] : "headless_example.ppm";
+
+  ApplicationWindowHeadless window("Headless Example", 720, 480);
+  if (!window.valid())
+    return 1;
+  HeadlessEngine e(window.width(), window.height());
+
+  // The same frames are rendered every run
+  window.setFrameLimit(frames);
+  window.setFixedTimeStep(1.0 / 60.0);
+
+  std::function<void(double)> loop = [&](double dt)
+  {
+    e.update(dt);
+  };
+
+  window.run(loop);
+  printf("GPU frame time %.3f ms\n", e.renderer().gpuFrameTime());
+
+  return window.saveFrame(output) ? 0 : 1;
+}
@@ -26,6 +26,7 @@ public:
   ~ArrayBuffer();
   
   inline GLuint id() { return _id; };
+  inline const InitData& initData() const { return _init_data; };
 
   inline void bind() { glBindBuffer(_init_data.buffer_type, _id); };
   inline void unbind() { glBindBuffer(_init_data.buffer_type, 0); };
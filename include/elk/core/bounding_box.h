@@ -16,6 +16,8 @@ public:
   bool intersects(const glm::vec3& point) const;
   std::pair<bool, float> intersects(
   	const glm::vec3& origin, const glm::vec3& direction) const;
+  //! Axis aligned box enclosing this box transformed by \param transform
+  BoundingBox transformed(const glm::mat4& transform) const;
 private:
   glm::vec3 _min;
   glm::vec3 _max;
@@ -0,0 +1,116 @@
+#pragma once
+
+#include "elk/core/texture.h"
+#include "elk/core/texture_unit.h"
+#include "elk/core/frame_buffer_object.h"
+#include "elk/core/shader_program.h"
+
+#include <glm/glm.hpp>
+
+#include <array>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace elk { namespace core {
+
+class PerspectiveCamera;
+class RenderableDeferred;
+
+struct CascadedShadowMapSettings
+{
+  //! Side of the shadow map of each cascade in texels
+  int resolution = 1024;
+  //! At most four
+  int number_of_cascades = 4;
+  //! Shadows end at this distance from the camera or at the far plane
+  float shadow_distance = 100.0f;
+  //! Blend between logarithmic, 1, and uniform, 0, cascade splits
+  float split_lambda = 0.75f;
+  //! Extra size of each cascade relative to its slice of the view frustum.
+  //! A cascade is only moved when its slice leaves the covered area.
+  float margin = 0.25f;
+  //! Cascades rendered per update, the others keep their last content
+  int max_updates_per_frame = 2;
+};
+
+//! Shadow map of a directional light split in cascades over the view frustum.
+/*!
+  Each cascade covers a bounding sphere of a slice of the camera frustum so
+  that its size does not change when the camera rotates. The cascades are
+  moved in whole texels which keeps the shadow edges from flickering, and
+  only once the slice leaves the margin around the covered area.
+
+  Casters are culled per cascade. A cascade is rendered again only if it
+  moved, if the light direction changed, or if a caster within it was
+  added, removed or moved. Cascades that need it are updated nearest first
+  and at most max_updates_per_frame per update. Cascades left behind keep
+  the transform they were rendered with, the shader picks the first cascade
+  that covers a position so the result stays correct.
+
+  All cascades are tiles of one depth texture.
+*/
+class CascadedShadowMap
+{
+public:
+  static const int max_cascades = 4;
+
+  CascadedShadowMap(
+    CascadedShadowMapSettings settings = CascadedShadowMapSettings());
+  ~CascadedShadowMap();
+
+  //! Fits the cascades to \param camera and renders those that changed
+  /*!
+    \param light_direction is the world space direction the light travels.
+  */
+  void update(
+    const PerspectiveCamera& camera, glm::vec3 light_direction,
+    const std::vector<RenderableDeferred*>& renderables);
+  //! Binds the shadow map to \param unit and sets the uniforms of the current
+  //! program, transforms are from view space of \param camera
+  void setUniforms(const PerspectiveCamera& camera, TextureUnit& unit) const;
+
+  inline const CascadedShadowMapSettings& settings() const { return _settings; };
+  //! Cascades rendered by the last update
+  inline int numberOfUpdatedCascades() const { return _updated_cascades; };
+
+  //! Depth only program of RenderableDeferred::renderShadowCaster()
+  /*!
+    Shared by all shadow maps, created on first use.
+  */
+  static const std::shared_ptr<ShaderProgram>& shadowCasterProgram();
+
+private:
+  struct Cascade
+  {
+    // Center of the covered cube in light space and half its side
+    glm::vec3 center;
+    float half_size;
+    glm::mat4 view;
+    glm::mat4 projection;
+    std::uint64_t signature;
+    bool valid;
+  };
+
+  struct Caster
+  {
+    RenderableDeferred* renderable;
+    // Bounds in light space
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::mat4 transform;
+  };
+
+  void renderCascade(int index, const std::vector<const Caster*>& casters);
+
+  CascadedShadowMapSettings _settings;
+  std::array<Cascade, max_cascades> _cascades;
+  glm::vec3 _light_direction;
+  int _updated_cascades;
+
+  std::unique_ptr<Texture> _depth;
+  FrameBufferObject _fbo;
+  static std::shared_ptr<ShaderProgram> _program;
+};
+
+} }
@@ -0,0 +1,100 @@
+#pragma once
+
+#include "elk/core/texture_unit.h"
+
+#include <gl/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace elk { namespace core {
+
+class PerspectiveCamera;
+class PointLightSource;
+class PointShadowAtlas;
+
+struct ClusteredLightingSettings
+{
+  //! Clusters across the screen
+  int tiles_x = 16;
+  int tiles_y = 9;
+  //! Clusters along the view direction, spaced logarithmically
+  int slices = 24;
+  //! Lights are not shaded beyond this distance or the far plane
+  float max_distance = 1000.0f;
+};
+
+//! Assigns point lights to clusters of the view frustum for shading in one pass.
+/*!
+  The frustum is split in tiles across the screen and in slices along the
+  view direction. Each light is tested against the clusters within its
+  projected bounds, four clusters at a time with SSE where supported. The
+  light data, the range of light indices of each cluster and the indices
+  themselves are uploaded to texture buffers so that a fragment shader can
+  loop over the lights of its cluster only. Texture buffers are core in
+  OpenGL 4.1, unlike shader storage buffers which are only an optional
+  extension there.
+*/
+class ClusteredLighting
+{
+public:
+  ClusteredLighting(
+    ClusteredLightingSettings settings = ClusteredLightingSettings());
+  ~ClusteredLighting();
+  ClusteredLighting(const ClusteredLighting&) = delete;
+  ClusteredLighting& operator=(const ClusteredLighting&) = delete;
+
+  //! Assigns \param lights to the clusters of the frustum of \param camera
+  /*!
+    Slots of lights with rendered shadows in \param shadows are passed on.
+  */
+  void update(
+    const PerspectiveCamera& camera,
+    const std::vector<PointLightSource*>& lights,
+    const PointShadowAtlas& shadows);
+  //! Binds the buffers to the units and sets the uniforms of the current program
+  void setUniforms(
+    TextureUnit& light_unit, TextureUnit& cluster_unit, TextureUnit& index_unit) const;
+
+  inline const ClusteredLightingSettings& settings() const { return _settings; };
+  //! Lights within the frustum at the last update
+  inline int numberOfVisibleLights() const { return _visible_lights; };
+  //! Sum of the number of lights over all clusters at the last update
+  inline int numberOfLightIndices() const { return _light_indices; };
+
+private:
+  struct TextureBuffer
+  {
+    GLuint buffer;
+    GLuint texture;
+  };
+
+  //! Bounds of the clusters in view space, recomputed when the projection changes
+  void updateClusterBounds(const glm::mat4& projection);
+  void upload(const TextureBuffer& buffer, const void* data, size_t size);
+
+  ClusteredLightingSettings _settings;
+  glm::mat4 _projection;
+  float _near;
+  float _far;
+  // Rows of clusters along x padded to a multiple of four, one array per
+  // bound so that four clusters are tested at a time
+  int _row_stride;
+  std::vector<float> _min_x, _min_y, _min_z;
+  std::vector<float> _max_x, _max_y, _max_z;
+
+  std::vector<glm::vec4> _light_data;
+  std::vector<glm::uvec2> _cluster_ranges;
+  std::vector<GLuint> _indices;
+  std::vector<std::uint64_t> _assignments;
+  int _visible_lights;
+  int _light_indices;
+  GLint _max_texels;
+
+  TextureBuffer _light_buffer;
+  TextureBuffer _cluster_buffer;
+  TextureBuffer _index_buffer;
+};
+
+} }
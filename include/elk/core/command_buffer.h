@@ -0,0 +1,122 @@
+#pragma once
+
+#include "elk/core/texture.h"
+
+#include <gl/glew.h>
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace elk { namespace core {
+
+//! A list of draw commands that is recorded on any thread and replayed on
+//! the GL thread.
+/*!
+  Recording makes no GL calls, it only stores object names, uniform
+  locations and values that were resolved on the GL thread beforehand.
+  Commands are small PODs, uniform values are kept in a separate array and
+  referenced by range. Texture slots are indices that are mapped to texture
+  units when replaying.
+  Consecutive commands that do not change anything are dropped when
+  recording, the rest is filtered by RenderState and TextureUnit.
+*/
+class CommandBuffer
+{
+public:
+  struct BindProgram
+  {
+    GLuint program;
+  };
+
+  struct SetSampler
+  {
+    GLint location;
+    GLuint slot;
+  };
+
+  struct SetUniformMatrices
+  {
+    GLint location;
+    //! Range in the recorded matrices
+    GLuint first;
+    GLsizei count;
+  };
+
+  struct BindTexture
+  {
+    GLuint slot;
+    GLenum target;
+    GLuint texture;
+  };
+
+  struct DrawElements
+  {
+    GLuint vertex_array;
+    GLuint element_buffer;
+    //! One bit per attribute array to enable
+    GLuint attributes;
+    GLenum mode;
+    GLsizei count;
+    GLenum index_type;
+  };
+
+  struct Command
+  {
+    enum class Type : uint8_t
+    {
+      BindProgram,
+      SetSampler,
+      SetUniformMatrices,
+      BindTexture,
+      DrawElements
+    };
+
+    Type type;
+    union
+    {
+      BindProgram bind_program;
+      SetSampler set_sampler;
+      SetUniformMatrices set_uniform_matrices;
+      BindTexture bind_texture;
+      DrawElements draw_elements;
+    };
+  };
+
+  CommandBuffer();
+
+  //! \return true if \param program differs from the previously bound one
+  /*!
+    Uniforms that are shared by all draws with the program only need to be
+    recorded when this returns true.
+  */
+  bool bindProgram(GLuint program);
+  //! Points the sampler at \param location to the unit of \param slot
+  void setSampler(GLint location, GLuint slot);
+  void setUniformMatrices(GLint location, const glm::mat4* matrices, GLsizei count = 1);
+  void bindTexture(GLuint slot, const Texture& texture);
+  void drawElements(
+    GLuint vertex_array, GLuint element_buffer, GLuint attributes,
+    GLenum mode, GLsizei count, GLenum index_type);
+
+  //! Issues the recorded commands, needs to be called on the GL thread
+  void replay() const;
+  //! Keeps the allocated memory for the next recording
+  void clear();
+
+  inline bool empty() const { return _commands.empty(); };
+  inline size_t size() const { return _commands.size(); };
+  inline const std::vector<Command>& commands() const { return _commands; };
+  inline int numberOfDraws() const { return _number_of_draws; };
+
+private:
+  std::vector<Command> _commands;
+  std::vector<glm::mat4> _matrices;
+  // Texture last recorded for each slot since the program was bound
+  std::vector<GLuint> _slot_textures;
+  GLuint _program;
+  GLuint _number_of_slots;
+  int _number_of_draws;
+};
+
+} }
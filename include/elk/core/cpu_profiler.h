@@ -0,0 +1,131 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+//! Scoped CPU profiling zones, compiled out unless ELK_ENABLE_PROFILING is set
+/*!
+  Names passed to ELK_PROFILE_ZONE must outlive the frame they are recorded
+  in, string literals or names from CpuProfiler::internName.
+*/
+#ifdef ELK_ENABLE_PROFILING
+  #define ELK_PROFILE_CONCAT_(a, b) a##b
+  #define ELK_PROFILE_CONCAT(a, b) ELK_PROFILE_CONCAT_(a, b)
+  #define ELK_PROFILE_ZONE(name) \
+    ::elk::core::CpuProfiler::ScopedZone ELK_PROFILE_CONCAT(elk_profile_zone_, __LINE__)(name)
+  #define ELK_PROFILE_FRAME() ::elk::core::CpuProfiler::markFrame()
+  #define ELK_PROFILE_THREAD(name) ::elk::core::CpuProfiler::setThreadName(name)
+#else
+  #define ELK_PROFILE_ZONE(name) ((void)0)
+  #define ELK_PROFILE_FRAME() ((void)0)
+  #define ELK_PROFILE_THREAD(name) ((void)0)
+#endif
+
+namespace elk { namespace core {
+
+class GpuProfiler;
+
+//! Collects CPU zones from all threads and heap allocations per frame.
+/*!
+  Each thread records its zones into its own ring buffer without locking.
+  The buffers are drained into a history of the last frames by markFrame,
+  which is called from the thread that owns the frame loop. Zones that do
+  not fit in a full ring buffer are dropped and counted.
+
+  Allocations are only counted when the library is built with
+  ELK_COUNT_ALLOCATIONS, which replaces the global operator new.
+*/
+class CpuProfiler
+{
+public:
+  struct Zone
+  {
+    //! Owned by the caller of recordZone, so collecting does not allocate
+    const char* name;
+    int thread;
+    //! Nanoseconds of the clock returned by now()
+    int64_t begin;
+    int64_t end;
+  };
+
+  struct Frame
+  {
+    unsigned int index;
+    int64_t begin;
+    int64_t end;
+    uint64_t allocations;
+    uint64_t allocated_bytes;
+    //! Zones lost to full ring buffers during the frame
+    uint64_t dropped_zones;
+  };
+
+  //! Records the time from construction to destruction as a zone
+  class ScopedZone
+  {
+  public:
+    inline ScopedZone(const char* name) : _name(name), _begin(now()) { };
+    inline ~ScopedZone() { CpuProfiler::recordZone(_name, _begin, now()); };
+    ScopedZone(const ScopedZone&) = delete;
+    ScopedZone& operator=(const ScopedZone&) = delete;
+
+  private:
+    const char* _name;
+    int64_t _begin;
+  };
+
+  //! Nanoseconds of a steady clock, also used for GPU traces
+  static int64_t now();
+
+  static void recordZone(const char* name, int64_t begin, int64_t end);
+  //! Names the track of the calling thread in traces
+  static void setThreadName(const char* name);
+  //! Returns a copy of \param name that is never freed
+  static const char* internName(const std::string& name);
+
+  //! Ends the current frame and collects the zones of all threads
+  static void markFrame();
+  //! Number of frames kept for zones and traces
+  static void setWindow(int frames);
+
+  //! Called from the allocation hook
+  static inline void countAllocation(size_t bytes)
+  {
+    _allocations.fetch_add(1, std::memory_order_relaxed);
+    _allocated_bytes.fetch_add(bytes, std::memory_order_relaxed);
+  };
+
+  //! Frames in the window, oldest first
+  static const std::deque<Frame>& frames();
+  //! Zones of the frames in the window, in the order they were collected
+  static const std::deque<Zone>& zones();
+  //! Writes the zones and frame markers of the window as Chrome trace JSON
+  /*!
+    Passes measured by \param gpu are added on their own track on the same
+    timeline.
+    \return false if the file could not be written.
+  */
+  static bool writeChromeTrace(const std::string& path, const GpuProfiler* gpu = nullptr);
+  //! Writes one complete event of a Chrome trace, used by both profilers
+  /*!
+    Times are nanoseconds of now() and are written in microseconds from
+    \param start. A negative \param frame is left out.
+  */
+  static void writeTraceEvent(
+    std::ostream& file, const char* name, const char* category, int thread,
+    int64_t start, int64_t begin, int64_t end, int64_t frame = -1);
+  //! Writes the event that names the track of \param thread
+  static void writeThreadName(std::ostream& file, int thread, const char* name);
+  //! Forgets all frames and zones
+  static void reset();
+
+private:
+  static std::atomic<uint64_t> _allocations;
+  static std::atomic<uint64_t> _allocated_bytes;
+};
+
+} }
@@ -25,7 +25,7 @@ public:
   static std::shared_ptr<Mesh> line(glm::vec3 start, glm::vec3 end);
   static std::shared_ptr<Mesh> grid(unsigned int segments);
   static std::shared_ptr<Mesh> circle(unsigned int segments);
-private:
+  //! Triangle elements and texture coordinates of a grid of quads
   static std::pair<std::vector<unsigned short>, std::vector<glm::vec2>>
     createGridPlane(int s_segments, int t_segments);
 };
@@ -2,6 +2,9 @@
 
 #include "elk/core/texture.h"
 #include "elk/core/cube_map_texture.h"
+#include "elk/core/image_processing.h"
+
+#include <glm/gtc/type_precision.hpp>
 
 #include <memory>
 
@@ -13,13 +16,23 @@ public:
   CreateTexture() {};
   ~CreateTexture() {};
   
-  static std::shared_ptr<Texture> load(const char* path);
+  //! Loads an RGBA image and computes its mip maps on the CPU.
+  /*!
+    Use ColorSpace::sRGB for color textures such as albedo so that the mip
+    maps are filtered in linear space.
+  */
+  static std::shared_ptr<Texture> load(
+    const char* path,
+    ColorSpace color_space = ColorSpace::Linear,
+    MipMapFilter filter = MipMapFilter::Box);
   static std::shared_ptr<CubeMapTexture> loadCubeMap(
     const char* path_positive_x, const char* path_negative_x,
     const char* path_positive_y, const char* path_negative_y,
     const char* path_positive_z, const char* path_negative_z);
   static std::shared_ptr<Texture> white(int width, int height);
   static std::shared_ptr<Texture> black(int width, int height);
+  //! Texture filled with \param color
+  static std::shared_ptr<Texture> color(int width, int height, glm::u8vec4 color);
 private:
 };
 
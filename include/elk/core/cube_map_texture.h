@@ -52,8 +52,18 @@ public:
   void bind() const;
 
   int numberOfChannels() const;
-  inline int size() { return _side; };
+  inline int size() const { return _side; };
+  inline Format format() const { return _format; };
+  inline GLenum dataType() const { return _data_type; };
+  //! Pixels of \param face in the order +x, -x, +y, -y, +z, -z
+  const void* faceData(int face) const;
   void upload();
+  //! Allocates \param levels mip levels which are filled by uploadLevel()
+  //! or by rendering to them instead of being generated
+  void setMipMapLevels(int levels);
+  inline int mipMapLevels() const { return _mip_map_level; };
+  //! Uploads \param data to \param level of \param face
+  void uploadLevel(int level, int face, const void* data);
 
   inline GLuint id() const {return _id;};
   
@@ -4,11 +4,22 @@
 #include "elk/core/camera.h"
 #include "elk/core/shader_program.h"
 #include "elk/core/renderer.h"
+#include "elk/core/command_buffer.h"
 #include "elk/core/cube_map_texture.h"
-#include "elk/object_extensions/framebuffer_quad.h"
+#include "elk/core/gpu_timer.h"
+#include "elk/core/gpu_profiler.h"
+#include "elk/core/dynamic_resolution.h"
+#include "elk/core/frame_graph.h"
+#include "elk/core/image_processing.h"
+#include "elk/core/specular_environment.h"
+#include "elk/core/point_shadow_atlas.h"
+#include "elk/core/clustered_lighting.h"
+#include "elk/core/point_light_volumes.h"
+#include "elk/core/worker_pool.h"
 #include "elk/object_extensions/renderable_cube_map.h"
 
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace elk { namespace core {
@@ -19,65 +30,200 @@ class DirectionalLightSource;
 
 class DeferredShadingRenderer : public Renderer {
 public:
+  enum class ScreenSpaceReflections {
+    Off,
+    //! Marches the depth buffer one pixel at a time
+    Linear,
+    //! Skips empty space using a min max depth pyramid
+    HierarchicalZ
+  };
+
   DeferredShadingRenderer(
     PerspectiveCamera& camera, int framebuffer_width, int framebuffer_height);
   ~DeferredShadingRenderer();
   
+  //! The sky box lights the scene and is reflected where rays miss
+  /*!
+    Its specular convolution is loaded from the environment cache directory
+    or computed and stored there.
+  */
   void setSkyBox(std::shared_ptr<RenderableCubeMap> sky_box);
+  //! Where prefiltered sky boxes are stored, the data directory by default
+  inline void setEnvironmentCacheDirectory(const std::string& directory)
+  { _environment_cache_directory = directory; };
   virtual void render(Object3D& scene) override;
+  //! Resizes all render targets
+  virtual void setWindowResolution(int width, int height) override;
+
+  //! Scales the internal resolution to keep the GPU time within a budget
+  /*!
+    The G-buffer and all lighting and post processing buffers are rendered
+    at the scaled resolution and upscaled when rendering to screen.
+  */
+  void setDynamicResolution(
+    bool enabled,
+    DynamicResolutionSettings settings = DynamicResolutionSettings());
+  inline float resolutionScale() const { return _resolution_scale; };
+  //! GPU time of the last measured frame in milliseconds
+  inline double gpuFrameTime() const { return _gpu_timer.elapsedMilliseconds(); };
+  //! GPU times of the frames whose results arrived since the last call
+  /*!
+    Each measured frame is returned once, indexed by the number of frames
+    rendered before it.
+  */
+  inline std::vector<GpuTimer::Result> takeGpuFrameTimes() { return _gpu_timer.takeResults(); };
+  //! Measures the GPU time of each pass of the frame graph
+  void setGpuProfiling(bool enabled);
+  inline bool gpuProfiling() const { return _gpu_profiling; };
+  //! Per pass statistics and traces, empty unless profiling is enabled
+  inline GpuProfiler& gpuProfiler() { return _gpu_profiler; };
+
+  //! Rays missing the screen fall back to the sky box
+  void setScreenSpaceReflections(ScreenSpaceReflections mode);
+  inline ScreenSpaceReflections screenSpaceReflections() const
+  { return _screen_space_reflections; };
+  //! Traces screen space reflections at half resolution
+  /*!
+    One pixel of each 2 x 2 block is traced per frame, a different one each
+    frame. The traces are accumulated over frames by reprojecting them with
+    the camera motion and upsampled using depth and normals.
+  */
+  void setHalfResolutionReflections(bool enabled);
+  inline bool halfResolutionReflections() const
+  { return _half_resolution_reflections; };
+
+  //! Culls occluded instances of renderables that support it on the GPU
+  /*!
+    The G-buffer is rendered in two phases. The first renders what was
+    visible last frame, the second what became visible according to a depth
+    pyramid of the first.
+  */
+  void setOcclusionCulling(bool enabled);
+  inline bool occlusionCulling() const { return _occlusion_culling; };
+
+  //! Records the G-buffer draws on worker threads, disabled by default
+  /*!
+    Each thread of a worker pool records the renderables of one slice of
+    the visible list into its own command buffer, the buffers are then
+    replayed in order. Renderables that can not be recorded are rendered
+    directly afterwards. The pool is created when first enabled.
+  */
+  void setParallelRecording(bool enabled);
+  inline bool parallelRecording() const { return _parallel_recording; };
+
+  //! Shadows of the point lights that cast them
+  inline PointShadowAtlas& pointShadowAtlas() { return _point_shadow_atlas; };
+
+  //! Shades all point lights in one pass over the screen
+  /*!
+    Lights are assigned to clusters of the view frustum on the CPU and each
+    pixel loops over the lights of its cluster. Otherwise a volume around
+    each light is rendered with one instanced draw call.
+  */
+  inline void setClusteredLighting(bool enabled)
+  { _clustered_lighting_enabled = enabled; };
+  inline bool clusteredLighting() const { return _clustered_lighting_enabled; };
 private:
   // Initialization. Called from constructor
   void initializeShaders();
-  void initializeFramebuffers(int framebuffer_width, int framebuffer_height);
+  //! Declares all passes, called again when the set of passes changes
+  void buildFrameGraph();
+  void resizeFramebuffers();
+  void updateDynamicResolution();
 
-  // External render functions called from render()
-  // Input is the fbo to render to
-  void renderGeometryBuffer(FrameBufferQuad& geometry_buffer);
-  void renderLightSources(FrameBufferQuad& light_buffer);
-  
-  // ping pong rendering if irradiance buffers
-  void renderReflections(
-    FrameBufferQuad& sample_buffer, FrameBufferQuad& output_buffer);
-  void renderHighlights(
-    FrameBufferQuad& sample_buffer, FrameBufferQuad& output_buffer);
+  // Pass functions executed by the frame graph, the context holds the
+  // textures declared by the pass
+  void renderGeometryBuffer();
+  void recordGeometryBuffer();
+  void cullOcclusion(
+    FrameGraph::PassContext& context, FrameGraph::Handle depth_pyramid);
+  void renderNewlyVisibleGeometry();
+  void renderShadowMaps();
+  void renderHiZPyramid(FrameGraph::PassContext& context);
+  void renderLightSources(FrameGraph::PassContext& context);
+  void renderReflections(FrameGraph::PassContext& context);
+  void renderReflectionTrace(FrameGraph::PassContext& context);
+  void renderReflectionResolve(FrameGraph::PassContext& context);
+  void renderReflectionHistory(FrameGraph::PassContext& context);
+  void renderHighlights(FrameGraph::PassContext& context);
   void renderPostProcess(
-    FrameBufferQuad& sample_buffer, FrameBufferQuad& output_buffer);
-  void renderPostProcessMotionBlur(
-    FrameBufferQuad& sample_buffer, FrameBufferQuad& output_buffer);
-  void forwardRenderIndependentRenderables(FrameBufferQuad& final_buffer);
-  
-  // Input is the fbo to sample from, index is the attachment to bind
-  void renderToScreen(FrameBufferQuad& sample_fbo_quad, int attachment);
+    FrameGraph::PassContext& context, FrameGraph::Handle bloom_buffer);
+  void renderPostProcessMotionBlur(FrameGraph::PassContext& context);
+  void forwardRenderIndependentRenderables();
+  void renderToScreen(FrameGraph::PassContext& context);
 
   // Internal render functions
-  void renderPointLights();
-  void renderDirectionalLights();
-  void renderDiffuseEnvironmentLights();
-  void renderSkyBox();
-  void renderScreenSpaceReflections(FrameBufferQuad& sample_buffer);
+  void renderPointLights(FrameGraph::PassContext& context);
+  void renderClusteredPointLights(FrameGraph::PassContext& context);
+  void renderDirectionalLights(FrameGraph::PassContext& context);
+  void renderDiffuseEnvironmentLights(FrameGraph::PassContext& context);
+  void renderSkyBox(FrameGraph::PassContext& context);
+  void setReflectionUniforms();
+  //! Binds the prefiltered sky box and renders a screen covering quad
+  void renderWithSpecularEnvironment(FrameGraph::PassContext& context);
+  inline bool tracesReflectionsAtHalfResolution() const
+  {
+    return _half_resolution_reflections &&
+      _screen_space_reflections != ScreenSpaceReflections::Off;
+  };
+  //! From view space of this frame to clip space of the last frame
+  glm::mat4 transformViewToPreviousScreen() const;
 
   std::shared_ptr<ShaderProgram> _shading_program_point_lights;
+  std::shared_ptr<ShaderProgram> _shading_program_clustered_point_lights;
   std::shared_ptr<ShaderProgram> _shading_program_directional_lights;
   std::shared_ptr<ShaderProgram> _shading_program_environment_diffuse;
   std::shared_ptr<ShaderProgram> _shading_program_reflections;
   std::shared_ptr<ShaderProgram> _shading_program_irradiance;
   std::shared_ptr<ShaderProgram> _cube_map_program;
+  std::shared_ptr<ShaderProgram> _hi_z_program;
+  std::unique_ptr<MipMapDownsampler> _hi_z_downsampler;
+  std::shared_ptr<ShaderProgram> _reflection_resolve_program;
+  std::shared_ptr<ShaderProgram> _copy_program;
   
   std::shared_ptr<ShaderProgram> _output_highlights_program;
   std::shared_ptr<ShaderProgram> _post_process_program;
   std::shared_ptr<ShaderProgram> _motion_blur_program;
   std::shared_ptr<ShaderProgram> _final_pass_through_program;
 
-  std::unique_ptr<FrameBufferQuad> _geometry_fbo_quad;
-  // Two irradiance FBOs to be able to perform ping ponging
-  std::unique_ptr<FrameBufferQuad> _irradiance_fbo_quad1;
-  std::unique_ptr<FrameBufferQuad> _irradiance_fbo_quad2;
-  std::unique_ptr<FrameBufferQuad> _post_process_fbo_quad;
+  FrameGraph _frame_graph;
 
   std::shared_ptr<RenderableCubeMap> _sky_box;
+  // Diffuse environment lighting of the sky box
+  SphericalHarmonics9 _sky_box_diffuse;
+  // Specular environment lighting of the sky box
+  std::unique_ptr<SpecularEnvironment> _sky_box_specular;
+  std::string _environment_cache_directory;
+
+  PointShadowAtlas _point_shadow_atlas;
+  PointLightVolumes _point_light_volumes;
+  ClusteredLighting _clustered_lighting;
+  bool _clustered_lighting_enabled;
+
+  // Resolved half resolution reflections of the last frame
+  std::shared_ptr<Texture> _reflection_history;
+  bool _reflection_history_valid;
+  unsigned int _frame_index;
 
   // Cached
   glm::mat4 _camera_previous_view_transform;
+
+  GpuTimer _gpu_timer;
+  GpuProfiler _gpu_profiler;
+  bool _gpu_profiling;
+  DynamicResolution _dynamic_resolution;
+  bool _dynamic_resolution_enabled;
+  float _resolution_scale;
+
+  ScreenSpaceReflections _screen_space_reflections;
+  bool _half_resolution_reflections;
+  bool _occlusion_culling;
+
+  // One per slice of the visible list, kept to reuse their memory
+  std::vector<CommandBuffer> _geometry_commands;
+  std::vector<std::vector<RenderableDeferred*> > _unrecorded_renderables;
+  std::unique_ptr<WorkerPool> _worker_pool;
+  bool _parallel_recording;
 };
 
 } }
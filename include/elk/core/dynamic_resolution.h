@@ -0,0 +1,54 @@
+#pragma once
+
+namespace elk { namespace core {
+
+struct DynamicResolutionSettings
+{
+  float min_scale = 0.5f;
+  float max_scale = 1.0f;
+  float scale_step = 0.05f;
+  //! GPU time budget per frame in milliseconds
+  double frame_budget = 16.0;
+  //! The scale grows only if the time is below frame_budget * headroom
+  double headroom = 0.8;
+  //! Frames to wait after a change before growing again
+  int cooldown_frames = 30;
+  //! GPU timings arrive a few frames late, measurements made this many
+  //! frames after a change are ignored
+  int latency_frames = 4;
+  //! Weight of the latest measurement in the moving average
+  double smoothing = 0.2;
+};
+
+//! Picks a render resolution scale that keeps the GPU time within a budget.
+/*!
+  The scale drops immediately when the smoothed GPU time exceeds the budget
+  and grows one step at a time when there is headroom, waiting a number of
+  frames between changes so that the resolution does not oscillate.
+  Scales are quantized to steps to limit how often render targets need to
+  be reallocated.
+*/
+class DynamicResolution
+{
+public:
+  DynamicResolution(
+    DynamicResolutionSettings settings = DynamicResolutionSettings());
+
+  //! Feeds a measured GPU time, \return the scale to render with
+  float update(double gpu_time);
+
+  inline float scale() const { return _scale; };
+  inline double smoothedGpuTime() const { return _smoothed_gpu_time; };
+  inline const DynamicResolutionSettings& settings() const { return _settings; };
+  void setSettings(DynamicResolutionSettings settings);
+
+private:
+  float quantize(float scale) const;
+
+  DynamicResolutionSettings _settings;
+  float _scale;
+  double _smoothed_gpu_time;
+  int _frames_since_change;
+};
+
+} }
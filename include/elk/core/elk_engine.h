@@ -32,6 +32,14 @@ public:
 protected:
   //! Update all objects
   void update(double dt);
+  //! Advances all objects by one fixed simulation step of \param dt
+  void step(double dt);
+  //! Updates transforms for a rendered frame in between the last two steps
+  /*!
+    \param alpha is the fraction of a step that has passed since the last
+    one, in [0, 1].
+  */
+  void interpolate(double alpha);
 
   // Add children to these objects
   Object3D scene;
@@ -43,6 +51,7 @@ protected:
 private:
   //! Initializes GLEW, an OpenGL context needs to be active
   virtual bool _initializeGL();
+  void beginFrame();
 };
 
 } }
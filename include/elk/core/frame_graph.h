@@ -0,0 +1,220 @@
+#pragma once
+
+#include "elk/core/texture.h"
+#include "elk/core/texture_unit.h"
+#include "elk/core/frame_buffer_object.h"
+#include "elk/core/gpu_profiler.h"
+#include "elk/core/mip_map_downsampler.h"
+#include "elk/core/mesh.h"
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace elk { namespace core {
+
+//! Orders render passes by the textures they read and write.
+/*!
+  Passes are added in execution order. Each pass declares the textures it
+  samples from and the textures it renders to in a setup function which is
+  run immediately by addPass(). compile() then
+  - culls passes whose output is never used,
+  - schedules mip map generation before the first pass that samples a
+    texture with mip maps, building only as many levels as its readers use,
+  - assigns transient textures to a pool of physical textures so that
+    textures with the same description and disjoint lifetimes share memory,
+  - creates one framebuffer per pass.
+  Writing to a texture creates a new version of it, a pass that renders on
+  top of existing content without clearing depends on the previous version.
+  The graph is compiled once and executed every frame. It only has to be
+  rebuilt when the set of passes changes.
+*/
+class FrameGraph
+{
+public:
+  struct TextureDescription
+  {
+    Texture::Format format;
+    GLint internal_format;
+    GLenum data_type;
+    Texture::FilterMode filter;
+    //! Size relative to the resolution of the graph
+    float scale;
+    //! Number of mip levels allocated, 1 for none
+    int mip_levels = 1;
+
+    bool operator==(const TextureDescription& other) const;
+  };
+
+  //! Refers to one version of a texture
+  using Handle = int;
+  static const Handle invalid_handle = -1;
+
+  class PassBuilder
+  {
+  public:
+    //! Creates a transient texture, it has no content until it is written to
+    Handle create(const std::string& name, TextureDescription description);
+    //! Samples \param texture as \param sampler_name in the pass
+    /*!
+      \param mip_levels is the number of levels the pass samples. Levels
+      above the base level are generated before the first pass that needs
+      them.
+    */
+    void read(Handle texture, const std::string& sampler_name, int mip_levels = 1);
+    //! Renders to \param texture, \return the new version of the texture
+    /*!
+      If \param clear is false the pass renders on top of the previous content.
+    */
+    Handle write(Handle texture, GLenum attachment, bool clear = true);
+    //! The pass is never culled. Passes without any writes render to screen
+    //! or to buffers outside of the graph.
+    void setSideEffect();
+
+  private:
+    friend class FrameGraph;
+    PassBuilder(FrameGraph& graph, int pass);
+
+    FrameGraph& _graph;
+    int _pass;
+  };
+
+  class PassContext
+  {
+  public:
+    //! Binds the textures read by the pass to texture units
+    /*!
+      The samplers of the current shader program are set to the units so it
+      needs to be called once for each program used in the pass.
+    */
+    void bindReads();
+    Texture& texture(Handle handle);
+    //! Texture of the \param index:th write declared by the pass
+    Texture& renderTarget(int index = 0);
+    //! Size of the render targets of the pass
+    inline int width() const { return _width; };
+    inline int height() const { return _height; };
+    //! Renders a screen covering quad
+    void renderQuad();
+
+  private:
+    friend class FrameGraph;
+    PassContext(FrameGraph& graph, int pass, int width, int height);
+
+    FrameGraph& _graph;
+    int _pass;
+    int _width, _height;
+    std::vector<TextureUnit> _texture_units;
+  };
+
+  using Setup = std::function<void(PassBuilder&)>;
+  using Execute = std::function<void(PassContext&)>;
+
+  FrameGraph(int width, int height);
+  ~FrameGraph();
+
+  //! Removes all passes and textures. Physical textures are kept for reuse.
+  void reset();
+  //! Adds a texture which outlives the graph, for example a history buffer
+  /*!
+    Imported textures are never aliased and passes writing to them are
+    never culled.
+  */
+  Handle importTexture(const std::string& name, std::shared_ptr<Texture> texture);
+  void addPass(const std::string& name, Setup setup, Execute execute);
+  void compile();
+  void execute();
+  //! Resizes all transient textures
+  void setResolution(int width, int height);
+
+  //! Size of a transient texture with relative size \param scale
+  glm::uvec3 scaledSize(float scale) const;
+
+  inline int numberOfPhysicalTextures() const { return _physical_textures.size(); };
+  int numberOfCulledPasses() const;
+  //! Prints the passes and the physical texture used for each texture
+  void print() const;
+  //! Measures each executed pass with \param profiler, nullptr to stop
+  inline void setProfiler(GpuProfiler* profiler) { _profiler = profiler; };
+
+private:
+  struct Resource
+  {
+    std::string name;
+    TextureDescription description;
+    std::shared_ptr<Texture> imported;
+    // Index in _physical_textures, -1 if not allocated
+    int physical;
+    int first_use;
+    int last_use;
+  };
+
+  struct Version
+  {
+    int resource;
+    // Pass writing this version, -1 for the initial version
+    int producer;
+    // The version this one is rendered on top of
+    Handle previous;
+    // Most levels sampled by any reader of this version
+    int mip_levels;
+  };
+
+  struct Read
+  {
+    Handle handle;
+    std::string sampler_name;
+    int mip_levels;
+  };
+
+  struct Write
+  {
+    Handle handle;
+    GLenum attachment;
+    bool clear;
+    // Index in the draw buffers of the pass framebuffer
+    int draw_buffer;
+  };
+
+  struct Pass
+  {
+    std::string name;
+    // Never freed so that recorded zones can refer to it
+    const char* zone_name;
+    Execute execute;
+    std::vector<Read> reads;
+    std::vector<Write> writes;
+    bool side_effect;
+    bool culled;
+    // Resources and number of levels to generate before the pass
+    std::vector<std::pair<int, int>> generate_mip_maps;
+    std::unique_ptr<FrameBufferObject> fbo;
+  };
+
+  struct PhysicalTexture
+  {
+    TextureDescription description;
+    std::shared_ptr<Texture> texture;
+    int last_use;
+  };
+
+  void cullPasses();
+  void computeLifetimes();
+  void allocateTextures();
+  void createFramebuffers();
+  void clearTargets(const Pass& pass);
+  Texture& textureOf(int resource);
+
+  int _width, _height;
+  bool _compiled;
+  std::vector<Resource> _resources;
+  std::vector<Version> _versions;
+  std::vector<Pass> _passes;
+  std::vector<PhysicalTexture> _physical_textures;
+  std::shared_ptr<Mesh> _quad;
+  MipMapDownsampler _downsampler;
+  GpuProfiler* _profiler;
+};
+
+} }
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+
+namespace elk { namespace core {
+
+//! Records the times of the last frames and summarizes their distribution.
+/*!
+  Each frame has a CPU time, a GPU time and the interval since the previous
+  frame was presented. GPU times arrive some frames later and are recorded
+  separately, once per measured frame. Both are kept in ring buffers,
+  summaries are only computed when asked for. Percentiles use the nearest
+  rank.
+*/
+class FrameStatistics
+{
+public:
+  enum class Metric
+  {
+    CpuTime,
+    GpuTime,
+    PresentInterval
+  };
+
+  struct Summary
+  {
+    int number_of_samples;
+    //! All times in milliseconds
+    double min;
+    double mean;
+    double p50;
+    double p95;
+    double p99;
+    double max;
+    //! Frames longer than the budget
+    int number_over_budget;
+    //! Frames longer than twice the budget
+    int number_of_hitches;
+  };
+
+  //! \param capacity is the number of frames kept
+  FrameStatistics(int capacity = 1000);
+
+  //! Times in milliseconds of the frame that was just presented
+  void record(double cpu_time, double present_interval);
+  //! GPU time in milliseconds of the measured frame \param frame
+  /*!
+    Frames have to be recorded in increasing order, a frame that is not
+    newer than the last recorded one is ignored.
+  */
+  void recordGpuTime(unsigned int frame, double gpu_time);
+  //! Frame time to compare against, 60 Hz by default
+  inline void setBudget(double milliseconds) { _budget = milliseconds; };
+  inline double budget() const { return _budget; };
+
+  Summary summary(Metric metric) const;
+  void printSummary(FILE* file = stdout) const;
+  //! Prints the number of frames in buckets of \param bucket_size milliseconds
+  void printHistogram(Metric metric, double bucket_size = 1.0, FILE* file = stdout) const;
+  void clear();
+
+  static const char* metricName(Metric metric);
+
+private:
+  struct Frame
+  {
+    double cpu_time;
+    double present_interval;
+  };
+
+  struct GpuFrame
+  {
+    unsigned int frame;
+    double gpu_time;
+  };
+
+  //! Recorded values of \param metric, oldest first
+  std::vector<double> values(Metric metric) const;
+
+  std::vector<Frame> _frames;
+  std::vector<GpuFrame> _gpu_frames;
+  int _capacity;
+  int _next;
+  int _next_gpu;
+  double _budget;
+};
+
+} }
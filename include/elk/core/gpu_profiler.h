@@ -0,0 +1,114 @@
+#pragma once
+
+#include <gl/glew.h>
+
+#include <array>
+#include <cstdint>
+#include <deque>
+#include <iosfwd>
+#include <string>
+#include <vector>
+
+namespace elk { namespace core {
+
+//! Measures the GPU time of each pass of a frame without stalling.
+/*!
+  A timestamp query is issued where each pass begins and ends. Timestamps
+  rather than elapsed time queries are used since those can not be nested
+  and a GpuTimer may be measuring the whole frame. Queries of a frame are
+  read a few frames after they were issued from a ring of query sets. A
+  frame whose results have not arrived when its set is needed again is
+  dropped.
+
+  Statistics of each pass are kept over the last frames. Passes of the
+  last frames can be written as Chrome trace events, which load in
+  chrome://tracing or Perfetto.
+*/
+class GpuProfiler
+{
+public:
+  struct PassStatistics
+  {
+    std::string name;
+    //! All times in milliseconds over the frames in the window
+    double last;
+    double average;
+    double min;
+    double max;
+    int number_of_samples;
+  };
+
+  struct TraceEvent
+  {
+    std::string name;
+    unsigned int frame;
+    //! Nanoseconds of the clock of CpuProfiler::now()
+    int64_t begin;
+    int64_t end;
+  };
+
+  //! \param window is the number of frames kept for statistics and traces
+  GpuProfiler(int window = 120);
+  ~GpuProfiler();
+  GpuProfiler(const GpuProfiler&) = delete;
+  GpuProfiler& operator=(const GpuProfiler&) = delete;
+
+  void beginFrame();
+  //! Reads the results of earlier frames that have arrived
+  void endFrame();
+  //! Passes can not be nested
+  void beginPass(const std::string& name);
+  void endPass();
+
+  //! Passes in the order they were first measured
+  inline const std::vector<PassStatistics>& statistics() const { return _statistics; };
+  void printStatistics() const;
+  //! Writes the measured passes of the frames in the window as JSON
+  /*!
+    \return false if the file could not be written.
+  */
+  bool writeChromeTrace(const std::string& path) const;
+  //! Writes the passes of the window as trace events on the track \param thread
+  /*!
+    Each event is preceded by a comma, times are written in microseconds
+    from \param start on the clock of CpuProfiler::now().
+  */
+  void writeTraceEvents(std::ostream& file, int thread, int64_t start) const;
+  //! Passes of the frames in the window, oldest first
+  inline const std::deque<TraceEvent>& traceEvents() const { return _trace; };
+  //! Forgets all statistics and trace events
+  void reset();
+
+private:
+  static const int number_of_frames = 4;
+
+  struct Frame
+  {
+    // Begin and end timestamp of each pass
+    std::vector<GLuint> queries;
+    std::vector<std::string> names;
+    int number_of_passes;
+    unsigned int index;
+    // Added to GPU timestamps to get CPU clock time
+    int64_t clock_offset;
+    bool pending;
+  };
+
+  //! Reads the results of \param frame if they have arrived
+  bool readFrame(Frame& frame);
+  void addSample(const std::string& name, double milliseconds);
+
+  std::array<Frame, number_of_frames> _frames;
+  int _current_frame;
+  unsigned int _frame_index;
+  bool _in_frame;
+  bool _in_pass;
+
+  const int _window;
+  std::vector<PassStatistics> _statistics;
+  // Times of the frames in the window, one queue per pass
+  std::vector<std::deque<double> > _samples;
+  std::deque<TraceEvent> _trace;
+};
+
+} }
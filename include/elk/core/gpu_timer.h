@@ -0,0 +1,57 @@
+#pragma once
+
+#include <gl/glew.h>
+
+#include <array>
+#include <vector>
+
+namespace elk { namespace core {
+
+//! Measures GPU time between begin() and end() without stalling.
+/*!
+  Uses a ring of GL_TIME_ELAPSED queries so that results are read a few
+  frames after they were issued. Only one GpuTimer can be active at a time.
+  Every result that arrives is kept until taken with takeResults(), so that
+  statistics see each measurement exactly once.
+*/
+class GpuTimer
+{
+public:
+  struct Result
+  {
+    //! Number of begin() calls before the measurement
+    unsigned int index;
+    double milliseconds;
+  };
+
+  GpuTimer();
+  ~GpuTimer();
+
+  void begin();
+  void end();
+  //! Reads finished queries, returns true if a new result is available
+  bool poll();
+  //! Last measured time in milliseconds, negative until the first result
+  inline double elapsedMilliseconds() const { return _elapsed_milliseconds; };
+  //! Results read by poll() since the last call, oldest first
+  /*!
+    Measurements whose query was reused before its result arrived are
+    missing. At most the last 1024 results are kept.
+  */
+  std::vector<Result> takeResults();
+
+private:
+  static const int number_of_queries = 4;
+  static const size_t max_results = 1024;
+
+  std::array<GLuint, number_of_queries> _queries;
+  // Index of the measurement of each query
+  std::array<unsigned int, number_of_queries> _indices;
+  unsigned int _next_index;
+  std::vector<Result> _results;
+  int _next_query;
+  int _pending_queries;
+  double _elapsed_milliseconds;
+};
+
+} }
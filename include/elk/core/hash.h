@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace elk { namespace core {
+
+//! Initial key of hashBytes()
+const std::uint64_t hash_offset_basis = 14695981039346656037ull;
+
+//! Folds \param size bytes at \param data into \param key with 64 bit FNV-1a
+inline void hashBytes(std::uint64_t& key, const void* data, size_t size)
+{
+  const unsigned char* bytes = static_cast<const unsigned char*>(data);
+  for (size_t i = 0; i < size; ++i)
+  {
+    key ^= bytes[i];
+    key *= 1099511628211ull;
+  }
+}
+
+} }
@@ -0,0 +1,88 @@
+#pragma once
+
+#include "elk/core/cube_map_texture.h"
+
+#include <gl/glew.h>
+#include <glm/glm.hpp>
+
+#include <array>
+#include <vector>
+
+namespace elk { namespace core {
+
+enum class ColorSpace {
+  Linear,
+  sRGB
+};
+
+enum class MipMapFilter {
+  Box,
+  Kaiser
+};
+
+//! Converts BGRA pixels to RGBA.
+/*!
+  Uses SSSE3 or AVX2 when supported by the CPU. \param source and
+  \param destination may point to the same memory to swizzle in place.
+*/
+void swizzleBGRAToRGBA(
+  const GLubyte* source, GLubyte* destination, size_t number_of_pixels);
+
+//! Computes the mip map chain of an RGBA image with 8 bits per channel.
+/*!
+  Filtering is done in linear space, color channels of \param color_space
+  sRGB are decoded before filtering and encoded again afterwards. Alpha is
+  always treated as linear. The work is split over all hardware threads.
+  \return levels 1 to n, each allocated with new GLubyte[]. The caller takes
+  ownership of the data.
+*/
+std::vector<GLubyte*> generateMipMapChain(
+  const GLubyte* pixels, glm::uvec2 size, MipMapFilter filter,
+  ColorSpace color_space);
+
+//! Coefficients of the real spherical harmonics of band 0 to 2, one per channel
+/*!
+  Ordered Y00, Y1-1, Y10, Y11, Y2-2, Y2-1, Y20, Y21, Y22.
+*/
+using SphericalHarmonics9 = std::array<glm::vec3, 9>;
+
+//! Projects the radiance of \param cube_map on spherical harmonics.
+/*!
+  Each texel is weighted by the solid angle it covers. The faces must be kept
+  in memory with 8 bit or floating point RGB or RGBA data, other formats
+  project to zero. Rows are split over all hardware threads and processed
+  four texels at a time with SSE where supported.
+*/
+SphericalHarmonics9 projectOnSphericalHarmonics(const CubeMapTexture& cube_map);
+
+//! Convolves \param radiance with the clamped cosine lobe
+/*!
+  \return the radiance reflected by a white Lambertian surface, that is the
+  irradiance divided by pi, as a function of the surface normal.
+*/
+SphericalHarmonics9 diffuseReflection(const SphericalHarmonics9& radiance);
+
+//! Levels of a cube map as floating point RGBA, six faces per level
+using CubeMapLevels = std::vector<std::array<std::vector<float>, 6> >;
+
+//! Convolves the radiance of \param cube_map with the GGX distribution.
+/*!
+  Level l of the result has side \param side >> l and roughness
+  l / (\param levels - 1). Each texel averages \param number_of_samples
+  importance sampled directions, read from a box filtered mip chain of the
+  source at the level matching the solid angle of the sample. The source
+  faces must be readable as for projectOnSphericalHarmonics(). Rows are
+  split over all hardware threads.
+*/
+CubeMapLevels prefilterGGX(
+  const CubeMapTexture& cube_map, int side, int levels, int number_of_samples);
+
+//! Integrates the GGX specular BRDF for the split sum approximation
+/*!
+  \return \param size x \param size pairs of scale and bias to apply to the
+  Fresnel reflectance at normal incidence. Columns are n dot v and rows
+  roughness, both from 0 to 1.
+*/
+std::vector<float> integrateSpecularBRDF(int size, int number_of_samples);
+
+} }
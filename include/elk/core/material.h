@@ -1,5 +1,6 @@
 #pragma once
 
+#include "elk/core/command_buffer.h"
 #include "elk/core/texture.h"
 #include "elk/core/shader_program.h"
 
@@ -7,6 +8,8 @@
 
 namespace elk { namespace core {
 
+class AbstractCamera;
+
 class Material
 {
 public:
@@ -20,6 +23,20 @@ public:
 
   void use();
   GLint programId() { return _gbuffer_program->id(); };
+  //! Records use() and the transforms of one draw into \param commands
+  /*!
+    Uniform locations are looked up when the program is created, so this may
+    be called from any thread. View and projection are only recorded when
+    the program changes.
+  */
+  void record(CommandBuffer& commands, const glm::mat4& model,
+    const AbstractCamera& camera) const;
+
+  const std::shared_ptr<Texture>& albedoTexture() const { return _albedo_texture; };
+  const std::shared_ptr<Texture>& roughnessTexture() const { return _roughness_texture; };
+  const std::shared_ptr<Texture>& R0Texture() const { return _R0_texture; };
+  const std::shared_ptr<Texture>& metalnessTexture() const { return _metalness_texture; };
+  const std::shared_ptr<Texture>& normalTexture() const { return _normal_texture; };
   
 private:
   void initialize();
@@ -30,7 +47,17 @@ private:
   std::shared_ptr<Texture> _metalness_texture;
   std::shared_ptr<Texture> _normal_texture;
   
+  struct UniformLocations
+  {
+    GLint M;
+    GLint V;
+    GLint P;
+    //! Samplers in the order of the textures above
+    GLint textures[5];
+  };
+
   static std::shared_ptr<ShaderProgram> _gbuffer_program;
+  static UniformLocations _locations;
 };
 
 } }
@@ -1,6 +1,7 @@
 #pragma once
 
 #include "elk/core/array_buffer.h"
+#include "elk/core/command_buffer.h"
 #include "elk/core/vertex_array.h"
 
 #include <gl/glew.h>
@@ -28,9 +29,20 @@ public:
   ~Mesh();
 
   virtual void render();
+  //! Records what render() does, may be called from any thread
+  /*!
+    Only meshes with elements can be recorded, others need render().
+  */
+  void recordDraw(CommandBuffer& commands) const;
   glm::vec3 computeMinPosition() const;
   glm::vec3 computeMaxPosition() const;
 
+  const std::vector<unsigned short>* elements() const { return _elements; };
+  const std::vector<glm::vec3>* positions() const { return _positions; };
+  const std::vector<glm::vec3>* normals() const { return _normals; };
+  const std::vector<glm::vec2>* textureCoordinates() const { return _texture_coordinates; };
+  const std::vector<glm::vec3>* tangents() const { return _tangents; };
+
 protected:
   VertexArray _vao;
 private:
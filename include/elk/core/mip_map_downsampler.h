@@ -0,0 +1,39 @@
+#pragma once
+
+#include "elk/core/texture.h"
+#include "elk/core/frame_buffer_object.h"
+#include "elk/core/shader_program.h"
+#include "elk/core/mesh.h"
+
+#include <memory>
+#include <string>
+
+namespace elk { namespace core {
+
+//! Builds mip maps of render targets by rendering each level from the last.
+/*!
+  Unlike glGenerateMipmap only the requested number of levels is built.
+  By default each level is a bilinear 2x2 box filter of the level above, a
+  custom fragment shader can reduce the levels differently. It samples the
+  uniform sampler2D source at lod 0 and renders a level of size
+  destination_size. While a level
+  is rendered, the base and max level of the texture are restricted to the
+  source level so that the texture is not sampled where it is written.
+*/
+class MipMapDownsampler
+{
+public:
+  MipMapDownsampler();
+  MipMapDownsampler(const std::string& name, const std::string& fragment_shader);
+  ~MipMapDownsampler();
+
+  //! Renders levels 1 to \param levels - 1 of \param texture
+  void downsample(Texture& texture, int levels);
+
+private:
+  std::unique_ptr<ShaderProgram> _program;
+  FrameBufferObject _fbo;
+  std::shared_ptr<Mesh> _quad;
+};
+
+} }
@@ -13,6 +13,8 @@ class PointLightSource;
 class DirectionalLightSource;
 class Renderer;
 class PerspectiveCamera;
+class Texture;
+class CommandBuffer;
 
 //! An object positioned in 3D space.
 /*!
@@ -22,7 +24,7 @@ class PerspectiveCamera;
 */
 class Object3D {
 public:
-  Object3D() {};
+  Object3D() : _transform_step(0) {};
   //! Destructor
   /*!
     The _children of the Object3D is not destroyed when the Object3D is destroyed.
@@ -39,16 +41,31 @@ public:
   */
   void removeChild(Object3D& child);
   void updateTransform(const glm::mat4& stacked_transform);
+  //! Updates the absolute transforms in between the last two simulation steps
+  /*!
+    Relative transforms set during the last step are blended from their
+    value before it, \param alpha 0 gives the previous and 1 the current.
+  */
+  void updateTransform(const glm::mat4& stacked_transform, float alpha);
   virtual void submit(Renderer& renderer);
   virtual void update(double dt);
 
   const glm::mat4& relativeTransform() const;
   const glm::mat4& absoluteTransform() const;
   void setTransform(const glm::mat4& transform);
+
+  //! Starts a new fixed simulation step, transforms set after this are interpolated
+  static inline void beginSimulationStep() { _simulation_step++; };
 private:
   std::vector<Object3D*> _children;
   glm::mat4 _relative_transform;
   glm::mat4 _absolute_transform;
+  // Relative transform before it was first set in step _transform_step
+  glm::mat4 _previous_relative_transform;
+  unsigned int _transform_step;
+
+  // Zero until the first step, nothing is interpolated before it
+  static unsigned int _simulation_step;
 };
 
 // Data needed when rendering
@@ -64,6 +81,38 @@ public:
   ~RenderableDeferred() {};
   virtual void submit(Renderer& renderer) override;
   virtual void render(const UsefulRenderData& render_data) = 0;
+  //! Records what render() does instead of doing it
+  /*!
+    Called from worker threads for disjoint sets of renderables, so it may
+    only read the renderable, its resources and \param render_data.
+    \return false if the renderable can not be recorded and needs render().
+  */
+  virtual bool recordCommands(
+    CommandBuffer& commands, const UsefulRenderData& render_data) { return false; };
+
+  //! True if the renderable can be rendered in two occlusion culling phases
+  /*!
+    The first phase renders what was visible last frame with renderVisible().
+    cullOcclusion() then tests everything against a depth pyramid of the first
+    phase and renderNewlyVisible() renders what became visible.
+  */
+  virtual bool supportsOcclusionCulling() const { return false; };
+  virtual void renderVisible(const UsefulRenderData& render_data) {};
+  //! \param depth_pyramid holds the min and max linear depth of each cell
+  virtual void cullOcclusion(
+    const UsefulRenderData& render_data, Texture& depth_pyramid) {};
+  virtual void renderNewlyVisible(const UsefulRenderData& render_data) {};
+
+  //! World space bounds used to cull shadow casters
+  /*!
+    \return false if the renderable does not cast shadows. Shadow maps that
+    the renderable is within are rendered again when its bounds or transform
+    change.
+  */
+  virtual bool shadowCasterBounds(glm::vec3& min, glm::vec3& max) { return false; };
+  //! Renders depth only, as seen by a light with \param view and \param projection
+  virtual void renderShadowCaster(
+    const glm::mat4& view, const glm::mat4& projection) {};
 };
 
 class RenderableForward : public Object3D
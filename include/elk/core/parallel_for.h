@@ -0,0 +1,44 @@
+#pragma once
+
+#include "elk/core/cpu_profiler.h"
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+namespace elk { namespace core {
+
+//! Runs f(begin, end) over [0, n) split into one chunk per hardware thread.
+/*!
+  Ranges with less than \param min_chunk_size items per thread are not worth
+  spawning threads for and use fewer threads. The calling thread runs the
+  first chunk.
+*/
+template <typename F>
+void parallelFor(int n, const F& f, int min_chunk_size = 32)
+{
+  int n_threads = std::max(1u, std::thread::hardware_concurrency());
+  n_threads = std::min(n_threads, n / std::max(min_chunk_size, 1));
+  if (n_threads <= 1)
+  {
+    f(0, n);
+    return;
+  }
+  std::vector<std::thread> threads;
+  int chunk = (n + n_threads - 1) / n_threads;
+  for (int begin = chunk; begin < n; begin += chunk)
+  {
+    threads.emplace_back([&f](int begin, int end)
+    {
+      ELK_PROFILE_ZONE("parallelFor");
+      f(begin, end);
+    }, begin, std::min(begin + chunk, n));
+  }
+  f(0, std::min(chunk, n));
+  for (auto& thread : threads)
+  {
+    thread.join();
+  }
+}
+
+} }
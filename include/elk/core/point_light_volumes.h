@@ -0,0 +1,61 @@
+#pragma once
+
+#include <gl/glew.h>
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace elk { namespace core {
+
+class PerspectiveCamera;
+class PointLightSource;
+class PointShadowAtlas;
+
+//! Draws a volume around each point light with one instanced draw call.
+/*!
+  All lights share one sphere, scaled and positioned per instance. Only the
+  back faces are rendered so that each pixel is shaded once per light also
+  when the camera is inside a volume. The light data is passed to the
+  shader as instance attributes together with the depth range of the
+  volume, pixels with scene depth outside of it are rejected before the
+  G-buffer is read.
+*/
+class PointLightVolumes
+{
+public:
+  PointLightVolumes();
+  ~PointLightVolumes();
+  PointLightVolumes(const PointLightVolumes&) = delete;
+  PointLightVolumes& operator=(const PointLightVolumes&) = delete;
+
+  //! Renders the volumes of \param lights with the current program
+  /*!
+    Slots of lights with rendered shadows in \param shadows are passed on.
+  */
+  void render(
+    const PerspectiveCamera& camera,
+    const std::vector<PointLightSource*>& lights,
+    const PointShadowAtlas& shadows);
+
+  //! Lights drawn by the last render
+  inline int numberOfLights() const { return int(_instances.size()); };
+
+private:
+  struct Instance
+  {
+    // View space position and radius
+    glm::vec4 position_radius;
+    glm::vec4 color_flux;
+    // Corner of the shadow atlas slot, far plane and 1 if shadowed
+    glm::vec4 shadow;
+  };
+
+  GLuint _vao;
+  GLuint _position_buffer;
+  GLuint _element_buffer;
+  GLuint _instance_buffer;
+  GLsizei _number_of_elements;
+  std::vector<Instance> _instances;
+};
+
+} }
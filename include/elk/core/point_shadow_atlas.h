@@ -0,0 +1,116 @@
+#pragma once
+
+#include "elk/core/texture.h"
+#include "elk/core/texture_unit.h"
+#include "elk/core/frame_buffer_object.h"
+#include "elk/core/shader_program.h"
+
+#include <glm/glm.hpp>
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <vector>
+
+namespace elk { namespace core {
+
+class PerspectiveCamera;
+class PointLightSource;
+class RenderableDeferred;
+
+struct PointShadowAtlasSettings
+{
+  //! Side of each cube face in texels
+  int face_resolution = 256;
+  //! Side of the atlas texture in texels, holds six faces per light
+  int atlas_resolution = 4096;
+  //! Lights rendered per update, the others keep their last content
+  int max_updates_per_frame = 4;
+  //! Distance of the near plane of the faces from the light
+  float near_plane = 0.05f;
+};
+
+//! Cube shadow maps of point lights packed in one depth texture.
+/*!
+  Each light that casts shadows gets a slot of six faces, three by two
+  tiles. Slots are kept between frames and handed to other lights in least
+  recently used order when the atlas is full.
+
+  A light is rendered again only if it moved or a caster within its radius
+  was added, removed or moved, so static lights cost nothing after their
+  first update. Lights that need it are rendered by priority and at most
+  max_updates_per_frame per update. The priority grows with the size of the
+  light seen from the camera and with the number of frames it has waited,
+  lights that have never been rendered come first. Lights left behind keep
+  their last shadows and lights without a slot are not shadowed.
+*/
+class PointShadowAtlas
+{
+public:
+  PointShadowAtlas(
+    PointShadowAtlasSettings settings = PointShadowAtlasSettings());
+  ~PointShadowAtlas();
+
+  //! Renders the shadows of those \param lights that cast them and changed
+  void update(
+    const PerspectiveCamera& camera,
+    const std::vector<PointLightSource*>& lights,
+    const std::vector<RenderableDeferred*>& renderables);
+  //! Binds the atlas to \param unit and sets the uniforms shared by all
+  //! lights, called once per program
+  void bind(TextureUnit& unit, const PerspectiveCamera& camera) const;
+  //! Texture space corner of the slot of \param light
+  /*!
+    \return false if the light has no rendered slot.
+  */
+  bool slotOrigin(const PointLightSource& light, glm::vec2& origin) const;
+
+  //! Drops all slots, the shadows are rendered again
+  void setSettings(PointShadowAtlasSettings settings);
+  inline const PointShadowAtlasSettings& settings() const { return _settings; };
+  //! Lights rendered by the last update
+  inline int numberOfUpdatedLights() const { return _updated_lights; };
+  //! Lights that needed an update but were left for later frames
+  inline int numberOfPendingLights() const { return _pending_lights; };
+
+private:
+  struct Entry
+  {
+    int slot;
+    std::uint64_t signature;
+    bool rendered;
+    // Frame the light was last submitted and frames it has waited
+    unsigned int last_seen;
+    int waiting;
+  };
+
+  struct Caster
+  {
+    RenderableDeferred* renderable;
+    // World space bounds
+    glm::vec3 min;
+    glm::vec3 max;
+    glm::mat4 transform;
+  };
+
+  int numberOfSlots() const;
+  //! Free slot or the one of the least recently seen light not seen this
+  //! frame, -1 if all slots are in use
+  int allocateSlot();
+  void renderLight(
+    const PointLightSource& light, int slot,
+    const std::vector<const Caster*>& casters);
+
+  PointShadowAtlasSettings _settings;
+  std::map<const PointLightSource*, Entry> _entries;
+  std::vector<const PointLightSource*> _slots;
+  unsigned int _frame;
+  int _updated_lights;
+  int _pending_lights;
+
+  // Created with the first light that casts shadows
+  std::unique_ptr<Texture> _depth;
+  std::unique_ptr<FrameBufferObject> _fbo;
+};
+
+} }
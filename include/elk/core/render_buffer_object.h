@@ -13,9 +13,12 @@ public:
   inline void bind() { glBindRenderbuffer(GL_RENDERBUFFER, _id); };
   inline void unbind() { glBindRenderbuffer(GL_RENDERBUFFER, 0); };
   inline GLuint id() { return _id; };
+  //! Reallocates the storage, the content is lost
+  void resize(GLsizei width, GLsizei height);
 private:
   GLuint _id;
   GLsizei _width, _height;
+  GLenum _internal_format;
 };
 
 } } 
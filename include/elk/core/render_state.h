@@ -0,0 +1,104 @@
+#pragma once
+
+#include <gl/glew.h>
+
+#include <map>
+#include <string>
+#include <vector>
+
+namespace elk { namespace core {
+
+//! Caches GL state and filters out redundant state changes.
+/*!
+  All engine code should change the tracked state through this class, GL
+  calls made elsewhere leave the cache stale. Call invalidate() after such
+  calls or after handing the context to other code.
+  Calls are counted per category, both issued and skipped ones, and the
+  counts are grouped in passes started with beginPass().
+*/
+class RenderState
+{
+public:
+  enum class Category
+  {
+    Capability,
+    BlendFunc,
+    DepthMask,
+    DepthFunc,
+    Program,
+    Framebuffer,
+    Viewport,
+    CullFace,
+    Scissor,
+    PolygonOffset,
+    DrawCall,
+    NumberOfCategories
+  };
+
+  static const int number_of_categories =
+    static_cast<int>(Category::NumberOfCategories);
+
+  struct PassStatistics
+  {
+    std::string name;
+    unsigned int issued[number_of_categories];
+    unsigned int skipped[number_of_categories];
+  };
+
+  static void enable(GLenum capability);
+  static void disable(GLenum capability);
+  static void blendFunc(GLenum source_factor, GLenum destination_factor);
+  static void depthMask(GLboolean flag);
+  static void depthFunc(GLenum function);
+  static void useProgram(GLuint program);
+  static void bindFramebuffer(GLuint framebuffer);
+  static void viewport(GLint x, GLint y, GLsizei width, GLsizei height);
+  static void cullFace(GLenum mode);
+  static void scissor(GLint x, GLint y, GLsizei width, GLsizei height);
+  static void polygonOffset(GLfloat factor, GLfloat units);
+  //! Draw calls are never filtered, only counted
+  static void countDrawCall(unsigned int number_of_calls = 1);
+
+  //! Removes deleted objects so that a reused name is not treated as bound
+  static void deleteProgram(GLuint program);
+  static void deleteFramebuffer(GLuint framebuffer);
+
+  //! Forgets all cached state, the next call of each kind is always issued
+  static void invalidate();
+
+  //! Following calls are counted in a new pass named \param name
+  static void beginPass(const std::string& name);
+  //! Should be called once at the start of each frame
+  static void resetFrameStatistics();
+  //! Passes of the frame in progress
+  static const std::vector<PassStatistics>& frameStatistics()
+    { return _frame_statistics; };
+  //! Passes of the last completed frame
+  static const std::vector<PassStatistics>& lastFrameStatistics()
+    { return _last_frame_statistics; };
+  static void printStatistics(const std::vector<PassStatistics>& statistics);
+
+  static const char* categoryName(Category category);
+private:
+  static void count(Category category, bool issued);
+
+  static std::map<GLenum, bool> _capabilities;
+  static GLenum _blend_source_factor;
+  static GLenum _blend_destination_factor;
+  static GLint _depth_mask;
+  static GLenum _depth_func;
+  static GLint64 _program;
+  static GLint64 _framebuffer;
+  static GLint _viewport[4];
+  static bool _viewport_known;
+  static GLenum _cull_face;
+  static GLint _scissor[4];
+  static bool _scissor_known;
+  static GLfloat _polygon_offset[2];
+  static bool _polygon_offset_known;
+
+  static std::vector<PassStatistics> _frame_statistics;
+  static std::vector<PassStatistics> _last_frame_statistics;
+};
+
+} }
@@ -21,7 +21,7 @@ public:
   void submitPointLightSource(PointLightSource& light_source);
   void submitDirectionalLightSource(DirectionalLightSource& light_source);
 
-  void setWindowResolution(int width, int height);
+  virtual void setWindowResolution(int width, int height);
   
   /**
 	Should render all objects in the lists of renderables and light sources.
@@ -17,6 +17,8 @@ public:
     const char* tes_src,
     const char* gs_src,
     const char* fs_src);
+  //! Creates a program with a single compute shader, needs OpenGL 4.3 or ARB_compute_shader
+  ShaderProgram(std::string name, const char* cs_src);
   ~ShaderProgram();
 
   void pushUsage();
@@ -31,7 +33,8 @@ private:
     const char* tcs_src,
     const char* tes_src,
     const char* gs_src,
-    const char* fs_src);
+    const char* fs_src,
+    const char* cs_src = nullptr);
 
   std::string _name;
   GLuint _id;
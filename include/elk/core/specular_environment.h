@@ -0,0 +1,59 @@
+#pragma once
+
+#include "elk/core/cube_map_texture.h"
+#include "elk/core/texture.h"
+
+#include <cstdint>
+#include <memory>
+#include <string>
+
+namespace elk { namespace core {
+
+//! Image based specular lighting of a cube map with the split sum approximation.
+/*!
+  The radiance of the source is convolved with the GGX distribution, one
+  mip level per roughness from 0 at the base level to 1 at the last level.
+  Together with a table of the integrated BRDF, the specular reflection of
+  the environment is one lookup in each at shading time.
+
+  Both are computed with shaders, or on all hardware threads if the device
+  is CPU or the GPU can not render to floating point cube maps. The result
+  is stored in the cache directory keyed by a hash of the source pixels and
+  loaded from there when the same environment is used again.
+*/
+class SpecularEnvironment
+{
+public:
+  enum class Device {
+    GPU,
+    CPU
+  };
+
+  //! \param source needs its faces in memory to be hashed and for the CPU
+  SpecularEnvironment(
+    const CubeMapTexture& source, const std::string& cache_directory,
+    Device device = Device::GPU);
+  ~SpecularEnvironment();
+
+  //! Radiance convolved with GGX, level l has roughness l / (levels() - 1)
+  inline const CubeMapTexture& prefiltered() const { return *_prefiltered; };
+  //! Scale and bias of the Fresnel term indexed by n dot v and roughness
+  inline const Texture& brdfLookUpTable() const { return *_brdf_lut; };
+  inline int levels() const { return _levels; };
+
+private:
+  // Return false if the source could not be read
+  bool computeOnGPU(const CubeMapTexture& source);
+  bool computeOnCPU(const CubeMapTexture& source);
+  bool loadCache(const std::string& path);
+  void saveCache(const std::string& path);
+  void uploadBRDFLookUpTable(const float* data);
+
+  const int _side;
+  const int _levels;
+  std::uint64_t _key;
+  std::unique_ptr<CubeMapTexture> _prefiltered;
+  std::unique_ptr<Texture> _brdf_lut;
+};
+
+} }
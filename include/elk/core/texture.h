@@ -3,6 +3,8 @@
 #include <gl/glew.h>
 #include <glm/glm.hpp>
 
+#include <vector>
+
 namespace elk { namespace core {
 
 class Texture
@@ -43,6 +45,17 @@ public:
           FilterMode filter = FilterMode::Linear,
           WrappingMode wrapping = WrappingMode::Repeat);
 
+  //! Takes ownership of \param data and of the precomputed mip map levels
+  /*!
+    \param mip_map_data holds level 1 to n, each level half the size of the
+    previous one. The levels are uploaded instead of generated on the GPU.
+  */
+  Texture(void* data, std::vector<void*> mip_map_data, glm::uvec3 dimensions,
+          Format format = Format::RGBA,
+          GLint internalFormat = GL_RGBA, GLenum dataType = GL_UNSIGNED_BYTE,
+          FilterMode filter = FilterMode::LinearMipMap,
+          WrappingMode wrapping = WrappingMode::Repeat);
+
   ~Texture();
 
   void enable() const;
@@ -54,8 +67,28 @@ public:
   void upload();
   void downloadTexture();
   void generateMipMap();
+  //! Reallocates the texture storage, the content is lost
+  /*!
+    Meant for render targets. Any pixel data kept on the CPU is released.
+  */
+  void resize(glm::uvec3 dimensions);
+  //! Limits the mip map chain to \param levels levels including the base level
+  /*!
+    Storage for the levels is allocated so that they can be rendered to.
+    The levels are kept when the texture is resized.
+  */
+  void setMipMapLevels(int levels);
+  inline int mipMapLevels() const {return _mip_map_level;};
 
   inline GLuint id() const {return _id;};
+  //! GL_TEXTURE_2D, GL_TEXTURE_CUBE_MAP and so on
+  inline GLenum target() const {return _type;};
+  inline glm::uvec3 dimensions() const {return _dimensions;};
+  inline Format format() const {return _format;};
+  inline GLenum dataType() const {return _data_type;};
+  //! CPU side copy of the pixel data, nullptr for render targets
+  inline const void* pixelData() const {return _pixel_data;};
+  inline const std::vector<void*>& mipMapData() const {return _mip_map_data;};
   
 protected:
   void initialize(bool allocate);
@@ -64,6 +97,9 @@ protected:
   void deallocateData();
 
   void generate();
+  void uploadLevel(int level, glm::uvec3 dimensions, void* data);
+  void uploadMipMaps();
+  void allocateMipMapLevels();
   void applyFilter();
   void applyWrapping();
   void applySwizzleMask();
@@ -89,6 +125,7 @@ private:
   bool _has_ownership_of_data;
 
   void* _pixel_data;
+  std::vector<void*> _mip_map_data;
 };
 
 } }
@@ -0,0 +1,54 @@
+#pragma once
+
+#include "elk/core/texture.h"
+
+#include <gl/glew.h>
+#include <glm/glm.hpp>
+
+#include <map>
+
+namespace elk { namespace core {
+
+//! A GL_TEXTURE_2D_ARRAY where all layers share size and format.
+/*!
+  Layers are filled from RGBA textures with 8 bits per channel that still
+  hold their pixel data on the CPU. Textures of any other size whose texels
+  all have the same color (such as the default white and black textures of
+  Material) are stored as a solid color layer. Identical solid colors share
+  one layer.
+*/
+class TextureArray
+{
+public:
+  TextureArray(glm::uvec2 layer_size, int max_number_of_layers);
+  ~TextureArray();
+
+  //! Returns true if \param texture can be added as a layer
+  bool accepts(const Texture& texture) const;
+  //! Copies \param texture to a new layer
+  /*!
+    \return the index of the layer or -1 if the texture can not be added
+  */
+  int addLayer(const Texture& texture);
+  int addSolidColorLayer(glm::u8vec4 color);
+  //! Generates mip maps for layers that did not have any precomputed
+  void updateMipMaps();
+
+  void bind() const;
+
+  inline GLuint id() const { return _id; };
+  inline glm::uvec2 layerSize() const { return _layer_size; };
+  inline int numberOfLayers() const { return _number_of_layers; };
+private:
+  bool isSolidColor(const Texture& texture, glm::u8vec4& color) const;
+
+  GLuint _id;
+  glm::uvec2 _layer_size;
+  int _max_number_of_layers;
+  int _number_of_layers;
+  int _mip_map_level;
+  bool _mip_maps_dirty;
+  std::map<GLuint, int> _solid_color_layers;
+};
+
+} }
@@ -2,15 +2,31 @@
 
 #include <gl/glew.h>
 
+#include <cstdint>
 #include <vector>
 
 namespace elk { namespace core {
 
+//! Allocates texture image units and tracks what is bound to them.
+/*!
+  Free units are kept as a bitmask so that assigning a unit is a constant
+  time bit scan. A shadow table of the texture bound to each unit and of the
+  active unit is used to skip redundant glActiveTexture and glBindTexture
+  calls. For the shadow table to stay valid, all textures need to be bound
+  with bindTexture() and deleted with deleteTexture().
+*/
 class TextureUnit {
 public:
-    
+    struct Statistics {
+        unsigned int binds_issued;
+        unsigned int binds_skipped;
+    };
+
     TextureUnit();
 	~TextureUnit();
+    TextureUnit(TextureUnit&& other) noexcept;
+    TextureUnit(const TextureUnit&) = delete;
+    TextureUnit& operator=(const TextureUnit&) = delete;
 
     void activate();
 
@@ -21,9 +37,29 @@ public:
     static void setZeroUnit();
     static int numberActiveUnits();
 
+    //! Binds \param id to the active unit unless it is already bound there
+    static void bindTexture(GLenum target, GLuint id);
+    //! Deletes the texture and removes it from the shadow table
+    static void deleteTexture(GLuint id);
+    //! Forgets all bindings, needed if GL state was changed behind our back
+    static void invalidateBindings();
+
+    //! Statistics of the frame in progress
+    static const Statistics& frameStatistics() { return _frameStatistics; };
+    //! Statistics of the last completed frame
+    static const Statistics& lastFrameStatistics() { return _lastFrameStatistics; };
+    //! Should be called once at the start of each frame
+    static void resetFrameStatistics();
+
 private:
+    struct Binding {
+        GLenum target;
+        GLuint id;
+    };
+
     void assignUnit();
     static void initialize();
+    static void setActiveUnit(GLint number);
 
     GLint _number;
     GLint _glEnum;
@@ -31,7 +67,12 @@ private:
     static bool _initialized;
     static unsigned int _totalActive;
     static GLint _maxTexUnits;
-    static std::vector<bool> _busyUnits;
+    // One bit per unit, set bits are free
+    static std::vector<uint64_t> _freeUnits;
+    static std::vector<Binding> _bindings;
+    static GLint _activeUnit;
+    static Statistics _frameStatistics;
+    static Statistics _lastFrameStatistics;
 };
 
 } }
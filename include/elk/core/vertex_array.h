@@ -19,9 +19,12 @@ public:
 
   inline void bind() { glBindVertexArray(_id); };
   inline void unbind() { glBindVertexArray(0); };
+  inline GLuint id() const { return _id; };
   ArrayBuffer& getBuffer(int attribute_index) { return *_buffers[attribute_index]; };
   void enableAttribArrays();
   void disableAttribArrays();
+  //! One bit per attribute index that has a buffer
+  GLuint attributeMask() const;
 private:
   GLuint _id;
   std::map<int, std::unique_ptr<ArrayBuffer> > _buffers;
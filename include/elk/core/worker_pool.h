@@ -0,0 +1,50 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace elk { namespace core {
+
+//! Threads that are kept alive to run small tasks every frame.
+/*!
+  Unlike parallelFor, no threads are created per call. Workers sleep on a
+  condition variable between calls and take tasks from a shared counter,
+  the calling thread takes tasks as well.
+*/
+class WorkerPool
+{
+public:
+  //! \param number_of_threads includes the calling thread, negative for one per hardware thread
+  WorkerPool(int number_of_threads = -1);
+  ~WorkerPool();
+  WorkerPool(const WorkerPool&) = delete;
+  WorkerPool& operator=(const WorkerPool&) = delete;
+
+  //! Runs \param f for each task in [0, number_of_tasks) and waits for all of them
+  void run(int number_of_tasks, const std::function<void(int)>& f);
+  //! Threads that run tasks, including the calling thread
+  inline int numberOfThreads() const { return static_cast<int>(_threads.size()) + 1; };
+
+private:
+  void work(int index);
+  void runTasks();
+
+  std::vector<std::thread> _threads;
+  std::mutex _mutex;
+  std::condition_variable _wake;
+  std::condition_variable _done;
+
+  // State of the current run, written under the mutex
+  const std::function<void(int)>* _task;
+  int _number_of_tasks;
+  std::atomic<int> _next_task;
+  int _busy_workers;
+  unsigned int _generation;
+  bool _stop;
+};
+
+} }
@@ -31,6 +31,8 @@ public:
   // as sampler name instead of the one specified for the actual render texture.
   void bindTextures(const std::vector<RenderTextureInfo>& render_texture_info);
   void generateMipMaps();
+  //! Reallocates all render textures and the depth buffer
+  void resize(int width, int height);
   void freeTextureUnits();
   void render();
   void bindFBO();
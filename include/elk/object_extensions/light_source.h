@@ -3,7 +3,9 @@
 #include "elk/core/object_3d.h"
 #include "elk/core/mesh.h"
 #include "elk/core/camera.h"
+#include "elk/core/cascaded_shadow_map.h"
 
+#include <memory>
 #include <vector>
   
 #include <glm/glm.hpp>
@@ -21,22 +23,25 @@ public:
   ~PointLightSource() {};
   virtual void submit(Renderer& renderer) override;
   virtual void update(double dt) override;
-  void render(const UsefulRenderData& render_data);
 
   void setRadiantFlux(float radiant_flux);
   void setColor(glm::vec3 color);
+  inline float radiantFlux() const { return _radiant_flux; };
+  inline glm::vec3 color() const { return _color; };
+  //! Occludes the light with a cube shadow map in the shadow atlas of the
+  //! renderer
+  inline void setCastsShadows(bool enabled) { _casts_shadows = enabled; };
+  inline bool castsShadows() const { return _casts_shadows; };
+  //! World space position
+  glm::vec3 position() const;
+  //! Distance beyond which the light has no effect
+  float radius() const;
 private:
-  void renderQuad(const UsefulRenderData& render_data);
-  void renderSphere(const UsefulRenderData& render_data);
-  void setupLightSourceUniforms(const UsefulRenderData& render_data);
-
-  std::shared_ptr<Mesh> _quad_mesh;
-  std::shared_ptr<Mesh> _sphere_mesh;
-
   float _sphere_scale;
 
   glm::vec3 _color;
   float     _radiant_flux;
+  bool      _casts_shadows;
 };
 
 class DirectionalLightSource : public Object3D
@@ -50,10 +55,19 @@ public:
 
   void setRadiance(float radiance);
   void setColor(glm::vec3 color);
+  //! Occludes the light with a cascaded shadow map
+  void setCastsShadows(
+    bool enabled,
+    CascadedShadowMapSettings settings = CascadedShadowMapSettings());
+  //! nullptr if the light casts no shadows
+  inline CascadedShadowMap* shadowMap() { return _shadow_map.get(); };
+  //! Direction the light travels in world space
+  glm::vec3 direction() const;
 private:
   void setupLightSourceUniforms(const UsefulRenderData& render_data);
 
   std::shared_ptr<Mesh> _quad_mesh;
+  std::unique_ptr<CascadedShadowMap> _shadow_map;
   
   glm::vec3 _color;
   float     _radiance;
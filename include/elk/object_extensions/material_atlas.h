@@ -0,0 +1,164 @@
+#pragma once
+
+#include "elk/core/object_3d.h"
+#include "elk/core/mesh.h"
+#include "elk/core/material.h"
+#include "elk/core/texture_array.h"
+#include "elk/core/shader_program.h"
+#include "elk/core/texture_unit.h"
+
+#include <memory>
+#include <vector>
+
+namespace elk { namespace core {
+
+//! Renders many meshes with different materials in a single draw call.
+/*!
+  All textures of the added materials are copied to one texture array and
+  the materials become indices into a uniform buffer of texture layers. The
+  meshes share one set of vertex buffers. Instances are grouped per mesh and
+  drawn with glMultiDrawElementsIndirect where ARB_multi_draw_indirect is
+  supported, otherwise with one instanced draw call per mesh.
+  Instance transforms are relative to the transform of the atlas.
+  Where the 4.1 context exposes compute shaders and shader storage buffers
+  as extensions, the instances can be occlusion culled on the GPU. The
+  culling shader then writes the indirect draw commands.
+*/
+class MaterialAtlas : public RenderableDeferred
+{
+public:
+  //! \param layer_size is the size that all material textures need to have
+  MaterialAtlas(glm::uvec2 layer_size, int max_number_of_layers = 64);
+  ~MaterialAtlas();
+
+  //! \return the material index or -1 if its textures do not fit the atlas
+  int addMaterial(std::shared_ptr<Material> material);
+  //! \return the mesh index
+  int addMesh(std::shared_ptr<Mesh> mesh);
+  //! \return the instance index
+  int addInstance(
+    int mesh_index, int material_index,
+    const glm::mat4& transform = glm::mat4(1.0f));
+  //! Only the moved instances are uploaded again, their visibility is kept
+  void setInstanceTransform(int instance_index, const glm::mat4& transform);
+
+  virtual void render(const UsefulRenderData& render_data) override;
+
+  virtual bool supportsOcclusionCulling() const override;
+  virtual void renderVisible(const UsefulRenderData& render_data) override;
+  virtual void cullOcclusion(
+    const UsefulRenderData& render_data, Texture& depth_pyramid) override;
+  virtual void renderNewlyVisible(const UsefulRenderData& render_data) override;
+
+  //! Bounds of all instances
+  virtual bool shadowCasterBounds(glm::vec3& min, glm::vec3& max) override;
+  virtual void renderShadowCaster(
+    const glm::mat4& view, const glm::mat4& projection) override;
+
+  static bool multiDrawIndirectSupported();
+  static bool occlusionCullingSupported();
+  static const int max_number_of_materials = 256;
+private:
+  struct MeshRange
+  {
+    GLuint first_index;
+    GLuint count;
+    GLint base_vertex;
+    glm::vec3 min_position;
+    glm::vec3 max_position;
+  };
+
+  struct Instance
+  {
+    glm::mat4 transform;
+    int mesh_index;
+    int material_index;
+  };
+
+  // Layout given by the GL specification
+  struct DrawElementsIndirectCommand
+  {
+    GLuint count;
+    GLuint instance_count;
+    GLuint first_index;
+    GLint base_vertex;
+    GLuint base_instance;
+  };
+
+  // Per instance vertex attributes, also read by the occlusion culling shader
+  struct InstanceData
+  {
+    glm::mat4 transform;
+    GLint material_index;
+    GLint command_index;
+    // Position in the instance buffer, kept when copied to the draw lists
+    GLint source_index;
+    GLint padding;
+  };
+
+  // Instances compacted per draw command by the occlusion culling shader
+  struct DrawList
+  {
+    GLuint instance_buffer;
+    GLuint indirect_buffer;
+  };
+
+  void update();
+  void uploadGeometry();
+  void uploadInstances();
+  void uploadTransforms();
+  void refreshVisibleTransforms();
+  void computeBounds();
+  void uploadMaterials();
+  void uploadCullingBuffers(const std::vector<glm::vec4>& command_bounds);
+  void beginDraw(const UsefulRenderData& render_data, TextureUnit& material_unit);
+  void drawIndirect(GLuint instance_buffer, GLuint indirect_buffer);
+  void endDraw();
+  void setInstanceAttributePointers(GLuint buffer, GLuint first_instance);
+  void setTransforms(
+    GLuint program, const glm::mat4& view, const glm::mat4& projection);
+  //! Draws all instances
+  void drawAll();
+
+  TextureArray _texture_array;
+  std::vector<std::shared_ptr<Mesh> > _meshes;
+  std::vector<std::shared_ptr<Material> > _materials;
+  // Two ivec4 per material: albedo, roughness, R0, metalness and normal layer
+  std::vector<glm::ivec4> _material_layers;
+  std::vector<MeshRange> _mesh_ranges;
+  std::vector<Instance> _instances;
+  // Position of each instance in the instance buffer
+  std::vector<GLuint> _instance_slots;
+  // Instances whose transform changed since the last upload
+  std::vector<int> _moved_instances;
+  std::vector<DrawElementsIndirectCommand> _draw_commands;
+  // Bounds of all instances relative to the atlas
+  glm::vec3 _min_position;
+  glm::vec3 _max_position;
+
+  GLuint _vao;
+  GLuint _vertex_buffers[4];
+  GLuint _element_buffer;
+  GLuint _instance_buffer;
+  GLuint _indirect_buffer;
+  GLuint _material_buffer;
+
+  // Occlusion culling
+  GLuint _command_bounds_buffer;
+  GLuint _visibility_buffer;
+  // Draw commands without instances, copied to reset the draw lists
+  GLuint _empty_commands_buffer;
+  // Visible last frame and visible this frame but not last frame
+  DrawList _visible;
+  DrawList _newly_visible;
+
+  bool _geometry_dirty;
+  bool _instances_dirty;
+  bool _materials_dirty;
+
+  static std::shared_ptr<ShaderProgram> _program;
+  static std::shared_ptr<ShaderProgram> _culling_program;
+  static std::shared_ptr<ShaderProgram> _shadow_program;
+};
+
+} }
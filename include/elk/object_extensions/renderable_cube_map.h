@@ -14,6 +14,7 @@ public:
   
   void bindTexture();
   int textureSize();
+  inline const CubeMapTexture& cubeMap() const { return *_cube_map; };
   void render();
 private:
   std::shared_ptr<Mesh> _cube;
@@ -14,10 +14,18 @@ public:
     	std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material);
     ~RenderableModel(){};
     virtual void render(const UsefulRenderData& render_data) override;
+    virtual bool recordCommands(
+      CommandBuffer& commands, const UsefulRenderData& render_data) override;
     virtual void update(double dt) override;
+    virtual bool shadowCasterBounds(glm::vec3& min, glm::vec3& max) override;
+    virtual void renderShadowCaster(
+      const glm::mat4& view, const glm::mat4& projection) override;
 private:
     std::shared_ptr<Mesh> _mesh;
     std::shared_ptr<Material> _material;
+    // Bounds of the mesh in model space
+    glm::vec3 _min_position;
+    glm::vec3 _max_position;
 };
 
 } }
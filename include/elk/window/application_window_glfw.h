@@ -1,6 +1,8 @@
 #pragma once
 
 #include "elk/core/controller.h"
+#include "elk/core/frame_statistics.h"
+#include "elk/core/gpu_timer.h"
 
 #include <gl/glfw3.h>
 
@@ -19,11 +21,42 @@ public:
   ApplicationWindowGLFW(std::string name, int width, int height);
   ~ApplicationWindowGLFW();
 
+  //! Runs \param f once per frame with the time since the last frame
   void run(std::function<void(double)> f);
+  //! Runs the simulation in fixed steps independent of the frame rate
+  /*!
+    \param simulate and then the controllers are called with \param dt as
+    many times as needed to catch up with the elapsed time. \param render
+    is then called once per frame with the fraction of a step that has
+    passed since the last step, which should be used to interpolate.
+  */
+  void run(
+    double dt,
+    std::function<void(double)> simulate,
+    std::function<void(double)> render);
   void addController(Controller& controller);
+
+  //! Number of screen refreshes to wait before swapping, 0 disables vsync
+  void setSwapInterval(int interval);
+  //! Upper bound on frames per second, 0 for no bound
+  inline void setFrameRateLimit(double frames_per_second) { _frame_rate_limit = frames_per_second; };
+  //! Steps taken per frame at most, time beyond that is dropped
+  inline void setMaxStepsPerFrame(int steps) { _max_steps_per_frame = steps; };
+
+  //! CPU time, GPU time and present interval of the last frames
+  inline FrameStatistics& frameStatistics() { return _frame_statistics; };
+  //! \param source returns the GPU times that arrived since it was last called
+  /*!
+    It is called once per frame and each result is recorded once, for
+    example DeferredShadingRenderer::takeGpuFrameTimes.
+  */
+  inline void setGpuTimeSource(std::function<std::vector<GpuTimer::Result>()> source)
+  { _gpu_time_source = source; };
 private:
   // Functions
   bool initOpenGLContext(int width, int height);
+  //! Counts the frame, swaps and waits for the frame rate limit
+  void endFrame();
   static void mousePosCallback(
     GLFWwindow * window,
     double x,
@@ -56,6 +89,14 @@ private:
   float _delay_counter;
   int   _frame_counter;
   double _time;
+  double _frame_start;
+
+  double _frame_rate_limit;
+  int _max_steps_per_frame;
+
+  FrameStatistics _frame_statistics;
+  std::function<std::vector<GpuTimer::Result>()> _gpu_time_source;
+  double _last_present;
 };
 
 } }
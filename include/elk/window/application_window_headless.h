@@ -0,0 +1,85 @@
+#pragma once
+
+#include "elk/core/controller.h"
+#include "elk/core/frame_statistics.h"
+#include "elk/core/gpu_timer.h"
+
+#include <EGL/egl.h>
+
+#include <functional>
+#include <vector>
+#include <string>
+
+namespace elk { namespace window {
+
+using namespace core;
+
+//! An OpenGL context without a window, for machines without a display.
+/*!
+  The context is created with EGL on the first device that supports
+  OpenGL 4.1 core. Mesa exposes a software device, so this also works on
+  machines without a GPU through llvmpipe. The default framebuffer is a
+  pbuffer of fixed size.
+*/
+class ApplicationWindowHeadless
+{
+public:
+  ApplicationWindowHeadless(std::string name, int width, int height);
+  ~ApplicationWindowHeadless();
+  ApplicationWindowHeadless(const ApplicationWindowHeadless&) = delete;
+  ApplicationWindowHeadless& operator=(const ApplicationWindowHeadless&) = delete;
+
+  //! False if no context could be created
+  inline bool valid() const { return _context != EGL_NO_CONTEXT; };
+
+  //! Runs \param f each frame until close() or the frame limit is reached
+  void run(std::function<void(double)> f);
+  void addController(Controller& controller);
+  //! Stops run() after the current frame
+  inline void close() { _should_close = true; };
+
+  //! Number of frames run() renders, negative to render until close()
+  inline void setFrameLimit(int frames) { _frame_limit = frames; };
+  //! Time step passed to each frame, non positive to use the elapsed time
+  inline void setFixedTimeStep(double dt) { _fixed_time_step = dt; };
+  //! Frames rendered by run() so far
+  inline int numberOfFrames() const { return _frame_counter; };
+  //! CPU time, GPU time and present interval of the last frames
+  inline FrameStatistics& frameStatistics() { return _frame_statistics; };
+  //! \param source returns the GPU times that arrived since it was last called
+  /*!
+    It is called once per frame and each result is recorded once, for
+    example DeferredShadingRenderer::takeGpuFrameTimes.
+  */
+  inline void setGpuTimeSource(std::function<std::vector<GpuTimer::Result>()> source)
+  { _gpu_time_source = source; };
+
+  inline int width() const { return _width; };
+  inline int height() const { return _height; };
+  //! Reads the default framebuffer as RGB rows from top to bottom
+  std::vector<unsigned char> readPixels() const;
+  //! Writes the default framebuffer as a binary PPM image
+  bool saveFrame(const std::string& path) const;
+
+private:
+  bool initOpenGLContext(int width, int height);
+  bool createContext(EGLDisplay display);
+
+  std::string _name;
+  int _width;
+  int _height;
+  EGLDisplay _display;
+  EGLSurface _surface;
+  EGLContext _context;
+  std::vector<Controller*> _controllers;
+
+  int _frame_limit;
+  double _fixed_time_step;
+  bool _should_close;
+  int _frame_counter;
+
+  FrameStatistics _frame_statistics;
+  std::function<std::vector<GpuTimer::Result>()> _gpu_time_source;
+};
+
+} }
@@ -0,0 +1,61 @@
+#version 410 core
+
+// Out data
+layout(location = 0) out vec2 scale_bias;
+
+// Uniforms
+uniform int destination_size;
+uniform int number_of_samples;
+
+const float pi = 3.14159265f;
+
+vec2 hammersley(uint i, uint n)
+{
+  uint bits = i;
+  bits = (bits << 16u) | (bits >> 16u);
+  bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+  bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+  bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+  bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+  return vec2(float(i) / float(n), float(bits) * 2.3283064365386963e-10f);
+}
+
+// Half vector around +z distributed as GGX with alpha = roughness^2
+vec3 importanceSampleGGX(vec2 xi, float roughness)
+{
+  float a = roughness * roughness;
+  float phi = 2.0f * pi * xi.x;
+  float cos_theta = sqrt((1.0f - xi.y) / (1.0f + (a * a - 1.0f) * xi.y));
+  float sin_theta = sqrt(1.0f - cos_theta * cos_theta);
+  return vec3(sin_theta * cos(phi), sin_theta * sin(phi), cos_theta);
+}
+
+// Columns are n dot v and rows roughness. The specular BRDF integrated over
+// the hemisphere is F0 * scale + bias.
+void main()
+{
+  vec2 coordinate = gl_FragCoord.xy / destination_size;
+  float n_dot_v = coordinate.x;
+  float roughness = coordinate.y;
+  vec3 v = vec3(sqrt(1.0f - n_dot_v * n_dot_v), 0.0f, n_dot_v);
+  // Schlick-Smith geometry term with k = alpha / 2 for image based lighting
+  float k = roughness * roughness / 2.0f;
+
+  scale_bias = vec2(0.0f);
+  for (int i = 0; i < number_of_samples; ++i)
+  {
+    vec3 h = importanceSampleGGX(hammersley(uint(i), uint(number_of_samples)), roughness);
+    float v_dot_h = dot(v, h);
+    vec3 l = 2.0f * v_dot_h * h - v;
+    if (l.z <= 0.0f)
+      continue;
+    v_dot_h = max(v_dot_h, 0.0f);
+    float g =
+      (n_dot_v / (n_dot_v * (1.0f - k) + k)) *
+      (l.z / (l.z * (1.0f - k) + k));
+    float g_visible = g * v_dot_h / (h.z * n_dot_v);
+    float fresnel = pow(1.0f - v_dot_h, 5.0f);
+    scale_bias += vec2(1.0f - fresnel, fresnel) * g_visible;
+  }
+  scale_bias /= float(number_of_samples);
+}
\ No newline at end of file
@@ -0,0 +1,12 @@
+#version 410 core
+
+// Out data
+layout(location = 0) out vec4 color;
+
+// Uniforms
+uniform sampler2D source; // Same size as the render target
+
+void main()
+{
+  color = texelFetch(source, ivec2(gl_FragCoord.xy), 0);
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#version 410 core
+
+// Out data
+layout(location = 0) out vec4 color;
+
+// Uniforms
+uniform sampler2D source; // Base level set to the level above
+uniform ivec2 destination_size;
+
+void main()
+{
+  // Sampling between four source texels gives a box filter
+  vec2 sample_point_texture_space = gl_FragCoord.xy / destination_size;
+  color = textureLod(source, sample_point_texture_space, 0);
+}
\ No newline at end of file
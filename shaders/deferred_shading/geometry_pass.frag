@@ -8,9 +8,9 @@ in vec2 fs_texture_coordinate;
 
 // Out data
 layout(location = 0) out vec4 albedo;
-layout(location = 1) out vec3 position;
-layout(location = 2) out vec3 normal;
-layout(location = 3) out vec3 material; // Roughness, Fresnel Term, metalness
+layout(location = 1) out vec2 encoded_normal;
+layout(location = 2) out vec4 material; // Roughness, Fresnel Term, metalness
+// Linear depth is written to gl_FragDepth
 
 // Uniforms
 uniform sampler2D albedo_texture;
@@ -36,6 +36,18 @@ float roughSchlick2(float R0, float cos_theta, float roughness)
     (1 + roughness) + (area_under_curve - new_area_under_curve);
 }
 
+// Octahedron encoding of a unit vector in to [0, 1]^2
+vec2 encodeNormal(vec3 n)
+{
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  if (n.z < 0.0f)
+  {
+    n.xy = (1.0f - abs(n.yx)) *
+      vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+  }
+  return n.xy * 0.5f + 0.5f;
+}
+
 float remapRoughness(float x)
 {
   return 2.0f * (1.0f / (1.0f - 0.5f + 0.001f) - 1.0f) * (pow(x, 2)) + 0.001f;
@@ -43,10 +55,10 @@ float remapRoughness(float x)
 
 void main()
 {
-  position = vertex_position_viewspace.xyz;
+  vec3 position = vertex_position_viewspace.xyz;
 
   vec3 sampled_normal = texture(normal_texture, fs_texture_coordinate).xyz;
-  normal = normalize(vertex_normal_viewspace); 
+  vec3 normal = normalize(vertex_normal_viewspace); 
 
   if (length(sampled_normal) != 0.0f)
   {
@@ -71,7 +83,8 @@ void main()
   float remapped_roughness = remapRoughness(roughness);
   float fresnel_term = roughSchlick2(R0, cos_theta, remapped_roughness);
 
-  material = vec3(roughness + 0.01, fresnel_term, metalness);
+  material = vec4(roughness + 0.01, fresnel_term, metalness, 0.0f);
+  encoded_normal = encodeNormal(normalize(normal));
 
   // Write to linear depth buffer
   float max_dist = 1000.0f;
@@ -0,0 +1,105 @@
+#version 410 core
+
+// In data
+in vec4 vertex_position_viewspace;
+in vec3 vertex_normal_viewspace;
+in vec3 vertex_tangent_viewspace;
+in vec2 fs_texture_coordinate;
+flat in int material_index;
+
+// Out data
+layout(location = 0) out vec4 albedo;
+layout(location = 1) out vec2 encoded_normal;
+layout(location = 2) out vec4 material; // Roughness, Fresnel Term, metalness
+// Linear depth is written to gl_FragDepth
+
+// Uniforms
+uniform sampler2DArray material_textures;
+
+// Texture array layers of each material. Albedo, roughness, R0 and metalness
+// in the first vector and normal in the x component of the second.
+layout(std140) uniform MaterialLayers
+{
+  ivec4 material_layers[2 * 256];
+};
+
+// R0 is calculated from IOR as so:
+// R0 = pow((n1 - n2) / (n1 + n2), 2)
+float schlick(float R0, float cos_theta)
+{
+  float R = R0 + (1 - R0) * pow((1 - cos_theta), 5);
+  return R;
+}
+
+float roughSchlick2(float R0, float cos_theta, float roughness)
+{
+  float area_under_curve = 1.0 / 6.0 * (5.0 * R0 + 1.0);
+  float new_area_under_curve = 1.0 / (6.0 * roughness + 6.0) * (5.0 * R0 + 1.0);
+
+  return schlick(R0, cos_theta) /
+    (1 + roughness) + (area_under_curve - new_area_under_curve);
+}
+
+// Octahedron encoding of a unit vector in to [0, 1]^2
+vec2 encodeNormal(vec3 n)
+{
+  n /= abs(n.x) + abs(n.y) + abs(n.z);
+  if (n.z < 0.0f)
+  {
+    n.xy = (1.0f - abs(n.yx)) *
+      vec2(n.x >= 0.0f ? 1.0f : -1.0f, n.y >= 0.0f ? 1.0f : -1.0f);
+  }
+  return n.xy * 0.5f + 0.5f;
+}
+
+float remapRoughness(float x)
+{
+  return 2.0f * (1.0f / (1.0f - 0.5f + 0.001f) - 1.0f) * (pow(x, 2)) + 0.001f;
+}
+
+vec4 sampleLayer(int layer)
+{
+  return texture(material_textures, vec3(fs_texture_coordinate, layer));
+}
+
+void main()
+{
+  vec3 position = vertex_position_viewspace.xyz;
+
+  ivec4 layers = material_layers[2 * material_index];
+  int normal_layer = material_layers[2 * material_index + 1].x;
+
+  vec3 sampled_normal = sampleLayer(normal_layer).xyz;
+  vec3 normal = normalize(vertex_normal_viewspace); 
+
+  if (length(sampled_normal) != 0.0f)
+  {
+    vec3 tangent = normalize(vertex_tangent_viewspace); 
+    sampled_normal = (2.0f * sampled_normal) - vec3(1.0f);
+    vec3 bitangent = cross(normal, tangent);
+
+    normal =
+      tangent * sampled_normal.x +
+      bitangent * sampled_normal.y +
+      normal * sampled_normal.z;
+  }
+
+        albedo =      sampleLayer(layers.x);
+  float roughness =   sampleLayer(layers.y).r;
+  float R0 =          0.04;//sampleLayer(layers.z).r;
+  float metalness =   sampleLayer(layers.w).r;
+
+  // Calculate dielctric Fresnel term
+  vec3 v = normalize(position);
+  float cos_theta = max(dot(-v, normal),  0.0f);
+  float remapped_roughness = remapRoughness(roughness);
+  float fresnel_term = roughSchlick2(R0, cos_theta, remapped_roughness);
+
+  material = vec4(roughness + 0.01, fresnel_term, metalness, 0.0f);
+  encoded_normal = encodeNormal(normalize(normal));
+
+  // Write to linear depth buffer
+  float max_dist = 1000.0f;
+  float depth = (-position.z / max_dist);
+  gl_FragDepth = depth;
+}
\ No newline at end of file
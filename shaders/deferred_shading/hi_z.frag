@@ -0,0 +1,33 @@
+#version 410 core
+
+// Out data
+layout(location = 0) out vec2 min_max_depth;
+
+// Uniforms
+uniform sampler2D source; // Base level set to the level above
+uniform bool source_is_depth; // Linear depth buffer instead of a pyramid level
+
+void main()
+{
+  ivec2 source_size = textureSize(source, 0);
+  ivec2 raster_coord = ivec2(gl_FragCoord.xy) * 2;
+
+  // For odd sizes the last texel also covers the extra row or column
+  ivec2 footprint = ivec2(2);
+  if ((source_size.x & 1) == 1 && raster_coord.x == source_size.x - 3)
+    footprint.x = 3;
+  if ((source_size.y & 1) == 1 && raster_coord.y == source_size.y - 3)
+    footprint.y = 3;
+
+  min_max_depth = vec2(1.0f, 0.0f);
+  for (int y = 0; y < footprint.y; ++y)
+  {
+    for (int x = 0; x < footprint.x; ++x)
+    {
+      ivec2 coord = min(raster_coord + ivec2(x, y), source_size - 1);
+      vec2 depth = source_is_depth ?
+        texelFetch(source, coord, 0).rr : texelFetch(source, coord, 0).rg;
+      min_max_depth = vec2(min(min_max_depth.x, depth.x), max(min_max_depth.y, depth.y));
+    }
+  }
+}
\ No newline at end of file
@@ -0,0 +1,35 @@
+#version 410 core
+
+// In data
+layout(location = 0) in vec3 position;
+// Per light, see PointLightVolumes
+layout(location = 4) in vec4 instance_position_radius; // View space
+layout(location = 5) in vec4 instance_color_flux;
+layout(location = 6) in vec4 instance_shadow;          // Atlas slot, far plane, shadowed
+
+flat out vec4 light_position_radius;
+flat out vec4 light_color_flux;
+flat out vec4 light_shadow;
+flat out vec2 light_depth_range; // Linear depth range covered by the light
+
+// Uniform data
+uniform mat4 P = mat4(1.0f);
+// Scales the unit sphere to enclose the light volume
+uniform float volume_scale = 1.0f;
+
+// Linear depth is stored as the distance along -z divided by max_dist
+const float max_dist = 1000.0f;
+
+void main()
+{
+  light_position_radius = instance_position_radius;
+  light_color_flux = instance_color_flux;
+  light_shadow = instance_shadow;
+  float center_depth = -instance_position_radius.z;
+  float radius = instance_position_radius.w;
+  light_depth_range = vec2(center_depth - radius, center_depth + radius) / max_dist;
+
+  vec3 position_view_space =
+    instance_position_radius.xyz + position * radius * volume_scale;
+  gl_Position = P * vec4(position_view_space, 1.0f);
+}
\ No newline at end of file
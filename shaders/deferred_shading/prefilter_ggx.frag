@@ -0,0 +1,84 @@
+#version 410 core
+
+// Out data
+layout(location = 0) out vec4 color;
+
+// Uniforms
+uniform samplerCube source; // Mip mapped
+uniform int source_size;
+uniform int face; // +x, -x, +y, -y, +z, -z
+uniform int destination_size;
+uniform float roughness;
+uniform int number_of_samples;
+
+const float pi = 3.14159265f;
+
+// Direction through a texel of a face, s and t in [-1, 1]
+vec3 cubeMapDirection(int face, float s, float t)
+{
+  if (face == 0) return vec3(1.0f, -t, -s);
+  if (face == 1) return vec3(-1.0f, -t, s);
+  if (face == 2) return vec3(s, 1.0f, t);
+  if (face == 3) return vec3(s, -1.0f, -t);
+  if (face == 4) return vec3(s, -t, 1.0f);
+  return vec3(-s, -t, -1.0f);
+}
+
+vec2 hammersley(uint i, uint n)
+{
+  uint bits = i;
+  bits = (bits << 16u) | (bits >> 16u);
+  bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+  bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+  bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+  bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+  return vec2(float(i) / float(n), float(bits) * 2.3283064365386963e-10f);
+}
+
+// Half vector around +z distributed as GGX with alpha = roughness^2
+vec3 importanceSampleGGX(vec2 xi, float roughness)
+{
+  float a = roughness * roughness;
+  float phi = 2.0f * pi * xi.x;
+  float cos_theta = sqrt((1.0f - xi.y) / (1.0f + (a * a - 1.0f) * xi.y));
+  float sin_theta = sqrt(1.0f - cos_theta * cos_theta);
+  return vec3(sin_theta * cos(phi), sin_theta * sin(phi), cos_theta);
+}
+
+void main()
+{
+  vec2 st = gl_FragCoord.xy / destination_size * 2.0f - 1.0f;
+  vec3 n = normalize(cubeMapDirection(face, st.x, st.y));
+  if (roughness == 0.0f)
+  {
+    // A mirror, sample the source at the resolution of the level
+    color = vec4(textureLod(source, n, log2(float(source_size) / destination_size)).rgb, 1.0f);
+    return;
+  }
+
+  // The view direction is assumed to be the normal
+  vec3 up = abs(n.z) < 0.999f ? vec3(0.0f, 0.0f, 1.0f) : vec3(1.0f, 0.0f, 0.0f);
+  vec3 tangent = normalize(cross(up, n));
+  vec3 bitangent = cross(n, tangent);
+
+  float a2 = pow(roughness, 4.0f);
+  float texel_solid_angle = 4.0f * pi / (6.0f * source_size * source_size);
+  vec3 radiance = vec3(0.0f);
+  float weight = 0.0f;
+  for (int i = 0; i < number_of_samples; ++i)
+  {
+    vec3 h = importanceSampleGGX(hammersley(uint(i), uint(number_of_samples)), roughness);
+    vec3 l = 2.0f * h.z * h - vec3(0.0f, 0.0f, 1.0f);
+    if (l.z <= 0.0f)
+      continue;
+    // Filtered importance sampling, each sample reads the mip level whose
+    // texels cover the solid angle of the sample
+    float d = a2 / (pi * pow(h.z * h.z * (a2 - 1.0f) + 1.0f, 2.0f));
+    float sample_solid_angle = 1.0f / (number_of_samples * d / 4.0f + 1e-6f);
+    float lod = max(0.5f * log2(sample_solid_angle / texel_solid_angle) + 1.0f, 0.0f);
+    vec3 direction = tangent * l.x + bitangent * l.y + n * l.z;
+    radiance += textureLod(source, direction, lod).rgb * l.z;
+    weight += l.z;
+  }
+  color = vec4(radiance / max(weight, 1e-6f), 1.0f);
+}
\ No newline at end of file
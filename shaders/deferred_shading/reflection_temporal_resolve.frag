@@ -0,0 +1,64 @@
+#version 410 core
+
+// Out data
+layout(location = 0) out vec4 resolved;
+
+// Uniforms
+uniform sampler2D ssr_buffer; // Reflections traced this frame, half resolution
+uniform sampler2D history_buffer; // Resolved reflections of the last frame
+uniform sampler2D depth_buffer; // Linear depth, full resolution
+
+uniform mat4 P_frag_inv;
+uniform mat4 transform_view_to_prev_screen;
+uniform float history_weight; // Zero when the history is not valid
+
+// Linear depth is stored as the distance along -z divided by max_dist
+const float max_dist = 1000.0f;
+
+// Reconstructs the view space position from the linear depth buffer
+vec3 viewSpacePosition(vec2 texture_coordinate, float depth)
+{
+  vec4 ray = P_frag_inv * vec4(texture_coordinate * 2.0f - 1.0f, 0.0f, 1.0f);
+  vec3 ray_view_space = ray.xyz / ray.w;
+  return ray_view_space * (depth * max_dist / -ray_view_space.z);
+}
+
+void main()
+{
+  ivec2 coord = ivec2(gl_FragCoord.xy);
+  ivec2 size = textureSize(ssr_buffer, 0);
+  vec4 current = texelFetch(ssr_buffer, coord, 0);
+
+  // The history is clamped to the neighbourhood of this frame so that
+  // reflections that moved away do not leave trails
+  vec4 neighbourhood_min = current;
+  vec4 neighbourhood_max = current;
+  for (int y = -1; y <= 1; ++y)
+  {
+    for (int x = -1; x <= 1; ++x)
+    {
+      vec4 neighbour = texelFetch(ssr_buffer, clamp(coord + ivec2(x, y), ivec2(0), size - 1), 0);
+      neighbourhood_min = min(neighbourhood_min, neighbour);
+      neighbourhood_max = max(neighbourhood_max, neighbour);
+    }
+  }
+
+  // Reproject the surface of the first pixel of the 2 x 2 block
+  ivec2 full_size = textureSize(depth_buffer, 0);
+  ivec2 raster_coord = min(coord * 2, full_size - 1);
+  vec3 position = viewSpacePosition(
+    (vec2(raster_coord) + 0.5f) / vec2(full_size),
+    texelFetch(depth_buffer, raster_coord, 0).r);
+  vec4 prev_screen = transform_view_to_prev_screen * vec4(position, 1.0f);
+  vec2 prev_texture_space = prev_screen.xy / prev_screen.w * 0.5f + vec2(0.5f);
+
+  float weight = history_weight;
+  if (any(lessThan(prev_texture_space, vec2(0.0f))) ||
+      any(greaterThan(prev_texture_space, vec2(1.0f))))
+  {
+    weight = 0.0f;
+  }
+  vec4 history = clamp(
+    texture(history_buffer, prev_texture_space), neighbourhood_min, neighbourhood_max);
+  resolved = mix(current, history, weight);
+}
\ No newline at end of file
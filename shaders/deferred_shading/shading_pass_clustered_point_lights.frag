@@ -0,0 +1,207 @@
+#version 410 core
+
+struct PointLightSource
+{
+  vec3  position;     // Position in view space
+  float radius;       // Distance beyond which the light has no effect
+  vec3  color;        // Works as a filter
+  float radiant_flux; // Given in Watt [M * L^2 * T^-3]
+  vec2  shadow_origin; // Corner of the shadow atlas slot in texture space
+  int   shadowed;     // 0 if the light has no rendered shadow map
+};
+
+// Out data
+layout(location = 0) out vec4 radiance;
+
+// Uniforms
+uniform sampler2D albedo_buffer;    // Albedo
+uniform sampler2D depth_buffer;     // Linear depth
+uniform sampler2D normal_buffer;    // Octahedron encoded normal
+uniform sampler2D material_buffer;  // Roughness, Dielectric Fresnel term, metalness
+
+// Three texels per light, see ClusteredLighting::update
+uniform samplerBuffer light_buffer;
+// Offset and number of light indices of each cluster
+uniform usamplerBuffer cluster_buffer;
+uniform usamplerBuffer light_index_buffer;
+uniform ivec3 cluster_grid;   // Tiles across the screen and slices
+uniform float cluster_near;   // Depth range of the slices, spaced logarithmically
+uniform float cluster_far;
+
+uniform mat4 P_frag;
+uniform mat4 P_frag_inv;
+
+// Linear depth is stored as the distance along -z divided by max_dist
+const float max_dist = 1000.0f;
+
+vec3 decodeNormal(vec2 encoded)
+{
+  // Octahedron encoding, see encodeNormal in geometry_pass.frag
+  encoded = encoded * 2.0f - 1.0f;
+  vec3 n = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+  float t = clamp(-n.z, 0.0f, 1.0f);
+  n.xy += vec2(n.x >= 0.0f ? -t : t, n.y >= 0.0f ? -t : t);
+  return normalize(n);
+}
+
+// Reconstructs the view space position from the linear depth buffer
+vec3 viewSpacePosition(vec2 texture_coordinate, float depth)
+{
+  vec4 ray = P_frag_inv * vec4(texture_coordinate * 2.0f - 1.0f, 0.0f, 1.0f);
+  vec3 ray_view_space = ray.xyz / ray.w;
+  return ray_view_space * (depth * max_dist / -ray_view_space.z);
+}
+
+PointLightSource fetchLight(int index)
+{
+  vec4 position_radius = texelFetch(light_buffer, index * 3 + 0);
+  vec4 color_flux = texelFetch(light_buffer, index * 3 + 1);
+  vec4 shadow = texelFetch(light_buffer, index * 3 + 2);
+  return PointLightSource(position_radius.xyz, position_radius.w,
+    color_flux.rgb, color_flux.a, shadow.xy, int(shadow.w));
+}
+
+// Cube shadow maps, six faces in a slot of the shadow atlas per light
+uniform sampler2DShadow point_shadow_map;
+uniform float point_shadow_tile_size;       // Side of a face in texture space
+uniform float point_shadow_near_plane;      // Near plane of the face projections
+uniform mat3 point_shadow_view_to_world;    // Rotation from view space to world space
+
+// Direction and up vector of each face, must match point_shadow_atlas.cpp
+const vec3 face_directions[6] = vec3[](
+  vec3(1.0f, 0.0f, 0.0f), vec3(-1.0f, 0.0f, 0.0f),
+  vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f),
+  vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, -1.0f));
+const vec3 face_ups[6] = vec3[](
+  vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f),
+  vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, -1.0f),
+  vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f));
+
+// Fraction of the light that reaches position
+float shadow(PointLightSource light_source, vec3 position, vec3 n)
+{
+  if (light_source.shadowed == 0)
+    return 1.0f;
+  vec2 texel = vec2(1.0f) / vec2(textureSize(point_shadow_map, 0));
+  float face_texels = point_shadow_tile_size / texel.x;
+  // Offset along the normal by a texel at the distance of the position
+  float distance = length(position - light_source.position);
+  vec3 offset_position = position + n * 3.0f * distance / face_texels;
+  vec3 w = point_shadow_view_to_world * (offset_position - light_source.position);
+
+  vec3 a = abs(w);
+  int face = a.x >= a.y && a.x >= a.z ? (w.x > 0.0f ? 0 : 1) :
+    a.y >= a.z ? (w.y > 0.0f ? 2 : 3) : (w.z > 0.0f ? 4 : 5);
+  vec3 forward = face_directions[face];
+  vec3 up = face_ups[face];
+  vec3 right = cross(forward, up);
+  float z = dot(w, forward);
+  if (z >= light_source.radius)
+    return 1.0f;
+  vec2 face_coordinate = vec2(dot(w, right), dot(w, up)) / z * 0.5f + 0.5f;
+  float near_plane = point_shadow_near_plane;
+  float far_plane = light_source.radius;
+  // Depth of the perspective projection of the face
+  float depth = ((far_plane + near_plane) / (far_plane - near_plane) -
+    2.0f * far_plane * near_plane / ((far_plane - near_plane) * z)) * 0.5f + 0.5f;
+
+  // Keep the filter footprint within the face
+  float border = 1.5f / face_texels;
+  face_coordinate = clamp(face_coordinate, border, 1.0f - border);
+  vec2 tile = vec2(face % 3, face / 3);
+  vec2 uv = light_source.shadow_origin + (face_coordinate + tile) * point_shadow_tile_size;
+  // 2 x 2 bilinear comparisons
+  float lit = 0.0f;
+  for (int y = 0; y < 2; ++y)
+  {
+    for (int x = 0; x < 2; ++x)
+      lit += texture(point_shadow_map, vec3(uv + (vec2(x, y) - 0.5f) * texel, depth));
+  }
+  return lit / 4.0f;
+}
+
+#define PI 3.1415
+float gaussian(float x, float sigma, float mu)
+{
+  float a = 1.0f / (sigma * sqrt(2.0f * PI));
+  float x_minus_b = x - mu;
+  return a * exp(-(x_minus_b * x_minus_b) / (2.0f * sigma * sigma));
+}
+
+void main()
+{
+  vec3 total_radiance = vec3(0.0f);
+
+  ivec2 raster_coord = ivec2(gl_FragCoord.xy);
+
+  // Material properties, read once for all lights
+  vec4 albedo =     texelFetch(albedo_buffer,   raster_coord, 0);
+  if (albedo.a != 0.0)
+  {
+    vec2 texture_coordinate =
+      (vec2(raster_coord) + 0.5f) / vec2(textureSize(depth_buffer, 0));
+    vec3 position =   viewSpacePosition(
+      texture_coordinate, texelFetch(depth_buffer, raster_coord, 0).r);
+    vec3 normal =     decodeNormal(texelFetch(normal_buffer, raster_coord, 0).xy);
+    vec3 material =   texelFetch(material_buffer, raster_coord, 0).xyz;
+    float roughness = material.x;
+    float R =         material.y;
+    float metalness = material.z;
+
+    // Cluster of the fragment
+    float distance_to_camera = -position.z;
+    if (distance_to_camera >= cluster_near && distance_to_camera < cluster_far)
+    {
+      ivec2 tile = min(ivec2(texture_coordinate * vec2(cluster_grid.xy)), cluster_grid.xy - 1);
+      int slice = int(log(distance_to_camera / cluster_near) /
+        log(cluster_far / cluster_near) * float(cluster_grid.z));
+      slice = clamp(slice, 0, cluster_grid.z - 1);
+      int cluster = (slice * cluster_grid.y + tile.y) * cluster_grid.x + tile.x;
+      uvec2 range = texelFetch(cluster_buffer, cluster).xy;
+
+      // Useful vectors
+      vec3 n = normalize(normal);
+      vec3 v = normalize(position - vec3(0.0f));
+      vec3 r = reflect(v, n);
+
+      // Different Frenel depending on if the material is metal or dielectric
+      vec3  R_metal = (albedo.rgb + (vec3(1.0f) - albedo.rgb) * vec3(R));
+      vec3  R_diffuse = vec3((1.0f - R) * (1.0f - metalness));
+      vec3  R_specular = vec3(R * (1.0f - metalness)) + R_metal * metalness;
+
+      for (uint i = range.x; i < range.x + range.y; ++i)
+      {
+        PointLightSource light_source =
+          fetchLight(int(texelFetch(light_index_buffer, int(i)).r));
+        vec3 light_to_point = position - light_source.position;
+        float dist = length(light_to_point);
+        if (dist >= light_source.radius)
+          continue;
+        float inv_dist_square = 1.0f / (dist * dist);
+        vec3 l = light_to_point / dist;
+
+        // Form factors
+        float cos_theta = max(dot(n, -l), 0.0f);
+        float cos_beta =  max(dot(r, -l), 0.0f);
+
+        // BRDFs, see shading_pass_point_light.frag
+        float BRDF_diffuse = 1.0;
+        float BRDF_specular_times_cos_theta = gaussian(acos(cos_beta) / (PI / 4.0f), roughness, 0.0f) * 4.0f;
+
+        // Irradiance measured in Watts per square meter
+        float light_source_radiance = light_source.radiant_flux * inv_dist_square;
+        float irradiance_diffuse =  light_source_radiance * BRDF_diffuse      * cos_theta * 2 * PI;
+        float irradiance_specular = light_source_radiance * BRDF_specular_times_cos_theta * 2 * PI;
+
+        float lit = shadow(light_source, position, n);
+
+        // Filter radiance through colors and material
+        vec3 diffuse_radiance = albedo.rgb * R_diffuse  * light_source.color * irradiance_diffuse * lit;
+        vec3 specular_radiance =             R_specular * light_source.color * irradiance_specular * lit;
+        total_radiance += diffuse_radiance + specular_radiance;
+      }
+    }
+  }
+  // Add to final radiance
+  radiance = vec4(total_radiance, 1.0f);
+}
\ No newline at end of file
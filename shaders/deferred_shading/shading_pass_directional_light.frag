@@ -12,13 +12,90 @@ layout(location = 0) out vec4 radiance;
 
 // Uniforms
 uniform sampler2D albedo_buffer;    // Albedo
-uniform sampler2D position_buffer;  // Position
-uniform sampler2D normal_buffer;    // Normal
+uniform sampler2D depth_buffer;     // Linear depth
+uniform sampler2D normal_buffer;    // Octahedron encoded normal
 uniform sampler2D material_buffer;  // Roughness, Dielectric Fresnel term, metalness
 
 uniform DirectionalLightSource light_source;
 
 uniform mat4 P_frag;
+uniform mat4 P_frag_inv;
+
+// Linear depth is stored as the distance along -z divided by max_dist
+const float max_dist = 1000.0f;
+
+vec3 decodeNormal(vec2 encoded)
+{
+  // Octahedron encoding, see encodeNormal in geometry_pass.frag
+  encoded = encoded * 2.0f - 1.0f;
+  vec3 n = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+  float t = clamp(-n.z, 0.0f, 1.0f);
+  n.xy += vec2(n.x >= 0.0f ? -t : t, n.y >= 0.0f ? -t : t);
+  return normalize(n);
+}
+
+// Reconstructs the view space position from the linear depth buffer
+vec3 viewSpacePosition(vec2 texture_coordinate, float depth)
+{
+  vec4 ray = P_frag_inv * vec4(texture_coordinate * 2.0f - 1.0f, 0.0f, 1.0f);
+  vec3 ray_view_space = ray.xyz / ray.w;
+  return ray_view_space * (depth * max_dist / -ray_view_space.z);
+}
+
+vec3 viewSpacePosition(vec2 texture_coordinate)
+{
+  return viewSpacePosition(
+    texture_coordinate, textureLod(depth_buffer, texture_coordinate, 0).r);
+}
+
+vec3 viewSpacePosition(ivec2 raster_coord)
+{
+  vec2 texture_coordinate =
+    (vec2(raster_coord) + 0.5f) / vec2(textureSize(depth_buffer, 0));
+  return viewSpacePosition(
+    texture_coordinate, texelFetch(depth_buffer, raster_coord, 0).r);
+}
+
+// Cascaded shadow map, all cascades are tiles of one texture
+uniform sampler2DShadow shadow_map;
+uniform mat4 shadow_transforms[4]; // View space to texture space of each cascade
+uniform float shadow_texel_sizes[4]; // Size of a texel in meters
+uniform ivec2 shadow_tiles;
+uniform int number_of_cascades; // 0 if the light casts no shadows
+uniform int valid_cascades; // Bit mask of cascades that have been rendered
+
+// Fraction of the light that reaches position, the first cascade that
+// covers the position is used
+float shadow(vec3 position, vec3 n)
+{
+  for (int i = 0; i < number_of_cascades; ++i)
+  {
+    if ((valid_cascades & (1 << i)) == 0)
+      continue;
+    // Offset along the normal against acne on surfaces facing away
+    vec3 offset_position = position + n * shadow_texel_sizes[i] * 1.5f;
+    vec4 coordinate = shadow_transforms[i] * vec4(offset_position, 1.0f);
+    vec2 texel = vec2(1.0f) / vec2(textureSize(shadow_map, 0));
+    vec2 tile_texel = texel * vec2(shadow_tiles);
+    // Leave room for the filter footprint
+    if (any(lessThan(coordinate.xy, 2.0f * tile_texel)) ||
+        any(greaterThan(coordinate.xy, 1.0f - 2.0f * tile_texel)) ||
+        coordinate.z > 1.0f)
+      continue;
+
+    vec2 tile = vec2(i % shadow_tiles.x, i / shadow_tiles.x);
+    vec2 uv = (coordinate.xy + tile) / vec2(shadow_tiles);
+    // 3 x 3 bilinear comparisons
+    float lit = 0.0f;
+    for (int y = -1; y <= 1; ++y)
+    {
+      for (int x = -1; x <= 1; ++x)
+        lit += texture(shadow_map, vec3(uv + vec2(x, y) * texel, coordinate.z));
+    }
+    return lit / 9.0f;
+  }
+  return 1.0f;
+}
 
 #define PI 3.1415
 float gaussian(float x, float sigma, float mu)
@@ -41,7 +118,7 @@ float castShadowRay(vec3 origin, vec3 direction)
     vec4 position_clip_space = P_frag * vec4(position_view_space, 1.0f);
     vec3 position_screen_space = position_clip_space.xyz / position_clip_space.w;
     vec2 position_texture_space = position_screen_space.xy * 0.5f + vec2(0.5f);
-    vec3 position = textureLod(position_buffer, position_texture_space, 0).xyz;
+    vec3 position = viewSpacePosition(position_texture_space);
     float alpha = textureLod(albedo_buffer, position_texture_space, 0).a;
 
     if (position_texture_space.x < 0 || position_texture_space.x > 1 ||
@@ -67,8 +144,8 @@ void main()
   vec4 albedo = texelFetch(albedo_buffer, raster_coord, 0);
   if (albedo.a != 0.0)
   {
-    vec3 position =   texelFetch(position_buffer, raster_coord, 0).xyz;
-    vec3 normal =     texelFetch(normal_buffer,   raster_coord, 0).xyz;
+    vec3 position =   viewSpacePosition(raster_coord);
+    vec3 normal =     decodeNormal(texelFetch(normal_buffer, raster_coord, 0).xy);
     float roughness = texelFetch(material_buffer, raster_coord, 0).x;
     float R =         texelFetch(material_buffer, raster_coord, 0).y;
     float metalness = texelFetch(material_buffer, raster_coord, 0).z;
@@ -105,7 +182,7 @@ void main()
     float irradiance_diffuse =  light_source.radiance * BRDF_diffuse      * cos_theta * 2 * PI;
     float irradiance_specular = light_source.radiance * BRDF_specular_times_cos_theta * 2 * PI;
 
-    float hit = 0;// castShadowRay(position + n * 0.01f, -l);
+    float hit = 1.0f - shadow(position, n);
 
     // Different Frenel depending on if the material is metal or dielectric
     vec3  R_metal = (albedo.rgb + (vec3(1.0f) - albedo.rgb) * vec3(R));
@@ -5,20 +5,64 @@ layout(location = 0) out vec4 radiance;
 
 // Uniforms
 uniform sampler2D albedo_buffer; // Albedo
-uniform sampler2D position_buffer; // Position
-uniform sampler2D normal_buffer; // Normal
+uniform sampler2D depth_buffer;     // Linear depth
+uniform sampler2D normal_buffer;    // Octahedron encoded normal
 uniform sampler2D material_buffer; // Roughness, Dielectric Fresnel term, metalness
 
-uniform samplerCube cube_map;
-uniform int cube_map_size;
+// Diffusely reflected sky box radiance projected on spherical harmonics, see
+// diffuseReflection in image_processing.h
+uniform vec3 sh_diffuse[9];
 uniform mat3 V_inv;
+uniform mat4 P_frag_inv;
 
-vec3 environment(vec3 dir_view_space, float roughness)
+// Linear depth is stored as the distance along -z divided by max_dist
+const float max_dist = 1000.0f;
+
+vec3 decodeNormal(vec2 encoded)
+{
+  // Octahedron encoding, see encodeNormal in geometry_pass.frag
+  encoded = encoded * 2.0f - 1.0f;
+  vec3 n = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+  float t = clamp(-n.z, 0.0f, 1.0f);
+  n.xy += vec2(n.x >= 0.0f ? -t : t, n.y >= 0.0f ? -t : t);
+  return normalize(n);
+}
+
+// Reconstructs the view space position from the linear depth buffer
+vec3 viewSpacePosition(vec2 texture_coordinate, float depth)
+{
+  vec4 ray = P_frag_inv * vec4(texture_coordinate * 2.0f - 1.0f, 0.0f, 1.0f);
+  vec3 ray_view_space = ray.xyz / ray.w;
+  return ray_view_space * (depth * max_dist / -ray_view_space.z);
+}
+
+vec3 viewSpacePosition(vec2 texture_coordinate)
+{
+  return viewSpacePosition(
+    texture_coordinate, textureLod(depth_buffer, texture_coordinate, 0).r);
+}
+
+vec3 viewSpacePosition(ivec2 raster_coord)
+{
+  vec2 texture_coordinate =
+    (vec2(raster_coord) + 0.5f) / vec2(textureSize(depth_buffer, 0));
+  return viewSpacePosition(
+    texture_coordinate, texelFetch(depth_buffer, raster_coord, 0).r);
+}
+
+vec3 diffuseEnvironment(vec3 normal_view_space)
 {
-  float level = clamp(log2(roughness * cube_map_size), 0, 10);
-  vec3 dir_world_space = V_inv * dir_view_space;
-  vec3 color = textureLod(cube_map, dir_world_space, level).rgb;
-  return color;
+  vec3 n = V_inv * normal_view_space;
+  return max(
+    sh_diffuse[0] * 0.282095f +
+    sh_diffuse[1] * 0.488603f * n.y +
+    sh_diffuse[2] * 0.488603f * n.z +
+    sh_diffuse[3] * 0.488603f * n.x +
+    sh_diffuse[4] * 1.092548f * n.x * n.y +
+    sh_diffuse[5] * 1.092548f * n.y * n.z +
+    sh_diffuse[6] * 0.315392f * (3.0f * n.z * n.z - 1.0f) +
+    sh_diffuse[7] * 1.092548f * n.x * n.z +
+    sh_diffuse[8] * 0.546274f * (n.x * n.x - n.y * n.y), 0.0f);
 }
 
 void main()
@@ -30,8 +74,8 @@ void main()
   vec4 albedo =     texelFetch(albedo_buffer,   raster_coord, 0);
   if (albedo.a > 0.5)
   {
-    vec3 position =   texelFetch(position_buffer, raster_coord, 0).xyz;
-    vec3 normal =     texelFetch(normal_buffer,   raster_coord, 0).xyz;
+    vec3 position =   viewSpacePosition(raster_coord);
+    vec3 normal =     decodeNormal(texelFetch(normal_buffer, raster_coord, 0).xy);
     float roughness = texelFetch(material_buffer, raster_coord, 0).x;
     float R =         texelFetch(material_buffer, raster_coord, 0).y;
     float metalness = texelFetch(material_buffer, raster_coord, 0).z;
@@ -57,7 +101,7 @@ void main()
     float R_diffuse = (1.0f - R) * (1.0f - metalness);
 
     // Filter radiance through colors and material
-    diffuse_radiance_env = albedo.rgb * R_diffuse * environment(n, 1) * 1.0f;
+    diffuse_radiance_env = albedo.rgb * R_diffuse * diffuseEnvironment(n);
   }
   // Add to final radiance
   radiance = vec4(diffuse_radiance_env, 1.0f);
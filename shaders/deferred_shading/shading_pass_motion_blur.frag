@@ -7,13 +7,31 @@ in vec3 vertex_position_viewspace_unprojected;
 
 // Uniforms
 uniform sampler2D irradiance_buffer;
-uniform sampler2D position_buffer;
+uniform sampler2D depth_buffer;
 uniform sampler2D albedo_buffer;
 
 uniform mat4 transform_view_to_prev_screen;
+uniform mat4 P_frag_inv;
 
 uniform ivec2 window_size;
 
+// Linear depth is stored as the distance along -z divided by max_dist
+const float max_dist = 1000.0f;
+
+vec3 viewSpacePosition(vec2 texture_coordinate, float depth)
+{
+  vec4 ray = P_frag_inv * vec4(texture_coordinate * 2.0f - 1.0f, 0.0f, 1.0f);
+  vec3 ray_view_space = ray.xyz / ray.w;
+  return ray_view_space * (depth * max_dist / -ray_view_space.z);
+}
+
+vec3 viewSpacePosition(ivec2 raster_coord)
+{
+  vec2 texture_coordinate =
+    (vec2(raster_coord) + 0.5f) / vec2(textureSize(depth_buffer, 0));
+  return viewSpacePosition(
+    texture_coordinate, texelFetch(depth_buffer, raster_coord, 0).r);
+}
 
 float max_level = 7; // Corresponds to completely out of focus  
 
@@ -44,7 +62,7 @@ void main()
   vec3 prev_irradiance;
   if (!infinite_dist)
   {
-    position = texelFetch(position_buffer, raster_coord, 0).xyz;
+    position = viewSpacePosition(raster_coord);
   }
   else
   {
@@ -70,7 +88,6 @@ void main()
   color = vec4(convertIrradiance(irradiance), 1.0f);
 
   // Write to linear depth buffer
-  float max_dist = 1000.0f;
   float depth = infinite_dist ? 1.0f : (-position.z / max_dist);
   gl_FragDepth = depth;
 }
\ No newline at end of file
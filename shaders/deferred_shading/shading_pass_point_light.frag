@@ -7,18 +7,127 @@ struct PointLightSource
   float radiant_flux; // Given in Watt [M * L^2 * T^-3]
 };
 
+// In data, per light from point_light_volume.vert
+flat in vec4 light_position_radius;
+flat in vec4 light_color_flux;
+flat in vec4 light_shadow;
+flat in vec2 light_depth_range;
+
 // Out data
 layout(location = 0) out vec4 radiance;
 
 // Uniforms
 uniform sampler2D albedo_buffer;    // Albedo
-uniform sampler2D position_buffer;  // Position
-uniform sampler2D normal_buffer;    // Normal
+uniform sampler2D depth_buffer;     // Linear depth
+uniform sampler2D normal_buffer;    // Octahedron encoded normal
 uniform sampler2D material_buffer;  // Roughness, Dielectric Fresnel term, metalness
 
-uniform PointLightSource light_source;
+PointLightSource light_source;
 
 uniform mat4 P_frag;
+uniform mat4 P_frag_inv;
+
+// Linear depth is stored as the distance along -z divided by max_dist
+const float max_dist = 1000.0f;
+
+vec3 decodeNormal(vec2 encoded)
+{
+  // Octahedron encoding, see encodeNormal in geometry_pass.frag
+  encoded = encoded * 2.0f - 1.0f;
+  vec3 n = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+  float t = clamp(-n.z, 0.0f, 1.0f);
+  n.xy += vec2(n.x >= 0.0f ? -t : t, n.y >= 0.0f ? -t : t);
+  return normalize(n);
+}
+
+// Reconstructs the view space position from the linear depth buffer
+vec3 viewSpacePosition(vec2 texture_coordinate, float depth)
+{
+  vec4 ray = P_frag_inv * vec4(texture_coordinate * 2.0f - 1.0f, 0.0f, 1.0f);
+  vec3 ray_view_space = ray.xyz / ray.w;
+  return ray_view_space * (depth * max_dist / -ray_view_space.z);
+}
+
+vec3 viewSpacePosition(vec2 texture_coordinate)
+{
+  return viewSpacePosition(
+    texture_coordinate, textureLod(depth_buffer, texture_coordinate, 0).r);
+}
+
+vec3 viewSpacePosition(ivec2 raster_coord)
+{
+  vec2 texture_coordinate =
+    (vec2(raster_coord) + 0.5f) / vec2(textureSize(depth_buffer, 0));
+  return viewSpacePosition(
+    texture_coordinate, texelFetch(depth_buffer, raster_coord, 0).r);
+}
+
+// Cube shadow map of the light, six faces in a slot of the shadow atlas
+struct PointShadow
+{
+  int   enabled;    // 0 if the light casts no shadows
+  vec2  origin;     // Corner of the slot in texture space
+  float far_plane;  // Far plane of the face projections
+};
+
+uniform sampler2DShadow point_shadow_map;
+uniform float point_shadow_tile_size;       // Side of a face in texture space
+uniform float point_shadow_near_plane;      // Near plane of the face projections
+uniform mat3 point_shadow_view_to_world;    // Rotation from view space to world space
+PointShadow point_shadow;
+
+// Direction and up vector of each face, must match point_shadow_atlas.cpp
+const vec3 face_directions[6] = vec3[](
+  vec3(1.0f, 0.0f, 0.0f), vec3(-1.0f, 0.0f, 0.0f),
+  vec3(0.0f, 1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f),
+  vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, -1.0f));
+const vec3 face_ups[6] = vec3[](
+  vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f),
+  vec3(0.0f, 0.0f, 1.0f), vec3(0.0f, 0.0f, -1.0f),
+  vec3(0.0f, -1.0f, 0.0f), vec3(0.0f, -1.0f, 0.0f));
+
+// Fraction of the light that reaches position
+float shadow(vec3 position, vec3 n)
+{
+  if (point_shadow.enabled == 0)
+    return 1.0f;
+  vec2 texel = vec2(1.0f) / vec2(textureSize(point_shadow_map, 0));
+  float face_texels = point_shadow_tile_size / texel.x;
+  // Offset along the normal by a texel at the distance of the position
+  float distance = length(position - light_source.position);
+  vec3 offset_position = position + n * 3.0f * distance / face_texels;
+  vec3 w = point_shadow_view_to_world * (offset_position - light_source.position);
+
+  vec3 a = abs(w);
+  int face = a.x >= a.y && a.x >= a.z ? (w.x > 0.0f ? 0 : 1) :
+    a.y >= a.z ? (w.y > 0.0f ? 2 : 3) : (w.z > 0.0f ? 4 : 5);
+  vec3 forward = face_directions[face];
+  vec3 up = face_ups[face];
+  vec3 right = cross(forward, up);
+  float z = dot(w, forward);
+  if (z >= point_shadow.far_plane)
+    return 1.0f;
+  vec2 face_coordinate = vec2(dot(w, right), dot(w, up)) / z * 0.5f + 0.5f;
+  float near_plane = point_shadow_near_plane;
+  float far_plane = point_shadow.far_plane;
+  // Depth of the perspective projection of the face
+  float depth = ((far_plane + near_plane) / (far_plane - near_plane) -
+    2.0f * far_plane * near_plane / ((far_plane - near_plane) * z)) * 0.5f + 0.5f;
+
+  // Keep the filter footprint within the face
+  float border = 1.5f / face_texels;
+  face_coordinate = clamp(face_coordinate, border, 1.0f - border);
+  vec2 tile = vec2(face % 3, face / 3);
+  vec2 uv = point_shadow.origin + (face_coordinate + tile) * point_shadow_tile_size;
+  // 2 x 2 bilinear comparisons
+  float lit = 0.0f;
+  for (int y = 0; y < 2; ++y)
+  {
+    for (int x = 0; x < 2; ++x)
+      lit += texture(point_shadow_map, vec3(uv + (vec2(x, y) - 0.5f) * texel, depth));
+  }
+  return lit / 4.0f;
+}
 
 #define PI 3.1415
 float gaussian(float x, float sigma, float mu)
@@ -41,7 +150,7 @@ float castShadowRay(vec3 origin, vec3 direction)
     vec4 position_clip_space = P_frag * vec4(position_view_space, 1.0f);
     vec3 position_screen_space = position_clip_space.xyz / position_clip_space.w;
     vec2 position_texture_space = position_screen_space.xy * 0.5f + vec2(0.5f);
-    vec3 position = textureLod(position_buffer, position_texture_space, 0).xyz;
+    vec3 position = viewSpacePosition(position_texture_space);
     float alpha = textureLod(albedo_buffer, position_texture_space, 0).a;
 
     if (position_texture_space.x < 0 || position_texture_space.x > 1 ||
@@ -66,12 +175,25 @@ void main()
   
   ivec2 raster_coord = ivec2(gl_FragCoord.xy);
 
+  // Reject surfaces outside of the light volume before reading the G-buffer
+  float depth = texelFetch(depth_buffer, raster_coord, 0).r;
+  if (depth < light_depth_range.x || depth > light_depth_range.y)
+    discard;
+  vec2 texture_coordinate =
+    (vec2(raster_coord) + 0.5f) / vec2(textureSize(depth_buffer, 0));
+  vec3 position = viewSpacePosition(texture_coordinate, depth);
+  if (length(position - light_position_radius.xyz) >= light_position_radius.w)
+    discard;
+
+  light_source = PointLightSource(
+    light_position_radius.xyz, light_color_flux.rgb, light_color_flux.a);
+  point_shadow = PointShadow(int(light_shadow.w), light_shadow.xy, light_shadow.z);
+
   // Material properties
   vec4 albedo =     texelFetch(albedo_buffer,   raster_coord, 0);
   if (albedo.a != 0.0)
   {
-    vec3 position =   texelFetch(position_buffer, raster_coord, 0).xyz;
-    vec3 normal =     texelFetch(normal_buffer,   raster_coord, 0).xyz;
+    vec3 normal =     decodeNormal(texelFetch(normal_buffer, raster_coord, 0).xy);
     float roughness = texelFetch(material_buffer, raster_coord, 0).x;
     float R =         texelFetch(material_buffer, raster_coord, 0).y;
     float metalness = texelFetch(material_buffer, raster_coord, 0).z;
@@ -109,7 +231,7 @@ void main()
     float irradiance_diffuse =  light_source_radiance * BRDF_diffuse      * cos_theta * 2 * PI;
     float irradiance_specular = light_source_radiance * BRDF_specular_times_cos_theta * 2 * PI;
 
-    float hit = 0;// castShadowRay(position + n * 0.01f, -l);
+    float hit = 1.0f - shadow(position, n);
 
     // Different Frenel depending on if the material is metal or dielectric
     vec3  R_metal = (albedo.rgb + (vec3(1.0f) - albedo.rgb) * vec3(R));
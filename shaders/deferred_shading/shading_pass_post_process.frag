@@ -7,7 +7,7 @@ in vec3 vertex_position_viewspace_unprojected;
 
 // Uniforms
 uniform sampler2D irradiance_buffer;
-uniform sampler2D position_buffer;
+uniform sampler2D depth_buffer; // Linear depth
 uniform sampler2D albedo_buffer;
 uniform sampler2D bloom_buffer;
 
@@ -20,6 +20,7 @@ uniform float focus;
 uniform float focal_length;
 
 float max_level = 7; // Corresponds to completely out of focus  
+float max_dist = 1000.0f; // Linear depth is stored divided by max_dist
 
 // Based on the camera parameters and the distance to the object, a mip level
 // for the irradiance buffer can be calculated
@@ -96,11 +97,11 @@ void main()
   ivec2 raster_coord = ivec2(gl_FragCoord.xy);
 
   // Material properties
-  vec3 position = texelFetch(position_buffer, raster_coord, 0).xyz;
+  float object_dist = texelFetch(depth_buffer, raster_coord, 0).r * max_dist;
   float alpha = texelFetch(albedo_buffer, raster_coord, 0).a;
   bool infinite_dist = alpha == 0.0f;
   
-  float level = calculateMipLevel(abs(position.z), infinite_dist);
+  float level = calculateMipLevel(object_dist, infinite_dist);
   vec3 irradiance = calculateUnfocusedIrradiance(sample_point_texture_space, level);
   vec3 bloom = calculateUnfocusedBloom(sample_point_texture_space, level);
 
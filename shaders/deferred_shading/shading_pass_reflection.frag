@@ -5,97 +5,55 @@ layout(location = 0) out vec4 final_irradiance;
 
 // Uniforms
 uniform sampler2D albedo_buffer; // Albedo
-uniform sampler2D position_buffer; // Position
-uniform sampler2D normal_buffer; // Normal
+uniform sampler2D depth_buffer;     // Linear depth
+uniform sampler2D normal_buffer;    // Octahedron encoded normal
 uniform sampler2D material_buffer; // Roughness, Dielectric Fresnel term, metalness
 uniform sampler2D irradiance_buffer; // Irradiance
 
 uniform mat4 P_frag;
+uniform mat4 P_frag_inv;
 
-uniform samplerCube cube_map;
-uniform int cube_map_size;
-uniform mat3 V_inv;
-
-
-
-
-
-
-
-
+// Linear depth is stored as the distance along -z divided by max_dist
+const float max_dist = 1000.0f;
 
-#define point2 vec2
-#define point3 vec3
-
-bool traceScreenSpaceRay(point3 csOrig, vec3 csDir, mat4x4 proj,
-    sampler2D csZBuffer, vec2 csZBufferSize, float zThickness,
-    const bool csZBufferIsHyperbolic, vec3 clipInfo, float nearPlaneZ,
-    float stride, float jitter, const float maxSteps, float maxDistance,
-    out point2 hitPixel, out int hitLayer, out point3 csHitPoint) {
-
-    // Clip to the near plane
-    float rayLength = ((csOrig.z + csDir.z * maxDistance) > nearPlaneZ) ?
-            (nearPlaneZ - csOrig.z) / csDir.z : maxDistance;
-        point3 csEndPoint = csOrig + csDir * rayLength;
-        hitPixel = point2(-1, -1);
-
-    // Project into screen space
-    vec4 H0 = proj * vec4(csOrig, 1.0), H1 = proj * vec4(csEndPoint, 1.0);
-    float k0 = 1.0 / H0.w, k1 = 1.0 / H1.w;
-    point3 Q0 = csOrig * k0, Q1 = csEndPoint * k1;
-
-    // Screen-space endpoints
-    point2 P0 = H0.xy * k0, P1 = H1.xy * k1;
+vec3 decodeNormal(vec2 encoded)
+{
+  // Octahedron encoding, see encodeNormal in geometry_pass.frag
+  encoded = encoded * 2.0f - 1.0f;
+  vec3 n = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+  float t = clamp(-n.z, 0.0f, 1.0f);
+  n.xy += vec2(n.x >= 0.0f ? -t : t, n.y >= 0.0f ? -t : t);
+  return normalize(n);
+}
 
-    // [ Optionally clip here using listing 4 ]
-    P1 += vec2((pow(distance(P0, P1), 2) < 0.0001) ? 0.01 : 0.0);
-    vec2 delta = P1 - P0;
-    bool permute = false;
-    if (abs(delta.x) < abs(delta.y)) {
-        permute = true;
-        delta = delta.yx; P0 = P0.yx; P1 = P1.yx;
-    }
-    float stepDir = sign(delta.x), invdx = stepDir / delta.x;
+// Reconstructs the view space position from the linear depth buffer
+vec3 viewSpacePosition(vec2 texture_coordinate, float depth)
+{
+  vec4 ray = P_frag_inv * vec4(texture_coordinate * 2.0f - 1.0f, 0.0f, 1.0f);
+  vec3 ray_view_space = ray.xyz / ray.w;
+  return ray_view_space * (depth * max_dist / -ray_view_space.z);
+}
 
-    // Track the derivatives of Q and k.
-    vec3 dQ = (Q1 - Q0) * invdx;
-    float dk = (k1 - k0) * invdx;
-    vec2 dP = vec2(stepDir, delta.y * invdx);
-    dP *= stride; dQ *= stride; dk *= stride;
-    P0 += dP * jitter; Q0 += dQ * jitter; k0 += dk * jitter;
-    float prevZMaxEstimate = csOrig.z;
+vec3 viewSpacePosition(vec2 texture_coordinate)
+{
+  return viewSpacePosition(
+    texture_coordinate, textureLod(depth_buffer, texture_coordinate, 0).r);
+}
 
-    // Slide P from P0 to P1, (now-homogeneous) Q from Q0 to Q1, k from k0 to k1
-    point3 Q = Q0; float k = k0, stepCount = 0.0, end = P1.x * stepDir;
-    for
-    (point2 P = P0;
-    ((P.x * stepDir) <= end) && (stepCount < maxSteps);
-    P += dP, Q.z += dQ.z, k += dk, stepCount += 1.0) {
-        // Project back from homogeneous to camera space
-        hitPixel = permute ? P.yx : P;
-        
-        // The depth range that the ray covers within this loop iteration.
-        // Assume that the ray is moving in increasing z and swap if backwards.
-        float rayZMin = prevZMaxEstimate;
-        // Compute the value at 1/2 pixel into the future
-        float rayZMax = (dQ.z * 0.5 +Q.z)/(dk*0.5+k);
-        prevZMaxEstimate = rayZMax;
-        if (rayZMin > rayZMax) { float tmp = rayZMin; rayZMin = rayZMax; rayZMax = tmp; }
-        // Camera-space z of the background at each layer (there can be up to 4)
-        float sceneZMax = -texelFetch(csZBuffer, ivec2(hitPixel), 0).z;
-        float sceneZMin = sceneZMax - zThickness;
-        if (((rayZMax >= sceneZMin) && (rayZMin <= sceneZMax)) ||
-            (sceneZMax == 0)) {
-              hitLayer = 0;
-              break; // Breaks out of both loops, since the inner loop is a macro
-        }
-    } // for each pixel on ray
-    // Advance Q based on the number of steps
-    Q.xy += dQ.xy * stepCount; csHitPoint = Q * (1.0 / k);
-    return all(lessThanEqual(abs(hitPixel - (csZBufferSize * 0.5)),
-                         csZBufferSize * 0.5));
-} 
+vec3 viewSpacePosition(ivec2 raster_coord)
+{
+  vec2 texture_coordinate =
+    (vec2(raster_coord) + 0.5f) / vec2(textureSize(depth_buffer, 0));
+  return viewSpacePosition(
+    texture_coordinate, texelFetch(depth_buffer, raster_coord, 0).r);
+}
 
+// Sky box convolved with GGX, one mip level per roughness
+uniform samplerCube specular_environment;
+uniform int specular_environment_levels;
+// Split sum BRDF scale and bias indexed by n dot v and roughness
+uniform sampler2D brdf_lut;
+uniform mat3 V_inv;
 
 
 
@@ -105,16 +63,159 @@ bool traceScreenSpaceRay(point3 csOrig, vec3 csDir, mat4x4 proj,
 
 
 
+// Screen space reflections
+uniform sampler2D hi_z_buffer; // Min and max linear depth, half resolution
+uniform int hi_z_levels;
+uniform int ssr_mode; // 0 off, 1 linear, 2 hierarchical z
 
+// Depth of the surfaces in the depth buffer in meters
+const float ssr_thickness = 0.3f;
+const float ssr_max_distance = 50.0f;
+const int ssr_linear_max_steps = 400;
+const int ssr_hi_z_max_steps = 48;
 
+// A view space ray projected on screen and parametrized by t in [0, 1].
+// The reciprocal of the depth is linear in t.
+struct ScreenSpaceRay
+{
+  vec2 start; // In pixels of the traced buffer
+  vec2 delta;
+  float k_start; // 1 / distance along -z
+  float k_delta;
+  float t_end; // Where the ray leaves the screen
+};
+
+ScreenSpaceRay screenSpaceRay(vec3 origin, vec3 direction, vec2 size)
+{
+  // Clip to a plane just in front of the camera
+  const float near_z = -0.01f;
+  float ray_length = (origin.z + direction.z * ssr_max_distance) > near_z ?
+    (near_z - origin.z) / direction.z : ssr_max_distance;
+  vec3 end = origin + direction * ray_length;
+
+  vec4 h0 = P_frag * vec4(origin, 1.0f);
+  vec4 h1 = P_frag * vec4(end, 1.0f);
+  ScreenSpaceRay ray;
+  ray.start = (h0.xy / h0.w * 0.5f + 0.5f) * size;
+  ray.delta = (h1.xy / h1.w * 0.5f + 0.5f) * size - ray.start;
+  // Avoid dividing by zero for axis aligned rays
+  ray.delta = mix(ray.delta, vec2(1e-4f), lessThan(abs(ray.delta), vec2(1e-4f)));
+  ray.k_start = 1.0f / -origin.z;
+  ray.k_delta = 1.0f / -end.z - ray.k_start;
+
+  vec2 bound = mix(vec2(0.0f), size, greaterThan(ray.delta, vec2(0.0f)));
+  vec2 t_exit = (bound - ray.start) / ray.delta;
+  ray.t_end = min(1.0f, min(t_exit.x, t_exit.y));
+  return ray;
+}
 
+float depthAlongRay(ScreenSpaceRay ray, float t)
+{
+  return 1.0f / (ray.k_start + ray.k_delta * t);
+}
 
+float rayParameterAtDepth(ScreenSpaceRay ray, float depth)
+{
+  return (1.0f / depth - ray.k_start) / ray.k_delta;
+}
 
+// Marches one pixel at a time through the full resolution depth buffer
+bool traceLinear(ScreenSpaceRay ray, out float t_hit)
+{
+  float dt = 1.0f / max(abs(ray.delta.x), abs(ray.delta.y));
+  float previous_depth = depthAlongRay(ray, 0.0f);
+  float t = dt;
+  for (int i = 0; i < ssr_linear_max_steps && t < ray.t_end; ++i)
+  {
+    float ray_depth = depthAlongRay(ray, t);
+    float scene_depth =
+      texelFetch(depth_buffer, ivec2(ray.start + ray.delta * t), 0).r * max_dist;
+    if (max(previous_depth, ray_depth) >= scene_depth &&
+        min(previous_depth, ray_depth) <= scene_depth + ssr_thickness)
+    {
+      t_hit = t;
+      return true;
+    }
+    previous_depth = ray_depth;
+    t += dt;
+  }
+  return false;
+}
 
+// Walks the min max depth pyramid. Cells that the ray passes in front of or
+// behind are skipped whole and the next step is taken at a coarser level.
+// Cells the ray may intersect are refined until the finest level.
+bool traceHierarchicalZ(ScreenSpaceRay ray, out float t_hit)
+{
+  int max_level = hi_z_levels - 1;
+  int level = 0;
+  // Parameter step of one pixel at the finest level
+  float pixel = 1.0f / max(abs(ray.delta.x), abs(ray.delta.y));
+  vec2 cell_direction = step(0.0f, ray.delta);
+  // Start outside the pixel of the origin
+  float t = pixel;
+  for (int i = 0; i < ssr_hi_z_max_steps && t < ray.t_end; ++i)
+  {
+    float cell_size = exp2(level);
+    vec2 cell = floor((ray.start + ray.delta * t) / cell_size);
+    vec2 t_boundary = ((cell + cell_direction) * cell_size - ray.start) / ray.delta;
+    float t_exit = min(min(t_boundary.x, t_boundary.y), ray.t_end);
 
+    vec2 min_max = texelFetch(hi_z_buffer, ivec2(cell), level).rg * max_dist;
+    float depth_enter = depthAlongRay(ray, t);
+    float depth_exit = depthAlongRay(ray, t_exit);
 
+    if (max(depth_enter, depth_exit) < min_max.x ||
+        min(depth_enter, depth_exit) > min_max.y + ssr_thickness)
+    {
+      // Step just across the cell boundary
+      t = t_exit + pixel * 0.01f;
+      level = min(level + 1, max_level);
+    }
+    else if (level == 0)
+    {
+      t_hit = t;
+      return true;
+    }
+    else
+    {
+      // Move up to the closest surface in the cell before refining
+      if (depth_enter < min_max.x)
+        t = max(t, rayParameterAtDepth(ray, min_max.x));
+      level--;
+    }
+  }
+  return false;
+}
 
+// Returns the weight of the reflection, zero if the ray missed
+float screenSpaceReflection(
+  vec3 origin, vec3 direction, float roughness, out vec3 radiance)
+{
+  radiance = vec3(0.0f);
+  bool hierarchical = ssr_mode == 2;
+  vec2 size = hierarchical ?
+    vec2(textureSize(hi_z_buffer, 0)) : vec2(textureSize(depth_buffer, 0));
+  ScreenSpaceRay ray = screenSpaceRay(origin, direction, size);
+
+  float t_hit;
+  bool hit = hierarchical ? traceHierarchicalZ(ray, t_hit) : traceLinear(ray, t_hit);
+  if (!hit)
+    return 0.0f;
 
+  vec2 position_texture_space = (ray.start + ray.delta * t_hit) / size;
+  vec3 position = viewSpacePosition(position_texture_space);
+  // Rough surfaces sample blurrier mip levels the further the ray travelled
+  float level = clamp(
+    log2(distance(position, origin) / -position.z * roughness * 1000), 0, 7);
+  float alpha = textureLod(albedo_buffer, position_texture_space, level).a;
+  radiance = textureLod(irradiance_buffer, position_texture_space, level).rgb;
+
+  // Fade out towards the screen edges where rays start to miss
+  vec2 edge = min(position_texture_space, 1.0f - position_texture_space);
+  float edge_fade = clamp(min(edge.x, edge.y) * 10.0f, 0.0f, 1.0f);
+  return max((alpha - 0.5f) * 2.0f, 0.0f) * edge_fade;
+}
 
 float rand(vec2 co){
   return fract(sin(dot(co.xy ,vec2(12.9898,78.233))) * 43758.5453);
@@ -186,7 +287,7 @@ float castReflectionRay(vec3 origin, vec3 direction, out vec3 radiance, float ro
   
     
     vec2 position_texture_space = position_screen_space.xy * 0.5f + vec2(0.5f);
-    vec3 position = textureLod(position_buffer, position_texture_space, 0).xyz;
+    vec3 position = viewSpacePosition(position_texture_space);
     float alpha = textureLod(albedo_buffer, position_texture_space, 0).a;
 
     if (position_texture_space.x < 0 || position_texture_space.x > 1 ||
@@ -215,7 +316,7 @@ float castReflectionRay(vec3 origin, vec3 direction, out vec3 radiance, float ro
     vec4 position_clip_space = P_frag * vec4(position_view_space, 1.0f);
     vec3 position_screen_space = position_clip_space.xyz / position_clip_space.w;
     vec2 position_texture_space = position_screen_space.xy * 0.5f + vec2(0.5f);
-    vec3 position = textureLod(position_buffer, position_texture_space, 0).xyz;
+    vec3 position = viewSpacePosition(position_texture_space);
     float alpha = textureLod(albedo_buffer, position_texture_space, 0).a;
 
     if (position_texture_space.x < 0 || position_texture_space.x > 1 ||
@@ -259,7 +360,7 @@ float castReflectionRay2(vec3 origin, vec3 direction, out vec3 radiance, float r
     vec4 position_clip_space = P_frag * vec4(position_view_space, 1.0f);
     vec3 position_screen_space = position_clip_space.xyz / position_clip_space.w;
     position_texture_space = position_screen_space.xy * 0.5f + vec2(0.5f);
-    position = textureLod(position_buffer, position_texture_space, 0).xyz;
+    position = viewSpacePosition(position_texture_space);
     float alpha = textureLod(albedo_buffer, position_texture_space, 0).a;
 
     if (position_texture_space.x < 0 || position_texture_space.x > 1 ||
@@ -301,25 +402,90 @@ float castReflectionRay2(vec3 origin, vec3 direction, out vec3 radiance, float r
 
 vec3 environment(vec3 dir_view_space, float roughness)
 {
-  float level = clamp(log2(roughness * cube_map_size), 0, 10);
+  float level = roughness * (specular_environment_levels - 1);
   vec3 dir_world_space = V_inv * dir_view_space;
-  vec3 color = textureLod(cube_map, dir_world_space, level).rgb;
-  return color;
+  return textureLod(specular_environment, dir_world_space, level).rgb;
+}
+
+// Reflections traced at half resolution, see reflection_pass
+uniform int reflection_pass; // 0 trace and shade, 1 trace only, 2 shade upsampled
+uniform ivec2 ssr_jitter; // Pixel traced in each 2 x 2 block this frame
+uniform sampler2D ssr_buffer; // Temporally resolved half resolution reflections
+
+// Radiance of the screen space reflection and its weight, zero on a miss
+vec4 traceReflection(vec3 position, vec3 n, float roughness)
+{
+  vec3 v = normalize(position);
+  vec3 radiance;
+  float hit = screenSpaceReflection(position + n * 0.01f, reflect(v, n), roughness, radiance);
+  // Fade out reflections toward camera
+  hit *= 1 - max(dot(-v, n), 0.0f);
+  return vec4(radiance, hit);
+}
+
+// Joint bilateral upsampling. The bilinear weights of the four closest half
+// resolution texels are scaled down where the surface of the texel differs.
+// Each texel represents the first pixel of its 2 x 2 block.
+vec4 upsampleReflection(ivec2 raster_coord, vec3 position, vec3 n)
+{
+  ivec2 full_size = textureSize(depth_buffer, 0);
+  ivec2 half_size = textureSize(ssr_buffer, 0);
+  vec2 coord = (vec2(raster_coord) + 0.5f) * 0.5f - 0.5f;
+  ivec2 base = ivec2(floor(coord));
+  vec2 f = coord - vec2(base);
+
+  vec4 sum = vec4(0.0f);
+  float weight_sum = 0.0f;
+  for (int i = 0; i < 4; ++i)
+  {
+    ivec2 offset = ivec2(i & 1, i >> 1);
+    ivec2 texel = clamp(base + offset, ivec2(0), half_size - 1);
+    ivec2 sample_coord = min(texel * 2, full_size - 1);
+    vec3 sample_position = viewSpacePosition(sample_coord);
+    vec3 sample_normal = decodeNormal(texelFetch(normal_buffer, sample_coord, 0).xy);
+
+    vec2 bilinear = mix(1.0f - f, f, vec2(offset));
+    float depth_weight = 1.0f / (1e-3f + abs(sample_position.z - position.z) / -position.z);
+    float normal_weight = pow(max(dot(n, sample_normal), 0.0f), 8.0f);
+    float weight = bilinear.x * bilinear.y * depth_weight * normal_weight;
+    sum += texelFetch(ssr_buffer, texel, 0) * weight;
+    weight_sum += weight;
+  }
+  // No texel lies on the same surface, fall back to the closest one
+  if (weight_sum < 1e-4f)
+    return texelFetch(ssr_buffer, clamp(ivec2(coord + 0.5f), ivec2(0), half_size - 1), 0);
+  return sum / weight_sum;
 }
 
 void main()
 {
   vec3 specular_radiance_env;
   ivec2 raster_coord = ivec2(gl_FragCoord.xy);
+  if (reflection_pass == 1)
+  {
+    raster_coord = min(raster_coord * 2 + ssr_jitter, textureSize(depth_buffer, 0) - 1);
+  }
  
   // Material properties
   vec3 irradiance = texelFetch(irradiance_buffer, raster_coord, 0).rgb;
-  vec3 position =   texelFetch(position_buffer,   raster_coord, 0).xyz;
+  vec3 position =   viewSpacePosition(raster_coord);
   vec4 albedo =     texelFetch(albedo_buffer,     raster_coord, 0);
   
+  if (reflection_pass == 1)
+  {
+    final_irradiance = vec4(0.0f);
+    if (albedo.a > 0.5)
+    {
+      vec3 n = decodeNormal(texelFetch(normal_buffer, raster_coord, 0).xy);
+      float roughness = texelFetch(material_buffer, raster_coord, 0).x;
+      final_irradiance = traceReflection(position, n, roughness);
+    }
+    return;
+  }
+
   if (albedo.a > 0.5)
   {
-    vec3 normal =     texelFetch(normal_buffer,   raster_coord, 0).xyz;
+    vec3 normal =     decodeNormal(texelFetch(normal_buffer, raster_coord, 0).xy);
     float roughness = texelFetch(material_buffer, raster_coord, 0).x;
     float R =         texelFetch(material_buffer, raster_coord, 0).y;
     float metalness = texelFetch(material_buffer, raster_coord, 0).z;
@@ -329,32 +495,23 @@ void main()
     vec3 v = normalize(position - vec3(0.0f));
     vec3 r = reflect(v, n);
 
-    // Form factors
-    float cos_alpha = max(dot(-v, n), 0.0f);
-
-    // BRDFs
-    float BRDF_specular_times_cos_theta_at_reflection = 1.0f;
-
-    // Irradiance measured in Watts per square meter
-    // [M * L^2 * T^-3] * [Sr^-1] * [L^-2] = [M * Sr^-1 * T^-3]
-    // Rendering equation over whole hemisphere
-    float irradiance_specular_environment = 1.0f * BRDF_specular_times_cos_theta_at_reflection;
-
-    vec3 radiance_reflection = vec3(0);
-    float hit = 0;// castReflectionRay2(position + n * 0.01f, r, radiance_reflection, roughness);
-    
-
-
+    // Specular BRDF integrated over the hemisphere, split sum approximation
+    vec2 brdf = texture(brdf_lut, vec2(max(dot(-v, n), 0.0f), roughness)).rg;
 
-    // Fade out reflections toward camera
-    hit *= 1 - cos_alpha;
+    vec4 reflection = vec4(0.0f);
+    if (reflection_pass == 2)
+      reflection = upsampleReflection(raster_coord, position, n);
+    else if (ssr_mode != 0)
+      reflection = traceReflection(position, n, roughness);
+    vec3 radiance_reflection = reflection.rgb;
+    float hit = reflection.a;
 
     // Different Frenel depending on if the material is metal or dielectric
     vec3  R_metal = (albedo.rgb + (vec3(1.0f) - albedo.rgb) * vec3(R));
     vec3  R_specular = vec3(R * (1.0f - metalness)) + R_metal * metalness;
 
     // Filter radiance through colors and material  
-    specular_radiance_env = R_specular * (environment(r, roughness) * (1 - hit) + hit * radiance_reflection) * irradiance_specular_environment;
+    specular_radiance_env = (R_specular * brdf.x + brdf.y) * (environment(r, roughness) * (1 - hit) + hit * radiance_reflection);
   }
   // Add to final radiance
   final_irradiance = vec4(max(specular_radiance_env + irradiance, 0.0f), 1.0f);
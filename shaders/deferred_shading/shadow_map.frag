@@ -0,0 +1,7 @@
+#version 410 core
+
+// Only depth is written
+void main()
+{
+
+}
\ No newline at end of file
@@ -0,0 +1,15 @@
+#version 410 core
+
+// In data
+layout(location = 0) in vec3 position;
+
+// Uniform data
+// Transform matrices, V and P of the light
+uniform mat4 M = mat4(1.0f);
+uniform mat4 V = mat4(1.0f);
+uniform mat4 P = mat4(1.0f);
+
+void main()
+{
+  gl_Position = P * V * M * vec4(position, 1);
+}
\ No newline at end of file
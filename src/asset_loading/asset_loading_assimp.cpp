@@ -1,4 +1,5 @@
 #include "elk/asset_loading/asset_loading_assimp.h"
+#include "elk/core/cpu_profiler.h"
 
 #include <assimp/Importer.hpp>
 #include <assimp/scene.h>
@@ -16,6 +17,7 @@ bool loadMesh_assimp(
   std::vector<glm::vec2>*       out_uvs, 
   std::vector<glm::vec3>*       out_normals)
 {
+  ELK_PROFILE_ZONE("loadMesh_assimp");
   Assimp::Importer importer;
 
   const aiScene* scene=importer.ReadFile(
@@ -0,0 +1,54 @@
+// Replaces the global allocation functions to count heap allocations per
+// frame in CpuProfiler. Only built with ELK_COUNT_ALLOCATIONS, the
+// replacement applies to the whole program the library is linked into.
+#ifdef ELK_COUNT_ALLOCATIONS
+
+#include "elk/core/cpu_profiler.h"
+
+#include <cstdlib>
+#include <new>
+
+namespace {
+
+void* allocate(size_t size)
+{
+  elk::core::CpuProfiler::countAllocation(size);
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+} // namespace
+
+void* operator new(size_t size)
+{
+  void* p = allocate(size);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void* operator new[](size_t size)
+{
+  void* p = allocate(size);
+  if (!p)
+    throw std::bad_alloc();
+  return p;
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+  return allocate(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+  return allocate(size);
+}
+
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete[](void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+void operator delete[](void* p, size_t) noexcept { std::free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { std::free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { std::free(p); }
+
+#endif
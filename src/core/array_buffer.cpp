@@ -1,4 +1,5 @@
 #include "elk/core/array_buffer.h"
+#include "elk/core/render_state.h"
 
 namespace elk { namespace core {
 
@@ -17,6 +18,7 @@ ArrayBuffer::~ArrayBuffer()
 void ArrayBuffer::render()
 {
   glDrawArrays(_init_data.render_mode, 0, _init_data.n_elements);
+  RenderState::countDrawCall();
 }
 
 void ArrayBuffer::update(InitData init_data)
@@ -46,6 +48,7 @@ void ElementArrayBuffer::render()
   glDrawElements(
     _init_data.render_mode, _init_data.n_elements, _init_data.type,
     static_cast<void*>(0));
+  RenderState::countDrawCall();
 }
 
 } }
@@ -1,5 +1,7 @@
 #include "elk/core/bounding_box.h"
 
+#include <limits>
+
 namespace elk { namespace core {
 
 BoundingBox::BoundingBox(glm::vec3 min, glm::vec3 max) :
@@ -61,4 +63,19 @@ std::pair<bool, float> BoundingBox::intersects(
     return {true, tmin};
 }
 
+BoundingBox BoundingBox::transformed(const glm::mat4& transform) const
+{
+  glm::vec3 min(std::numeric_limits<float>::max());
+  glm::vec3 max(-std::numeric_limits<float>::max());
+  for (int i = 0; i < 8; ++i)
+  {
+    glm::vec3 corner(
+      i & 1 ? _max.x : _min.x, i & 2 ? _max.y : _min.y, i & 4 ? _max.z : _min.z);
+    glm::vec3 p = glm::vec3(transform * glm::vec4(corner, 1.0f));
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+  return BoundingBox(min, max);
+}
+
 } }
@@ -0,0 +1,283 @@
+#include "elk/core/cascaded_shadow_map.h"
+
+#include "elk/core/bounding_box.h"
+#include "elk/core/camera.h"
+#include "elk/core/hash.h"
+#include "elk/core/object_3d.h"
+#include "elk/core/render_state.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace elk { namespace core {
+
+std::shared_ptr<ShaderProgram> CascadedShadowMap::_program = nullptr;
+
+namespace {
+
+// Tiles of the shadow map in x and y
+glm::ivec2 tiles(int number_of_cascades)
+{
+  return glm::ivec2(number_of_cascades > 1 ? 2 : 1, number_of_cascades > 2 ? 2 : 1);
+}
+
+} // namespace
+
+CascadedShadowMap::CascadedShadowMap(CascadedShadowMapSettings settings) :
+  _settings(settings),
+  _light_direction(0.0f),
+  _updated_cascades(0)
+{
+  _settings.number_of_cascades =
+    glm::clamp(_settings.number_of_cascades, 1, max_cascades);
+  for (auto& cascade : _cascades)
+    cascade.valid = false;
+
+  glm::ivec2 size = tiles(_settings.number_of_cascades) * _settings.resolution;
+  _depth = std::make_unique<Texture>(
+    glm::uvec3(size.x, size.y, 1), Texture::Format::DepthComponent,
+    GL_DEPTH_COMPONENT32F, GL_FLOAT, Texture::FilterMode::Linear,
+    Texture::WrappingMode::ClampToEdge);
+  // Only GPU storage is needed
+  _depth->resize(_depth->dimensions());
+  // Bilinear filtering of the depth comparison
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+  _fbo.attach2DTexture(_depth->id(), GL_DEPTH_ATTACHMENT, 0);
+  _fbo.bind();
+  glDrawBuffer(GL_NONE);
+  glReadBuffer(GL_NONE);
+  _fbo.unbind();
+
+  shadowCasterProgram();
+}
+
+const std::shared_ptr<ShaderProgram>& CascadedShadowMap::shadowCasterProgram()
+{
+  if (!_program)
+  {
+    _program = std::make_shared<ShaderProgram>(
+      "shadow_map_program",
+      (std::string(ELK_DIR) + "/shaders/deferred_shading/shadow_map.vert").c_str(),
+      nullptr,
+      nullptr,
+      nullptr,
+      (std::string(ELK_DIR) + "/shaders/deferred_shading/shadow_map.frag").c_str());
+  }
+  return _program;
+}
+
+CascadedShadowMap::~CascadedShadowMap()
+{
+
+}
+
+void CascadedShadowMap::update(
+  const PerspectiveCamera& camera, glm::vec3 light_direction,
+  const std::vector<RenderableDeferred*>& renderables)
+{
+  _updated_cascades = 0;
+  light_direction = glm::normalize(light_direction);
+  glm::vec3 up = std::abs(light_direction.y) > 0.99f ?
+    glm::vec3(1.0f, 0.0f, 0.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+  // Rotation only, the light looks along -z
+  const glm::mat4 light_view = glm::lookAt(glm::vec3(0.0f), light_direction, up);
+  if (light_direction != _light_direction)
+  {
+    for (auto& cascade : _cascades)
+      cascade.valid = false;
+    _light_direction = light_direction;
+  }
+
+  // Near and far plane of the camera from its projection
+  const glm::mat4 projection = camera.projectionTransform();
+  const glm::mat4 projection_inv = glm::inverse(projection);
+  const float near = projection[3][2] / (projection[2][2] - 1.0f);
+  const float far = std::min(
+    projection[3][2] / (projection[2][2] + 1.0f), _settings.shadow_distance);
+  const glm::mat4 view_to_light = light_view * camera.absoluteTransform();
+
+  std::vector<Caster> casters;
+  for (auto renderable : renderables)
+  {
+    glm::vec3 min, max;
+    if (!renderable->shadowCasterBounds(min, max))
+      continue;
+    BoundingBox bounds = BoundingBox(min, max).transformed(light_view);
+    casters.push_back(
+      {renderable, bounds.min(), bounds.max(), renderable->absoluteTransform()});
+  }
+
+  const int n = _settings.number_of_cascades;
+  for (int i = 0; i < n; ++i)
+  {
+    // Slice of the view frustum between the practical split distances
+    float split[2];
+    for (int j = 0; j < 2; ++j)
+    {
+      float f = float(i + j) / n;
+      float logarithmic = near * std::pow(far / near, f);
+      float uniform = near + (far - near) * f;
+      split[j] = glm::mix(uniform, logarithmic, _settings.split_lambda);
+    }
+    glm::vec3 corners[8];
+    glm::vec3 center(0.0f);
+    for (int c = 0; c < 8; ++c)
+    {
+      glm::vec4 ray = projection_inv * glm::vec4(
+        c & 1 ? 1.0f : -1.0f, c & 2 ? 1.0f : -1.0f, -1.0f, 1.0f);
+      glm::vec3 ray_view_space = glm::vec3(ray) / ray.w;
+      float depth = split[c >> 2];
+      corners[c] = glm::vec3(view_to_light *
+        glm::vec4(ray_view_space * (depth / -ray_view_space.z), 1.0f));
+      center += corners[c] / 8.0f;
+    }
+    float radius = 0.0f;
+    for (const auto& corner : corners)
+      radius = std::max(radius, glm::length(corner - center));
+    // Rounded so that the size stays constant as the camera rotates
+    radius = std::ceil(radius * 16.0f) / 16.0f;
+
+    Cascade next = _cascades[i];
+    const float half_size = radius * (1.0f + _settings.margin);
+    const glm::vec3 offset = glm::abs(center - next.center);
+    if (!next.valid || next.half_size != half_size ||
+        std::max(offset.x, std::max(offset.y, offset.z)) + radius > half_size)
+    {
+      // Move in whole texels
+      float texel = 2.0f * half_size / _settings.resolution;
+      next.center = glm::floor(center / texel) * texel;
+      next.half_size = half_size;
+    }
+
+    // Casters overlapping the cascade that are not behind all receivers
+    std::vector<const Caster*> cascade_casters;
+    glm::vec3 cube_min = next.center - next.half_size;
+    glm::vec3 cube_max = next.center + next.half_size;
+    float near_z = cube_max.z;
+    std::uint64_t signature = hash_offset_basis;
+    hashBytes(signature, &next.center, sizeof(next.center));
+    hashBytes(signature, &next.half_size, sizeof(next.half_size));
+    for (const auto& caster : casters)
+    {
+      if (caster.max.x < cube_min.x || caster.min.x > cube_max.x ||
+          caster.max.y < cube_min.y || caster.min.y > cube_max.y ||
+          caster.max.z < cube_min.z)
+        continue;
+      cascade_casters.push_back(&caster);
+      near_z = std::max(near_z, caster.max.z);
+      hashBytes(signature, &caster.renderable, sizeof(caster.renderable));
+      hashBytes(signature, &caster.min, sizeof(caster.min));
+      hashBytes(signature, &caster.max, sizeof(caster.max));
+      hashBytes(signature, &caster.transform, sizeof(caster.transform));
+    }
+
+    if (next.valid && signature == _cascades[i].signature)
+      continue;
+    if (_updated_cascades >= _settings.max_updates_per_frame)
+      continue;
+
+    next.view = light_view;
+    next.projection = glm::ortho(
+      cube_min.x, cube_max.x, cube_min.y, cube_max.y, -near_z, -cube_min.z);
+    next.signature = signature;
+    next.valid = true;
+    _cascades[i] = next;
+    renderCascade(i, cascade_casters);
+    _updated_cascades++;
+  }
+}
+
+void CascadedShadowMap::renderCascade(
+  int index, const std::vector<const Caster*>& casters)
+{
+  const Cascade& cascade = _cascades[index];
+  const int columns = tiles(_settings.number_of_cascades).x;
+  const int x = (index % columns) * _settings.resolution;
+  const int y = (index / columns) * _settings.resolution;
+
+  _fbo.bind();
+  RenderState::viewport(x, y, _settings.resolution, _settings.resolution);
+  RenderState::enable(GL_SCISSOR_TEST);
+  RenderState::scissor(x, y, _settings.resolution, _settings.resolution);
+  RenderState::enable(GL_DEPTH_TEST);
+  RenderState::disable(GL_BLEND);
+  RenderState::depthMask(GL_TRUE);
+  glClear(GL_DEPTH_BUFFER_BIT);
+
+  // Slope scaled bias against shadow acne
+  RenderState::enable(GL_POLYGON_OFFSET_FILL);
+  RenderState::polygonOffset(2.0f, 4.0f);
+
+  _program->pushUsage();
+  glUniformMatrix4fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "V"),
+    1,
+    GL_FALSE,
+    &cascade.view[0][0]);
+  glUniformMatrix4fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "P"),
+    1,
+    GL_FALSE,
+    &cascade.projection[0][0]);
+  for (auto caster : casters)
+    caster->renderable->renderShadowCaster(cascade.view, cascade.projection);
+  _program->popUsage();
+
+  RenderState::disable(GL_POLYGON_OFFSET_FILL);
+  RenderState::disable(GL_SCISSOR_TEST);
+  _fbo.unbind();
+}
+
+void CascadedShadowMap::setUniforms(
+  const PerspectiveCamera& camera, TextureUnit& unit) const
+{
+  unit.activate();
+  _depth->bind();
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "shadow_map"), unit);
+
+  const int n = _settings.number_of_cascades;
+  // From view space of the camera to texture space of each cascade
+  const glm::mat4 bias =
+    glm::translate(glm::vec3(0.5f)) * glm::scale(glm::vec3(0.5f));
+  glm::mat4 transforms[max_cascades];
+  float texel_sizes[max_cascades] = {};
+  int valid_mask = 0;
+  for (int i = 0; i < n; ++i)
+  {
+    const Cascade& cascade = _cascades[i];
+    transforms[i] = glm::mat4(1.0f);
+    if (!cascade.valid)
+      continue;
+    transforms[i] =
+      bias * cascade.projection * cascade.view * camera.absoluteTransform();
+    texel_sizes[i] = 2.0f * cascade.half_size / _settings.resolution;
+    valid_mask |= 1 << i;
+  }
+  glUniformMatrix4fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "shadow_transforms"),
+    n,
+    GL_FALSE,
+    &transforms[0][0][0]);
+  glUniform1fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "shadow_texel_sizes"),
+    n,
+    texel_sizes);
+  glm::ivec2 shadow_tiles = tiles(n);
+  glUniform2i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "shadow_tiles"),
+    shadow_tiles.x, shadow_tiles.y);
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "number_of_cascades"),
+    n);
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "valid_cascades"),
+    valid_mask);
+}
+
+} }
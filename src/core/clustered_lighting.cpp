@@ -0,0 +1,342 @@
+#include "elk/core/clustered_lighting.h"
+
+#include "elk/core/camera.h"
+#include "elk/core/point_shadow_atlas.h"
+#include "elk/core/shader_program.h"
+#include "elk/object_extensions/light_source.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+  #define ELK_X86_SIMD
+  #include <immintrin.h>
+#endif
+
+namespace elk { namespace core {
+
+namespace {
+
+// Texels of light data per light
+const int light_texels = 3;
+
+// Bounds of a row of clusters, each pointer is offset to the start of the row
+struct ClusterRow
+{
+  const float* min_x;
+  const float* min_y;
+  const float* min_z;
+  const float* max_x;
+  const float* max_y;
+  const float* max_z;
+};
+
+// Appends the clusters in [begin, end) of the row that intersect the sphere
+void intersectClustersScalar(
+  const ClusterRow& row, int begin, int end, glm::vec4 sphere, std::vector<int>& hits)
+{
+  for (int i = begin; i < end; ++i)
+  {
+    float dx = std::max(row.min_x[i] - sphere.x, 0.0f) + std::max(sphere.x - row.max_x[i], 0.0f);
+    float dy = std::max(row.min_y[i] - sphere.y, 0.0f) + std::max(sphere.y - row.max_y[i], 0.0f);
+    float dz = std::max(row.min_z[i] - sphere.z, 0.0f) + std::max(sphere.z - row.max_z[i], 0.0f);
+    if (dx * dx + dy * dy + dz * dz <= sphere.w * sphere.w)
+      hits.push_back(i);
+  }
+}
+
+#ifdef ELK_X86_SIMD
+// Four clusters at a time, begin must be a multiple of four and the row
+// padded to a multiple of four
+__attribute__((target("sse2")))
+void intersectClustersSSE2(
+  const ClusterRow& row, int begin, int end, glm::vec4 sphere, std::vector<int>& hits)
+{
+  const __m128 zero = _mm_setzero_ps();
+  const __m128 x = _mm_set1_ps(sphere.x);
+  const __m128 y = _mm_set1_ps(sphere.y);
+  const __m128 z = _mm_set1_ps(sphere.z);
+  const __m128 radius_squared = _mm_set1_ps(sphere.w * sphere.w);
+  for (int i = begin; i < end; i += 4)
+  {
+    __m128 dx = _mm_add_ps(
+      _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(row.min_x + i), x), zero),
+      _mm_max_ps(_mm_sub_ps(x, _mm_loadu_ps(row.max_x + i)), zero));
+    __m128 dy = _mm_add_ps(
+      _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(row.min_y + i), y), zero),
+      _mm_max_ps(_mm_sub_ps(y, _mm_loadu_ps(row.max_y + i)), zero));
+    __m128 dz = _mm_add_ps(
+      _mm_max_ps(_mm_sub_ps(_mm_loadu_ps(row.min_z + i), z), zero),
+      _mm_max_ps(_mm_sub_ps(z, _mm_loadu_ps(row.max_z + i)), zero));
+    __m128 distance_squared = _mm_add_ps(
+      _mm_add_ps(_mm_mul_ps(dx, dx), _mm_mul_ps(dy, dy)), _mm_mul_ps(dz, dz));
+    int mask = _mm_movemask_ps(_mm_cmple_ps(distance_squared, radius_squared));
+    while (mask)
+    {
+      hits.push_back(i + __builtin_ctz(mask));
+      mask &= mask - 1;
+    }
+  }
+}
+#endif
+
+} // namespace
+
+ClusteredLighting::ClusteredLighting(ClusteredLightingSettings settings) :
+  _settings(settings),
+  _projection(0.0f),
+  _near(0.1f),
+  _far(1.0f),
+  _row_stride(0),
+  _visible_lights(0),
+  _light_indices(0)
+{
+  _settings.tiles_x = std::max(_settings.tiles_x, 1);
+  _settings.tiles_y = std::max(_settings.tiles_y, 1);
+  _settings.slices = std::max(_settings.slices, 1);
+  glGetIntegerv(GL_MAX_TEXTURE_BUFFER_SIZE, &_max_texels);
+
+  const GLenum formats[3] = { GL_RGBA32F, GL_RG32UI, GL_R32UI };
+  TextureBuffer* buffers[3] = { &_light_buffer, &_cluster_buffer, &_index_buffer };
+  for (int i = 0; i < 3; ++i)
+  {
+    glGenBuffers(1, &buffers[i]->buffer);
+    glBindBuffer(GL_TEXTURE_BUFFER, buffers[i]->buffer);
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+    glGenTextures(1, &buffers[i]->texture);
+    TextureUnit::bindTexture(GL_TEXTURE_BUFFER, buffers[i]->texture);
+    glTexBuffer(GL_TEXTURE_BUFFER, formats[i], buffers[i]->buffer);
+  }
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+ClusteredLighting::~ClusteredLighting()
+{
+  for (auto* buffer : { &_light_buffer, &_cluster_buffer, &_index_buffer })
+  {
+    TextureUnit::deleteTexture(buffer->texture);
+    glDeleteBuffers(1, &buffer->buffer);
+  }
+}
+
+void ClusteredLighting::updateClusterBounds(const glm::mat4& projection)
+{
+  _projection = projection;
+  // Near and far plane from the projection
+  _near = projection[3][2] / (projection[2][2] - 1.0f);
+  _far = std::min(projection[3][2] / (projection[2][2] + 1.0f), _settings.max_distance);
+  _far = std::max(_far, _near * 1.001f);
+
+  const int tiles_x = _settings.tiles_x;
+  const int tiles_y = _settings.tiles_y;
+  const int slices = _settings.slices;
+  _row_stride = (tiles_x + 3) & ~3;
+  const size_t size = size_t(_row_stride) * tiles_y * slices;
+  // Padding never intersects anything
+  const float infinity = std::numeric_limits<float>::infinity();
+  for (auto* bounds : { &_min_x, &_min_y, &_min_z })
+    bounds->assign(size, infinity);
+  for (auto* bounds : { &_max_x, &_max_y, &_max_z })
+    bounds->assign(size, -infinity);
+
+  // Rays through the corners of the tiles with z = -1
+  const glm::mat4 projection_inv = glm::inverse(projection);
+  std::vector<glm::vec3> rays((tiles_x + 1) * (tiles_y + 1));
+  for (int y = 0; y <= tiles_y; ++y)
+  {
+    for (int x = 0; x <= tiles_x; ++x)
+    {
+      glm::vec4 ray = projection_inv * glm::vec4(
+        2.0f * x / tiles_x - 1.0f, 2.0f * y / tiles_y - 1.0f, -1.0f, 1.0f);
+      glm::vec3 ray_view_space = glm::vec3(ray) / ray.w;
+      rays[y * (tiles_x + 1) + x] = ray_view_space / -ray_view_space.z;
+    }
+  }
+
+  for (int s = 0; s < slices; ++s)
+  {
+    const float depths[2] = {
+      _near * std::pow(_far / _near, float(s) / slices),
+      _near * std::pow(_far / _near, float(s + 1) / slices) };
+    for (int y = 0; y < tiles_y; ++y)
+    {
+      for (int x = 0; x < tiles_x; ++x)
+      {
+        glm::vec3 min(infinity), max(-infinity);
+        for (int c = 0; c < 8; ++c)
+        {
+          glm::vec3 ray = rays[(y + ((c >> 1) & 1)) * (tiles_x + 1) + x + (c & 1)];
+          glm::vec3 corner = ray * depths[c >> 2];
+          min = glm::min(min, corner);
+          max = glm::max(max, corner);
+        }
+        const size_t i = (size_t(s) * tiles_y + y) * _row_stride + x;
+        _min_x[i] = min.x; _min_y[i] = min.y; _min_z[i] = min.z;
+        _max_x[i] = max.x; _max_y[i] = max.y; _max_z[i] = max.z;
+      }
+    }
+  }
+}
+
+void ClusteredLighting::update(
+  const PerspectiveCamera& camera,
+  const std::vector<PointLightSource*>& lights,
+  const PointShadowAtlas& shadows)
+{
+  if (camera.projectionTransform() != _projection)
+    updateClusterBounds(camera.projectionTransform());
+
+  const int tiles_x = _settings.tiles_x;
+  const int tiles_y = _settings.tiles_y;
+  const int slices = _settings.slices;
+  const float slice_scale = slices / std::log(_far / _near);
+  const glm::mat4 view = camera.viewTransform();
+#ifdef ELK_X86_SIMD
+  const bool sse2 = __builtin_cpu_supports("sse2");
+#endif
+
+  _light_data.clear();
+  _assignments.clear();
+  std::vector<int> hits;
+  for (auto light : lights)
+  {
+    const float radius = light->radius();
+    const glm::vec3 center = glm::vec3(view * glm::vec4(light->position(), 1.0f));
+    if (center.z - radius > -_near || center.z + radius < -_far)
+      continue;
+
+    // Slices overlapping the depth range of the sphere
+    const float nearest = std::max(-(center.z + radius), _near);
+    const float farthest = std::min(-(center.z - radius), _far);
+    const int first_slice = glm::clamp(
+      int(std::log(nearest / _near) * slice_scale), 0, slices - 1);
+    const int last_slice = glm::clamp(
+      int(std::log(farthest / _near) * slice_scale), 0, slices - 1);
+
+    // Tiles covered by the projected box around the sphere, cut at the near
+    // plane
+    glm::vec2 ndc_min(std::numeric_limits<float>::max());
+    glm::vec2 ndc_max(-std::numeric_limits<float>::max());
+    const float front = std::min(center.z + radius, -_near);
+    for (int c = 0; c < 8; ++c)
+    {
+      glm::vec4 corner = _projection * glm::vec4(
+        center.x + (c & 1 ? radius : -radius),
+        center.y + (c & 2 ? radius : -radius),
+        c & 4 ? front : center.z - radius,
+        1.0f);
+      glm::vec2 ndc = glm::vec2(corner) / corner.w;
+      ndc_min = glm::min(ndc_min, ndc);
+      ndc_max = glm::max(ndc_max, ndc);
+    }
+    if (ndc_max.x < -1.0f || ndc_max.y < -1.0f || ndc_min.x > 1.0f || ndc_min.y > 1.0f)
+      continue;
+    const int first_x = glm::clamp(int((ndc_min.x * 0.5f + 0.5f) * tiles_x), 0, tiles_x - 1);
+    const int last_x = glm::clamp(int((ndc_max.x * 0.5f + 0.5f) * tiles_x), 0, tiles_x - 1);
+    const int first_y = glm::clamp(int((ndc_min.y * 0.5f + 0.5f) * tiles_y), 0, tiles_y - 1);
+    const int last_y = glm::clamp(int((ndc_max.y * 0.5f + 0.5f) * tiles_y), 0, tiles_y - 1);
+
+    const std::uint64_t light_index = _light_data.size() / light_texels;
+    glm::vec2 shadow_origin(0.0f);
+    const bool shadowed = shadows.slotOrigin(*light, shadow_origin);
+    _light_data.push_back(glm::vec4(center, radius));
+    _light_data.push_back(glm::vec4(light->color(), light->radiantFlux()));
+    _light_data.push_back(
+      glm::vec4(shadow_origin, radius, shadowed ? 1.0f : 0.0f));
+
+    const glm::vec4 sphere(center, radius);
+    for (int s = first_slice; s <= last_slice; ++s)
+    {
+      for (int y = first_y; y <= last_y; ++y)
+      {
+        const size_t offset = (size_t(s) * tiles_y + y) * _row_stride;
+        const ClusterRow row = {
+          &_min_x[offset], &_min_y[offset], &_min_z[offset],
+          &_max_x[offset], &_max_y[offset], &_max_z[offset] };
+        hits.clear();
+#ifdef ELK_X86_SIMD
+        if (sse2)
+          intersectClustersSSE2(row, first_x & ~3, last_x + 1, sphere, hits);
+        else
+#endif
+          intersectClustersScalar(row, first_x, last_x + 1, sphere, hits);
+        const std::uint64_t cluster_row = (std::uint64_t(s) * tiles_y + y) * tiles_x;
+        for (int x : hits)
+          _assignments.push_back((cluster_row + x) << 32 | light_index);
+      }
+    }
+  }
+  _visible_lights = int(_light_data.size() / light_texels);
+
+  if (_assignments.size() > size_t(_max_texels))
+  {
+    fprintf(stderr,
+      "ERROR : %zu light indices do not fit in a texture buffer, dropping lights\n",
+      _assignments.size());
+    _assignments.resize(_max_texels);
+  }
+
+  // Counting sort of the indices by cluster, lights keep their order
+  _cluster_ranges.assign(size_t(tiles_x) * tiles_y * slices, glm::uvec2(0));
+  for (auto assignment : _assignments)
+    _cluster_ranges[assignment >> 32].y++;
+  GLuint offset = 0;
+  for (auto& range : _cluster_ranges)
+  {
+    range.x = offset;
+    offset += range.y;
+    range.y = 0;
+  }
+  _indices.resize(_assignments.size());
+  for (auto assignment : _assignments)
+  {
+    glm::uvec2& range = _cluster_ranges[assignment >> 32];
+    _indices[range.x + range.y++] = GLuint(assignment & 0xffffffffu);
+  }
+  _light_indices = int(_indices.size());
+
+  upload(_light_buffer, _light_data.data(), _light_data.size() * sizeof(glm::vec4));
+  upload(_cluster_buffer, _cluster_ranges.data(), _cluster_ranges.size() * sizeof(glm::uvec2));
+  upload(_index_buffer, _indices.data(), _indices.size() * sizeof(GLuint));
+}
+
+void ClusteredLighting::upload(const TextureBuffer& buffer, const void* data, size_t size)
+{
+  glBindBuffer(GL_TEXTURE_BUFFER, buffer.buffer);
+  // Orphans the storage of the last frame, empty buffers are not allowed
+  if (size)
+    glBufferData(GL_TEXTURE_BUFFER, size, data, GL_STREAM_DRAW);
+  else
+    glBufferData(GL_TEXTURE_BUFFER, sizeof(glm::vec4), nullptr, GL_STREAM_DRAW);
+  glBindBuffer(GL_TEXTURE_BUFFER, 0);
+}
+
+void ClusteredLighting::setUniforms(
+  TextureUnit& light_unit, TextureUnit& cluster_unit, TextureUnit& index_unit) const
+{
+  light_unit.activate();
+  TextureUnit::bindTexture(GL_TEXTURE_BUFFER, _light_buffer.texture);
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "light_buffer"), light_unit);
+  cluster_unit.activate();
+  TextureUnit::bindTexture(GL_TEXTURE_BUFFER, _cluster_buffer.texture);
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "cluster_buffer"), cluster_unit);
+  index_unit.activate();
+  TextureUnit::bindTexture(GL_TEXTURE_BUFFER, _index_buffer.texture);
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "light_index_buffer"), index_unit);
+
+  glUniform3i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "cluster_grid"),
+    _settings.tiles_x, _settings.tiles_y, _settings.slices);
+  glUniform1f(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "cluster_near"), _near);
+  glUniform1f(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "cluster_far"), _far);
+}
+
+} }
@@ -0,0 +1,141 @@
+#include "elk/core/command_buffer.h"
+#include "elk/core/render_state.h"
+#include "elk/core/texture_unit.h"
+
+#include <algorithm>
+
+namespace elk { namespace core {
+
+CommandBuffer::CommandBuffer() :
+  _program(0),
+  _number_of_slots(0),
+  _number_of_draws(0)
+{
+
+}
+
+bool CommandBuffer::bindProgram(GLuint program)
+{
+  if (!_commands.empty() && program == _program)
+    return false;
+  _program = program;
+  // Textures bound for another program are not reused
+  _slot_textures.clear();
+
+  Command command;
+  command.type = Command::Type::BindProgram;
+  command.bind_program = { program };
+  _commands.push_back(command);
+  return true;
+}
+
+void CommandBuffer::setSampler(GLint location, GLuint slot)
+{
+  Command command;
+  command.type = Command::Type::SetSampler;
+  command.set_sampler = { location, slot };
+  _commands.push_back(command);
+  _number_of_slots = std::max(_number_of_slots, slot + 1);
+}
+
+void CommandBuffer::setUniformMatrices(
+  GLint location, const glm::mat4* matrices, GLsizei count)
+{
+  Command command;
+  command.type = Command::Type::SetUniformMatrices;
+  command.set_uniform_matrices =
+    { location, static_cast<GLuint>(_matrices.size()), count };
+  _commands.push_back(command);
+  _matrices.insert(_matrices.end(), matrices, matrices + count);
+}
+
+void CommandBuffer::bindTexture(GLuint slot, const Texture& texture)
+{
+  if (slot >= _slot_textures.size())
+    _slot_textures.resize(slot + 1, 0);
+  if (_slot_textures[slot] == texture.id())
+    return;
+  _slot_textures[slot] = texture.id();
+
+  Command command;
+  command.type = Command::Type::BindTexture;
+  command.bind_texture = { slot, texture.target(), texture.id() };
+  _commands.push_back(command);
+  _number_of_slots = std::max(_number_of_slots, slot + 1);
+}
+
+void CommandBuffer::drawElements(
+  GLuint vertex_array, GLuint element_buffer, GLuint attributes,
+  GLenum mode, GLsizei count, GLenum index_type)
+{
+  Command command;
+  command.type = Command::Type::DrawElements;
+  command.draw_elements =
+    { vertex_array, element_buffer, attributes, mode, count, index_type };
+  _commands.push_back(command);
+  _number_of_draws++;
+}
+
+void CommandBuffer::replay() const
+{
+  std::vector<TextureUnit> units(_number_of_slots);
+  GLuint vertex_array = 0;
+
+  for (const Command& command : _commands)
+  {
+    switch (command.type)
+    {
+      case Command::Type::BindProgram:
+        RenderState::useProgram(command.bind_program.program);
+        break;
+      case Command::Type::SetSampler:
+        glUniform1i(command.set_sampler.location, units[command.set_sampler.slot]);
+        break;
+      case Command::Type::SetUniformMatrices:
+        glUniformMatrix4fv(
+          command.set_uniform_matrices.location,
+          command.set_uniform_matrices.count,
+          GL_FALSE,
+          &_matrices[command.set_uniform_matrices.first][0][0]);
+        break;
+      case Command::Type::BindTexture:
+        units[command.bind_texture.slot].activate();
+        TextureUnit::bindTexture(
+          command.bind_texture.target, command.bind_texture.texture);
+        break;
+      case Command::Type::DrawElements:
+      {
+        const DrawElements& draw = command.draw_elements;
+        // Enabled arrays are state of the vertex array, so consecutive
+        // draws of the same mesh only issue the draw call
+        if (draw.vertex_array != vertex_array)
+        {
+          vertex_array = draw.vertex_array;
+          glBindVertexArray(vertex_array);
+          glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, draw.element_buffer);
+          for (GLuint i = 0; i < 32; ++i)
+          {
+            if (draw.attributes & (1u << i))
+              glEnableVertexAttribArray(i);
+          }
+        }
+        glDrawElements(
+          draw.mode, draw.count, draw.index_type, static_cast<void*>(0));
+        RenderState::countDrawCall();
+        break;
+      }
+    }
+  }
+}
+
+void CommandBuffer::clear()
+{
+  _commands.clear();
+  _matrices.clear();
+  _slot_textures.clear();
+  _program = 0;
+  _number_of_slots = 0;
+  _number_of_draws = 0;
+}
+
+} }
@@ -0,0 +1,275 @@
+#include "elk/core/cpu_profiler.h"
+#include "elk/core/gpu_profiler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <set>
+
+namespace elk { namespace core {
+
+namespace {
+
+const uint32_t ring_size = 4096;
+
+struct RecordedZone
+{
+  const char* name;
+  int64_t begin;
+  int64_t end;
+};
+
+// Written only by the thread that owns it and read only by markFrame
+struct ThreadBuffer
+{
+  std::atomic<uint32_t> head;
+  std::atomic<uint32_t> tail;
+  std::atomic<uint64_t> dropped;
+  std::atomic<bool> in_use;
+  std::string name;
+  RecordedZone zones[ring_size];
+};
+
+// Buffers are never freed, threads that exit hand theirs on to new threads
+struct Registry
+{
+  std::mutex mutex;
+  std::vector<std::unique_ptr<ThreadBuffer> > buffers;
+  std::set<std::string> names;
+
+  std::deque<CpuProfiler::Frame> frames;
+  std::deque<CpuProfiler::Zone> zones;
+  int window = 120;
+  unsigned int frame_index = 0;
+  int64_t frame_begin = CpuProfiler::now();
+};
+
+Registry& registry()
+{
+  static Registry registry;
+  return registry;
+}
+
+ThreadBuffer* acquireBuffer()
+{
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  for (size_t i = 0; i < r.buffers.size(); ++i)
+  {
+    bool free = false;
+    if (r.buffers[i]->in_use.compare_exchange_strong(free, true))
+    {
+      r.buffers[i]->name = "Thread " + std::to_string(i);
+      return r.buffers[i].get();
+    }
+  }
+  r.buffers.emplace_back(new ThreadBuffer);
+  ThreadBuffer* buffer = r.buffers.back().get();
+  buffer->head = 0;
+  buffer->tail = 0;
+  buffer->dropped = 0;
+  buffer->in_use = true;
+  buffer->name = "Thread " + std::to_string(r.buffers.size() - 1);
+  return buffer;
+}
+
+struct ThreadBufferOwner
+{
+  ThreadBuffer* buffer = nullptr;
+  ~ThreadBufferOwner()
+  {
+    if (buffer)
+      buffer->in_use.store(false, std::memory_order_release);
+  }
+};
+
+ThreadBuffer& threadBuffer()
+{
+  static thread_local ThreadBufferOwner owner;
+  if (!owner.buffer)
+    owner.buffer = acquireBuffer();
+  return *owner.buffer;
+}
+
+void writeEscapedJson(std::ostream& file, const char* text)
+{
+  for (; *text; ++text)
+  {
+    if (*text == '"' || *text == '\\')
+      file << '\\';
+    file << *text;
+  }
+}
+
+} // namespace
+
+std::atomic<uint64_t> CpuProfiler::_allocations(0);
+std::atomic<uint64_t> CpuProfiler::_allocated_bytes(0);
+
+int64_t CpuProfiler::now()
+{
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void CpuProfiler::recordZone(const char* name, int64_t begin, int64_t end)
+{
+  ThreadBuffer& buffer = threadBuffer();
+  const uint32_t head = buffer.head.load(std::memory_order_relaxed);
+  if (head - buffer.tail.load(std::memory_order_acquire) >= ring_size)
+  {
+    buffer.dropped.fetch_add(1, std::memory_order_relaxed);
+    return;
+  }
+  buffer.zones[head % ring_size] = { name, begin, end };
+  buffer.head.store(head + 1, std::memory_order_release);
+}
+
+void CpuProfiler::setThreadName(const char* name)
+{
+  ThreadBuffer& buffer = threadBuffer();
+  std::lock_guard<std::mutex> lock(registry().mutex);
+  buffer.name = name;
+}
+
+const char* CpuProfiler::internName(const std::string& name)
+{
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  return r.names.insert(name).first->c_str();
+}
+
+void CpuProfiler::markFrame()
+{
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+
+  Frame frame;
+  frame.index = r.frame_index++;
+  frame.begin = r.frame_begin;
+  frame.end = now();
+  frame.allocations = _allocations.exchange(0, std::memory_order_relaxed);
+  frame.allocated_bytes = _allocated_bytes.exchange(0, std::memory_order_relaxed);
+  frame.dropped_zones = 0;
+  r.frame_begin = frame.end;
+
+  for (size_t i = 0; i < r.buffers.size(); ++i)
+  {
+    ThreadBuffer& buffer = *r.buffers[i];
+    const uint32_t head = buffer.head.load(std::memory_order_acquire);
+    uint32_t tail = buffer.tail.load(std::memory_order_relaxed);
+    for (; tail != head; ++tail)
+    {
+      const RecordedZone& zone = buffer.zones[tail % ring_size];
+      r.zones.push_back({ zone.name, int(i), zone.begin, zone.end });
+    }
+    buffer.tail.store(tail, std::memory_order_release);
+    frame.dropped_zones += buffer.dropped.exchange(0, std::memory_order_relaxed);
+  }
+
+  r.frames.push_back(frame);
+  while (r.frames.size() > size_t(r.window))
+    r.frames.pop_front();
+  const int64_t oldest = r.frames.front().begin;
+  while (!r.zones.empty() && r.zones.front().end < oldest)
+    r.zones.pop_front();
+}
+
+void CpuProfiler::setWindow(int frames)
+{
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.window = std::max(frames, 1);
+}
+
+const std::deque<CpuProfiler::Frame>& CpuProfiler::frames()
+{
+  return registry().frames;
+}
+
+const std::deque<CpuProfiler::Zone>& CpuProfiler::zones()
+{
+  return registry().zones;
+}
+
+bool CpuProfiler::writeChromeTrace(const std::string& path, const GpuProfiler* gpu)
+{
+  std::ofstream file(path);
+  if (!file)
+  {
+    fprintf(stderr, "ERROR : Could not write CPU trace %s\n", path.c_str());
+    return false;
+  }
+
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+
+  // Microseconds from the first frame, GPU events are already on the same clock
+  const int64_t start = r.frames.empty() ? now() : r.frames.front().begin;
+  const int gpu_thread = int(r.buffers.size());
+  char buffer[256];
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  for (size_t i = 0; i < r.buffers.size(); ++i)
+  {
+    writeThreadName(file, int(i), r.buffers[i]->name.c_str());
+    file << ",\n";
+  }
+  writeThreadName(file, gpu_thread, "GPU");
+
+  for (const auto& frame : r.frames)
+  {
+    snprintf(buffer, sizeof(buffer),
+      ",\n{\"name\":\"Frame %u\",\"ph\":\"i\",\"s\":\"g\",\"pid\":1,\"tid\":0,\"ts\":%.3f}"
+      ",\n{\"name\":\"Allocations\",\"ph\":\"C\",\"pid\":1,\"ts\":%.3f,"
+      "\"args\":{\"count\":%llu,\"bytes\":%llu}}",
+      frame.index, (frame.begin - start) / 1.0e3, (frame.begin - start) / 1.0e3,
+      (unsigned long long)frame.allocations, (unsigned long long)frame.allocated_bytes);
+    file << buffer;
+  }
+  for (const auto& zone : r.zones)
+  {
+    file << ",\n";
+    writeTraceEvent(file, zone.name, "cpu", zone.thread, start, zone.begin, zone.end);
+  }
+  if (gpu)
+    gpu->writeTraceEvents(file, gpu_thread, start);
+  file << "\n]}\n";
+  return bool(file);
+}
+
+void CpuProfiler::writeTraceEvent(
+  std::ostream& file, const char* name, const char* category, int thread,
+  int64_t start, int64_t begin, int64_t end, int64_t frame)
+{
+  char buffer[160];
+  snprintf(buffer, sizeof(buffer),
+    "\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f",
+    category, thread, (begin - start) / 1.0e3, (end - begin) / 1.0e3);
+  file << "{\"name\":\"";
+  writeEscapedJson(file, name);
+  file << buffer;
+  if (frame >= 0)
+    file << ",\"args\":{\"frame\":" << frame << "}";
+  file << "}";
+}
+
+void CpuProfiler::writeThreadName(std::ostream& file, int thread, const char* name)
+{
+  file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << thread
+    << ",\"args\":{\"name\":\"";
+  writeEscapedJson(file, name);
+  file << "\"}}";
+}
+
+void CpuProfiler::reset()
+{
+  Registry& r = registry();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  r.frames.clear();
+  r.zones.clear();
+}
+
+} }
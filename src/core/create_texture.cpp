@@ -1,4 +1,5 @@
 #include "elk/core/create_texture.h"
+#include "elk/core/cpu_profiler.h"
 
 #include <glm/glm.hpp>
 #include <vector>
@@ -9,15 +10,22 @@
 
 namespace elk { namespace core {
 
-std::shared_ptr<Texture> CreateTexture::load(const char* path)
+std::shared_ptr<Texture> CreateTexture::load(
+  const char* path, ColorSpace color_space, MipMapFilter filter)
 {
+ELK_PROFILE_ZONE("CreateTexture::load");
 
 #if ELK_USE_FREEIMAGE
 
 auto texture_data = loadTexture_freeimage(path);
+std::vector<GLubyte*> mip_map_chain = generateMipMapChain(
+  static_cast<const GLubyte*>(texture_data.first), texture_data.second,
+  filter, color_space);
 
 std::shared_ptr<Texture> tex = std::make_shared<Texture>(
-  texture_data.first, glm::uvec3(texture_data.second,1),
+  texture_data.first,
+  std::vector<void*>(mip_map_chain.begin(), mip_map_chain.end()),
+  glm::uvec3(texture_data.second,1),
   Texture::Format::RGBA, GL_RGBA, GL_UNSIGNED_BYTE,
   Texture::FilterMode::LinearMipMap, Texture::WrappingMode::Repeat);
 
@@ -33,6 +41,7 @@ std::shared_ptr<CubeMapTexture> CreateTexture::loadCubeMap(
   const char* path_positive_y, const char* path_negative_y,
   const char* path_positive_z, const char* path_negative_z)
 {
+ELK_PROFILE_ZONE("CreateTexture::loadCubeMap");
 #if ELK_USE_FREEIMAGE
 auto texture_data_positive_x = loadTexture_freeimage(path_positive_x);
 auto texture_data_negative_x = loadTexture_freeimage(path_negative_x);
@@ -79,4 +88,18 @@ std::shared_ptr<Texture> CreateTexture::black(int width, int height)
   return std::make_shared<Texture>(pixel_data, glm::uvec3(width, height, 1));
 }
 
+std::shared_ptr<Texture> CreateTexture::color(int width, int height, glm::u8vec4 color)
+{
+  unsigned int array_size = width * height * 4 * 1;
+  GLubyte* pixel_data = new GLubyte[array_size];
+  for (int i = 0; i < width * height; ++i)
+  {
+    pixel_data[i*4 + 0] = color.r;
+    pixel_data[i*4 + 1] = color.g;
+    pixel_data[i*4 + 2] = color.b;
+    pixel_data[i*4 + 3] = color.a;
+  }
+  return std::make_shared<Texture>(pixel_data, glm::uvec3(width, height, 1));
+}
+
 } }
@@ -1,4 +1,7 @@
 #include "elk/core/cube_map_texture.h"
+#include "elk/core/texture_unit.h"
+#include "elk/core/render_state.h"
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 
@@ -55,7 +58,7 @@ CubeMapTexture::CubeMapTexture(
 CubeMapTexture::~CubeMapTexture()
 {
   if (_id) {
-    glDeleteTextures(1, &_id);
+    TextureUnit::deleteTexture(_id);
   }
 
   if (_has_ownership_of_data) {
@@ -114,17 +117,17 @@ void CubeMapTexture::generate()
 
 void CubeMapTexture::enable() const
 {
-  glEnable(_type);
+  RenderState::enable(_type);
 }
 
 void CubeMapTexture::disable() const
 {
-  glDisable(_type);
+  RenderState::disable(_type);
 }
 
 void CubeMapTexture::bind() const
 {
-  glBindTexture(_type, _id);
+  TextureUnit::bindTexture(_type, _id);
 }
 
 void CubeMapTexture::applyFilter()
@@ -145,7 +148,7 @@ void CubeMapTexture::applyFilter()
       glTexParameteri(_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
       upload();
       glGenerateMipmap(_type);
-      glEnable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+      RenderState::enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
       break;
     case FilterMode::AnisotropicMipMap:
     {
@@ -171,6 +174,16 @@ void CubeMapTexture::applyFilter()
   }
 }
 
+const void* CubeMapTexture::faceData(int face) const
+{
+  const void* faces[] = {
+    _pixel_data_positive_x, _pixel_data_negative_x,
+    _pixel_data_positive_y, _pixel_data_negative_y,
+    _pixel_data_positive_z, _pixel_data_negative_z };
+  assert(face >= 0 && face < 6);
+  return faces[face];
+}
+
 int CubeMapTexture::numberOfChannels() const
 {
   return numberOfChannels(_format);
@@ -263,4 +276,36 @@ void CubeMapTexture::upload()
     GLint(_format), _data_type, _pixel_data_negative_z);
 }
 
+void CubeMapTexture::setMipMapLevels(int levels)
+{
+  _mip_map_level = std::max(levels, 1);
+  bind();
+  glTexParameteri(_type, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(_type, GL_TEXTURE_MAX_LEVEL, _mip_map_level - 1);
+  for (int level = 1; level < _mip_map_level; ++level)
+  {
+    int side = std::max(_side >> level, 1);
+    for (int face = 0; face < 6; ++face)
+    {
+      glTexImage2D(
+        GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, _internal_format, side, side,
+        0, GLint(_format), _data_type, nullptr);
+    }
+  }
+  if (_mip_map_level > 1)
+  {
+    glTexParameteri(_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    RenderState::enable(GL_TEXTURE_CUBE_MAP_SEAMLESS);
+  }
+}
+
+void CubeMapTexture::uploadLevel(int level, int face, const void* data)
+{
+  bind();
+  int side = std::max(_side >> level, 1);
+  glTexImage2D(
+    GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, _internal_format, side, side,
+    0, GLint(_format), _data_type, data);
+}
+
 } }
@@ -1,18 +1,54 @@
 #include "elk/core/deferred_shading_renderer.h"
 
 #include "elk/core/texture_unit.h"
-#include "elk/core/create_texture.h"
+#include "elk/core/render_state.h"
+#include "elk/core/cpu_profiler.h"
 #include "elk/object_extensions/light_source.h"
 #include "elk/core/debug_input.h"
 
+#include <algorithm>
+
 namespace elk { namespace core {
 
+namespace {
+
+// The coarsest cell of the depth pyramid covers 128 x 128 pixels
+const int hi_z_levels = 7;
+
+// Fewer renderables are not worth a thread when recording the G-buffer
+const int min_renderables_per_slice = 64;
+
+// Pixel of each 2 x 2 block traced by half resolution reflections, one per
+// frame. Diagonal pixels follow each other.
+const glm::ivec2 reflection_jitter[] = {
+  glm::ivec2(0, 0), glm::ivec2(1, 1), glm::ivec2(1, 0), glm::ivec2(0, 1) };
+// Weight of the accumulated reflections when blending in a new frame
+const float reflection_history_weight = 0.85f;
+
+} // namespace
+
 DeferredShadingRenderer::DeferredShadingRenderer(
   PerspectiveCamera& camera, int framebuffer_width, int framebuffer_height) :
-  Renderer(camera, framebuffer_width, framebuffer_height)
+  Renderer(camera, framebuffer_width, framebuffer_height),
+  _frame_graph(framebuffer_width, framebuffer_height),
+  _environment_cache_directory(std::string(ELK_DIR) + "/data"),
+  _clustered_lighting_enabled(true),
+  _reflection_history_valid(false),
+  _frame_index(0),
+  _gpu_profiling(false),
+  _dynamic_resolution_enabled(false),
+  _resolution_scale(1.0f),
+  _screen_space_reflections(ScreenSpaceReflections::Off),
+  _half_resolution_reflections(true),
+  _occlusion_culling(false),
+  _parallel_recording(false)
 {
   initializeShaders();
-  initializeFramebuffers(framebuffer_width, framebuffer_height);
+  _reflection_history = std::make_shared<Texture>(
+    _frame_graph.scaledSize(0.5f), Texture::Format::RGBA, GL_RGBA16F,
+    GL_HALF_FLOAT, Texture::FilterMode::Linear, Texture::WrappingMode::ClampToEdge);
+  _reflection_history->upload();
+  buildFrameGraph();
 }
 
 DeferredShadingRenderer::~DeferredShadingRenderer()
@@ -22,38 +58,119 @@ DeferredShadingRenderer::~DeferredShadingRenderer()
 
 void DeferredShadingRenderer::setSkyBox(std::shared_ptr<RenderableCubeMap> sky_box)
 {
+  bool rebuild = !_sky_box != !sky_box;
   _sky_box = sky_box;
+  if (_sky_box)
+  {
+    _sky_box_diffuse =
+      diffuseReflection(projectOnSphericalHarmonics(_sky_box->cubeMap()));
+    _sky_box_specular = std::make_unique<SpecularEnvironment>(
+      _sky_box->cubeMap(), _environment_cache_directory);
+  }
+  else
+  {
+    _sky_box_specular.reset();
+  }
+  // Reflections and environment lighting depend on the sky box
+  if (rebuild)
+    buildFrameGraph();
 }
 
-void DeferredShadingRenderer::render(Object3D& scene)
+void DeferredShadingRenderer::setScreenSpaceReflections(
+  ScreenSpaceReflections mode)
 {
-  // Submit all objects in the scene to the lists of renderable objects
-  scene.submit(*this);
+  if (mode == _screen_space_reflections)
+    return;
+  _screen_space_reflections = mode;
+  buildFrameGraph();
+}
 
-  renderGeometryBuffer(*_geometry_fbo_quad);
-  renderLightSources(*_irradiance_fbo_quad1);
+void DeferredShadingRenderer::setHalfResolutionReflections(bool enabled)
+{
+  if (enabled == _half_resolution_reflections)
+    return;
+  _half_resolution_reflections = enabled;
+  buildFrameGraph();
+}
 
-  // This will allow reflections to have roughness by sampling from mip-map
-  _irradiance_fbo_quad1->generateMipMaps();
-  _geometry_fbo_quad->generateMipMaps();
+void DeferredShadingRenderer::setGpuProfiling(bool enabled)
+{
+  _gpu_profiling = enabled;
+  _frame_graph.setProfiler(enabled ? &_gpu_profiler : nullptr);
+}
 
-  renderReflections(*_irradiance_fbo_quad1, *_irradiance_fbo_quad2);
+void DeferredShadingRenderer::setOcclusionCulling(bool enabled)
+{
+  if (enabled == _occlusion_culling)
+    return;
+  _occlusion_culling = enabled;
+  buildFrameGraph();
+}
 
-  // This will allow depth of field by sampling from mip-map
-  _irradiance_fbo_quad2->generateMipMaps();
+void DeferredShadingRenderer::setParallelRecording(bool enabled)
+{
+  _parallel_recording = enabled;
+  if (enabled && !_worker_pool)
+    _worker_pool.reset(new WorkerPool());
+}
 
-  renderHighlights(*_irradiance_fbo_quad2, *_post_process_fbo_quad);
+void DeferredShadingRenderer::setWindowResolution(int width, int height)
+{
+  Renderer::setWindowResolution(width, height);
+  resizeFramebuffers();
+}
 
-  // This will allow smooth blooming by sampling from mip-map
-  _post_process_fbo_quad->generateMipMaps();
+void DeferredShadingRenderer::setDynamicResolution(
+  bool enabled, DynamicResolutionSettings settings)
+{
+  _dynamic_resolution_enabled = enabled;
+  _dynamic_resolution = DynamicResolution(settings);
+  _resolution_scale = enabled ? _dynamic_resolution.scale() : 1.0f;
+  resizeFramebuffers();
+}
 
-  renderPostProcess(*_irradiance_fbo_quad2, *_irradiance_fbo_quad1);
+void DeferredShadingRenderer::updateDynamicResolution()
+{
+  // Results arrive a few frames after they were measured
+  if (!_gpu_timer.poll() || !_dynamic_resolution_enabled)
+    return;
+  float scale = _dynamic_resolution.update(_gpu_timer.elapsedMilliseconds());
+  if (scale != _resolution_scale)
+  {
+    _resolution_scale = scale;
+    resizeFramebuffers();
+  }
+}
 
-  renderPostProcessMotionBlur(*_irradiance_fbo_quad1, *_irradiance_fbo_quad2);
-  forwardRenderIndependentRenderables(*_irradiance_fbo_quad2);
+void DeferredShadingRenderer::resizeFramebuffers()
+{
+  int width = std::max(1, static_cast<int>(_window_width * _resolution_scale));
+  int height = std::max(1, static_cast<int>(_window_height * _resolution_scale));
+  _frame_graph.setResolution(width, height);
+  _reflection_history->resize(_frame_graph.scaledSize(0.5f));
+  _reflection_history_valid = false;
+}
 
-  // Render the first attachment of the final fbo to screen
-  renderToScreen(*_irradiance_fbo_quad2, 0);
+void DeferredShadingRenderer::render(Object3D& scene)
+{
+  ELK_PROFILE_ZONE("DeferredShadingRenderer::render");
+  {
+    // Submit all objects in the scene to the lists of renderable objects
+    ELK_PROFILE_ZONE("Object3D::submit");
+    scene.submit(*this);
+  }
+
+  updateDynamicResolution();
+  // Everything except the final upscale is rendered at the internal resolution
+  _gpu_timer.begin();
+  if (_gpu_profiling)
+    _gpu_profiler.beginFrame();
+  _frame_graph.execute();
+  if (_gpu_profiling)
+    _gpu_profiler.endFrame();
+  _gpu_timer.end();
+  _renderables_deferred_to_render.clear();
+  _frame_index++;
 
   checkForErrors();
 }
@@ -62,11 +179,18 @@ void DeferredShadingRenderer::initializeShaders()
 {
   _shading_program_point_lights = std::make_shared<ShaderProgram>(
     "shading_program_point_lights",
-    (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass.vert").c_str(),
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/point_light_volume.vert").c_str(),
     nullptr,
     nullptr,
     nullptr,
     (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass_point_light.frag").c_str());
+  _shading_program_clustered_point_lights = std::make_shared<ShaderProgram>(
+    "shading_program_clustered_point_lights",
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass.vert").c_str(),
+    nullptr,
+    nullptr,
+    nullptr,
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass_clustered_point_lights.frag").c_str());
   _shading_program_directional_lights = std::make_shared<ShaderProgram>(
     "shading_program_directional_lights",
     (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass.vert").c_str(),
@@ -102,6 +226,30 @@ void DeferredShadingRenderer::initializeShaders()
     nullptr,
     nullptr,
     (std::string(ELK_DIR) + "/shaders/deferred_shading/cube_map.frag").c_str());
+  _hi_z_program = std::make_shared<ShaderProgram>(
+    "hi_z_program",
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass.vert").c_str(),
+    nullptr,
+    nullptr,
+    nullptr,
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/hi_z.frag").c_str());
+  _hi_z_downsampler = std::make_unique<MipMapDownsampler>(
+    "hi_z_downsample_program",
+    std::string(ELK_DIR) + "/shaders/deferred_shading/hi_z.frag");
+  _reflection_resolve_program = std::make_shared<ShaderProgram>(
+    "reflection_resolve_program",
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass.vert").c_str(),
+    nullptr,
+    nullptr,
+    nullptr,
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/reflection_temporal_resolve.frag").c_str());
+  _copy_program = std::make_shared<ShaderProgram>(
+    "copy_program",
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass.vert").c_str(),
+    nullptr,
+    nullptr,
+    nullptr,
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/copy.frag").c_str());
   _output_highlights_program = std::make_shared<ShaderProgram>(
     "output_highlights_program",
     (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass.vert").c_str(),
@@ -132,206 +280,541 @@ void DeferredShadingRenderer::initializeShaders()
     (std::string(ELK_DIR) + "/shaders/deferred_shading/final_pass_through.frag").c_str());
 }
 
-void DeferredShadingRenderer::initializeFramebuffers(
-  int framebuffer_width, int framebuffer_height)
+void DeferredShadingRenderer::buildFrameGraph()
 {
-  // Create render textures to be used in G-Buffer
-  FrameBufferQuad::RenderTexture albedo_render_tex =
+  using Handle = FrameGraph::Handle;
+  using PassBuilder = FrameGraph::PassBuilder;
+  using PassContext = FrameGraph::PassContext;
+
+  _frame_graph.reset();
+  // Passes writing the history may have been culled
+  _reflection_history_valid = false;
+
+  // Reflection roughness, depth of field and bloom sample up to level 7
+  const int mip_levels = 8;
+
+  // G-Buffer. Normals are octahedron encoded in two channels and view space
+  // positions are reconstructed from linear depth
+  Handle albedo, normal, material, depth;
+  _frame_graph.addPass("geometry",
+    [&](PassBuilder& builder)
+    {
+      albedo = builder.create("albedo", { Texture::Format::RGBA,
+        GL_RGBA, GL_UNSIGNED_BYTE, Texture::FilterMode::LinearMipMap, 1.0f,
+        mip_levels });
+      normal = builder.create("normal", { Texture::Format::RG,
+        GL_RG16, GL_UNSIGNED_SHORT, Texture::FilterMode::Nearest, 1.0f });
+      material = builder.create("material", { Texture::Format::RGBA,
+        GL_RGBA8, GL_UNSIGNED_BYTE, Texture::FilterMode::Nearest, 1.0f });
+      depth = builder.create("depth", { Texture::Format::DepthComponent,
+        GL_DEPTH_COMPONENT32F, GL_FLOAT, Texture::FilterMode::Nearest, 1.0f });
+      albedo = builder.write(albedo, GL_COLOR_ATTACHMENT0);
+      normal = builder.write(normal, GL_COLOR_ATTACHMENT1);
+      material = builder.write(material, GL_COLOR_ATTACHMENT2);
+      depth = builder.write(depth, GL_DEPTH_ATTACHMENT);
+    },
+    [this](PassContext& context) { renderGeometryBuffer(); });
+
+  if (_occlusion_culling)
   {
-    std::make_shared<Texture>(
-      glm::uvec3(framebuffer_width, framebuffer_height, 1),
-      Texture::Format::RGBA, GL_RGBA, GL_UNSIGNED_BYTE,
-      Texture::FilterMode::LinearMipMap,
-      Texture::WrappingMode::ClampToEdge),
-      GL_COLOR_ATTACHMENT0,
-      "albedo_buffer"
-  };
-  FrameBufferQuad::RenderTexture position_render_tex =
+    // Depth pyramid of what was visible last frame, described like the
+    // reflection pyramid so that they share memory
+    Handle occluders;
+    _frame_graph.addPass("occlusion_hi_z",
+      [&](PassBuilder& builder)
+      {
+        builder.read(depth, "source");
+        occluders = builder.create("occlusion_hi_z", { Texture::Format::RG,
+          GL_RG32F, GL_FLOAT, Texture::FilterMode::NearestLinearMipMap, 0.5f,
+          hi_z_levels });
+        occluders = builder.write(occluders, GL_COLOR_ATTACHMENT0);
+      },
+      [this](PassContext& context) { renderHiZPyramid(context); });
+
+    // Writes draw commands, not textures
+    _frame_graph.addPass("occlusion_culling",
+      [&](PassBuilder& builder)
+      {
+        builder.read(occluders, "depth_pyramid");
+        builder.setSideEffect();
+      },
+      [this, occluders](PassContext& context) { cullOcclusion(context, occluders); });
+
+    _frame_graph.addPass("geometry_newly_visible",
+      [&](PassBuilder& builder)
+      {
+        albedo = builder.write(albedo, GL_COLOR_ATTACHMENT0, false);
+        normal = builder.write(normal, GL_COLOR_ATTACHMENT1, false);
+        material = builder.write(material, GL_COLOR_ATTACHMENT2, false);
+        depth = builder.write(depth, GL_DEPTH_ATTACHMENT, false);
+      },
+      [this](PassContext& context) { renderNewlyVisibleGeometry(); });
+  }
+
+  auto readGeometryBuffer = [&](PassBuilder& builder, int albedo_mip_levels)
   {
-    std::make_shared<Texture>(
-      glm::uvec3(framebuffer_width, framebuffer_height, 1),
-      Texture::Format::RGB, GL_RGB16F, GL_HALF_FLOAT,
-      Texture::FilterMode::Nearest,
-      Texture::WrappingMode::ClampToEdge),
-      GL_COLOR_ATTACHMENT1,
-      "position_buffer"
+    builder.read(albedo, "albedo_buffer", albedo_mip_levels);
+    builder.read(normal, "normal_buffer");
+    builder.read(material, "material_buffer");
+    builder.read(depth, "depth_buffer");
   };
-  FrameBufferQuad::RenderTexture normal_render_tex =
+
+  // Shadow maps are owned by the lights and cached between frames
+  _frame_graph.addPass("shadow_maps",
+    [&](PassBuilder& builder) { builder.setSideEffect(); },
+    [this](PassContext& context) { renderShadowMaps(); });
+
+  Handle irradiance;
+  _frame_graph.addPass("light_sources",
+    [&](PassBuilder& builder)
+    {
+      readGeometryBuffer(builder, 1);
+      irradiance = builder.create("irradiance", { Texture::Format::RGBA,
+        GL_RGBA16F, GL_HALF_FLOAT, Texture::FilterMode::LinearMipMap, 1.0f,
+        mip_levels });
+      irradiance = builder.write(irradiance, GL_COLOR_ATTACHMENT0);
+    },
+    [this](PassContext& context) { renderLightSources(context); });
+
+  // Min and max of the linear depth at half resolution. Culled unless the
+  // reflections are traced hierarchically.
+  Handle hi_z;
+  _frame_graph.addPass("hi_z",
+    [&](PassBuilder& builder)
+    {
+      builder.read(depth, "source");
+      hi_z = builder.create("hi_z", { Texture::Format::RG,
+        GL_RG32F, GL_FLOAT, Texture::FilterMode::NearestLinearMipMap, 0.5f,
+        hi_z_levels });
+      hi_z = builder.write(hi_z, GL_COLOR_ATTACHMENT0);
+    },
+    [this](PassContext& context) { renderHiZPyramid(context); });
+
+  // Reflections sample the sky box where the screen space ray misses
+  Handle reflected = irradiance;
+  if (_sky_box)
   {
-    std::make_shared<Texture>(
-      glm::uvec3(framebuffer_width, framebuffer_height, 1),
-      Texture::Format::RGB, GL_RGB16F, GL_HALF_FLOAT,
-      Texture::FilterMode::Nearest,
-      Texture::WrappingMode::ClampToEdge),
-      GL_COLOR_ATTACHMENT2,
-      "normal_buffer"
-  };
-  FrameBufferQuad::RenderTexture material_render_tex =
+    const bool half_resolution = tracesReflectionsAtHalfResolution();
+    const bool hierarchical =
+      _screen_space_reflections == ScreenSpaceReflections::HierarchicalZ;
+    Handle resolved_reflections;
+    if (half_resolution)
+    {
+      Handle traced;
+      _frame_graph.addPass("reflection_trace",
+        [&](PassBuilder& builder)
+        {
+          // Mip maps give reflections roughness
+          readGeometryBuffer(builder, mip_levels);
+          builder.read(irradiance, "irradiance_buffer", mip_levels);
+          if (hierarchical)
+            builder.read(hi_z, "hi_z_buffer");
+          traced = builder.create("reflection_trace", { Texture::Format::RGBA,
+            GL_RGBA16F, GL_HALF_FLOAT, Texture::FilterMode::Nearest, 0.5f });
+          traced = builder.write(traced, GL_COLOR_ATTACHMENT0);
+        },
+        [this](PassContext& context) { renderReflectionTrace(context); });
+
+      Handle history =
+        _frame_graph.importTexture("reflection_history", _reflection_history);
+      _frame_graph.addPass("reflection_resolve",
+        [&](PassBuilder& builder)
+        {
+          builder.read(traced, "ssr_buffer");
+          builder.read(history, "history_buffer");
+          builder.read(depth, "depth_buffer");
+          resolved_reflections = builder.create("reflection_resolved", {
+            Texture::Format::RGBA, GL_RGBA16F, GL_HALF_FLOAT,
+            Texture::FilterMode::Nearest, 0.5f });
+          resolved_reflections =
+            builder.write(resolved_reflections, GL_COLOR_ATTACHMENT0);
+        },
+        [this](PassContext& context) { renderReflectionResolve(context); });
+
+      _frame_graph.addPass("reflection_history",
+        [&](PassBuilder& builder)
+        {
+          builder.read(resolved_reflections, "source");
+          builder.write(history, GL_COLOR_ATTACHMENT0);
+        },
+        [this](PassContext& context) { renderReflectionHistory(context); });
+    }
+
+    _frame_graph.addPass("reflections",
+      [&](PassBuilder& builder)
+      {
+        if (half_resolution)
+        {
+          readGeometryBuffer(builder, 1);
+          builder.read(irradiance, "irradiance_buffer");
+          builder.read(resolved_reflections, "ssr_buffer");
+        }
+        else
+        {
+          // Mip maps give reflections roughness
+          readGeometryBuffer(builder, mip_levels);
+          builder.read(irradiance, "irradiance_buffer", mip_levels);
+          if (hierarchical)
+            builder.read(hi_z, "hi_z_buffer");
+        }
+        reflected = builder.create("reflected", { Texture::Format::RGB,
+          GL_RGB16F, GL_HALF_FLOAT, Texture::FilterMode::LinearMipMap, 1.0f,
+          mip_levels });
+        reflected = builder.write(reflected, GL_COLOR_ATTACHMENT0);
+      },
+      [this](PassContext& context) { renderReflections(context); });
+  }
+
+  Handle bloom;
+  _frame_graph.addPass("highlights",
+    [&](PassBuilder& builder)
+    {
+      builder.read(reflected, "irradiance_buffer");
+      bloom = builder.create("bloom", { Texture::Format::RGB,
+        GL_RGB16F, GL_HALF_FLOAT, Texture::FilterMode::LinearMipMap, 0.5f,
+        mip_levels });
+      bloom = builder.write(bloom, GL_COLOR_ATTACHMENT0);
+    },
+    [this](PassContext& context) { renderHighlights(context); });
+
+  Handle post_processed;
+  _frame_graph.addPass("post_process",
+    [&](PassBuilder& builder)
+    {
+      // Mip maps give depth of field and smooth blooming
+      builder.read(reflected, "irradiance_buffer", mip_levels);
+      builder.read(bloom, "bloom_buffer", mip_levels);
+      builder.read(albedo, "albedo_buffer");
+      builder.read(depth, "depth_buffer");
+      // Described like the irradiance texture so that they share memory
+      post_processed = builder.create("post_processed", { Texture::Format::RGBA,
+        GL_RGBA16F, GL_HALF_FLOAT, Texture::FilterMode::LinearMipMap, 1.0f,
+        mip_levels });
+      post_processed = builder.write(post_processed, GL_COLOR_ATTACHMENT0);
+    },
+    [this, bloom](PassContext& context) { renderPostProcess(context, bloom); });
+
+  // The motion blur pass writes linear depth so that forward rendered
+  // objects are depth tested against the deferred ones
+  Handle final_color, final_depth;
+  _frame_graph.addPass("motion_blur",
+    [&](PassBuilder& builder)
+    {
+      builder.read(post_processed, "irradiance_buffer");
+      builder.read(albedo, "albedo_buffer");
+      builder.read(depth, "depth_buffer");
+      final_color = builder.create("final_color", { Texture::Format::RGB,
+        GL_RGB16F, GL_HALF_FLOAT, Texture::FilterMode::LinearMipMap, 1.0f,
+        mip_levels });
+      final_depth = builder.create("final_depth", { Texture::Format::DepthComponent,
+        GL_DEPTH_COMPONENT32F, GL_FLOAT, Texture::FilterMode::Nearest, 1.0f });
+      final_color = builder.write(final_color, GL_COLOR_ATTACHMENT0);
+      final_depth = builder.write(final_depth, GL_DEPTH_ATTACHMENT);
+    },
+    [this](PassContext& context) { renderPostProcessMotionBlur(context); });
+
+  _frame_graph.addPass("forward",
+    [&](PassBuilder& builder)
+    {
+      final_color = builder.write(final_color, GL_COLOR_ATTACHMENT0, false);
+      final_depth = builder.write(final_depth, GL_DEPTH_ATTACHMENT, false);
+    },
+    [this](PassContext& context) { forwardRenderIndependentRenderables(); });
+
+  _frame_graph.addPass("to_screen",
+    [&](PassBuilder& builder)
+    {
+      builder.read(final_color, "pixel_buffer");
+      builder.setSideEffect();
+    },
+    [this](PassContext& context) { renderToScreen(context); });
+
+  _frame_graph.compile();
+}
+
+void DeferredShadingRenderer::renderGeometryBuffer()
+{
+  RenderState::enable(GL_DEPTH_TEST);
+  RenderState::disable(GL_BLEND);
+  RenderState::depthMask(GL_TRUE);
+
+  if (_parallel_recording)
   {
-    std::make_shared<Texture>(
-      glm::uvec3(framebuffer_width, framebuffer_height, 1),
-      Texture::Format::RGB, GL_RGB16F, GL_HALF_FLOAT,
-      Texture::FilterMode::Nearest,
-      Texture::WrappingMode::ClampToEdge),
-      GL_COLOR_ATTACHMENT3,
-      "material_buffer"
-  };
-  
-  // Create render textures to be used in Irradiance-Buffer
-  FrameBufferQuad::RenderTexture irradiance_render_tex1 =
+    recordGeometryBuffer();
+    {
+      ELK_PROFILE_ZONE("CommandBuffer::replay");
+      for (const auto& commands : _geometry_commands)
+        commands.replay();
+    }
+    for (const auto& renderables : _unrecorded_renderables)
+    {
+      for (auto renderable : renderables)
+      {
+        if (_occlusion_culling && renderable->supportsOcclusionCulling())
+          renderable->renderVisible({ _camera });
+        else
+          renderable->render({ _camera });
+      }
+    }
+    return;
+  }
+
+  for (auto renderable : _renderables_deferred_to_render)
   {
-    std::make_shared<Texture>(
-      glm::uvec3(framebuffer_width, framebuffer_height, 1),
-      Texture::Format::RGBA, GL_RGBA16F, GL_HALF_FLOAT,
-      Texture::FilterMode::LinearMipMap,
-      Texture::WrappingMode::ClampToEdge),
-      GL_COLOR_ATTACHMENT0,
-      "irradiance_buffer"
-  };
+    if (_occlusion_culling && renderable->supportsOcclusionCulling())
+      renderable->renderVisible({ _camera });
+    else
+      renderable->render({ _camera });
+  }
+}
 
-  FrameBufferQuad::RenderTexture irradiance_render_tex2 =
+void DeferredShadingRenderer::recordGeometryBuffer()
+{
+  ELK_PROFILE_ZONE("DeferredShadingRenderer::recordGeometryBuffer");
+  const int n = static_cast<int>(_renderables_deferred_to_render.size());
+  const int n_slices = std::max(1, std::min(
+    _worker_pool->numberOfThreads(), n / min_renderables_per_slice));
+  _geometry_commands.resize(n_slices);
+  _unrecorded_renderables.resize(n_slices);
+
+  // One slice per thread, the threads only write to their own slice
+  _worker_pool->run(n_slices, [&](int slice)
   {
-    std::make_shared<Texture>(
-      glm::uvec3(framebuffer_width, framebuffer_height, 1),
-      Texture::Format::RGB, GL_RGB16F, GL_HALF_FLOAT,
-      Texture::FilterMode::LinearMipMap,
-      Texture::WrappingMode::ClampToEdge),
-      GL_COLOR_ATTACHMENT0,
-      "irradiance_buffer"
-  };
+    const UsefulRenderData render_data = { _camera };
+    CommandBuffer& commands = _geometry_commands[slice];
+    std::vector<RenderableDeferred*>& unrecorded = _unrecorded_renderables[slice];
+    commands.clear();
+    unrecorded.clear();
+    for (int i = slice * n / n_slices; i < (slice + 1) * n / n_slices; ++i)
+    {
+      RenderableDeferred* renderable = _renderables_deferred_to_render[i];
+      // The occlusion culling phases are rendered directly
+      if ((_occlusion_culling && renderable->supportsOcclusionCulling()) ||
+          !renderable->recordCommands(commands, render_data))
+        unrecorded.push_back(renderable);
+    }
+  });
+}
 
-  // Render textures for post processing
-  FrameBufferQuad::RenderTexture bloom_render_tex =
+void DeferredShadingRenderer::renderShadowMaps()
+{
+  for (auto light_source : _directional_light_sources_to_render)
   {
-    std::make_shared<Texture>(
-      glm::uvec3(framebuffer_width / 2, framebuffer_height / 2, 1),
-      Texture::Format::RGB, GL_RGB16F, GL_HALF_FLOAT,
-      Texture::FilterMode::LinearMipMap,
-      Texture::WrappingMode::ClampToEdge),
-      GL_COLOR_ATTACHMENT0,
-      "bloom_buffer"
-  };
+    if (light_source->shadowMap())
+    {
+      light_source->shadowMap()->update(
+        _camera, light_source->direction(), _renderables_deferred_to_render);
+    }
+  }
+  _point_shadow_atlas.update(
+    _camera, _point_light_sources_to_render, _renderables_deferred_to_render);
+}
 
-  // Generate the framebuffer quads
-  _geometry_fbo_quad = std::make_unique<FrameBufferQuad>(
-    framebuffer_width, framebuffer_height,
-    std::vector<FrameBufferQuad::RenderTexture>{
-      albedo_render_tex,
-      position_render_tex,
-      normal_render_tex,
-      material_render_tex },
-      FrameBufferQuad::UseDepthBuffer::YES);
-
-  _irradiance_fbo_quad1 = std::make_unique<FrameBufferQuad>(
-    framebuffer_width, framebuffer_height,
-    std::vector<FrameBufferQuad::RenderTexture>{
-      irradiance_render_tex1},
-      FrameBufferQuad::UseDepthBuffer::YES);
-
-  _irradiance_fbo_quad2 = std::make_unique<FrameBufferQuad>(
-    framebuffer_width, framebuffer_height,
-    std::vector<FrameBufferQuad::RenderTexture>{
-      irradiance_render_tex2},
-      FrameBufferQuad::UseDepthBuffer::YES);
-
-  _post_process_fbo_quad = std::make_unique<FrameBufferQuad>(
-    framebuffer_width / 2, framebuffer_height / 2,
-    std::vector<FrameBufferQuad::RenderTexture>{bloom_render_tex});
-}
-
-void DeferredShadingRenderer::renderGeometryBuffer(FrameBufferQuad& geometry_buffer)
-{
-  geometry_buffer.bindFBO();
-  glViewport(0,0, geometry_buffer.width(), geometry_buffer.height());
-  glClearColor(0.0, 0.0, 0.0, 0.0);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+void DeferredShadingRenderer::cullOcclusion(
+  FrameGraph::PassContext& context, FrameGraph::Handle depth_pyramid)
+{
+  for (auto renderable : _renderables_deferred_to_render)
+  {
+    if (renderable->supportsOcclusionCulling())
+      renderable->cullOcclusion({ _camera }, context.texture(depth_pyramid));
+  }
+}
 
-  glEnable(GL_DEPTH_TEST);
-  glDisable(GL_BLEND);
-  glDepthMask(GL_TRUE);
+void DeferredShadingRenderer::renderNewlyVisibleGeometry()
+{
+  RenderState::enable(GL_DEPTH_TEST);
+  RenderState::disable(GL_BLEND);
+  RenderState::depthMask(GL_TRUE);
 
   for (auto renderable : _renderables_deferred_to_render)
-    renderable->render({ _camera });
-  _renderables_deferred_to_render.clear();
+  {
+    if (renderable->supportsOcclusionCulling())
+      renderable->renderNewlyVisible({ _camera });
+  }
+}
+
+void DeferredShadingRenderer::renderHiZPyramid(FrameGraph::PassContext& context)
+{
+  RenderState::disable(GL_BLEND);
+  RenderState::disable(GL_DEPTH_TEST);
 
-  geometry_buffer.unbindFBO();
+  // The first level reduces the full resolution depth buffer
+  _hi_z_program->pushUsage();
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "source_is_depth"),
+    GL_TRUE);
+  context.bindReads();
+  context.renderQuad();
+  _hi_z_program->popUsage();
+
+  // The following levels reduce the level above
+  Texture& hi_z = context.renderTarget();
+  _hi_z_downsampler->downsample(hi_z, hi_z.mipMapLevels());
 }
 
-void DeferredShadingRenderer::renderLightSources(FrameBufferQuad& light_buffer)
+void DeferredShadingRenderer::renderLightSources(FrameGraph::PassContext& context)
 {
-  // Render to irradiance buffer
-  light_buffer.bindFBO();
-  // Setup for rendering light sources to the light_buffer.rame buffer
-  glViewport(0,0, light_buffer.width(), light_buffer.height());
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  glDisable(GL_DEPTH_TEST);
-  glBlendFunc(GL_ONE, GL_ONE);
-  glEnable(GL_BLEND);
+  RenderState::disable(GL_DEPTH_TEST);
+  RenderState::blendFunc(GL_ONE, GL_ONE);
+  RenderState::enable(GL_BLEND);
   
   // Render light sources
-  renderPointLights();
-  renderDirectionalLights();
+  renderPointLights(context);
+  renderDirectionalLights(context);
 
   if (_sky_box)
   {
-    renderDiffuseEnvironmentLights();
-    renderSkyBox();
+    renderDiffuseEnvironmentLights(context);
+    renderSkyBox(context);
   }
-  light_buffer.unbindFBO();
 }
 
-void DeferredShadingRenderer::renderReflections(
-  FrameBufferQuad& sample_buffer, FrameBufferQuad& output_buffer)
+void DeferredShadingRenderer::setReflectionUniforms()
 {
-  // Render to final irradiance buffer (reflections)
-  output_buffer.bindFBO();
-  glViewport(0,0,
-    output_buffer.width(),
-    output_buffer.height());
-  glDisable(GL_BLEND);
-  
-  renderScreenSpaceReflections(sample_buffer);
-  output_buffer.unbindFBO();
+  glUniformMatrix4fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "P_frag"), 1, GL_FALSE,
+    &_camera.projectionTransform()[0][0]);
+  glm::mat4 P_frag_inv = glm::inverse(_camera.projectionTransform());
+  glUniformMatrix4fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "P_frag_inv"), 1, GL_FALSE,
+    &P_frag_inv[0][0]);
+
+  glm::mat3 V_inv = glm::mat3(_camera.absoluteTransform());
+  glUniformMatrix3fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "V_inv"),
+    1,
+    GL_FALSE,
+    &V_inv[0][0]);
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "ssr_mode"),
+    static_cast<int>(_screen_space_reflections));
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "hi_z_levels"),
+    hi_z_levels);
+}
+
+void DeferredShadingRenderer::renderWithSpecularEnvironment(
+  FrameGraph::PassContext& context)
+{
+  TextureUnit environment_unit;
+  environment_unit.activate();
+  _sky_box_specular->prefiltered().bind();
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "specular_environment"),
+    environment_unit);
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "specular_environment_levels"),
+    _sky_box_specular->levels());
+
+  TextureUnit brdf_unit;
+  brdf_unit.activate();
+  _sky_box_specular->brdfLookUpTable().bind();
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "brdf_lut"), brdf_unit);
+
+  context.renderQuad();
 }
 
-void DeferredShadingRenderer::renderHighlights(
-  FrameBufferQuad& sample_buffer, FrameBufferQuad& output_buffer)
+glm::mat4 DeferredShadingRenderer::transformViewToPreviousScreen() const
 {
-  output_buffer.bindFBO();
-  glViewport(0,0,
-    output_buffer.width(),
-    output_buffer.height());
-  glClear(GL_COLOR_BUFFER_BIT);
+  return
+    _camera.projectionTransform() *
+    _camera_previous_view_transform *
+    glm::inverse(_camera.viewTransform());
+}
+
+void DeferredShadingRenderer::renderReflectionTrace(FrameGraph::PassContext& context)
+{
+  RenderState::disable(GL_BLEND);
+
+  _shading_program_reflections->pushUsage();
+  setReflectionUniforms();
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "reflection_pass"), 1);
+  glm::ivec2 jitter = reflection_jitter[_frame_index % 4];
+  glUniform2i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "ssr_jitter"),
+    jitter.x, jitter.y);
+
+  context.bindReads();
+  renderWithSpecularEnvironment(context);
+  _shading_program_reflections->popUsage();
+}
 
+void DeferredShadingRenderer::renderReflectionResolve(FrameGraph::PassContext& context)
+{
+  RenderState::disable(GL_BLEND);
+
+  _reflection_resolve_program->pushUsage();
+  glm::mat4 P_frag_inv = glm::inverse(_camera.projectionTransform());
+  glUniformMatrix4fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "P_frag_inv"), 1, GL_FALSE,
+    &P_frag_inv[0][0]);
+  glm::mat4 transform_view_to_prev_screen = transformViewToPreviousScreen();
+  glUniformMatrix4fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(),
+      "transform_view_to_prev_screen"), 1, GL_FALSE,
+    &transform_view_to_prev_screen[0][0]);
+  glUniform1f(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "history_weight"),
+    _reflection_history_valid ? reflection_history_weight : 0.0f);
+
+  context.bindReads();
+  context.renderQuad();
+  _reflection_resolve_program->popUsage();
+}
+
+void DeferredShadingRenderer::renderReflectionHistory(FrameGraph::PassContext& context)
+{
+  RenderState::disable(GL_BLEND);
+
+  _copy_program->pushUsage();
+  context.bindReads();
+  context.renderQuad();
+  _copy_program->popUsage();
+  _reflection_history_valid = true;
+}
+
+void DeferredShadingRenderer::renderReflections(FrameGraph::PassContext& context)
+{
+  RenderState::disable(GL_BLEND);
+
+  _shading_program_reflections->pushUsage();
+  setReflectionUniforms();
+  // Reflections traced at half resolution are upsampled
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "reflection_pass"),
+    tracesReflectionsAtHalfResolution() ? 2 : 0);
+
+  context.bindReads();
+  renderWithSpecularEnvironment(context);
+  _shading_program_reflections->popUsage();
+}
+
+void DeferredShadingRenderer::renderHighlights(FrameGraph::PassContext& context)
+{
   _output_highlights_program->pushUsage();
   glUniform2i(
     glGetUniformLocation(ShaderProgram::currentProgramId(), "window_size"),
-    output_buffer.width(), output_buffer.height());
-  sample_buffer.bindTextures();
-  sample_buffer.render();
-  sample_buffer.freeTextureUnits();
+    context.width(), context.height());
+  context.bindReads();
+  context.renderQuad();
   _output_highlights_program->popUsage();
-  output_buffer.unbindFBO();
 }
 
 void DeferredShadingRenderer::renderPostProcess(
-  FrameBufferQuad& sample_buffer, FrameBufferQuad& output_buffer)
+  FrameGraph::PassContext& context, FrameGraph::Handle bloom_buffer)
 {
-  // Perform post processing, rendering to final buffer
-  output_buffer.bindFBO();
-  glViewport(0,0,
-    output_buffer.width(),
-    output_buffer.height());
-  
   _post_process_program->pushUsage();
   glUniform2i(
     glGetUniformLocation(ShaderProgram::currentProgramId(), "window_size"),
-    output_buffer.width(),
-    output_buffer.height());
+    context.width(),
+    context.height());
+  glm::uvec3 bloom_size = context.texture(bloom_buffer).dimensions();
   glUniform2i(
     glGetUniformLocation(ShaderProgram::currentProgramId(), "bloom_buffer_base_size"),
-    _post_process_fbo_quad->width(),
-    _post_process_fbo_quad->height());
+    bloom_size.x,
+    bloom_size.y);
   glUniform1f(
     glGetUniformLocation(ShaderProgram::currentProgramId(), "focal_length"),
     _camera.focalLength() / 1000.0f); // Convert from mm to m
@@ -341,7 +824,7 @@ void DeferredShadingRenderer::renderPostProcess(
 
   float diagonal = _camera.diagonal() / 1000.0f;
   float window_diagonal =
-    sqrt(pow(output_buffer.width(), 2) + pow(output_buffer.height(), 2));  
+    sqrt(pow(context.width(), 2) + pow(context.height(), 2));  
   float inv_focal_ratio_in_pixels =
     1.0f / (diagonal * _camera.focalRatio()) * window_diagonal;
 
@@ -350,52 +833,36 @@ void DeferredShadingRenderer::renderPostProcess(
       "inv_focal_ratio_in_pixels"),
     inv_focal_ratio_in_pixels);
 
-  sample_buffer.bindTextures();
-  _post_process_fbo_quad->bindTextures();
-  _geometry_fbo_quad->bindTextures();
-
-  sample_buffer.render();
-  
-  sample_buffer.freeTextureUnits();
-  _post_process_fbo_quad->freeTextureUnits();
-  _geometry_fbo_quad->freeTextureUnits();
+  context.bindReads();
+  context.renderQuad();
 
   _post_process_program->popUsage();
-
-  output_buffer.unbindFBO();
 }
 
 
 void DeferredShadingRenderer::renderPostProcessMotionBlur(
-  FrameBufferQuad& sample_fbo_quad, FrameBufferQuad& output_buffer)
-{
-  // Perform post processing, rendering to final buffer
-  output_buffer.bindFBO();
-  glViewport(0,0,
-    output_buffer.width(),
-    output_buffer.height());
-  glEnable(GL_DEPTH_TEST);
-  glDepthMask(GL_TRUE);
-  glDepthFunc(GL_LEQUAL);
-  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+  FrameGraph::PassContext& context)
+{
+  RenderState::enable(GL_DEPTH_TEST);
+  RenderState::depthMask(GL_TRUE);
+  RenderState::depthFunc(GL_LEQUAL);
 
   _motion_blur_program->pushUsage();
 
   glUniform2i(
     glGetUniformLocation(ShaderProgram::currentProgramId(), "window_size"),
-    output_buffer.width(),
-    output_buffer.height());
+    context.width(),
+    context.height());
 
   glm::mat4 P_inv = glm::inverse(_camera.projectionTransform());
   glUniformMatrix4fv(
     glGetUniformLocation(ShaderProgram::currentProgramId(), "P_inv"), 1, GL_FALSE,
     &P_inv[0][0]);
+  glUniformMatrix4fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "P_frag_inv"), 1, GL_FALSE,
+    &P_inv[0][0]);
 
-  glm::mat4 transform_view_to_prev_screen =
-    _camera.projectionTransform() *
-    _camera_previous_view_transform *
-    glm::inverse(_camera.viewTransform());
-
+  glm::mat4 transform_view_to_prev_screen = transformViewToPreviousScreen();
   glUniformMatrix4fv(
     glGetUniformLocation(ShaderProgram::currentProgramId(),
       "transform_view_to_prev_screen"), 1, GL_FALSE,
@@ -403,120 +870,146 @@ void DeferredShadingRenderer::renderPostProcessMotionBlur(
 
   _camera_previous_view_transform = _camera.viewTransform();
   
-  sample_fbo_quad.bindTextures();
-  _geometry_fbo_quad->bindTextures();
-
-  sample_fbo_quad.render();
-  
-  sample_fbo_quad.freeTextureUnits();
-  _geometry_fbo_quad->freeTextureUnits();
+  context.bindReads();
+  context.renderQuad();
   
   _motion_blur_program->popUsage();
   
   // Back to default
-  glDepthFunc(GL_LESS);
-  output_buffer.unbindFBO();
+  RenderState::depthFunc(GL_LESS);
 }
 
-void DeferredShadingRenderer::renderToScreen(
-  FrameBufferQuad& sample_fbo_quad, int attachment)
+void DeferredShadingRenderer::renderToScreen(FrameGraph::PassContext& context)
 {
-  glViewport(0,0, _window_width, _window_height);
-  glDisable(GL_BLEND);
-  glDisable(GL_DEPTH_TEST);
+  RenderState::viewport(0,0, _window_width, _window_height);
+  RenderState::disable(GL_BLEND);
+  RenderState::disable(GL_DEPTH_TEST);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
   _final_pass_through_program->pushUsage();
   glUniform2i(
     glGetUniformLocation(ShaderProgram::currentProgramId(), "window_size"),
     _window_width, _window_height);
   
-  std::vector<FrameBufferQuad::RenderTextureInfo> render_texture_info;
-  render_texture_info.push_back(
-  {
-    attachment, // Attachment 
-    "pixel_buffer" // Shader name
-  });
-  sample_fbo_quad.bindTextures(render_texture_info);
-  sample_fbo_quad.render();
-  sample_fbo_quad.freeTextureUnits();
+  // The sample buffer is addressed with normalized coordinates so it is
+  // upscaled with bilinear filtering when rendered at a lower resolution
+  context.bindReads();
+  context.renderQuad();
   _final_pass_through_program->popUsage();
 }
 
-void DeferredShadingRenderer::forwardRenderIndependentRenderables(
-  FrameBufferQuad& final_buffer)
+void DeferredShadingRenderer::forwardRenderIndependentRenderables()
 {
-  final_buffer.bindFBO();
-  glViewport(0,0,
-    final_buffer.width(),
-    final_buffer.height());
-  glEnable(GL_DEPTH_TEST);
-  glDepthMask(GL_TRUE);
-  glDisable(GL_BLEND);
+  RenderState::enable(GL_DEPTH_TEST);
+  RenderState::depthMask(GL_TRUE);
+  RenderState::disable(GL_BLEND);
 
   for (auto renderable : _renderables_forward_to_render)
     renderable->render({ _camera });
   _renderables_forward_to_render.clear();  
-  
-  final_buffer.unbindFBO();
 }
 
-void DeferredShadingRenderer::renderPointLights()
+void DeferredShadingRenderer::renderPointLights(FrameGraph::PassContext& context)
 {
+  if (_clustered_lighting_enabled)
+  {
+    renderClusteredPointLights(context);
+    return;
+  }
   _shading_program_point_lights->pushUsage();
   glUniformMatrix4fv(
     glGetUniformLocation(ShaderProgram::currentProgramId(), "P_frag"), 1, GL_FALSE,
     &_camera.projectionTransform()[0][0]);
+  glm::mat4 P_frag_inv = glm::inverse(_camera.projectionTransform());
+  glUniformMatrix4fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "P_frag_inv"), 1, GL_FALSE,
+    &P_frag_inv[0][0]);
   
-  _geometry_fbo_quad->bindTextures();
-  for (auto it : _point_light_sources_to_render)
-  {
-    it->render({ _camera });
-  }
-  _geometry_fbo_quad->freeTextureUnits();
+  context.bindReads();
+  TextureUnit tex_unit_shadow_map;
+  _point_shadow_atlas.bind(tex_unit_shadow_map, _camera);
+  _point_light_volumes.render(
+    _camera, _point_light_sources_to_render, _point_shadow_atlas);
   _point_light_sources_to_render.clear();
   _shading_program_point_lights->popUsage();
 }
 
-void DeferredShadingRenderer::renderDirectionalLights()
+void DeferredShadingRenderer::renderClusteredPointLights(
+  FrameGraph::PassContext& context)
+{
+  _clustered_lighting.update(
+    _camera, _point_light_sources_to_render, _point_shadow_atlas);
+  _point_light_sources_to_render.clear();
+  if (_clustered_lighting.numberOfVisibleLights() == 0)
+    return;
+
+  _shading_program_clustered_point_lights->pushUsage();
+  glUniformMatrix4fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "P_frag"), 1, GL_FALSE,
+    &_camera.projectionTransform()[0][0]);
+  glm::mat4 P_frag_inv = glm::inverse(_camera.projectionTransform());
+  glUniformMatrix4fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "P_frag_inv"), 1, GL_FALSE,
+    &P_frag_inv[0][0]);
+
+  context.bindReads();
+  TextureUnit tex_unit_shadow_map;
+  TextureUnit tex_unit_lights;
+  TextureUnit tex_unit_clusters;
+  TextureUnit tex_unit_light_indices;
+  _point_shadow_atlas.bind(tex_unit_shadow_map, _camera);
+  _clustered_lighting.setUniforms(
+    tex_unit_lights, tex_unit_clusters, tex_unit_light_indices);
+  context.renderQuad();
+  _shading_program_clustered_point_lights->popUsage();
+}
+
+void DeferredShadingRenderer::renderDirectionalLights(FrameGraph::PassContext& context)
 {
   _shading_program_directional_lights->pushUsage();
   glUniformMatrix4fv(
     glGetUniformLocation(ShaderProgram::currentProgramId(), "P_frag"), 1, GL_FALSE,
     &_camera.projectionTransform()[0][0]);
-  _geometry_fbo_quad->bindTextures();
+  glm::mat4 P_frag_inv = glm::inverse(_camera.projectionTransform());
+  glUniformMatrix4fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "P_frag_inv"), 1, GL_FALSE,
+    &P_frag_inv[0][0]);
+  context.bindReads();
   for (auto it : _directional_light_sources_to_render)
   {
     it->render({ _camera });
   }
-  _geometry_fbo_quad->freeTextureUnits();
   _directional_light_sources_to_render.clear();
   _shading_program_directional_lights->popUsage();
 }
 
-void DeferredShadingRenderer::renderDiffuseEnvironmentLights()
+void DeferredShadingRenderer::renderDiffuseEnvironmentLights(FrameGraph::PassContext& context)
 {
   _shading_program_environment_diffuse->pushUsage();
+  glm::mat4 P_frag_inv = glm::inverse(_camera.projectionTransform());
+  glUniformMatrix4fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "P_frag_inv"), 1, GL_FALSE,
+    &P_frag_inv[0][0]);
   glm::mat3 V_inv = glm::mat3(_camera.absoluteTransform());
   glUniformMatrix3fv(
     glGetUniformLocation(ShaderProgram::currentProgramId(), "V_inv"),
     1,
     GL_FALSE,
     &V_inv[0][0]);
-  glUniform1i(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "cube_map_size"),
-    _sky_box->textureSize());
+  glUniform3fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "sh_diffuse"),
+    _sky_box_diffuse.size(),
+    &_sky_box_diffuse[0][0]);
 
-  _geometry_fbo_quad->bindTextures();
-  _sky_box->render();
-  _geometry_fbo_quad->freeTextureUnits();
+  context.bindReads();
+  context.renderQuad();
   _shading_program_environment_diffuse->popUsage();
 }
 
-void DeferredShadingRenderer::renderSkyBox()
+void DeferredShadingRenderer::renderSkyBox(FrameGraph::PassContext& context)
 {
   _cube_map_program->pushUsage();
-  _geometry_fbo_quad->bindTextures();
-    glDisable(GL_CULL_FACE);
+  context.bindReads();
+    RenderState::disable(GL_CULL_FACE);
 
   glUniformMatrix4fv(
       glGetUniformLocation(ShaderProgram::currentProgramId(), "V"),
@@ -530,35 +1023,8 @@ void DeferredShadingRenderer::renderSkyBox()
       &_camera.projectionTransform()[0][0]);
 
   _sky_box->render();
-  _geometry_fbo_quad->freeTextureUnits();
-  glEnable(GL_CULL_FACE);
+  RenderState::enable(GL_CULL_FACE);
   _cube_map_program->popUsage();
 }
 
-void DeferredShadingRenderer::renderScreenSpaceReflections(
-  FrameBufferQuad& sample_buffer)
-{
-  _shading_program_reflections->pushUsage();
-  glUniformMatrix4fv(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "P_frag"), 1, GL_FALSE,
-    &_camera.projectionTransform()[0][0]);
-
-  glm::mat3 V_inv = glm::mat3(_camera.absoluteTransform());
-  glUniformMatrix3fv(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "V_inv"),
-    1,
-    GL_FALSE,
-    &V_inv[0][0]);
-  glUniform1i(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "cube_map_size"),
-    _sky_box->textureSize());
-
-  sample_buffer.bindTextures();
-  _geometry_fbo_quad->bindTextures();
-  _sky_box->render();
-  sample_buffer.freeTextureUnits();
-  _geometry_fbo_quad->freeTextureUnits();
-  _shading_program_reflections->popUsage();
-}
-
-} }
+} }
\ No newline at end of file
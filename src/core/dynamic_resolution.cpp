@@ -0,0 +1,62 @@
+#include "elk/core/dynamic_resolution.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace elk { namespace core {
+
+DynamicResolution::DynamicResolution(DynamicResolutionSettings settings) :
+  _settings(settings),
+  _scale(settings.max_scale),
+  _smoothed_gpu_time(-1.0),
+  _frames_since_change(0)
+{ }
+
+void DynamicResolution::setSettings(DynamicResolutionSettings settings)
+{
+  _settings = settings;
+  _scale = quantize(_scale);
+}
+
+float DynamicResolution::quantize(float scale) const
+{
+  scale = std::floor(scale / _settings.scale_step + 0.001f) * _settings.scale_step;
+  return std::min(std::max(scale, _settings.min_scale), _settings.max_scale);
+}
+
+float DynamicResolution::update(double gpu_time)
+{
+  _frames_since_change++;
+  // Still measuring frames rendered at the previous resolution
+  if (_frames_since_change <= _settings.latency_frames)
+    return _scale;
+
+  _smoothed_gpu_time = _smoothed_gpu_time < 0.0 ? gpu_time :
+    _settings.smoothing * gpu_time +
+    (1.0 - _settings.smoothing) * _smoothed_gpu_time;
+
+  float new_scale = _scale;
+  if (_smoothed_gpu_time > _settings.frame_budget)
+  {
+    // GPU time is roughly proportional to the number of pixels
+    float target = _scale *
+      std::sqrt(static_cast<float>(_settings.frame_budget / _smoothed_gpu_time));
+    new_scale = quantize(std::min(target, _scale - _settings.scale_step));
+  }
+  else if (_smoothed_gpu_time < _settings.frame_budget * _settings.headroom &&
+           _frames_since_change > _settings.cooldown_frames)
+  {
+    new_scale = quantize(_scale + _settings.scale_step);
+  }
+
+  if (new_scale != _scale)
+  {
+    _scale = new_scale;
+    _frames_since_change = 0;
+    // The old measurements were made at another resolution
+    _smoothed_gpu_time = -1.0;
+  }
+  return _scale;
+}
+
+} }
@@ -1,4 +1,7 @@
 #include "elk/core/elk_engine.h"
+#include "elk/core/texture_unit.h"
+#include "elk/core/render_state.h"
+#include "elk/core/cpu_profiler.h"
 
 namespace elk { namespace core {
 
@@ -21,7 +24,14 @@ bool ElkEngine::_initializeGL()
 {
   glewExperimental = true; // Needed in core profile
 
-  if (glewInit() != GLEW_OK) {
+  GLenum error = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+  // Contexts created with EGL have no GLX display, the GL functions are
+  // loaded anyway
+  if (error == GLEW_ERROR_NO_GLX_DISPLAY)
+    error = GLEW_OK;
+#endif
+  if (error != GLEW_OK) {
     fprintf(stderr, "Failed to initialize GLEW\n");
     return false;
   }
@@ -31,8 +41,19 @@ bool ElkEngine::_initializeGL()
   return true;
 }
 
+void ElkEngine::beginFrame()
+{
+  ELK_PROFILE_FRAME();
+  TextureUnit::resetFrameStatistics();
+  RenderState::resetFrameStatistics();
+}
+
 void ElkEngine::update(double dt)
 {
+  // A new frame starts
+  beginFrame();
+  ELK_PROFILE_ZONE("ElkEngine::update");
+
   // Call update for all objects
   scene.update(dt);
   view_space.update(dt);
@@ -47,6 +68,30 @@ void ElkEngine::update(double dt)
   background_space.updateTransform(glm::mat4());
 }
 
+void ElkEngine::step(double dt)
+{
+  ELK_PROFILE_ZONE("ElkEngine::step");
+  Object3D::beginSimulationStep();
+  scene.update(dt);
+  view_space.update(dt);
+  background_space.update(dt);
+}
+
+void ElkEngine::interpolate(double alpha)
+{
+  // A new frame starts, any number of steps may have been taken since the
+  // last one
+  beginFrame();
+  ELK_PROFILE_ZONE("ElkEngine::interpolate");
+
+  perspective_camera.updateTransform(glm::mat4(), alpha);
+  viewspace_ortho_camera.updateTransform(glm::mat4(), alpha);
+
+  scene.updateTransform(glm::mat4(), alpha);
+  view_space.updateTransform(glm::mat4(), alpha);
+  background_space.updateTransform(glm::mat4(), alpha);
+}
+
 PerspectiveCamera& ElkEngine::camera()
 {
   return perspective_camera;
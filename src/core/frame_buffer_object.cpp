@@ -1,4 +1,5 @@
 #include "elk/core/frame_buffer_object.h"
+#include "elk/core/render_state.h"
 
 #include <gl/glew.h>
 
@@ -13,17 +14,17 @@ FrameBufferObject::FrameBufferObject()
 
 FrameBufferObject::~FrameBufferObject()
 {
-  glDeleteFramebuffers(1, &_id);
+  RenderState::deleteFramebuffer(_id);
 }
 
 void FrameBufferObject::bind()
 {
-  glBindFramebuffer(GL_FRAMEBUFFER, _id);
+  RenderState::bindFramebuffer(_id);
 }
 
 void FrameBufferObject::unbind()
 {
-  glBindFramebuffer(GL_FRAMEBUFFER, 0);
+  RenderState::bindFramebuffer(0);
 }
 
 void FrameBufferObject::attach2DTexture(
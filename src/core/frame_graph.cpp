@@ -0,0 +1,496 @@
+#include "elk/core/frame_graph.h"
+
+#include "elk/core/cpu_profiler.h"
+#include "elk/core/create_mesh.h"
+#include "elk/core/render_state.h"
+#include "elk/core/shader_program.h"
+
+#include <algorithm>
+#include <iostream>
+
+namespace elk { namespace core {
+
+bool FrameGraph::TextureDescription::operator==(
+  const TextureDescription& other) const
+{
+  return
+    format == other.format &&
+    internal_format == other.internal_format &&
+    data_type == other.data_type &&
+    filter == other.filter &&
+    scale == other.scale &&
+    mip_levels == other.mip_levels;
+}
+
+FrameGraph::PassBuilder::PassBuilder(FrameGraph& graph, int pass) :
+  _graph(graph),
+  _pass(pass)
+{
+
+}
+
+FrameGraph::Handle FrameGraph::PassBuilder::create(
+  const std::string& name, TextureDescription description)
+{
+  _graph._resources.push_back({ name, description, nullptr, -1, -1, -1 });
+  _graph._versions.push_back(
+    { static_cast<int>(_graph._resources.size()) - 1, -1, invalid_handle, 1 });
+  return _graph._versions.size() - 1;
+}
+
+void FrameGraph::PassBuilder::read(
+  Handle texture, const std::string& sampler_name, int mip_levels)
+{
+  _graph._passes[_pass].reads.push_back({ texture, sampler_name, mip_levels });
+}
+
+FrameGraph::Handle FrameGraph::PassBuilder::write(
+  Handle texture, GLenum attachment, bool clear)
+{
+  int resource = _graph._versions[texture].resource;
+  _graph._versions.push_back({ resource, _pass, texture, 1 });
+  Handle new_version = _graph._versions.size() - 1;
+  _graph._passes[_pass].writes.push_back({ new_version, attachment, clear, 0 });
+  // Output to textures outside the graph is always considered used
+  if (_graph._resources[resource].imported)
+    setSideEffect();
+  return new_version;
+}
+
+void FrameGraph::PassBuilder::setSideEffect()
+{
+  _graph._passes[_pass].side_effect = true;
+}
+
+FrameGraph::PassContext::PassContext(
+  FrameGraph& graph, int pass, int width, int height) :
+  _graph(graph),
+  _pass(pass),
+  _width(width),
+  _height(height)
+{
+
+}
+
+void FrameGraph::PassContext::bindReads()
+{
+  const auto& reads = _graph._passes[_pass].reads;
+  // Units are assigned on the first call and kept until the pass is done
+  if (_texture_units.size() != reads.size())
+  {
+    _texture_units.clear();
+    _texture_units.resize(reads.size());
+  }
+  for (int i = 0; i < reads.size(); ++i)
+  {
+    _texture_units[i].activate();
+    texture(reads[i].handle).bind();
+    glUniform1i(glGetUniformLocation(ShaderProgram::currentProgramId(),
+      reads[i].sampler_name.c_str()), _texture_units[i]);
+  }
+}
+
+Texture& FrameGraph::PassContext::texture(Handle handle)
+{
+  return _graph.textureOf(_graph._versions[handle].resource);
+}
+
+Texture& FrameGraph::PassContext::renderTarget(int index)
+{
+  return texture(_graph._passes[_pass].writes[index].handle);
+}
+
+void FrameGraph::PassContext::renderQuad()
+{
+  _graph._quad->render();
+}
+
+FrameGraph::FrameGraph(int width, int height) :
+  _width(width),
+  _height(height),
+  _compiled(false),
+  _profiler(nullptr)
+{
+  _quad = CreateMesh::quad();
+}
+
+FrameGraph::~FrameGraph()
+{
+
+}
+
+void FrameGraph::reset()
+{
+  _resources.clear();
+  _versions.clear();
+  _passes.clear();
+  _compiled = false;
+}
+
+FrameGraph::Handle FrameGraph::importTexture(
+  const std::string& name, std::shared_ptr<Texture> texture)
+{
+  TextureDescription description =
+    { texture->format(), 0, texture->dataType(), Texture::FilterMode::Nearest, 0.0f,
+      texture->mipMapLevels() };
+  _resources.push_back({ name, description, texture, -1, -1, -1 });
+  _versions.push_back(
+    { static_cast<int>(_resources.size()) - 1, -1, invalid_handle, 1 });
+  return _versions.size() - 1;
+}
+
+void FrameGraph::addPass(const std::string& name, Setup setup, Execute execute)
+{
+  Pass pass;
+  pass.name = name;
+  pass.zone_name = CpuProfiler::internName(name);
+  pass.execute = execute;
+  pass.side_effect = false;
+  pass.culled = true;
+  _passes.push_back(std::move(pass));
+
+  PassBuilder builder(*this, _passes.size() - 1);
+  setup(builder);
+  _compiled = false;
+}
+
+void FrameGraph::compile()
+{
+  cullPasses();
+  computeLifetimes();
+  allocateTextures();
+  createFramebuffers();
+  _compiled = true;
+}
+
+void FrameGraph::cullPasses()
+{
+  for (auto& pass : _passes)
+    pass.culled = true;
+
+  // Walk backwards from the passes with side effects to everything they
+  // depend on
+  std::vector<int> stack;
+  for (int i = 0; i < _passes.size(); ++i)
+  {
+    if (_passes[i].side_effect)
+      stack.push_back(i);
+  }
+  while (!stack.empty())
+  {
+    int index = stack.back();
+    stack.pop_back();
+    Pass& pass = _passes[index];
+    if (!pass.culled)
+      continue;
+    pass.culled = false;
+
+    for (const auto& read : pass.reads)
+    {
+      int producer = _versions[read.handle].producer;
+      if (producer >= 0)
+        stack.push_back(producer);
+      else if (!_resources[_versions[read.handle].resource].imported)
+      {
+        std::cout << "ERROR : Pass " << pass.name << " reads " <<
+          _resources[_versions[read.handle].resource].name <<
+          " before it is written." << std::endl;
+      }
+    }
+    for (const auto& write : pass.writes)
+    {
+      if (write.clear)
+        continue;
+      int producer = _versions[_versions[write.handle].previous].producer;
+      if (producer >= 0)
+        stack.push_back(producer);
+    }
+  }
+}
+
+void FrameGraph::computeLifetimes()
+{
+  for (auto& resource : _resources)
+  {
+    resource.first_use = -1;
+    resource.last_use = -1;
+  }
+  for (auto& version : _versions)
+    version.mip_levels = 1;
+
+  auto use = [&](Handle handle, int pass)
+  {
+    Resource& resource = _resources[_versions[handle].resource];
+    if (resource.first_use < 0)
+      resource.first_use = pass;
+    resource.last_use = pass;
+  };
+
+  for (int i = 0; i < _passes.size(); ++i)
+  {
+    Pass& pass = _passes[i];
+    pass.generate_mip_maps.clear();
+    if (pass.culled)
+      continue;
+    for (const auto& read : pass.reads)
+    {
+      use(read.handle, i);
+      Version& version = _versions[read.handle];
+      version.mip_levels = std::max(version.mip_levels, read.mip_levels);
+    }
+    for (const auto& write : pass.writes)
+      use(write.handle, i);
+  }
+
+  // Levels are generated once per version, before its first reader that
+  // samples them, and only as many as the most demanding reader uses
+  std::vector<bool> scheduled(_versions.size(), false);
+  for (auto& pass : _passes)
+  {
+    if (pass.culled)
+      continue;
+    for (const auto& read : pass.reads)
+    {
+      if (read.mip_levels <= 1 || scheduled[read.handle])
+        continue;
+      scheduled[read.handle] = true;
+      const Version& version = _versions[read.handle];
+      const Resource& resource = _resources[version.resource];
+      int levels = version.mip_levels;
+      if (levels > resource.description.mip_levels)
+      {
+        std::cout << "ERROR : Pass " << pass.name << " samples " << levels <<
+          " mip levels of " << resource.name << " which has only " <<
+          resource.description.mip_levels << "." << std::endl;
+        levels = resource.description.mip_levels;
+      }
+      pass.generate_mip_maps.push_back({ version.resource, levels });
+    }
+  }
+}
+
+void FrameGraph::allocateTextures()
+{
+  // Resources ordered by their first use so that a physical texture can be
+  // handed over as soon as its previous user is done
+  std::vector<int> order;
+  for (int i = 0; i < _resources.size(); ++i)
+  {
+    _resources[i].physical = -1;
+    if (!_resources[i].imported && _resources[i].first_use >= 0)
+      order.push_back(i);
+  }
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b)
+  {
+    return _resources[a].first_use < _resources[b].first_use;
+  });
+
+  // Physical textures of the previous compilation are reused if possible
+  std::vector<PhysicalTexture> available;
+  available.swap(_physical_textures);
+  for (int index : order)
+  {
+    Resource& resource = _resources[index];
+    for (int i = 0; i < _physical_textures.size(); ++i)
+    {
+      PhysicalTexture& physical = _physical_textures[i];
+      if (physical.last_use < resource.first_use &&
+          physical.description == resource.description)
+      {
+        resource.physical = i;
+        break;
+      }
+    }
+    if (resource.physical < 0)
+    {
+      auto it = std::find_if(available.begin(), available.end(),
+        [&](const PhysicalTexture& physical)
+        { return physical.description == resource.description; });
+      if (it != available.end())
+      {
+        _physical_textures.push_back(*it);
+        available.erase(it);
+      }
+      else
+      {
+        const TextureDescription& d = resource.description;
+        auto texture = std::make_shared<Texture>(
+          scaledSize(d.scale), d.format, d.internal_format, d.data_type,
+          d.filter, Texture::WrappingMode::ClampToEdge);
+        texture->upload();
+        texture->setMipMapLevels(d.mip_levels);
+        _physical_textures.push_back({ d, texture, -1 });
+      }
+      resource.physical = _physical_textures.size() - 1;
+    }
+    _physical_textures[resource.physical].last_use = resource.last_use;
+  }
+}
+
+void FrameGraph::createFramebuffers()
+{
+  for (auto& pass : _passes)
+  {
+    pass.fbo.reset();
+    if (pass.culled || pass.writes.empty())
+      continue;
+    pass.fbo = std::make_unique<FrameBufferObject>();
+    std::vector<GLenum> draw_buffers;
+    glm::uvec3 size = textureOf(_versions[pass.writes[0].handle].resource).dimensions();
+    for (auto& write : pass.writes)
+    {
+      Texture& texture = textureOf(_versions[write.handle].resource);
+      if (texture.dimensions() != size)
+      {
+        std::cout << "ERROR : Render targets of pass " << pass.name <<
+          " differ in size." << std::endl;
+      }
+      pass.fbo->attach2DTexture(texture.id(), write.attachment, 0);
+      if (write.attachment != GL_DEPTH_ATTACHMENT)
+        draw_buffers.push_back(write.attachment);
+    }
+    std::sort(draw_buffers.begin(), draw_buffers.end());
+    // Color targets are cleared by their index in the draw buffers
+    for (auto& write : pass.writes)
+    {
+      write.draw_buffer = std::find(draw_buffers.begin(), draw_buffers.end(),
+        write.attachment) - draw_buffers.begin();
+    }
+    // The draw buffers are part of the framebuffer state, set them once
+    pass.fbo->bind();
+    glDrawBuffers(draw_buffers.size(), draw_buffers.data());
+    pass.fbo->unbind();
+  }
+}
+
+void FrameGraph::execute()
+{
+  if (!_compiled)
+    compile();
+
+  for (int i = 0; i < _passes.size(); ++i)
+  {
+    Pass& pass = _passes[i];
+    if (pass.culled)
+      continue;
+    ELK_PROFILE_ZONE(pass.zone_name);
+    RenderState::beginPass(pass.name);
+    if (_profiler)
+      _profiler->beginPass(pass.name);
+
+    for (const auto& generate : pass.generate_mip_maps)
+      _downsampler.downsample(textureOf(generate.first), generate.second);
+
+    int width = _width;
+    int height = _height;
+    if (pass.fbo)
+    {
+      glm::uvec3 size = textureOf(_versions[pass.writes[0].handle].resource).dimensions();
+      width = size.x;
+      height = size.y;
+      pass.fbo->bind();
+      RenderState::viewport(0, 0, width, height);
+      clearTargets(pass);
+    }
+    else
+    {
+      // Passes without render targets draw to the default framebuffer and
+      // set the viewport themselves
+      RenderState::bindFramebuffer(0);
+    }
+
+    PassContext context(*this, i, width, height);
+    pass.execute(context);
+    if (_profiler)
+      _profiler->endPass();
+  }
+  RenderState::bindFramebuffer(0);
+}
+
+void FrameGraph::clearTargets(const Pass& pass)
+{
+  const GLfloat zero[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+  const GLfloat one = 1.0f;
+  for (const auto& write : pass.writes)
+  {
+    if (!write.clear)
+      continue;
+    if (write.attachment == GL_DEPTH_ATTACHMENT)
+    {
+      // Depth is only cleared where it can be written
+      RenderState::depthMask(GL_TRUE);
+      glClearBufferfv(GL_DEPTH, 0, &one);
+    }
+    else
+      glClearBufferfv(GL_COLOR, write.draw_buffer, zero);
+  }
+}
+
+void FrameGraph::setResolution(int width, int height)
+{
+  _width = width;
+  _height = height;
+  for (auto& physical : _physical_textures)
+  {
+    glm::uvec3 size = scaledSize(physical.description.scale);
+    // The framebuffers refer to the texture objects so they stay valid
+    if (physical.texture->dimensions() != size)
+      physical.texture->resize(size);
+  }
+}
+
+int FrameGraph::numberOfCulledPasses() const
+{
+  return std::count_if(_passes.begin(), _passes.end(),
+    [](const Pass& pass) { return pass.culled; });
+}
+
+void FrameGraph::print() const
+{
+  for (const auto& pass : _passes)
+  {
+    printf("%s%s\n", pass.name.c_str(), pass.culled ? " (culled)" : "");
+    for (const auto& read : pass.reads)
+    {
+      printf("  read  %s\n",
+        _resources[_versions[read.handle].resource].name.c_str());
+    }
+    for (const auto& generate : pass.generate_mip_maps)
+    {
+      printf("  mips  %s (%i levels)\n",
+        _resources[generate.first].name.c_str(), generate.second);
+    }
+    for (const auto& write : pass.writes)
+    {
+      printf("  write %s%s\n",
+        _resources[_versions[write.handle].resource].name.c_str(),
+        write.clear ? "" : " (load)");
+    }
+  }
+  for (const auto& resource : _resources)
+  {
+    if (resource.imported)
+      printf("%s : imported\n", resource.name.c_str());
+    else if (resource.physical >= 0)
+      printf("%s : texture %i\n", resource.name.c_str(), resource.physical);
+  }
+  printf("%i physical textures\n", numberOfPhysicalTextures());
+}
+
+glm::uvec3 FrameGraph::scaledSize(float scale) const
+{
+  return glm::uvec3(
+    std::max(1, static_cast<int>(_width * scale)),
+    std::max(1, static_cast<int>(_height * scale)),
+    1);
+}
+
+Texture& FrameGraph::textureOf(int resource)
+{
+  const Resource& r = _resources[resource];
+  if (r.imported)
+    return *r.imported;
+  return *_physical_textures[r.physical].texture;
+}
+
+} }
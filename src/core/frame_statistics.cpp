@@ -0,0 +1,162 @@
+#include "elk/core/frame_statistics.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace elk { namespace core {
+
+namespace {
+
+const size_t max_buckets = 100;
+
+// Nearest rank percentile of sorted values
+double percentile(const std::vector<double>& sorted, double p)
+{
+  size_t rank = size_t(std::ceil(p / 100.0 * sorted.size()));
+  return sorted[std::min(std::max(rank, size_t(1)), sorted.size()) - 1];
+}
+
+} // namespace
+
+FrameStatistics::FrameStatistics(int capacity) :
+  _capacity(std::max(capacity, 1)),
+  _next(0),
+  _next_gpu(0),
+  _budget(1000.0 / 60.0)
+{
+  _frames.reserve(_capacity);
+  _gpu_frames.reserve(_capacity);
+}
+
+void FrameStatistics::record(double cpu_time, double present_interval)
+{
+  Frame frame = { cpu_time, present_interval };
+  if (int(_frames.size()) < _capacity)
+    _frames.push_back(frame);
+  else
+    _frames[_next] = frame;
+  _next = (_next + 1) % _capacity;
+}
+
+void FrameStatistics::recordGpuTime(unsigned int frame, double gpu_time)
+{
+  if (!_gpu_frames.empty())
+  {
+    const GpuFrame& newest = _gpu_frames[(_next_gpu + _capacity - 1) % _capacity];
+    if (frame <= newest.frame)
+      return;
+  }
+  GpuFrame gpu_frame = { frame, gpu_time };
+  if (int(_gpu_frames.size()) < _capacity)
+    _gpu_frames.push_back(gpu_frame);
+  else
+    _gpu_frames[_next_gpu] = gpu_frame;
+  _next_gpu = (_next_gpu + 1) % _capacity;
+}
+
+std::vector<double> FrameStatistics::values(Metric metric) const
+{
+  std::vector<double> result;
+  // Before a buffer is full its oldest entry is at index 0
+  if (metric == Metric::GpuTime)
+  {
+    result.reserve(_gpu_frames.size());
+    const size_t oldest = int(_gpu_frames.size()) < _capacity ? 0 : _next_gpu;
+    for (size_t i = 0; i < _gpu_frames.size(); ++i)
+      result.push_back(_gpu_frames[(oldest + i) % _gpu_frames.size()].gpu_time);
+    return result;
+  }
+  result.reserve(_frames.size());
+  const size_t oldest = int(_frames.size()) < _capacity ? 0 : _next;
+  for (size_t i = 0; i < _frames.size(); ++i)
+  {
+    const Frame& frame = _frames[(oldest + i) % _frames.size()];
+    result.push_back(metric == Metric::CpuTime ? frame.cpu_time : frame.present_interval);
+  }
+  return result;
+}
+
+FrameStatistics::Summary FrameStatistics::summary(Metric metric) const
+{
+  std::vector<double> sorted = values(metric);
+  Summary summary = { int(sorted.size()), 0.0, 0.0, 0.0, 0.0, 0.0, 0.0, 0, 0 };
+  if (sorted.empty())
+    return summary;
+  std::sort(sorted.begin(), sorted.end());
+
+  double sum = 0.0;
+  for (double value : sorted)
+  {
+    sum += value;
+    summary.number_over_budget += value > _budget;
+    summary.number_of_hitches += value > 2.0 * _budget;
+  }
+  summary.min = sorted.front();
+  summary.mean = sum / sorted.size();
+  summary.p50 = percentile(sorted, 50.0);
+  summary.p95 = percentile(sorted, 95.0);
+  summary.p99 = percentile(sorted, 99.0);
+  summary.max = sorted.back();
+  return summary;
+}
+
+void FrameStatistics::printSummary(FILE* file) const
+{
+  const Metric metrics[] = { Metric::CpuTime, Metric::GpuTime, Metric::PresentInterval };
+  for (Metric metric : metrics)
+  {
+    Summary s = summary(metric);
+    fprintf(file,
+      "%s : min %.2f mean %.2f p50 %.2f p95 %.2f p99 %.2f max %.2f ms, "
+      "%d over %.2f ms budget, %d hitches in %d frames\n",
+      metricName(metric), s.min, s.mean, s.p50, s.p95, s.p99, s.max,
+      s.number_over_budget, _budget, s.number_of_hitches, s.number_of_samples);
+  }
+}
+
+void FrameStatistics::printHistogram(Metric metric, double bucket_size, FILE* file) const
+{
+  std::vector<double> samples = values(metric);
+  fprintf(file, "%s histogram of %d frames\n", metricName(metric), int(samples.size()));
+  if (samples.empty() || bucket_size <= 0.0)
+    return;
+
+  // The last bucket also holds everything longer
+  const double max = *std::max_element(samples.begin(), samples.end());
+  std::vector<int> buckets(std::min(size_t(max / bucket_size) + 1, max_buckets), 0);
+  for (double value : samples)
+    buckets[std::min(size_t(value / bucket_size), buckets.size() - 1)]++;
+  const int largest = *std::max_element(buckets.begin(), buckets.end());
+
+  // Bars are scaled to at most 50 characters, the budget is marked
+  for (size_t i = 0; i < buckets.size(); ++i)
+  {
+    const double begin = i * bucket_size;
+    const bool budget = begin <= _budget && _budget < begin + bucket_size;
+    fprintf(file, "%7.2f ms %c %6d ", begin, budget ? '>' : '|', buckets[i]);
+    for (int j = 0; j < (buckets[i] * 50 + largest - 1) / largest; ++j)
+      fputc('#', file);
+    fputc('\n', file);
+  }
+}
+
+void FrameStatistics::clear()
+{
+  _frames.clear();
+  _gpu_frames.clear();
+  _next = 0;
+  _next_gpu = 0;
+}
+
+const char* FrameStatistics::metricName(Metric metric)
+{
+  switch (metric)
+  {
+    case Metric::CpuTime: return "CPU time";
+    case Metric::GpuTime: return "GPU time";
+    case Metric::PresentInterval: return "Present interval";
+  }
+  return "";
+}
+
+} }
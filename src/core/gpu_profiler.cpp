@@ -0,0 +1,203 @@
+#include "elk/core/gpu_profiler.h"
+#include "elk/core/cpu_profiler.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+namespace elk { namespace core {
+
+GpuProfiler::GpuProfiler(int window) :
+  _current_frame(0),
+  _frame_index(0),
+  _in_frame(false),
+  _in_pass(false),
+  _window(std::max(window, 1))
+{
+  for (auto& frame : _frames)
+  {
+    frame.number_of_passes = 0;
+    frame.index = 0;
+    frame.clock_offset = 0;
+    frame.pending = false;
+  }
+}
+
+GpuProfiler::~GpuProfiler()
+{
+  for (auto& frame : _frames)
+  {
+    if (!frame.queries.empty())
+      glDeleteQueries(frame.queries.size(), frame.queries.data());
+  }
+}
+
+void GpuProfiler::beginFrame()
+{
+  _current_frame = _frame_index % number_of_frames;
+  Frame& frame = _frames[_current_frame];
+  // Still in flight, drop it rather than waiting for it
+  if (frame.pending && !readFrame(frame))
+    frame.pending = false;
+  frame.number_of_passes = 0;
+  frame.index = _frame_index;
+  // The time at which the GL receives the command, close enough to pair
+  // with the CPU clock
+  GLint64 gpu_time = 0;
+  glGetInteger64v(GL_TIMESTAMP, &gpu_time);
+  frame.clock_offset = CpuProfiler::now() - gpu_time;
+  _in_frame = true;
+}
+
+void GpuProfiler::endFrame()
+{
+  if (!_in_frame)
+    return;
+  if (_in_pass)
+    endPass();
+  Frame& frame = _frames[_current_frame];
+  frame.pending = frame.number_of_passes > 0;
+  _in_frame = false;
+  _frame_index++;
+
+  // Oldest first, later frames can not have finished before earlier ones
+  for (int age = number_of_frames - 1; age >= 0; --age)
+  {
+    unsigned int index = _frame_index - 1 - age;
+    Frame& earlier = _frames[index % number_of_frames];
+    if (!earlier.pending || earlier.index != index)
+      continue;
+    if (!readFrame(earlier))
+      break;
+  }
+}
+
+void GpuProfiler::beginPass(const std::string& name)
+{
+  if (!_in_frame)
+    return;
+  if (_in_pass)
+    endPass();
+  Frame& frame = _frames[_current_frame];
+  const size_t needed = 2 * (frame.number_of_passes + 1);
+  if (frame.queries.size() < needed)
+  {
+    size_t first = frame.queries.size();
+    frame.queries.resize(needed);
+    glGenQueries(needed - first, frame.queries.data() + first);
+  }
+  if (frame.names.size() < size_t(frame.number_of_passes + 1))
+    frame.names.resize(frame.number_of_passes + 1);
+  frame.names[frame.number_of_passes] = name;
+  glQueryCounter(frame.queries[2 * frame.number_of_passes], GL_TIMESTAMP);
+  _in_pass = true;
+}
+
+void GpuProfiler::endPass()
+{
+  if (!_in_pass)
+    return;
+  Frame& frame = _frames[_current_frame];
+  glQueryCounter(frame.queries[2 * frame.number_of_passes + 1], GL_TIMESTAMP);
+  frame.number_of_passes++;
+  _in_pass = false;
+}
+
+bool GpuProfiler::readFrame(Frame& frame)
+{
+  // Timestamps are written in order, the last one arrives last
+  GLint available = GL_FALSE;
+  glGetQueryObjectiv(
+    frame.queries[2 * frame.number_of_passes - 1], GL_QUERY_RESULT_AVAILABLE, &available);
+  if (!available)
+    return false;
+
+  for (int i = 0; i < frame.number_of_passes; ++i)
+  {
+    GLuint64 begin, end;
+    glGetQueryObjectui64v(frame.queries[2 * i], GL_QUERY_RESULT, &begin);
+    glGetQueryObjectui64v(frame.queries[2 * i + 1], GL_QUERY_RESULT, &end);
+    addSample(frame.names[i], (end - begin) / 1.0e6);
+    _trace.push_back({
+      frame.names[i], frame.index,
+      int64_t(begin) + frame.clock_offset, int64_t(end) + frame.clock_offset });
+  }
+  while (!_trace.empty() && frame.index - _trace.front().frame >= unsigned(_window))
+    _trace.pop_front();
+  frame.pending = false;
+  return true;
+}
+
+void GpuProfiler::addSample(const std::string& name, double milliseconds)
+{
+  size_t i = 0;
+  while (i < _statistics.size() && _statistics[i].name != name)
+    i++;
+  if (i == _statistics.size())
+  {
+    _statistics.push_back({ name, 0.0, 0.0, 0.0, 0.0, 0 });
+    _samples.emplace_back();
+  }
+
+  std::deque<double>& samples = _samples[i];
+  samples.push_back(milliseconds);
+  if (samples.size() > size_t(_window))
+    samples.pop_front();
+
+  PassStatistics& statistics = _statistics[i];
+  statistics.last = milliseconds;
+  statistics.min = *std::min_element(samples.begin(), samples.end());
+  statistics.max = *std::max_element(samples.begin(), samples.end());
+  double sum = 0.0;
+  for (double sample : samples)
+    sum += sample;
+  statistics.average = sum / samples.size();
+  statistics.number_of_samples = samples.size();
+}
+
+void GpuProfiler::printStatistics() const
+{
+  for (const auto& pass : _statistics)
+  {
+    printf("%s : %.3f ms average %.3f min %.3f max %.3f over %d frames\n",
+      pass.name.c_str(), pass.last, pass.average, pass.min, pass.max,
+      pass.number_of_samples);
+  }
+}
+
+bool GpuProfiler::writeChromeTrace(const std::string& path) const
+{
+  std::ofstream file(path);
+  if (!file)
+  {
+    fprintf(stderr, "ERROR : Could not write GPU trace %s\n", path.c_str());
+    return false;
+  }
+
+  // Microseconds from the first event
+  const int64_t start = _trace.empty() ? 0 : _trace.front().begin;
+  file << "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+  CpuProfiler::writeThreadName(file, 1, "GPU");
+  writeTraceEvents(file, 1, start);
+  file << "\n]}\n";
+  return bool(file);
+}
+
+void GpuProfiler::writeTraceEvents(std::ostream& file, int thread, int64_t start) const
+{
+  for (const auto& event : _trace)
+  {
+    file << ",\n";
+    CpuProfiler::writeTraceEvent(file, event.name.c_str(), "gpu", thread,
+      start, event.begin, event.end, event.frame);
+  }
+}
+
+void GpuProfiler::reset()
+{
+  _statistics.clear();
+  _samples.clear();
+  _trace.clear();
+}
+
+} }
@@ -0,0 +1,65 @@
+#include "elk/core/gpu_timer.h"
+
+namespace elk { namespace core {
+
+GpuTimer::GpuTimer() :
+  _next_index(0),
+  _next_query(0),
+  _pending_queries(0),
+  _elapsed_milliseconds(-1.0)
+{
+  glGenQueries(number_of_queries, _queries.data());
+}
+
+GpuTimer::~GpuTimer()
+{
+  glDeleteQueries(number_of_queries, _queries.data());
+}
+
+void GpuTimer::begin()
+{
+  // All queries in flight, drop the oldest result rather than waiting for it
+  if (_pending_queries == number_of_queries)
+    _pending_queries--;
+  _indices[_next_query] = _next_index++;
+  glBeginQuery(GL_TIME_ELAPSED, _queries[_next_query]);
+}
+
+void GpuTimer::end()
+{
+  glEndQuery(GL_TIME_ELAPSED);
+  _next_query = (_next_query + 1) % number_of_queries;
+  _pending_queries++;
+}
+
+bool GpuTimer::poll()
+{
+  bool new_result = false;
+  while (_pending_queries > 0)
+  {
+    int oldest =
+      (_next_query - _pending_queries + number_of_queries) % number_of_queries;
+    GLint available = GL_FALSE;
+    glGetQueryObjectiv(_queries[oldest], GL_QUERY_RESULT_AVAILABLE, &available);
+    if (!available)
+      break;
+    GLuint64 nanoseconds;
+    glGetQueryObjectui64v(_queries[oldest], GL_QUERY_RESULT, &nanoseconds);
+    _elapsed_milliseconds = nanoseconds / 1.0e6;
+    if (_results.size() == max_results)
+      _results.erase(_results.begin());
+    _results.push_back({ _indices[oldest], _elapsed_milliseconds });
+    _pending_queries--;
+    new_result = true;
+  }
+  return new_result;
+}
+
+std::vector<GpuTimer::Result> GpuTimer::takeResults()
+{
+  std::vector<Result> results;
+  results.swap(_results);
+  return results;
+}
+
+} }
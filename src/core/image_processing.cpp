@@ -0,0 +1,815 @@
+#include "elk/core/image_processing.h"
+#include "elk/core/cpu_profiler.h"
+#include "elk/core/parallel_for.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+
+#if (defined(__GNUC__) || defined(__clang__)) && \
+    (defined(__x86_64__) || defined(__i386__))
+  #define ELK_X86_SIMD
+  #include <immintrin.h>
+#endif
+
+namespace elk { namespace core {
+
+namespace {
+
+void swizzleBGRAToRGBAScalar(
+  const GLubyte* source, GLubyte* destination, size_t number_of_pixels)
+{
+  for (size_t i = 0; i < number_of_pixels; ++i)
+  {
+    uint32_t p;
+    std::memcpy(&p, source + i * 4, 4);
+    // Swap the bytes of the red and blue channels
+    p = (p & 0xFF00FF00) | ((p >> 16) & 0xFF) | ((p & 0xFF) << 16);
+    std::memcpy(destination + i * 4, &p, 4);
+  }
+}
+
+#ifdef ELK_X86_SIMD
+__attribute__((target("ssse3")))
+size_t swizzleBGRAToRGBASSSE3(
+  const GLubyte* source, GLubyte* destination, size_t number_of_pixels)
+{
+  const __m128i mask = _mm_setr_epi8(
+    2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  size_t i = 0;
+  for (; i + 4 <= number_of_pixels; i += 4)
+  {
+    __m128i p = _mm_loadu_si128(reinterpret_cast<const __m128i*>(source + i * 4));
+    _mm_storeu_si128(
+      reinterpret_cast<__m128i*>(destination + i * 4), _mm_shuffle_epi8(p, mask));
+  }
+  return i;
+}
+
+__attribute__((target("avx2")))
+size_t swizzleBGRAToRGBAAVX2(
+  const GLubyte* source, GLubyte* destination, size_t number_of_pixels)
+{
+  // The shuffle works within each 128 bit lane so the mask is repeated
+  const __m256i mask = _mm256_setr_epi8(
+    2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15,
+    2, 1, 0, 3, 6, 5, 4, 7, 10, 9, 8, 11, 14, 13, 12, 15);
+  size_t i = 0;
+  for (; i + 8 <= number_of_pixels; i += 8)
+  {
+    __m256i p = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(source + i * 4));
+    _mm256_storeu_si256(
+      reinterpret_cast<__m256i*>(destination + i * 4), _mm256_shuffle_epi8(p, mask));
+  }
+  return i;
+}
+#endif
+
+// Lookup tables for converting between sRGB and linear color
+const std::array<float, 256>& sRGBToLinearTable()
+{
+  static const std::array<float, 256> table = []
+  {
+    std::array<float, 256> t;
+    for (int i = 0; i < 256; ++i)
+    {
+      float c = i / 255.0f;
+      t[i] = c <= 0.04045f ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+    }
+    return t;
+  }();
+  return table;
+}
+
+const int linear_to_sRGB_table_size = 4096;
+
+const std::array<GLubyte, linear_to_sRGB_table_size>& linearToSRGBTable()
+{
+  static const std::array<GLubyte, linear_to_sRGB_table_size> table = []
+  {
+    std::array<GLubyte, linear_to_sRGB_table_size> t;
+    for (int i = 0; i < linear_to_sRGB_table_size; ++i)
+    {
+      float c = i / float(linear_to_sRGB_table_size - 1);
+      c = c <= 0.0031308f ? c * 12.92f : 1.055f * std::pow(c, 1.0f / 2.4f) - 0.055f;
+      t[i] = static_cast<GLubyte>(c * 255.0f + 0.5f);
+    }
+    return t;
+  }();
+  return table;
+}
+
+// Zeroth order modified Bessel function of the first kind
+float besselI0(float x)
+{
+  float sum = 1.0f;
+  float term = 1.0f;
+  for (int k = 1; k < 16; ++k)
+  {
+    term *= (x / (2.0f * k)) * (x / (2.0f * k));
+    sum += term;
+  }
+  return sum;
+}
+
+// Weights for resampling one axis from source_size to destination_size
+struct FilterTaps
+{
+  int max_taps;
+  std::vector<int> first;
+  std::vector<float> weights; // destination_size * max_taps
+};
+
+FilterTaps computeFilterTaps(int source_size, int destination_size, MipMapFilter filter)
+{
+  const float alpha = 4.0f;
+  // Support given in destination texels
+  const float support = filter == MipMapFilter::Box ? 0.5f : 1.5f;
+  float scale = float(source_size) / destination_size;
+
+  FilterTaps taps;
+  taps.max_taps = static_cast<int>(std::ceil(2.0f * support * scale)) + 1;
+  taps.first.resize(destination_size);
+  taps.weights.assign(destination_size * taps.max_taps, 0.0f);
+
+  for (int i = 0; i < destination_size; ++i)
+  {
+    float center = (i + 0.5f) * scale - 0.5f;
+    int first = static_cast<int>(std::ceil(center - support * scale));
+    float* weights = &taps.weights[i * taps.max_taps];
+    float sum = 0.0f;
+    for (int t = 0; t < taps.max_taps; ++t)
+    {
+      float x = (first + t - center) / scale;
+      float w = 0.0f;
+      if (std::abs(x) < support)
+      {
+        if (filter == MipMapFilter::Box)
+        {
+          w = 1.0f;
+        }
+        else
+        {
+          float sinc = x == 0.0f ? 1.0f : std::sin(M_PI * x) / (M_PI * x);
+          float r = x / support;
+          w = sinc * besselI0(alpha * std::sqrt(1.0f - r * r)) / besselI0(alpha);
+        }
+      }
+      weights[t] = w;
+      sum += w;
+    }
+    for (int t = 0; t < taps.max_taps; ++t)
+    {
+      weights[t] /= sum;
+    }
+    taps.first[i] = first;
+  }
+  return taps;
+}
+
+// Separable downsampling of an RGBA image. read_row(y, row) writes source row
+// y as linear floating point RGBA to row.
+template <typename ReadRow>
+std::vector<float> downsample(
+  const ReadRow& read_row, glm::uvec2 source_size,
+  glm::uvec2 destination_size, MipMapFilter filter)
+{
+  FilterTaps taps_x = computeFilterTaps(source_size.x, destination_size.x, filter);
+  FilterTaps taps_y = computeFilterTaps(source_size.y, destination_size.y, filter);
+  std::vector<float> horizontal(destination_size.x * source_size.y * 4);
+  std::vector<float> destination(destination_size.x * destination_size.y * 4);
+
+  parallelFor(source_size.y, [&](int begin, int end)
+  {
+    std::vector<float> row(source_size.x * 4);
+    for (int y = begin; y < end; ++y)
+    {
+      read_row(y, row.data());
+      for (int x = 0; x < destination_size.x; ++x)
+      {
+        float sum[4] = {0.0f, 0.0f, 0.0f, 0.0f};
+        const float* weights = &taps_x.weights[x * taps_x.max_taps];
+        for (int t = 0; t < taps_x.max_taps; ++t)
+        {
+          int sx = glm::clamp(taps_x.first[x] + t, 0, int(source_size.x) - 1);
+          for (int c = 0; c < 4; ++c)
+            sum[c] += row[sx * 4 + c] * weights[t];
+        }
+        std::memcpy(&horizontal[(y * destination_size.x + x) * 4], sum, sizeof(sum));
+      }
+    }
+  });
+
+  parallelFor(destination_size.y, [&](int begin, int end)
+  {
+    for (int y = begin; y < end; ++y)
+    {
+      const float* weights = &taps_y.weights[y * taps_y.max_taps];
+      float* row = &destination[y * destination_size.x * 4];
+      for (int t = 0; t < taps_y.max_taps; ++t)
+      {
+        int sy = glm::clamp(taps_y.first[y] + t, 0, int(source_size.y) - 1);
+        const float* source_row = &horizontal[sy * destination_size.x * 4];
+        for (int i = 0; i < destination_size.x * 4; ++i)
+          row[i] += source_row[i] * weights[t];
+      }
+    }
+  });
+  return destination;
+}
+
+
+// Direction through texel coordinates s, t in [-1, 1] of a cube map face.
+// Orientations as in the OpenGL specification.
+glm::vec3 cubeMapDirection(int face, float s, float t)
+{
+  switch (face)
+  {
+    case 0: return glm::vec3(1.0f, -t, -s);
+    case 1: return glm::vec3(-1.0f, -t, s);
+    case 2: return glm::vec3(s, 1.0f, t);
+    case 3: return glm::vec3(s, -1.0f, -t);
+    case 4: return glm::vec3(s, -t, 1.0f);
+    default: return glm::vec3(-s, -t, -1.0f);
+  }
+}
+
+// Texels of one cube map row as structure of arrays
+struct SphericalHarmonicsRow
+{
+  std::vector<float> x, y, z; // Normalized direction
+  std::vector<float> weight; // Solid angle up to a constant factor
+  std::vector<float> r, g, b;
+};
+
+void sphericalHarmonicsBasis(float x, float y, float z, float* basis)
+{
+  basis[0] = 0.282095f;
+  basis[1] = 0.488603f * y;
+  basis[2] = 0.488603f * z;
+  basis[3] = 0.488603f * x;
+  basis[4] = 1.092548f * x * y;
+  basis[5] = 1.092548f * y * z;
+  basis[6] = 0.315392f * (3.0f * z * z - 1.0f);
+  basis[7] = 1.092548f * x * z;
+  basis[8] = 0.546274f * (x * x - y * y);
+}
+
+// Adds the texels in [begin, end) to sums, three channels per coefficient
+void accumulateSphericalHarmonicsScalar(
+  const SphericalHarmonicsRow& row, size_t begin, size_t end, float* sums)
+{
+  for (size_t i = begin; i < end; ++i)
+  {
+    float basis[9];
+    sphericalHarmonicsBasis(row.x[i], row.y[i], row.z[i], basis);
+    for (int k = 0; k < 9; ++k)
+    {
+      float weighted = basis[k] * row.weight[i];
+      sums[k * 3 + 0] += weighted * row.r[i];
+      sums[k * 3 + 1] += weighted * row.g[i];
+      sums[k * 3 + 2] += weighted * row.b[i];
+    }
+  }
+}
+
+#ifdef ELK_X86_SIMD
+__attribute__((target("sse2")))
+size_t accumulateSphericalHarmonicsSSE2(
+  const SphericalHarmonicsRow& row, size_t n, float* sums)
+{
+  __m128 accumulators[27];
+  for (auto& accumulator : accumulators)
+    accumulator = _mm_setzero_ps();
+
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+  {
+    __m128 x = _mm_loadu_ps(&row.x[i]);
+    __m128 y = _mm_loadu_ps(&row.y[i]);
+    __m128 z = _mm_loadu_ps(&row.z[i]);
+    __m128 weight = _mm_loadu_ps(&row.weight[i]);
+    __m128 color[3] = {
+      _mm_loadu_ps(&row.r[i]), _mm_loadu_ps(&row.g[i]), _mm_loadu_ps(&row.b[i]) };
+
+    __m128 basis[9];
+    basis[0] = _mm_set1_ps(0.282095f);
+    basis[1] = _mm_mul_ps(_mm_set1_ps(0.488603f), y);
+    basis[2] = _mm_mul_ps(_mm_set1_ps(0.488603f), z);
+    basis[3] = _mm_mul_ps(_mm_set1_ps(0.488603f), x);
+    basis[4] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(x, y));
+    basis[5] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(y, z));
+    basis[6] = _mm_mul_ps(_mm_set1_ps(0.315392f), _mm_sub_ps(
+      _mm_mul_ps(_mm_set1_ps(3.0f), _mm_mul_ps(z, z)), _mm_set1_ps(1.0f)));
+    basis[7] = _mm_mul_ps(_mm_set1_ps(1.092548f), _mm_mul_ps(x, z));
+    basis[8] = _mm_mul_ps(_mm_set1_ps(0.546274f), _mm_sub_ps(
+      _mm_mul_ps(x, x), _mm_mul_ps(y, y)));
+
+    for (int k = 0; k < 9; ++k)
+    {
+      __m128 weighted = _mm_mul_ps(basis[k], weight);
+      for (int c = 0; c < 3; ++c)
+      {
+        accumulators[k * 3 + c] = _mm_add_ps(
+          accumulators[k * 3 + c], _mm_mul_ps(weighted, color[c]));
+      }
+    }
+  }
+
+  for (int k = 0; k < 27; ++k)
+  {
+    float lanes[4];
+    _mm_storeu_ps(lanes, accumulators[k]);
+    sums[k] += lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  }
+  return i;
+}
+#endif
+
+
+// True if the faces of cube_map are in memory in a format the CPU functions
+// read, prints an error otherwise
+bool readableOnCPU(const CubeMapTexture& cube_map)
+{
+  const GLenum data_type = cube_map.dataType();
+  if ((data_type != GL_UNSIGNED_BYTE && data_type != GL_FLOAT) ||
+      cube_map.numberOfChannels() < 3)
+  {
+    fprintf(stderr,
+      "ERROR : Cube map needs 8 bit or float RGB data to be processed on the CPU\n");
+    return false;
+  }
+  for (int face = 0; face < 6; ++face)
+  {
+    if (!cube_map.faceData(face))
+    {
+      fprintf(stderr, "ERROR : Cube map face %d has no pixel data\n", face);
+      return false;
+    }
+  }
+  return true;
+}
+
+// Face and texel coordinates s, t in [0, 1] that direction points at
+int cubeMapFace(glm::vec3 direction, glm::vec2& st)
+{
+  glm::vec3 a = glm::abs(direction);
+  int face;
+  glm::vec2 sc_tc;
+  float major;
+  if (a.x >= a.y && a.x >= a.z)
+  {
+    face = direction.x > 0.0f ? 0 : 1;
+    sc_tc = glm::vec2(direction.x > 0.0f ? -direction.z : direction.z, -direction.y);
+    major = a.x;
+  }
+  else if (a.y >= a.z)
+  {
+    face = direction.y > 0.0f ? 2 : 3;
+    sc_tc = glm::vec2(direction.x, direction.y > 0.0f ? direction.z : -direction.z);
+    major = a.y;
+  }
+  else
+  {
+    face = direction.z > 0.0f ? 4 : 5;
+    sc_tc = glm::vec2(direction.z > 0.0f ? direction.x : -direction.x, -direction.y);
+    major = a.z;
+  }
+  st = (sc_tc / major + 1.0f) * 0.5f;
+  return face;
+}
+
+// Box filtered mip chain of a cube map down to a side of one texel
+CubeMapLevels cubeMapPyramid(const CubeMapTexture& cube_map)
+{
+  const int side = cube_map.size();
+  const int channels = cube_map.numberOfChannels();
+  CubeMapLevels levels(1);
+  for (int face = 0; face < 6; ++face)
+  {
+    std::vector<float>& pixels = levels[0][face];
+    pixels.resize(side * side * 4);
+    for (int i = 0; i < side * side; ++i)
+    {
+      for (int c = 0; c < 4; ++c)
+      {
+        float value = 1.0f;
+        if (c < channels && cube_map.dataType() == GL_UNSIGNED_BYTE)
+          value = static_cast<const GLubyte*>(cube_map.faceData(face))[i * channels + c] / 255.0f;
+        else if (c < channels)
+          value = static_cast<const float*>(cube_map.faceData(face))[i * channels + c];
+        pixels[i * 4 + c] = value;
+      }
+    }
+  }
+  for (int level_side = side / 2; level_side >= 1; level_side /= 2)
+  {
+    const int source_side = level_side * 2;
+    const auto& source = levels.back();
+    std::array<std::vector<float>, 6> level;
+    for (int face = 0; face < 6; ++face)
+    {
+      level[face].resize(level_side * level_side * 4);
+      for (int y = 0; y < level_side; ++y)
+        for (int x = 0; x < level_side; ++x)
+          for (int c = 0; c < 4; ++c)
+          {
+            const std::vector<float>& s = source[face];
+            level[face][(y * level_side + x) * 4 + c] = 0.25f * (
+              s[((2 * y) * source_side + 2 * x) * 4 + c] +
+              s[((2 * y) * source_side + 2 * x + 1) * 4 + c] +
+              s[((2 * y + 1) * source_side + 2 * x) * 4 + c] +
+              s[((2 * y + 1) * source_side + 2 * x + 1) * 4 + c]);
+          }
+    }
+    levels.push_back(std::move(level));
+  }
+  return levels;
+}
+
+// Bilinear lookup within one face, clamped at the edges
+glm::vec3 sampleCubeMapLevel(
+  const CubeMapLevels& levels, int side, int level, glm::vec3 direction)
+{
+  glm::vec2 st;
+  int face = cubeMapFace(direction, st);
+  int level_side = std::max(side >> level, 1);
+  glm::vec2 coordinate = st * float(level_side) - 0.5f;
+  glm::ivec2 p0 = glm::ivec2(glm::floor(coordinate));
+  glm::vec2 f = coordinate - glm::vec2(p0);
+  const std::vector<float>& pixels = levels[level][face];
+  glm::vec3 result(0.0f);
+  for (int i = 0; i < 4; ++i)
+  {
+    glm::ivec2 offset(i & 1, i >> 1);
+    glm::ivec2 p = glm::clamp(p0 + offset, glm::ivec2(0), glm::ivec2(level_side - 1));
+    float weight =
+      (offset.x ? f.x : 1.0f - f.x) * (offset.y ? f.y : 1.0f - f.y);
+    const float* texel = &pixels[(p.y * level_side + p.x) * 4];
+    result += glm::vec3(texel[0], texel[1], texel[2]) * weight;
+  }
+  return result;
+}
+
+// Trilinear lookup
+glm::vec3 sampleCubeMap(
+  const CubeMapLevels& levels, int side, glm::vec3 direction, float lod)
+{
+  lod = glm::clamp(lod, 0.0f, float(levels.size() - 1));
+  int level = static_cast<int>(lod);
+  int next_level = std::min(level + 1, int(levels.size()) - 1);
+  glm::vec3 a = sampleCubeMapLevel(levels, side, level, direction);
+  glm::vec3 b = sampleCubeMapLevel(levels, side, next_level, direction);
+  return a + (b - a) * (lod - level);
+}
+
+glm::vec2 hammersley(uint32_t i, uint32_t n)
+{
+  uint32_t bits = i;
+  bits = (bits << 16u) | (bits >> 16u);
+  bits = ((bits & 0x55555555u) << 1u) | ((bits & 0xAAAAAAAAu) >> 1u);
+  bits = ((bits & 0x33333333u) << 2u) | ((bits & 0xCCCCCCCCu) >> 2u);
+  bits = ((bits & 0x0F0F0F0Fu) << 4u) | ((bits & 0xF0F0F0F0u) >> 4u);
+  bits = ((bits & 0x00FF00FFu) << 8u) | ((bits & 0xFF00FF00u) >> 8u);
+  return glm::vec2(float(i) / n, bits * 2.3283064365386963e-10f);
+}
+
+// Half vector around +z distributed as GGX with alpha = roughness^2
+glm::vec3 importanceSampleGGX(glm::vec2 xi, float roughness)
+{
+  float a = roughness * roughness;
+  float phi = 2.0f * M_PI * xi.x;
+  float cos_theta = std::sqrt((1.0f - xi.y) / (1.0f + (a * a - 1.0f) * xi.y));
+  float sin_theta = std::sqrt(1.0f - cos_theta * cos_theta);
+  return glm::vec3(sin_theta * std::cos(phi), sin_theta * std::sin(phi), cos_theta);
+}
+
+// Light direction of a GGX sample in the tangent space of the normal and the
+// mip level to sample so that the samples together cover the lobe
+struct PrefilterSample
+{
+  glm::vec3 direction;
+  float n_dot_l;
+  float lod;
+};
+
+std::vector<PrefilterSample> prefilterSamples(
+  float roughness, int number_of_samples, int source_side)
+{
+  std::vector<PrefilterSample> samples;
+  const float a2 = std::pow(roughness, 4.0f);
+  const float texel_solid_angle = 4.0f * M_PI / (6.0f * source_side * source_side);
+  for (int i = 0; i < number_of_samples; ++i)
+  {
+    glm::vec3 h = importanceSampleGGX(hammersley(i, number_of_samples), roughness);
+    // The view direction is the normal
+    glm::vec3 l = 2.0f * h.z * h - glm::vec3(0.0f, 0.0f, 1.0f);
+    if (l.z <= 0.0f)
+      continue;
+    float d = a2 / (M_PI * std::pow(h.z * h.z * (a2 - 1.0f) + 1.0f, 2.0f));
+    float pdf = d / 4.0f;
+    float sample_solid_angle = 1.0f / (number_of_samples * pdf + 1e-6f);
+    float lod = std::max(
+      0.5f * std::log2(sample_solid_angle / texel_solid_angle) + 1.0f, 0.0f);
+    samples.push_back({ l, l.z, lod });
+  }
+  return samples;
+}
+
+} // namespace
+
+void swizzleBGRAToRGBA(
+  const GLubyte* source, GLubyte* destination, size_t number_of_pixels)
+{
+  size_t done = 0;
+#ifdef ELK_X86_SIMD
+  if (__builtin_cpu_supports("avx2"))
+    done = swizzleBGRAToRGBAAVX2(source, destination, number_of_pixels);
+  else if (__builtin_cpu_supports("ssse3"))
+    done = swizzleBGRAToRGBASSSE3(source, destination, number_of_pixels);
+#endif
+  // Remaining pixels
+  swizzleBGRAToRGBAScalar(
+    source + done * 4, destination + done * 4, number_of_pixels - done);
+}
+
+std::vector<GLubyte*> generateMipMapChain(
+  const GLubyte* pixels, glm::uvec2 size, MipMapFilter filter,
+  ColorSpace color_space)
+{
+  ELK_PROFILE_ZONE("generateMipMapChain");
+  const auto& to_linear = sRGBToLinearTable();
+  const auto& to_sRGB = linearToSRGBTable();
+  const bool srgb = color_space == ColorSpace::sRGB;
+
+  // The first level is decoded to linear floating point one row at a time,
+  // the following levels are filtered from the unquantized previous level
+  auto read_base_row = [&](int y, float* row)
+  {
+    const GLubyte* source_row = pixels + y * size.x * 4;
+    for (int i = 0; i < size.x * 4; ++i)
+    {
+      bool color_channel = (i % 4) != 3;
+      row[i] = srgb && color_channel ?
+        to_linear[source_row[i]] : source_row[i] / 255.0f;
+    }
+  };
+
+  std::vector<float> level;
+  std::vector<GLubyte*> mip_maps;
+  while (size.x > 1 || size.y > 1)
+  {
+    glm::uvec2 next_size(std::max(size.x / 2, 1u), std::max(size.y / 2, 1u));
+    if (mip_maps.empty())
+    {
+      level = downsample(read_base_row, size, next_size, filter);
+    }
+    else
+    {
+      const std::vector<float>& previous = level;
+      const int row_size = size.x * 4;
+      level = downsample([&](int y, float* row)
+      {
+        std::memcpy(row, &previous[y * row_size], row_size * sizeof(float));
+      }, size, next_size, filter);
+    }
+    size = next_size;
+
+    GLubyte* encoded = new GLubyte[size.x * size.y * 4];
+    parallelFor(size.y, [&](int begin, int end)
+    {
+      for (size_t i = begin * size.x * 4; i < end * size.x * 4; ++i)
+      {
+        // Kaiser filtering can over- and undershoot
+        float value = glm::clamp(level[i], 0.0f, 1.0f);
+        bool color_channel = (i % 4) != 3;
+        encoded[i] = srgb && color_channel ?
+          to_sRGB[static_cast<int>(value * (linear_to_sRGB_table_size - 1) + 0.5f)] :
+          static_cast<GLubyte>(value * 255.0f + 0.5f);
+      }
+    });
+    mip_maps.push_back(encoded);
+  }
+  return mip_maps;
+}
+
+SphericalHarmonics9 projectOnSphericalHarmonics(const CubeMapTexture& cube_map)
+{
+  SphericalHarmonics9 coefficients;
+  coefficients.fill(glm::vec3(0.0f));
+
+  if (!readableOnCPU(cube_map))
+    return coefficients;
+  const int side = cube_map.size();
+  const int channels = cube_map.numberOfChannels();
+  const GLenum data_type = cube_map.dataType();
+
+  std::array<float, 27> sums;
+  sums.fill(0.0f);
+  float total_weight = 0.0f;
+  std::mutex sums_mutex;
+#ifdef ELK_X86_SIMD
+  const bool sse2 = __builtin_cpu_supports("sse2");
+#endif
+
+  parallelFor(6 * side, [&](int begin, int end)
+  {
+    SphericalHarmonicsRow row;
+    for (auto* values : { &row.x, &row.y, &row.z, &row.weight, &row.r, &row.g, &row.b })
+      values->resize(side);
+    std::array<float, 27> partial_sums;
+    partial_sums.fill(0.0f);
+    float partial_weight = 0.0f;
+
+    for (int row_index = begin; row_index < end; ++row_index)
+    {
+      const int face = row_index / side;
+      const int y = row_index % side;
+      const float t = 2.0f * (y + 0.5f) / side - 1.0f;
+      const size_t first = size_t(y) * side * channels;
+      const GLubyte* bytes = static_cast<const GLubyte*>(cube_map.faceData(face)) + first;
+      const float* floats = static_cast<const float*>(cube_map.faceData(face)) + first;
+
+      for (int x = 0; x < side; ++x)
+      {
+        const float s = 2.0f * (x + 0.5f) / side - 1.0f;
+        glm::vec3 direction = cubeMapDirection(face, s, t);
+        // The solid angle of a texel falls with the cube of the distance
+        float length_squared = glm::dot(direction, direction);
+        float length = std::sqrt(length_squared);
+        direction /= length;
+        row.x[x] = direction.x;
+        row.y[x] = direction.y;
+        row.z[x] = direction.z;
+        row.weight[x] = 1.0f / (length_squared * length);
+        partial_weight += row.weight[x];
+
+        if (data_type == GL_UNSIGNED_BYTE)
+        {
+          row.r[x] = bytes[x * channels + 0] / 255.0f;
+          row.g[x] = bytes[x * channels + 1] / 255.0f;
+          row.b[x] = bytes[x * channels + 2] / 255.0f;
+        }
+        else
+        {
+          row.r[x] = floats[x * channels + 0];
+          row.g[x] = floats[x * channels + 1];
+          row.b[x] = floats[x * channels + 2];
+        }
+      }
+
+      size_t done = 0;
+#ifdef ELK_X86_SIMD
+      if (sse2)
+        done = accumulateSphericalHarmonicsSSE2(row, side, partial_sums.data());
+#endif
+      // Remaining texels
+      accumulateSphericalHarmonicsScalar(row, done, side, partial_sums.data());
+    }
+
+    std::lock_guard<std::mutex> lock(sums_mutex);
+    for (int i = 0; i < 27; ++i)
+      sums[i] += partial_sums[i];
+    total_weight += partial_weight;
+  });
+
+  // Scale the weights to sum up to the solid angle of the sphere
+  const float normalization = 4.0f * M_PI / total_weight;
+  for (int k = 0; k < 9; ++k)
+  {
+    coefficients[k] =
+      glm::vec3(sums[k * 3 + 0], sums[k * 3 + 1], sums[k * 3 + 2]) * normalization;
+  }
+  return coefficients;
+}
+
+SphericalHarmonics9 diffuseReflection(const SphericalHarmonics9& radiance)
+{
+  // Coefficients of the clamped cosine divided by pi for band 0, 1 and 2.
+  // Ramamoorthi and Hanrahan, An Efficient Representation for Irradiance
+  // Environment Maps.
+  const float band_factors[] = { 1.0f, 2.0f / 3.0f, 1.0f / 4.0f };
+  SphericalHarmonics9 reflected;
+  for (int k = 0; k < 9; ++k)
+  {
+    int band = k == 0 ? 0 : (k < 4 ? 1 : 2);
+    reflected[k] = radiance[k] * band_factors[band];
+  }
+  return reflected;
+}
+
+CubeMapLevels prefilterGGX(
+  const CubeMapTexture& cube_map, int side, int levels, int number_of_samples)
+{
+  CubeMapLevels prefiltered;
+  if (!readableOnCPU(cube_map))
+    return prefiltered;
+
+  const int source_side = cube_map.size();
+  const CubeMapLevels source = cubeMapPyramid(cube_map);
+  for (int level = 0; level < levels; ++level)
+  {
+    const int level_side = std::max(side >> level, 1);
+    const float roughness = levels > 1 ? float(level) / (levels - 1) : 0.0f;
+    const std::vector<PrefilterSample> samples =
+      prefilterSamples(roughness, number_of_samples, source_side);
+    // A mirror samples the source at the resolution of the level
+    const float mirror_lod = std::log2(float(source_side) / level_side);
+
+    std::array<std::vector<float>, 6> faces;
+    for (auto& face : faces)
+      face.resize(level_side * level_side * 4);
+
+    parallelFor(6 * level_side, [&](int begin, int end)
+    {
+      for (int row = begin; row < end; ++row)
+      {
+        const int face = row / level_side;
+        const int y = row % level_side;
+        const float t = 2.0f * (y + 0.5f) / level_side - 1.0f;
+        for (int x = 0; x < level_side; ++x)
+        {
+          const float s = 2.0f * (x + 0.5f) / level_side - 1.0f;
+          glm::vec3 n = glm::normalize(cubeMapDirection(face, s, t));
+          glm::vec3 radiance(0.0f);
+          if (roughness == 0.0f)
+          {
+            radiance = sampleCubeMap(source, source_side, n, mirror_lod);
+          }
+          else
+          {
+            glm::vec3 up = std::abs(n.z) < 0.999f ?
+              glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(1.0f, 0.0f, 0.0f);
+            glm::vec3 tangent = glm::normalize(glm::cross(up, n));
+            glm::vec3 bitangent = glm::cross(n, tangent);
+            float weight = 0.0f;
+            for (const auto& sample : samples)
+            {
+              glm::vec3 l =
+                tangent * sample.direction.x +
+                bitangent * sample.direction.y +
+                n * sample.direction.z;
+              radiance +=
+                sampleCubeMap(source, source_side, l, sample.lod) * sample.n_dot_l;
+              weight += sample.n_dot_l;
+            }
+            radiance /= std::max(weight, 1e-6f);
+          }
+          float* texel = &faces[face][(y * level_side + x) * 4];
+          texel[0] = radiance.r;
+          texel[1] = radiance.g;
+          texel[2] = radiance.b;
+          texel[3] = 1.0f;
+        }
+      }
+    });
+    prefiltered.push_back(std::move(faces));
+  }
+  return prefiltered;
+}
+
+std::vector<float> integrateSpecularBRDF(int size, int number_of_samples)
+{
+  std::vector<float> table(size * size * 2);
+  parallelFor(size, [&](int begin, int end)
+  {
+    for (int y = begin; y < end; ++y)
+    {
+      const float roughness = (y + 0.5f) / size;
+      // Schlick-Smith geometry term with k = alpha / 2 for image based lighting
+      const float k = roughness * roughness / 2.0f;
+      for (int x = 0; x < size; ++x)
+      {
+        const float n_dot_v = (x + 0.5f) / size;
+        const glm::vec3 v(std::sqrt(1.0f - n_dot_v * n_dot_v), 0.0f, n_dot_v);
+        float scale = 0.0f;
+        float bias = 0.0f;
+        for (int i = 0; i < number_of_samples; ++i)
+        {
+          glm::vec3 h = importanceSampleGGX(hammersley(i, number_of_samples), roughness);
+          float v_dot_h = glm::dot(v, h);
+          glm::vec3 l = 2.0f * v_dot_h * h - v;
+          float n_dot_l = l.z;
+          if (n_dot_l <= 0.0f)
+            continue;
+          v_dot_h = std::max(v_dot_h, 0.0f);
+          float g =
+            (n_dot_v / (n_dot_v * (1.0f - k) + k)) *
+            (n_dot_l / (n_dot_l * (1.0f - k) + k));
+          float g_visible = g * v_dot_h / (h.z * n_dot_v);
+          float fresnel = std::pow(1.0f - v_dot_h, 5.0f);
+          scale += (1.0f - fresnel) * g_visible;
+          bias += fresnel * g_visible;
+        }
+        table[(y * size + x) * 2 + 0] = scale / number_of_samples;
+        table[(y * size + x) * 2 + 1] = bias / number_of_samples;
+      }
+    }
+  });
+  return table;
+}
+
+} }
@@ -1,11 +1,14 @@
 #include "elk/core/material.h"
 
+#include "elk/core/camera.h"
 #include "elk/core/create_texture.h"
 #include "elk/core/texture_unit.h"
+#include "elk/core/render_state.h"
 
 namespace elk { namespace core {
 
 std::shared_ptr<ShaderProgram> Material::_gbuffer_program = nullptr;
+Material::UniformLocations Material::_locations;
 
 Material::Material(
   std::shared_ptr<Texture> albedo_texture,
@@ -35,6 +38,16 @@ Material::Material(
       nullptr,
       nullptr,
       (std::string(ELK_DIR) + "/shaders/deferred_shading/geometry_pass.frag").c_str());
+
+    GLuint id = _gbuffer_program->id();
+    _locations.M = glGetUniformLocation(id, "M");
+    _locations.V = glGetUniformLocation(id, "V");
+    _locations.P = glGetUniformLocation(id, "P");
+    _locations.textures[0] = glGetUniformLocation(id, "albedo_texture");
+    _locations.textures[1] = glGetUniformLocation(id, "roughness_texture");
+    _locations.textures[2] = glGetUniformLocation(id, "R0_texture");
+    _locations.textures[3] = glGetUniformLocation(id, "metalness_texture");
+    _locations.textures[4] = glGetUniformLocation(id, "normal_texture");
   }
 }
 
@@ -45,7 +58,7 @@ Material::~Material()
 
 void Material::use()
 {
-  glUseProgram(_gbuffer_program->id());
+  RenderState::useProgram(_gbuffer_program->id());
 
   TextureUnit
     tex_unit_albedo,
@@ -73,4 +86,25 @@ void Material::use()
   glUniform1i(glGetUniformLocation(_gbuffer_program->id(), "normal_texture"),    tex_unit_normal);
 }
 
+void Material::record(CommandBuffer& commands, const glm::mat4& model,
+  const AbstractCamera& camera) const
+{
+  if (commands.bindProgram(_gbuffer_program->id()))
+  {
+    const glm::mat4 view = camera.viewTransform();
+    const glm::mat4 projection = camera.projectionTransform();
+    for (GLuint slot = 0; slot < 5; ++slot)
+      commands.setSampler(_locations.textures[slot], slot);
+    commands.setUniformMatrices(_locations.V, &view);
+    commands.setUniformMatrices(_locations.P, &projection);
+  }
+
+  commands.bindTexture(0, *_albedo_texture);
+  commands.bindTexture(1, *_roughness_texture);
+  commands.bindTexture(2, *_R0_texture);
+  commands.bindTexture(3, *_metalness_texture);
+  commands.bindTexture(4, *_normal_texture);
+  commands.setUniformMatrices(_locations.M, &model);
+}
+
 } }
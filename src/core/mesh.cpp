@@ -1,4 +1,5 @@
 #include "elk/core/mesh.h"
+#include "elk/core/render_state.h"
 
 namespace elk { namespace core {
 
@@ -95,15 +96,15 @@ void Mesh::render()
   _vao.disableAttribArrays();
 }
 
-glm::vec3 Mesh::computeMinPosition() const
+void Mesh::recordDraw(CommandBuffer& commands) const
 {
-  glm::vec3 max = _positions->at(0);
-  for (int i = 1; i < _positions->size(); i++)
-    max = glm::max(max, _positions->at(i));
-  return max;
+  const ArrayBuffer::InitData& elements = _element_buffer->initData();
+  commands.drawElements(
+    _vao.id(), _element_buffer->id(), _vao.attributeMask(),
+    elements.render_mode, elements.n_elements, elements.type);
 }
 
-glm::vec3 Mesh::computeMaxPosition() const
+glm::vec3 Mesh::computeMinPosition() const
 {
   glm::vec3 min = _positions->at(0);
   for (int i = 1; i < _positions->size(); i++)
@@ -111,6 +112,14 @@ glm::vec3 Mesh::computeMaxPosition() const
   return min;
 }
 
+glm::vec3 Mesh::computeMaxPosition() const
+{
+  glm::vec3 max = _positions->at(0);
+  for (int i = 1; i < _positions->size(); i++)
+    max = glm::max(max, _positions->at(i));
+  return max;
+}
+
 CPUPointCloud::CPUPointCloud(std::vector<glm::vec3>* positions) :
   Mesh(nullptr, positions, nullptr, nullptr, nullptr, nullptr,
     GL_POINTS, GL_DYNAMIC_DRAW)
@@ -122,7 +131,7 @@ void CPUPointCloud::render()
 {
   _vao.bind();
   _vao.enableAttribArrays();
-  glEnable(GL_VERTEX_PROGRAM_POINT_SIZE);
+  RenderState::enable(GL_VERTEX_PROGRAM_POINT_SIZE);
   _vao.getBuffer(0).render();
   _vao.disableAttribArrays();
 }
@@ -0,0 +1,74 @@
+#include "elk/core/mip_map_downsampler.h"
+
+#include "elk/core/create_mesh.h"
+#include "elk/core/render_state.h"
+#include "elk/core/texture_unit.h"
+
+#include <algorithm>
+
+namespace elk { namespace core {
+
+MipMapDownsampler::MipMapDownsampler() :
+  MipMapDownsampler("downsample_program",
+    std::string(ELK_DIR) + "/shaders/deferred_shading/downsample.frag")
+{
+
+}
+
+MipMapDownsampler::MipMapDownsampler(
+  const std::string& name, const std::string& fragment_shader)
+{
+  _program = std::make_unique<ShaderProgram>(
+    name,
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass.vert").c_str(),
+    nullptr,
+    nullptr,
+    nullptr,
+    fragment_shader.c_str());
+  _quad = CreateMesh::quad();
+}
+
+MipMapDownsampler::~MipMapDownsampler()
+{
+
+}
+
+void MipMapDownsampler::downsample(Texture& texture, int levels)
+{
+  levels = std::min(levels, texture.mipMapLevels());
+  if (levels <= 1)
+    return;
+
+  _program->pushUsage();
+  _fbo.bind();
+  RenderState::disable(GL_BLEND);
+  RenderState::disable(GL_DEPTH_TEST);
+
+  TextureUnit unit;
+  unit.activate();
+  texture.bind();
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "source"), unit);
+
+  glm::uvec3 size = texture.dimensions();
+  for (int level = 1; level < levels && size != glm::uvec3(1); ++level)
+  {
+    size = glm::max(size / 2u, glm::uvec3(1));
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, level - 1);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, level - 1);
+    glFramebufferTexture2D(
+      GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture.id(), level);
+    RenderState::viewport(0, 0, size.x, size.y);
+    glUniform2i(
+      glGetUniformLocation(ShaderProgram::currentProgramId(), "destination_size"),
+      size.x, size.y);
+    _quad->render();
+  }
+
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, texture.mipMapLevels() - 1);
+  _fbo.unbind();
+  _program->popUsage();
+}
+
+} }
@@ -4,8 +4,37 @@
 #include "elk/object_extensions/light_source.h"
 #include "elk/core/camera.h"
 
+#include <glm/gtc/quaternion.hpp>
+
 namespace elk { namespace core {
 
+namespace {
+
+// Blends translation, rotation and scale separately, shear is not kept
+glm::mat4 interpolateTransform(const glm::mat4& a, const glm::mat4& b, float alpha)
+{
+  const glm::vec3 scale_a(
+    glm::length(glm::vec3(a[0])), glm::length(glm::vec3(a[1])), glm::length(glm::vec3(a[2])));
+  const glm::vec3 scale_b(
+    glm::length(glm::vec3(b[0])), glm::length(glm::vec3(b[1])), glm::length(glm::vec3(b[2])));
+  const glm::quat rotation_a = glm::quat_cast(glm::mat3(
+    glm::vec3(a[0]) / scale_a.x, glm::vec3(a[1]) / scale_a.y, glm::vec3(a[2]) / scale_a.z));
+  const glm::quat rotation_b = glm::quat_cast(glm::mat3(
+    glm::vec3(b[0]) / scale_b.x, glm::vec3(b[1]) / scale_b.y, glm::vec3(b[2]) / scale_b.z));
+
+  glm::mat4 result = glm::mat4_cast(glm::slerp(rotation_a, rotation_b, alpha));
+  const glm::vec3 scale = glm::mix(scale_a, scale_b, alpha);
+  result[0] *= scale.x;
+  result[1] *= scale.y;
+  result[2] *= scale.z;
+  result[3] = glm::mix(a[3], b[3], alpha);
+  return result;
+}
+
+} // namespace
+
+unsigned int Object3D::_simulation_step = 0;
+
 void Object3D::addChild(Object3D& child)
 {
   _children.push_back(&child);
@@ -28,6 +57,19 @@ void Object3D::updateTransform(const glm::mat4& stacked_transform)
   }
 }
 
+void Object3D::updateTransform(const glm::mat4& stacked_transform, float alpha)
+{
+  const bool moved =
+    _simulation_step > 0 && _transform_step == _simulation_step &&
+    _previous_relative_transform != _relative_transform;
+  _absolute_transform = stacked_transform * (moved ?
+    interpolateTransform(_previous_relative_transform, _relative_transform, alpha) :
+    _relative_transform);
+  for (auto ch : _children) {
+    ch->updateTransform(_absolute_transform, alpha);
+  }
+}
+
 void Object3D::submit(Renderer& renderer)
 {
   for (auto ch : _children) {
@@ -54,6 +96,11 @@ const glm::mat4& Object3D::absoluteTransform() const
 
 void Object3D::setTransform(const glm::mat4& transform)
 {
+  if (_transform_step != _simulation_step)
+  {
+    _previous_relative_transform = _relative_transform;
+    _transform_step = _simulation_step;
+  }
   _relative_transform = transform;
 }
 
@@ -0,0 +1,127 @@
+#include "elk/core/point_light_volumes.h"
+
+#include "elk/core/camera.h"
+#include "elk/core/create_mesh.h"
+#include "elk/core/point_shadow_atlas.h"
+#include "elk/core/render_state.h"
+#include "elk/core/shader_program.h"
+#include "elk/object_extensions/light_source.h"
+
+#include <cstddef>
+
+namespace elk { namespace core {
+
+namespace {
+
+const GLuint position_location = 0;
+// Matches point_light_volume.vert
+const GLuint instance_location = 4;
+// The faces of the sphere lie within the unit sphere, scaled so that they
+// enclose it
+const float volume_scale = 1.11f;
+
+} // namespace
+
+PointLightVolumes::PointLightVolumes()
+{
+  std::shared_ptr<Mesh> sphere = CreateMesh::lonLatSphere(16, 8);
+  _number_of_elements = sphere->elements()->size();
+
+  glGenVertexArrays(1, &_vao);
+  glGenBuffers(1, &_position_buffer);
+  glGenBuffers(1, &_element_buffer);
+  glGenBuffers(1, &_instance_buffer);
+
+  glBindVertexArray(_vao);
+  glBindBuffer(GL_ARRAY_BUFFER, _position_buffer);
+  glBufferData(
+    GL_ARRAY_BUFFER, sphere->positions()->size() * sizeof(glm::vec3),
+    sphere->positions()->data(), GL_STATIC_DRAW);
+  glVertexAttribPointer(position_location, 3, GL_FLOAT, GL_FALSE, 0, nullptr);
+  glEnableVertexAttribArray(position_location);
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _element_buffer);
+  glBufferData(
+    GL_ELEMENT_ARRAY_BUFFER, sphere->elements()->size() * sizeof(GLushort),
+    sphere->elements()->data(), GL_STATIC_DRAW);
+
+  glBindBuffer(GL_ARRAY_BUFFER, _instance_buffer);
+  const size_t offsets[] = {
+    offsetof(Instance, position_radius),
+    offsetof(Instance, color_flux),
+    offsetof(Instance, shadow) };
+  for (int i = 0; i < 3; ++i)
+  {
+    glVertexAttribPointer(
+      instance_location + i, 4, GL_FLOAT, GL_FALSE, sizeof(Instance),
+      reinterpret_cast<void*>(offsets[i]));
+    glEnableVertexAttribArray(instance_location + i);
+    glVertexAttribDivisor(instance_location + i, 1);
+  }
+  glBindVertexArray(0);
+}
+
+PointLightVolumes::~PointLightVolumes()
+{
+  glDeleteBuffers(1, &_instance_buffer);
+  glDeleteBuffers(1, &_element_buffer);
+  glDeleteBuffers(1, &_position_buffer);
+  glDeleteVertexArrays(1, &_vao);
+}
+
+void PointLightVolumes::render(
+  const PerspectiveCamera& camera,
+  const std::vector<PointLightSource*>& lights,
+  const PointShadowAtlas& shadows)
+{
+  const glm::mat4 view = camera.viewTransform();
+  _instances.clear();
+  for (auto light : lights)
+  {
+    const float radius = light->radius();
+    const glm::vec3 center = glm::vec3(view * glm::vec4(light->position(), 1.0f));
+    // Entirely behind the camera
+    if (center.z - radius * volume_scale > 0.0f)
+      continue;
+    glm::vec2 shadow_origin(0.0f);
+    const bool shadowed = shadows.slotOrigin(*light, shadow_origin);
+    _instances.push_back({
+      glm::vec4(center, radius),
+      glm::vec4(light->color(), light->radiantFlux()),
+      glm::vec4(shadow_origin, radius, shadowed ? 1.0f : 0.0f) });
+  }
+  if (_instances.empty())
+    return;
+
+  glBindBuffer(GL_ARRAY_BUFFER, _instance_buffer);
+  // Orphans the storage of the last frame
+  glBufferData(
+    GL_ARRAY_BUFFER, _instances.size() * sizeof(Instance),
+    _instances.data(), GL_STREAM_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  glUniformMatrix4fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "P"),
+    1,
+    GL_FALSE,
+    &camera.projectionTransform()[0][0]);
+  glUniform1f(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "volume_scale"),
+    volume_scale);
+
+  // Back faces only, not clipped by the far plane so that surfaces in front
+  // of it are still covered
+  RenderState::enable(GL_CULL_FACE);
+  RenderState::enable(GL_DEPTH_CLAMP);
+  RenderState::cullFace(GL_FRONT);
+  glBindVertexArray(_vao);
+  glDrawElementsInstanced(
+    GL_TRIANGLES, _number_of_elements, GL_UNSIGNED_SHORT, nullptr,
+    GLsizei(_instances.size()));
+  RenderState::countDrawCall();
+  glBindVertexArray(0);
+  RenderState::cullFace(GL_BACK);
+  RenderState::disable(GL_DEPTH_CLAMP);
+}
+
+} }
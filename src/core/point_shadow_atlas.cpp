@@ -0,0 +1,305 @@
+#include "elk/core/point_shadow_atlas.h"
+
+#include "elk/core/camera.h"
+#include "elk/core/cascaded_shadow_map.h"
+#include "elk/core/hash.h"
+#include "elk/core/object_3d.h"
+#include "elk/core/render_state.h"
+#include "elk/object_extensions/light_source.h"
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <algorithm>
+#include <cmath>
+
+namespace elk { namespace core {
+
+namespace {
+
+// Direction and up vector of each face in the order of the cube map faces,
+// must match shading_pass_point_light.frag
+const glm::vec3 face_directions[6] = {
+  { 1.0f, 0.0f, 0.0f }, { -1.0f, 0.0f, 0.0f },
+  { 0.0f, 1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f },
+  { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f } };
+const glm::vec3 face_ups[6] = {
+  { 0.0f, -1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f },
+  { 0.0f, 0.0f, 1.0f }, { 0.0f, 0.0f, -1.0f },
+  { 0.0f, -1.0f, 0.0f }, { 0.0f, -1.0f, 0.0f } };
+
+bool intersectsSphere(
+  const glm::vec3& min, const glm::vec3& max, const glm::vec3& center, float radius)
+{
+  glm::vec3 closest = glm::clamp(center, min, max);
+  glm::vec3 offset = closest - center;
+  return glm::dot(offset, offset) <= radius * radius;
+}
+
+} // namespace
+
+PointShadowAtlas::PointShadowAtlas(PointShadowAtlasSettings settings) :
+  _settings(settings),
+  _frame(0),
+  _updated_lights(0),
+  _pending_lights(0)
+{
+  setSettings(settings);
+}
+
+PointShadowAtlas::~PointShadowAtlas()
+{
+
+}
+
+void PointShadowAtlas::setSettings(PointShadowAtlasSettings settings)
+{
+  _settings = settings;
+  _settings.face_resolution = std::max(_settings.face_resolution, 1);
+  _settings.atlas_resolution = std::max(
+    _settings.atlas_resolution, 3 * _settings.face_resolution);
+  _entries.clear();
+  _slots.assign(numberOfSlots(), nullptr);
+  _depth.reset();
+  _fbo.reset();
+}
+
+int PointShadowAtlas::numberOfSlots() const
+{
+  return (_settings.atlas_resolution / (3 * _settings.face_resolution)) *
+    (_settings.atlas_resolution / (2 * _settings.face_resolution));
+}
+
+void PointShadowAtlas::update(
+  const PerspectiveCamera& camera,
+  const std::vector<PointLightSource*>& lights,
+  const std::vector<RenderableDeferred*>& renderables)
+{
+  _frame++;
+  _updated_lights = 0;
+  _pending_lights = 0;
+
+  std::vector<Caster> casters;
+  bool any_shadows = false;
+  for (auto light : lights)
+    any_shadows = any_shadows || light->castsShadows();
+  if (!any_shadows)
+    return;
+  for (auto renderable : renderables)
+  {
+    glm::vec3 min, max;
+    if (!renderable->shadowCasterBounds(min, max))
+      continue;
+    casters.push_back({renderable, min, max, renderable->absoluteTransform()});
+  }
+
+  struct Candidate
+  {
+    const PointLightSource* light;
+    float priority;
+    std::uint64_t signature;
+    std::vector<const Caster*> casters;
+  };
+  std::vector<Candidate> candidates;
+  const glm::vec3 camera_position = glm::vec3(camera.absoluteTransform()[3]);
+  for (auto light : lights)
+  {
+    if (!light->castsShadows())
+      continue;
+    auto inserted = _entries.insert({light, {-1, 0, false, _frame, 0}});
+    Entry& entry = inserted.first->second;
+    entry.last_seen = _frame;
+
+    const glm::vec3 position = light->position();
+    const float radius = light->radius();
+    Candidate candidate;
+    candidate.light = light;
+    candidate.signature = hash_offset_basis;
+    hashBytes(candidate.signature, &position, sizeof(position));
+    hashBytes(candidate.signature, &radius, sizeof(radius));
+    for (const auto& caster : casters)
+    {
+      if (!intersectsSphere(caster.min, caster.max, position, radius))
+        continue;
+      candidate.casters.push_back(&caster);
+      hashBytes(candidate.signature, &caster.renderable, sizeof(caster.renderable));
+      hashBytes(candidate.signature, &caster.min, sizeof(caster.min));
+      hashBytes(candidate.signature, &caster.max, sizeof(caster.max));
+      hashBytes(candidate.signature, &caster.transform, sizeof(caster.transform));
+    }
+    if (entry.rendered && entry.slot >= 0 && entry.signature == candidate.signature)
+      continue;
+
+    // Close to one when the camera is within the light, falls off with distance
+    const float distance = glm::length(position - camera_position);
+    candidate.priority = radius / std::max(distance, radius) * (1 + entry.waiting);
+    if (!entry.rendered)
+      candidate.priority += 1000.0f;
+    candidates.push_back(std::move(candidate));
+  }
+
+  std::sort(candidates.begin(), candidates.end(),
+    [](const Candidate& a, const Candidate& b) { return a.priority > b.priority; });
+  for (const auto& candidate : candidates)
+  {
+    Entry& entry = _entries[candidate.light];
+    if (_updated_lights >= _settings.max_updates_per_frame)
+    {
+      entry.waiting++;
+      _pending_lights++;
+      continue;
+    }
+    if (entry.slot < 0)
+    {
+      entry.slot = allocateSlot();
+      if (entry.slot < 0)
+      {
+        entry.waiting++;
+        _pending_lights++;
+        continue;
+      }
+      _slots[entry.slot] = candidate.light;
+    }
+    renderLight(*candidate.light, entry.slot, candidate.casters);
+    entry.signature = candidate.signature;
+    entry.rendered = true;
+    entry.waiting = 0;
+    _updated_lights++;
+  }
+}
+
+int PointShadowAtlas::allocateSlot()
+{
+  int oldest_slot = -1;
+  unsigned int oldest_frame = _frame;
+  for (int i = 0; i < int(_slots.size()); ++i)
+  {
+    if (!_slots[i])
+      return i;
+    const Entry& entry = _entries[_slots[i]];
+    if (entry.last_seen < oldest_frame)
+    {
+      oldest_frame = entry.last_seen;
+      oldest_slot = i;
+    }
+  }
+  if (oldest_slot >= 0)
+  {
+    // The light may no longer exist, only its entry is removed
+    _entries.erase(_slots[oldest_slot]);
+    _slots[oldest_slot] = nullptr;
+  }
+  return oldest_slot;
+}
+
+void PointShadowAtlas::renderLight(
+  const PointLightSource& light, int slot,
+  const std::vector<const Caster*>& casters)
+{
+  if (!_depth)
+  {
+    const int size = _settings.atlas_resolution;
+    _depth = std::make_unique<Texture>(
+      glm::uvec3(size, size, 1), Texture::Format::DepthComponent,
+      GL_DEPTH_COMPONENT32F, GL_FLOAT, Texture::FilterMode::Linear,
+      Texture::WrappingMode::ClampToEdge);
+    // Only GPU storage is needed
+    _depth->resize(_depth->dimensions());
+    // Bilinear filtering of the depth comparison
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LEQUAL);
+
+    _fbo = std::make_unique<FrameBufferObject>();
+    _fbo->attach2DTexture(_depth->id(), GL_DEPTH_ATTACHMENT, 0);
+    _fbo->bind();
+    glDrawBuffer(GL_NONE);
+    glReadBuffer(GL_NONE);
+    _fbo->unbind();
+  }
+
+  const int face_size = _settings.face_resolution;
+  const int slots_per_row = _settings.atlas_resolution / (3 * face_size);
+  const glm::ivec2 slot_origin(
+    (slot % slots_per_row) * 3 * face_size, (slot / slots_per_row) * 2 * face_size);
+  const glm::vec3 position = light.position();
+  const glm::mat4 projection = glm::perspective(
+    float(M_PI) / 2.0f, 1.0f, _settings.near_plane, light.radius());
+
+  _fbo->bind();
+  RenderState::enable(GL_SCISSOR_TEST);
+  RenderState::enable(GL_DEPTH_TEST);
+  RenderState::disable(GL_BLEND);
+  RenderState::depthMask(GL_TRUE);
+  // Slope scaled bias against shadow acne
+  RenderState::enable(GL_POLYGON_OFFSET_FILL);
+  RenderState::polygonOffset(2.0f, 4.0f);
+
+  CascadedShadowMap::shadowCasterProgram()->pushUsage();
+  glUniformMatrix4fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "P"),
+    1,
+    GL_FALSE,
+    &projection[0][0]);
+  for (int face = 0; face < 6; ++face)
+  {
+    const int x = slot_origin.x + (face % 3) * face_size;
+    const int y = slot_origin.y + (face / 3) * face_size;
+    RenderState::viewport(x, y, face_size, face_size);
+    RenderState::scissor(x, y, face_size, face_size);
+    glClear(GL_DEPTH_BUFFER_BIT);
+
+    const glm::mat4 view =
+      glm::lookAt(position, position + face_directions[face], face_ups[face]);
+    glUniformMatrix4fv(
+      glGetUniformLocation(ShaderProgram::currentProgramId(), "V"),
+      1,
+      GL_FALSE,
+      &view[0][0]);
+    for (auto caster : casters)
+      caster->renderable->renderShadowCaster(view, projection);
+  }
+  CascadedShadowMap::shadowCasterProgram()->popUsage();
+
+  RenderState::disable(GL_POLYGON_OFFSET_FILL);
+  RenderState::disable(GL_SCISSOR_TEST);
+  _fbo->unbind();
+}
+
+void PointShadowAtlas::bind(TextureUnit& unit, const PerspectiveCamera& camera) const
+{
+  unit.activate();
+  if (_depth)
+    _depth->bind();
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "point_shadow_map"), unit);
+
+  const glm::mat3 view_to_world = glm::mat3(camera.absoluteTransform());
+  glUniform1f(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "point_shadow_tile_size"),
+    float(_settings.face_resolution) / _settings.atlas_resolution);
+  glUniform1f(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "point_shadow_near_plane"),
+    _settings.near_plane);
+  glUniformMatrix3fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "point_shadow_view_to_world"),
+    1,
+    GL_FALSE,
+    &view_to_world[0][0]);
+}
+
+bool PointShadowAtlas::slotOrigin(const PointLightSource& light, glm::vec2& origin) const
+{
+  auto it = _entries.find(&light);
+  if (!_depth || !light.castsShadows() ||
+      it == _entries.end() || !it->second.rendered || it->second.slot < 0)
+    return false;
+
+  const int face_size = _settings.face_resolution;
+  const int slots_per_row = _settings.atlas_resolution / (3 * face_size);
+  const int slot = it->second.slot;
+  origin = glm::vec2(
+    (slot % slots_per_row) * 3 * face_size, (slot / slots_per_row) * 2 * face_size) /
+    float(_settings.atlas_resolution);
+  return true;
+}
+
+} }
@@ -9,7 +9,8 @@ namespace elk { namespace core {
 RenderBufferObject::RenderBufferObject(
 	GLsizei width, GLsizei height, GLenum internalformat) :
   _width(width),
-  _height(height)
+  _height(height),
+  _internal_format(internalformat)
 {
   glGenRenderbuffers(1, &_id);
   bind();
@@ -21,4 +22,12 @@ RenderBufferObject::~RenderBufferObject()
   glDeleteRenderbuffers(1, &_id);
 }
 
+void RenderBufferObject::resize(GLsizei width, GLsizei height)
+{
+  _width = width;
+  _height = height;
+  bind();
+  glRenderbufferStorage(GL_RENDERBUFFER, _internal_format, _width, _height);
+}
+
 } }
@@ -0,0 +1,270 @@
+#include "elk/core/render_state.h"
+
+#include <cstdio>
+
+namespace elk { namespace core {
+
+namespace {
+  // Used for state that has not been set through RenderState yet
+  const GLenum unknown_enum = GL_INVALID_ENUM;
+  const GLint64 unknown_name = -1;
+}
+
+std::map<GLenum, bool> RenderState::_capabilities;
+GLenum RenderState::_blend_source_factor = unknown_enum;
+GLenum RenderState::_blend_destination_factor = unknown_enum;
+GLint RenderState::_depth_mask = -1;
+GLenum RenderState::_depth_func = unknown_enum;
+GLint64 RenderState::_program = unknown_name;
+GLint64 RenderState::_framebuffer = unknown_name;
+GLint RenderState::_viewport[4] = {0, 0, 0, 0};
+bool RenderState::_viewport_known = false;
+GLenum RenderState::_cull_face = unknown_enum;
+GLint RenderState::_scissor[4] = {0, 0, 0, 0};
+bool RenderState::_scissor_known = false;
+GLfloat RenderState::_polygon_offset[2] = {0.0f, 0.0f};
+bool RenderState::_polygon_offset_known = false;
+
+std::vector<RenderState::PassStatistics> RenderState::_frame_statistics;
+std::vector<RenderState::PassStatistics> RenderState::_last_frame_statistics;
+
+void RenderState::enable(GLenum capability)
+{
+  auto it = _capabilities.find(capability);
+  bool redundant = it != _capabilities.end() && it->second;
+  if (!redundant)
+  {
+    glEnable(capability);
+    _capabilities[capability] = true;
+  }
+  count(Category::Capability, !redundant);
+}
+
+void RenderState::disable(GLenum capability)
+{
+  auto it = _capabilities.find(capability);
+  bool redundant = it != _capabilities.end() && !it->second;
+  if (!redundant)
+  {
+    glDisable(capability);
+    _capabilities[capability] = false;
+  }
+  count(Category::Capability, !redundant);
+}
+
+void RenderState::blendFunc(GLenum source_factor, GLenum destination_factor)
+{
+  bool redundant =
+    _blend_source_factor == source_factor &&
+    _blend_destination_factor == destination_factor;
+  if (!redundant)
+  {
+    glBlendFunc(source_factor, destination_factor);
+    _blend_source_factor = source_factor;
+    _blend_destination_factor = destination_factor;
+  }
+  count(Category::BlendFunc, !redundant);
+}
+
+void RenderState::depthMask(GLboolean flag)
+{
+  bool redundant = _depth_mask == flag;
+  if (!redundant)
+  {
+    glDepthMask(flag);
+    _depth_mask = flag;
+  }
+  count(Category::DepthMask, !redundant);
+}
+
+void RenderState::depthFunc(GLenum function)
+{
+  bool redundant = _depth_func == function;
+  if (!redundant)
+  {
+    glDepthFunc(function);
+    _depth_func = function;
+  }
+  count(Category::DepthFunc, !redundant);
+}
+
+void RenderState::useProgram(GLuint program)
+{
+  bool redundant = _program == program;
+  if (!redundant)
+  {
+    glUseProgram(program);
+    _program = program;
+  }
+  count(Category::Program, !redundant);
+}
+
+void RenderState::bindFramebuffer(GLuint framebuffer)
+{
+  bool redundant = _framebuffer == framebuffer;
+  if (!redundant)
+  {
+    glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+    _framebuffer = framebuffer;
+  }
+  count(Category::Framebuffer, !redundant);
+}
+
+void RenderState::viewport(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+  bool redundant = _viewport_known &&
+    _viewport[0] == x && _viewport[1] == y &&
+    _viewport[2] == width && _viewport[3] == height;
+  if (!redundant)
+  {
+    glViewport(x, y, width, height);
+    _viewport[0] = x;
+    _viewport[1] = y;
+    _viewport[2] = width;
+    _viewport[3] = height;
+    _viewport_known = true;
+  }
+  count(Category::Viewport, !redundant);
+}
+
+void RenderState::cullFace(GLenum mode)
+{
+  bool redundant = _cull_face == mode;
+  if (!redundant)
+  {
+    glCullFace(mode);
+    _cull_face = mode;
+  }
+  count(Category::CullFace, !redundant);
+}
+
+void RenderState::scissor(GLint x, GLint y, GLsizei width, GLsizei height)
+{
+  bool redundant = _scissor_known &&
+    _scissor[0] == x && _scissor[1] == y &&
+    _scissor[2] == width && _scissor[3] == height;
+  if (!redundant)
+  {
+    glScissor(x, y, width, height);
+    _scissor[0] = x;
+    _scissor[1] = y;
+    _scissor[2] = width;
+    _scissor[3] = height;
+    _scissor_known = true;
+  }
+  count(Category::Scissor, !redundant);
+}
+
+void RenderState::polygonOffset(GLfloat factor, GLfloat units)
+{
+  bool redundant = _polygon_offset_known &&
+    _polygon_offset[0] == factor && _polygon_offset[1] == units;
+  if (!redundant)
+  {
+    glPolygonOffset(factor, units);
+    _polygon_offset[0] = factor;
+    _polygon_offset[1] = units;
+    _polygon_offset_known = true;
+  }
+  count(Category::PolygonOffset, !redundant);
+}
+
+void RenderState::countDrawCall(unsigned int number_of_calls)
+{
+  if (_frame_statistics.empty())
+    beginPass("frame");
+  _frame_statistics.back().issued[static_cast<int>(Category::DrawCall)] +=
+    number_of_calls;
+}
+
+void RenderState::deleteProgram(GLuint program)
+{
+  if (_program == program)
+    _program = unknown_name;
+  glDeleteProgram(program);
+}
+
+void RenderState::deleteFramebuffer(GLuint framebuffer)
+{
+  // Deleting the bound framebuffer reverts the binding to zero
+  if (_framebuffer == framebuffer)
+    _framebuffer = 0;
+  glDeleteFramebuffers(1, &framebuffer);
+}
+
+void RenderState::invalidate()
+{
+  _capabilities.clear();
+  _blend_source_factor = unknown_enum;
+  _blend_destination_factor = unknown_enum;
+  _depth_mask = -1;
+  _depth_func = unknown_enum;
+  _program = unknown_name;
+  _framebuffer = unknown_name;
+  _viewport_known = false;
+  _cull_face = unknown_enum;
+  _scissor_known = false;
+  _polygon_offset_known = false;
+}
+
+void RenderState::beginPass(const std::string& name)
+{
+  PassStatistics pass = {name, {0}, {0}};
+  _frame_statistics.push_back(pass);
+}
+
+void RenderState::resetFrameStatistics()
+{
+  _last_frame_statistics.swap(_frame_statistics);
+  _frame_statistics.clear();
+}
+
+void RenderState::printStatistics(const std::vector<PassStatistics>& statistics)
+{
+  for (auto& pass : statistics)
+  {
+    printf("%s :", pass.name.c_str());
+    for (int i = 0; i < number_of_categories; ++i)
+    {
+      if (pass.issued[i] || pass.skipped[i])
+      {
+        printf(" %s %u/%u", categoryName(static_cast<Category>(i)),
+          pass.issued[i], pass.issued[i] + pass.skipped[i]);
+      }
+    }
+    printf("\n");
+  }
+}
+
+const char* RenderState::categoryName(Category category)
+{
+  switch (category)
+  {
+    case Category::Capability: return "capability";
+    case Category::BlendFunc: return "blend_func";
+    case Category::DepthMask: return "depth_mask";
+    case Category::DepthFunc: return "depth_func";
+    case Category::Program: return "program";
+    case Category::Framebuffer: return "framebuffer";
+    case Category::Viewport: return "viewport";
+    case Category::CullFace: return "cull_face";
+    case Category::Scissor: return "scissor";
+    case Category::PolygonOffset: return "polygon_offset";
+    case Category::DrawCall: return "draw_call";
+    default: return "unknown";
+  }
+}
+
+void RenderState::count(Category category, bool issued)
+{
+  // Calls made before the first pass of a frame
+  if (_frame_statistics.empty())
+    beginPass("frame");
+  PassStatistics& pass = _frame_statistics.back();
+  if (issued)
+    pass.issued[static_cast<int>(category)]++;
+  else
+    pass.skipped[static_cast<int>(category)]++;
+}
+
+} }
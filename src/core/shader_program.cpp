@@ -1,6 +1,7 @@
 #include "elk/core/shader_program.h"
 
 #include "elk/core/file_utils.h"
+#include "elk/core/render_state.h"
 
 #include <array>
 #include <vector>
@@ -21,27 +22,36 @@ ShaderProgram::ShaderProgram(
   _id = loadShaderProgram(vs_src, tcs_src, tes_src, gs_src, fs_src);
 }
 
+ShaderProgram::ShaderProgram(std::string name, const char* cs_src) :
+  _name(name)
+{
+  _id = loadShaderProgram(nullptr, nullptr, nullptr, nullptr, nullptr, cs_src);
+}
+
 ShaderProgram::~ShaderProgram()
 {
-  glDeleteProgram(_id);
+  RenderState::deleteProgram(_id);
 }
 
 void ShaderProgram::pushUsage()
 {
   _shader_stack.push(_id);
-  glUseProgram(_shader_stack.top());
+  RenderState::useProgram(_shader_stack.top());
 }
 
 void ShaderProgram::popUsage()
 {
   _shader_stack.pop();
-  glUseProgram(_shader_stack.empty() ? 0 : _shader_stack.top());
+  // The last program stays bound when the stack empties, so that the next
+  // push of the same program is filtered by RenderState
+  if (!_shader_stack.empty())
+    RenderState::useProgram(_shader_stack.top());
 }
 
 void ShaderProgram::useNone()
 {
   _shader_stack = std::stack<GLuint>();
-  glUseProgram(0);
+  RenderState::useProgram(0);
 }
 
 // https://www.omniref.com/ruby/gems/opengl-bindings/1.3.5/symbols/OpenGL::GL_TESS_CONTROL_SHADER
@@ -57,23 +67,27 @@ void ShaderProgram::useNone()
 #ifndef GL_PATCHES
     #define GL_PATCHES 0x000E
 #endif
+#ifndef GL_COMPUTE_SHADER
+    #define GL_COMPUTE_SHADER 0x91B9
+#endif
 
 GLuint ShaderProgram::loadShaderProgram(
     const char* vs_src,
     const char* tcs_src,
     const char* tes_src,
     const char* gs_src,
-    const char* fs_src)
+    const char* fs_src,
+    const char* cs_src)
 {
-  std::array<const char*, 5> paths = {{vs_src,tcs_src,tes_src,gs_src,fs_src}};
-  std::array<GLenum, 5> types = {{
+  std::array<const char*, 6> paths = {{vs_src,tcs_src,tes_src,gs_src,fs_src,cs_src}};
+  std::array<GLenum, 6> types = {{
     GL_VERTEX_SHADER, GL_TESS_CONTROL_SHADER, GL_TESS_EVALUATION_SHADER,
-    GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER}};
-  std::array<std::string, 5> types_names = {{
+    GL_GEOMETRY_SHADER, GL_FRAGMENT_SHADER, GL_COMPUTE_SHADER}};
+  std::array<std::string, 6> types_names = {{
     "vertex shader", "tesselation control shader", "tesselation evaluation shader",
-    "geometry shader", "fragment shader"}};
-  std::array<GLuint, 5> ids = {{0,0,0,0,0}};
-  std::array<std::string, 5> code;
+    "geometry shader", "fragment shader", "compute shader"}};
+  std::array<GLuint, 6> ids = {{0,0,0,0,0,0}};
+  std::array<std::string, 6> code;
 
   GLint result = 0;
   int info_log_length;
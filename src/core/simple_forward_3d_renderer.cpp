@@ -1,4 +1,5 @@
 #include "elk/core/simple_forward_3d_renderer.h"
+#include "elk/core/render_state.h"
 
 namespace elk { namespace core {
 
@@ -19,7 +20,7 @@ void SimpleForward3DRenderer::render(Object3D& scene)
   // Submit all objects in the scene to the lists of renderable objects
   scene.submit(*this);
 
-  glViewport(0,0, _window_width, _window_height);
+  RenderState::viewport(0,0, _window_width, _window_height);
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
   for (auto renderable : _renderables_forward_to_render)
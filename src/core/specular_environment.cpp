@@ -0,0 +1,291 @@
+#include "elk/core/specular_environment.h"
+
+#include "elk/core/create_mesh.h"
+#include "elk/core/frame_buffer_object.h"
+#include "elk/core/hash.h"
+#include "elk/core/image_processing.h"
+#include "elk/core/render_state.h"
+#include "elk/core/shader_program.h"
+#include "elk/core/texture_unit.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+namespace elk { namespace core {
+
+namespace {
+
+const int max_side = 128;
+const int number_of_levels = 6;
+const int brdf_lut_size = 64;
+const int number_of_samples = 256;
+
+const char cache_magic[8] = "ELKENV1";
+
+// Identifies the source pixels and the parameters of the convolution, zero
+// if the faces are not in memory
+std::uint64_t cacheKey(const CubeMapTexture& source, int side, int levels)
+{
+  int bytes_per_channel;
+  switch (source.dataType())
+  {
+    case GL_UNSIGNED_BYTE: bytes_per_channel = 1; break;
+    case GL_HALF_FLOAT: bytes_per_channel = 2; break;
+    case GL_FLOAT: bytes_per_channel = 4; break;
+    default: return 0;
+  }
+  std::uint64_t key = hash_offset_basis;
+  const size_t face_size =
+    size_t(source.size()) * source.size() * source.numberOfChannels() * bytes_per_channel;
+  for (int face = 0; face < 6; ++face)
+  {
+    if (!source.faceData(face))
+      return 0;
+    hashBytes(key, source.faceData(face), face_size);
+  }
+  const int parameters[] = {
+    source.size(), int(source.format()), int(source.dataType()),
+    side, levels, brdf_lut_size, number_of_samples };
+  hashBytes(key, parameters, sizeof(parameters));
+  return key;
+}
+
+int levelSide(int side, int level)
+{
+  return std::max(side >> level, 1);
+}
+
+} // namespace
+
+SpecularEnvironment::SpecularEnvironment(
+  const CubeMapTexture& source, const std::string& cache_directory,
+  Device device) :
+  _side(std::min(source.size(), max_side)),
+  _levels(std::min(number_of_levels, 1 + int(std::log2(std::min(source.size(), max_side))))),
+  _key(cacheKey(source, _side, _levels))
+{
+  _prefiltered = std::make_unique<CubeMapTexture>(
+    _side, CubeMapTexture::Format::RGBA, GL_RGBA16F, GL_FLOAT,
+    CubeMapTexture::FilterMode::Linear, CubeMapTexture::WrappingMode::ClampToEdge);
+  _prefiltered->upload();
+  _prefiltered->setMipMapLevels(_levels);
+
+  char file_name[64];
+  snprintf(file_name, sizeof(file_name), "/environment_%016llx.cache",
+    static_cast<unsigned long long>(_key));
+  const std::string cache_path = cache_directory + file_name;
+  if (_key && loadCache(cache_path))
+    return;
+
+  bool computed = device == Device::GPU ?
+    computeOnGPU(source) : computeOnCPU(source);
+  if (computed && _key)
+    saveCache(cache_path);
+}
+
+SpecularEnvironment::~SpecularEnvironment()
+{
+
+}
+
+void SpecularEnvironment::uploadBRDFLookUpTable(const float* data)
+{
+  const size_t size = brdf_lut_size * brdf_lut_size * 2 * sizeof(float);
+  GLubyte* pixels = new GLubyte[size];
+  std::memcpy(pixels, data, size);
+  _brdf_lut = std::make_unique<Texture>(
+    pixels, glm::uvec3(brdf_lut_size, brdf_lut_size, 1), Texture::Format::RG,
+    GL_RG16F, GL_FLOAT, Texture::FilterMode::Linear,
+    Texture::WrappingMode::ClampToEdge);
+  _brdf_lut->upload();
+}
+
+bool SpecularEnvironment::computeOnGPU(const CubeMapTexture& source)
+{
+  ShaderProgram prefilter_program(
+    "prefilter_ggx_program",
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass.vert").c_str(),
+    nullptr,
+    nullptr,
+    nullptr,
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/prefilter_ggx.frag").c_str());
+  ShaderProgram brdf_program(
+    "brdf_lut_program",
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/shading_pass.vert").c_str(),
+    nullptr,
+    nullptr,
+    nullptr,
+    (std::string(ELK_DIR) + "/shaders/deferred_shading/brdf_lut.frag").c_str());
+  std::shared_ptr<Mesh> quad = CreateMesh::quad();
+  FrameBufferObject fbo;
+
+  _brdf_lut = std::make_unique<Texture>(
+    glm::uvec3(brdf_lut_size, brdf_lut_size, 1), Texture::Format::RG, GL_RG16F,
+    GL_FLOAT, Texture::FilterMode::Linear, Texture::WrappingMode::ClampToEdge);
+  _brdf_lut->upload();
+
+  fbo.bind();
+  RenderState::disable(GL_BLEND);
+  RenderState::disable(GL_DEPTH_TEST);
+  glFramebufferTexture2D(
+    GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, _brdf_lut->id(), 0);
+  if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+  {
+    fbo.unbind();
+    fprintf(stderr,
+      "ERROR : Can not render to floating point textures, "
+      "prefiltering the environment on the CPU\n");
+    return computeOnCPU(source);
+  }
+
+  brdf_program.pushUsage();
+  RenderState::viewport(0, 0, brdf_lut_size, brdf_lut_size);
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "destination_size"),
+    brdf_lut_size);
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "number_of_samples"),
+    number_of_samples);
+  quad->render();
+  brdf_program.popUsage();
+
+  prefilter_program.pushUsage();
+  TextureUnit unit;
+  unit.activate();
+  source.bind();
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "source"), unit);
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "source_size"),
+    source.size());
+  glUniform1i(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "number_of_samples"),
+    number_of_samples);
+  for (int level = 0; level < _levels; ++level)
+  {
+    const int side = levelSide(_side, level);
+    RenderState::viewport(0, 0, side, side);
+    glUniform1f(
+      glGetUniformLocation(ShaderProgram::currentProgramId(), "roughness"),
+      _levels > 1 ? float(level) / (_levels - 1) : 0.0f);
+    glUniform1i(
+      glGetUniformLocation(ShaderProgram::currentProgramId(), "destination_size"),
+      side);
+    for (int face = 0; face < 6; ++face)
+    {
+      glFramebufferTexture2D(
+        GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_CUBE_MAP_POSITIVE_X + face,
+        _prefiltered->id(), level);
+      glUniform1i(
+        glGetUniformLocation(ShaderProgram::currentProgramId(), "face"), face);
+      quad->render();
+    }
+  }
+  prefilter_program.popUsage();
+  fbo.unbind();
+  return true;
+}
+
+bool SpecularEnvironment::computeOnCPU(const CubeMapTexture& source)
+{
+  uploadBRDFLookUpTable(
+    integrateSpecularBRDF(brdf_lut_size, number_of_samples).data());
+  CubeMapLevels levels =
+    prefilterGGX(source, _side, _levels, number_of_samples);
+  if (levels.empty())
+    return false;
+  for (int level = 0; level < int(levels.size()); ++level)
+  {
+    for (int face = 0; face < 6; ++face)
+      _prefiltered->uploadLevel(level, face, levels[level][face].data());
+  }
+  return true;
+}
+
+bool SpecularEnvironment::loadCache(const std::string& path)
+{
+  std::ifstream file(path, std::ios::binary);
+  if (!file)
+    return false;
+
+  char magic[8];
+  std::uint64_t key;
+  int header[3];
+  file.read(magic, sizeof(magic));
+  file.read(reinterpret_cast<char*>(&key), sizeof(key));
+  file.read(reinterpret_cast<char*>(header), sizeof(header));
+  if (!file || std::memcmp(magic, cache_magic, sizeof(magic)) != 0 ||
+      key != _key || header[0] != _side || header[1] != _levels ||
+      header[2] != brdf_lut_size)
+  {
+    fprintf(stderr, "ERROR : Ignoring invalid environment cache %s\n", path.c_str());
+    return false;
+  }
+
+  std::vector<std::vector<float> > faces;
+  for (int level = 0; level < _levels; ++level)
+  {
+    const int side = levelSide(_side, level);
+    for (int face = 0; face < 6; ++face)
+    {
+      faces.emplace_back(side * side * 4);
+      file.read(reinterpret_cast<char*>(faces.back().data()),
+        faces.back().size() * sizeof(float));
+    }
+  }
+  std::vector<float> brdf_lut(brdf_lut_size * brdf_lut_size * 2);
+  file.read(reinterpret_cast<char*>(brdf_lut.data()), brdf_lut.size() * sizeof(float));
+  if (!file)
+  {
+    fprintf(stderr, "ERROR : Environment cache %s is truncated\n", path.c_str());
+    return false;
+  }
+
+  for (int level = 0; level < _levels; ++level)
+  {
+    for (int face = 0; face < 6; ++face)
+      _prefiltered->uploadLevel(level, face, faces[level * 6 + face].data());
+  }
+  uploadBRDFLookUpTable(brdf_lut.data());
+  return true;
+}
+
+void SpecularEnvironment::saveCache(const std::string& path)
+{
+  std::ofstream file(path, std::ios::binary);
+  if (!file)
+  {
+    fprintf(stderr, "ERROR : Could not write environment cache %s\n", path.c_str());
+    return;
+  }
+
+  const int header[3] = { _side, _levels, brdf_lut_size };
+  file.write(cache_magic, sizeof(cache_magic));
+  file.write(reinterpret_cast<const char*>(&_key), sizeof(_key));
+  file.write(reinterpret_cast<const char*>(header), sizeof(header));
+
+  // Read back what is on the GPU so that both devices write the same data
+  std::vector<float> pixels;
+  _prefiltered->bind();
+  for (int level = 0; level < _levels; ++level)
+  {
+    const int side = levelSide(_side, level);
+    pixels.resize(side * side * 4);
+    for (int face = 0; face < 6; ++face)
+    {
+      glGetTexImage(
+        GL_TEXTURE_CUBE_MAP_POSITIVE_X + face, level, GL_RGBA, GL_FLOAT, pixels.data());
+      file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size() * sizeof(float));
+    }
+  }
+  pixels.resize(brdf_lut_size * brdf_lut_size * 2);
+  _brdf_lut->bind();
+  glGetTexImage(GL_TEXTURE_2D, 0, GL_RG, GL_FLOAT, pixels.data());
+  file.write(reinterpret_cast<const char*>(pixels.data()), pixels.size() * sizeof(float));
+}
+
+} }
@@ -1,4 +1,7 @@
 #include "elk/core/texture.h"
+#include "elk/core/texture_unit.h"
+#include "elk/core/render_state.h"
+#include <algorithm>
 #include <cassert>
 #include <cstring>
 
@@ -38,10 +41,29 @@ Texture::Texture(
   initialize(false);
 }
 
+Texture::Texture(
+  void* data, std::vector<void*> mip_map_data, glm::uvec3 dimensions,
+  Format format, GLint internalFormat, GLenum dataType, FilterMode filter,
+  WrappingMode wrapping) :
+  _dimensions(std::move(dimensions)),
+  _format(format),
+  _internal_format(internalFormat),
+  _data_type(dataType),
+  _filter(filter),
+  _wrapping(wrapping),
+  _mip_map_level(static_cast<int>(mip_map_data.size()) + 1),
+  _anisotropy_level(-1.f),
+  _has_ownership_of_data(true),
+  _pixel_data(data),
+  _mip_map_data(std::move(mip_map_data))
+{
+  initialize(false);
+}
+
 Texture::~Texture()
 {
   if (_id) {
-    glDeleteTextures(1, &_id);
+    TextureUnit::deleteTexture(_id);
   }
 
   if (_has_ownership_of_data) {
@@ -71,6 +93,10 @@ void Texture::allocateData()
 void Texture::deallocateData() {
   delete[] static_cast<GLubyte*>(_pixel_data);
   _pixel_data = nullptr;
+  for (auto level_data : _mip_map_data) {
+    delete[] static_cast<GLubyte*>(level_data);
+  }
+  _mip_map_data.clear();
 }
 
 void Texture::generate()
@@ -81,17 +107,17 @@ void Texture::generate()
 
 void Texture::enable() const
 {
-  glEnable(_type);
+  RenderState::enable(_type);
 }
 
 void Texture::disable() const
 {
-  glDisable(_type);
+  RenderState::disable(_type);
 }
 
 void Texture::bind() const
 {
-  glBindTexture(_type, _id);
+  TextureUnit::bindTexture(_type, _id);
 }
 
 void Texture::applyFilter()
@@ -112,20 +138,20 @@ void Texture::applyFilter()
       glTexParameteri(_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
       glTexParameteri(_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
       upload();
-      glGenerateMipmap(_type);
+      uploadMipMaps();
       break;
     case FilterMode::NearestLinearMipMap:
       glTexParameteri(_type, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
       glTexParameteri(_type, GL_TEXTURE_MIN_FILTER, GL_NEAREST_MIPMAP_LINEAR);
       upload();
-      glGenerateMipmap(_type);
+      uploadMipMaps();
       break;
     case FilterMode::AnisotropicMipMap:
     {
       glTexParameteri(_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
       glTexParameteri(_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
       glTexParameteri(_type, GL_TEXTURE_MAX_LEVEL, _mip_map_level - 1);
-      glGenerateMipmap(_type);
+      uploadMipMaps();
       if (_anisotropy_level == -1.f) {
         GLfloat maxTextureAnisotropy = 1.0;
         glGetFloatv(
@@ -149,6 +175,49 @@ void Texture::generateMipMap()
   glGenerateMipmap(_type);
 }
 
+void Texture::resize(glm::uvec3 dimensions)
+{
+  _dimensions = dimensions;
+  deallocateData();
+  upload();
+  if (_mip_map_level > 1)
+    allocateMipMapLevels();
+}
+
+void Texture::setMipMapLevels(int levels)
+{
+  _mip_map_level = std::max(levels, 1);
+  bind();
+  glTexParameteri(_type, GL_TEXTURE_MAX_LEVEL, _mip_map_level - 1);
+  allocateMipMapLevels();
+}
+
+void Texture::allocateMipMapLevels()
+{
+  bind();
+  // No more levels than needed to reach a size of one
+  glm::uvec3 level_dimensions = _dimensions;
+  for (int level = 1; level < _mip_map_level; ++level) {
+    if (level_dimensions == glm::uvec3(1))
+      break;
+    level_dimensions = glm::max(level_dimensions / 2u, glm::uvec3(1));
+    uploadLevel(level, level_dimensions, nullptr);
+  }
+}
+
+void Texture::uploadMipMaps()
+{
+  if (_mip_map_data.empty()) {
+    glGenerateMipmap(_type);
+    return;
+  }
+  glm::uvec3 level_dimensions = _dimensions;
+  for (int i = 0; i < _mip_map_data.size(); ++i) {
+    level_dimensions = glm::max(level_dimensions / 2u, glm::uvec3(1));
+    uploadLevel(i + 1, level_dimensions, _mip_map_data[i]);
+  }
+}
+
 int Texture::numberOfChannels() const
 {
   return numberOfChannels(_format);
@@ -231,45 +300,49 @@ void Texture::calculateBytesPerPixel()
 void Texture::upload()
 {
   bind();
+  uploadLevel(0, _dimensions, _pixel_data);
+}
 
+void Texture::uploadLevel(int level, glm::uvec3 dimensions, void* data)
+{
   switch (_type) {
     case GL_TEXTURE_1D:
       glTexImage1D(
         _type,
-        0,
+        level,
         _internal_format,
-        GLsizei(_dimensions.x),
+        GLsizei(dimensions.x),
         0,
         GLint(_format),
         _data_type,
-        _pixel_data
+        data
       );
       break;
     case GL_TEXTURE_2D:
       glTexImage2D(
         _type,
-        0,
+        level,
         _internal_format,
-        GLsizei(_dimensions.x),
-        GLsizei(_dimensions.y),
+        GLsizei(dimensions.x),
+        GLsizei(dimensions.y),
         0,
         GLint(_format),
         _data_type,
-        _pixel_data
+        data
       );
       break;
     case GL_TEXTURE_3D:
       glTexImage3D(
         _type,
-        0,
+        level,
         _internal_format,
-        GLsizei(_dimensions.x),
-        GLsizei(_dimensions.y),
-        GLsizei(_dimensions.z),
+        GLsizei(dimensions.x),
+        GLsizei(dimensions.y),
+        GLsizei(dimensions.z),
         0,
         GLint(_format),
         _data_type,
-        _pixel_data
+        data
       );
       break;
     default:
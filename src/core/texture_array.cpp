@@ -0,0 +1,162 @@
+#include "elk/core/texture_array.h"
+#include "elk/core/texture_unit.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+namespace elk { namespace core {
+
+TextureArray::TextureArray(glm::uvec2 layer_size, int max_number_of_layers) :
+  _layer_size(layer_size),
+  _max_number_of_layers(max_number_of_layers),
+  _number_of_layers(0),
+  _mip_maps_dirty(false)
+{
+  _mip_map_level = static_cast<int>(
+    std::floor(std::log2(std::max(layer_size.x, layer_size.y)))) + 1;
+
+  glGenTextures(1, &_id);
+  bind();
+  glm::uvec2 level_size = layer_size;
+  for (int level = 0; level < _mip_map_level; ++level)
+  {
+    glTexImage3D(
+      GL_TEXTURE_2D_ARRAY, level, GL_RGBA8, level_size.x, level_size.y,
+      max_number_of_layers, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+    level_size = glm::max(level_size / 2u, glm::uvec2(1));
+  }
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_REPEAT);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BASE_LEVEL, 0);
+  glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, _mip_map_level - 1);
+  float max_anisotropy;
+  glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &max_anisotropy);
+  glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY_EXT, max_anisotropy);
+}
+
+TextureArray::~TextureArray()
+{
+  TextureUnit::deleteTexture(_id);
+}
+
+bool TextureArray::isSolidColor(const Texture& texture, glm::u8vec4& color) const
+{
+  const GLubyte* pixels = static_cast<const GLubyte*>(texture.pixelData());
+  glm::uvec3 dimensions = texture.dimensions();
+  size_t number_of_pixels = dimensions.x * dimensions.y;
+  for (size_t i = 1; i < number_of_pixels; ++i)
+  {
+    if (std::memcmp(pixels, pixels + i * 4, 4) != 0)
+      return false;
+  }
+  color = glm::u8vec4(pixels[0], pixels[1], pixels[2], pixels[3]);
+  return true;
+}
+
+bool TextureArray::accepts(const Texture& texture) const
+{
+  if (!texture.pixelData() ||
+      texture.format() != Texture::Format::RGBA ||
+      texture.dataType() != GL_UNSIGNED_BYTE ||
+      texture.dimensions().z != 1)
+    return false;
+  glm::u8vec4 color;
+  return glm::uvec2(texture.dimensions()) == _layer_size ||
+    isSolidColor(texture, color);
+}
+
+int TextureArray::addLayer(const Texture& texture)
+{
+  if (!accepts(texture))
+  {
+    fprintf(stderr, "ERROR : Texture %u does not fit in texture array %u\n",
+      texture.id(), _id);
+    return -1;
+  }
+  if (glm::uvec2(texture.dimensions()) != _layer_size)
+  {
+    glm::u8vec4 color;
+    isSolidColor(texture, color);
+    return addSolidColorLayer(color);
+  }
+  if (_number_of_layers >= _max_number_of_layers)
+  {
+    fprintf(stderr, "ERROR : Texture array %u is full\n", _id);
+    return -1;
+  }
+
+  int layer = _number_of_layers++;
+  bind();
+  glTexSubImage3D(
+    GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, _layer_size.x, _layer_size.y, 1,
+    GL_RGBA, GL_UNSIGNED_BYTE, texture.pixelData());
+
+  // Use the mip maps computed on load when the whole chain is available
+  const std::vector<void*>& mip_map_data = texture.mipMapData();
+  if (mip_map_data.size() == _mip_map_level - 1)
+  {
+    glm::uvec2 level_size = _layer_size;
+    for (int i = 0; i < mip_map_data.size(); ++i)
+    {
+      level_size = glm::max(level_size / 2u, glm::uvec2(1));
+      glTexSubImage3D(
+        GL_TEXTURE_2D_ARRAY, i + 1, 0, 0, layer, level_size.x, level_size.y, 1,
+        GL_RGBA, GL_UNSIGNED_BYTE, mip_map_data[i]);
+    }
+  }
+  else
+  {
+    _mip_maps_dirty = true;
+  }
+  return layer;
+}
+
+int TextureArray::addSolidColorLayer(glm::u8vec4 color)
+{
+  GLuint key =
+    color.r | (color.g << 8) | (color.b << 16) | (GLuint(color.a) << 24);
+  auto cached = _solid_color_layers.find(key);
+  if (cached != _solid_color_layers.end())
+    return cached->second;
+  if (_number_of_layers >= _max_number_of_layers)
+  {
+    fprintf(stderr, "ERROR : Texture array %u is full\n", _id);
+    return -1;
+  }
+
+  int layer = _number_of_layers++;
+  std::vector<GLuint> pixels(_layer_size.x * _layer_size.y, key);
+  bind();
+  // All levels of a solid color are the same, the base level data is large
+  // enough for every one of them
+  glm::uvec2 level_size = _layer_size;
+  for (int level = 0; level < _mip_map_level; ++level)
+  {
+    glTexSubImage3D(
+      GL_TEXTURE_2D_ARRAY, level, 0, 0, layer, level_size.x, level_size.y, 1,
+      GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+    level_size = glm::max(level_size / 2u, glm::uvec2(1));
+  }
+  _solid_color_layers[key] = layer;
+  return layer;
+}
+
+void TextureArray::updateMipMaps()
+{
+  if (!_mip_maps_dirty)
+    return;
+  bind();
+  glGenerateMipmap(GL_TEXTURE_2D_ARRAY);
+  _mip_maps_dirty = false;
+}
+
+void TextureArray::bind() const
+{
+  TextureUnit::bindTexture(GL_TEXTURE_2D_ARRAY, _id);
+}
+
+} }
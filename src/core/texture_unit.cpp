@@ -1,11 +1,18 @@
 #include "elk/core/texture_unit.h"
 
+#include <cstdio>
+
 namespace elk { namespace core {
 
 bool TextureUnit::_initialized = false;
 unsigned int TextureUnit::_totalActive = 0;
 GLint TextureUnit::_maxTexUnits = 0;
-std::vector<bool> TextureUnit::_busyUnits = std::vector<bool>();
+std::vector<uint64_t> TextureUnit::_freeUnits = std::vector<uint64_t>();
+std::vector<TextureUnit::Binding> TextureUnit::_bindings =
+    std::vector<TextureUnit::Binding>();
+GLint TextureUnit::_activeUnit = -1;
+TextureUnit::Statistics TextureUnit::_frameStatistics = {0, 0};
+TextureUnit::Statistics TextureUnit::_lastFrameStatistics = {0, 0};
 
 TextureUnit::TextureUnit()
     : _number(0)
@@ -17,9 +24,17 @@ TextureUnit::TextureUnit()
     }
 }
 
+TextureUnit::TextureUnit(TextureUnit&& other) noexcept
+    : _number(other._number)
+    , _glEnum(other._glEnum)
+    , _assigned(other._assigned)
+{
+    other._assigned = false;
+}
+
 TextureUnit::~TextureUnit() {
     if (_assigned) {
-        _busyUnits.at(_number) = false;
+        _freeUnits[_number / 64] |= uint64_t(1) << (_number % 64);
         --_totalActive;
     }
 }
@@ -28,7 +43,7 @@ void TextureUnit::activate() {
     if (!_assigned) {
         assignUnit();
     }
-    glActiveTexture(_glEnum);
+    setActiveUnit(_number);
 }
 
 GLint TextureUnit::glEnum() {
@@ -50,34 +65,87 @@ TextureUnit::operator GLint() {
 }
 
 void TextureUnit::setZeroUnit() {
-    glActiveTexture(GL_TEXTURE0);
+    if (!_initialized) {
+        initialize();
+    }
+    setActiveUnit(0);
 }
 
 int TextureUnit::numberActiveUnits() {
     return _totalActive;
 }
 
-void TextureUnit::assignUnit() {
-    if (_totalActive >= _maxTexUnits)
-        printf("No more texture units available!\n");
+void TextureUnit::bindTexture(GLenum target, GLuint id) {
+    if (!_initialized) {
+        initialize();
+    }
+    if (_activeUnit < 0) {
+        // Active unit unknown, bind without updating the shadow table
+        glBindTexture(target, id);
+        ++_frameStatistics.binds_issued;
+        return;
+    }
+    Binding& binding = _bindings[_activeUnit];
+    if (binding.target == target && binding.id == id) {
+        ++_frameStatistics.binds_skipped;
+        return;
+    }
+    glBindTexture(target, id);
+    binding = {target, id};
+    ++_frameStatistics.binds_issued;
+}
 
-    _assigned = true;
+void TextureUnit::deleteTexture(GLuint id) {
+    for (auto& binding : _bindings) {
+        if (binding.id == id) {
+            binding = {GL_NONE, 0};
+        }
+    }
+    glDeleteTextures(1, &id);
+}
 
-    for (size_t i = 0; i < _maxTexUnits; ++i) {
-        if (!_busyUnits[i]) {
-            _number = static_cast<GLint>(i);
+void TextureUnit::invalidateBindings() {
+    for (auto& binding : _bindings) {
+        binding = {GL_NONE, 0};
+    }
+    _activeUnit = -1;
+}
+
+void TextureUnit::resetFrameStatistics() {
+    _lastFrameStatistics = _frameStatistics;
+    _frameStatistics = {0, 0};
+}
+
+void TextureUnit::setActiveUnit(GLint number) {
+    if (_activeUnit != number) {
+        glActiveTexture(GL_TEXTURE0 + number);
+        _activeUnit = number;
+    }
+}
+
+void TextureUnit::assignUnit() {
+    for (size_t word = 0; word < _freeUnits.size(); ++word) {
+        if (_freeUnits[word]) {
+            int bit = __builtin_ctzll(_freeUnits[word]);
+            _freeUnits[word] &= _freeUnits[word] - 1;
+            _number = static_cast<GLint>(word * 64 + bit);
             _glEnum = GL_TEXTURE0 + _number;
-            _busyUnits[i] = true;
+            _assigned = true;
             ++_totalActive;
-            break;
+            return;
         }
     }
+    printf("No more texture units available!\n");
 }
 
 void TextureUnit::initialize()
 {
     glGetIntegerv(GL_MAX_TEXTURE_IMAGE_UNITS, &_maxTexUnits);
-    _busyUnits = std::vector<bool>(_maxTexUnits, false);
+    _freeUnits = std::vector<uint64_t>((_maxTexUnits + 63) / 64, ~uint64_t(0));
+    if (_maxTexUnits % 64) {
+        _freeUnits.back() = (uint64_t(1) << (_maxTexUnits % 64)) - 1;
+    }
+    _bindings = std::vector<Binding>(_maxTexUnits, Binding{GL_NONE, 0});
     _initialized = true;
 }
 
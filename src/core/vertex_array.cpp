@@ -40,6 +40,16 @@ void VertexArray::enableAttribArrays()
   }
 }
 
+GLuint VertexArray::attributeMask() const
+{
+  GLuint mask = 0;
+  for (auto& pair : _buffers)
+  {
+    mask |= 1u << pair.first;
+  }
+  return mask;
+}
+
 void VertexArray::disableAttribArrays()
 {
   for (auto& pair : _buffers)
@@ -0,0 +1,90 @@
+#include "elk/core/worker_pool.h"
+#include "elk/core/cpu_profiler.h"
+
+#include <algorithm>
+#include <string>
+
+namespace elk { namespace core {
+
+WorkerPool::WorkerPool(int number_of_threads) :
+  _task(nullptr),
+  _number_of_tasks(0),
+  _next_task(0),
+  _busy_workers(0),
+  _generation(0),
+  _stop(false)
+{
+  if (number_of_threads < 0)
+    number_of_threads = std::max(1u, std::thread::hardware_concurrency());
+  for (int i = 1; i < number_of_threads; ++i)
+    _threads.emplace_back(&WorkerPool::work, this, i);
+}
+
+WorkerPool::~WorkerPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _stop = true;
+  }
+  _wake.notify_all();
+  for (auto& thread : _threads)
+  {
+    thread.join();
+  }
+}
+
+void WorkerPool::run(int number_of_tasks, const std::function<void(int)>& f)
+{
+  if (_threads.empty() || number_of_tasks <= 1)
+  {
+    for (int task = 0; task < number_of_tasks; ++task)
+      f(task);
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _task = &f;
+    _number_of_tasks = number_of_tasks;
+    _next_task = 0;
+    _busy_workers = static_cast<int>(_threads.size());
+    _generation++;
+  }
+  _wake.notify_all();
+  runTasks();
+
+  std::unique_lock<std::mutex> lock(_mutex);
+  _done.wait(lock, [this] { return _busy_workers == 0; });
+  _task = nullptr;
+}
+
+void WorkerPool::runTasks()
+{
+  for (int task = _next_task++; task < _number_of_tasks; task = _next_task++)
+    (*_task)(task);
+}
+
+void WorkerPool::work(int index)
+{
+  ELK_PROFILE_THREAD(("Worker " + std::to_string(index)).c_str());
+
+  unsigned int generation = 0;
+  while (true)
+  {
+    {
+      std::unique_lock<std::mutex> lock(_mutex);
+      _wake.wait(lock, [&] { return _stop || _generation != generation; });
+      if (_stop)
+        return;
+      generation = _generation;
+    }
+    runTasks();
+    {
+      std::lock_guard<std::mutex> lock(_mutex);
+      if (--_busy_workers == 0)
+        _done.notify_one();
+    }
+  }
+}
+
+} }
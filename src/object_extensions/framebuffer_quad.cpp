@@ -20,7 +20,10 @@ FrameBufferQuad::FrameBufferQuad(
     auto texture = std::get<std::shared_ptr<Texture>>(render_texture);
     auto attachment = std::get<GLenum>(render_texture);
     
-    _color_attachments.push_back(attachment);
+    // Depth textures are sampled like any other render texture but are not
+    // draw buffers
+    if (attachment != GL_DEPTH_ATTACHMENT)
+      _color_attachments.push_back(attachment);
     texture->upload();
     _fbo.attach2DTexture(texture->id(), attachment, 0);
   }
@@ -40,7 +43,9 @@ FrameBufferQuad::~FrameBufferQuad()
 
 void FrameBufferQuad::bindTextures()
 {
-  _texture_units_in_use = std::vector<TextureUnit>(_render_textures.size());
+  // Reuse the storage, the units are released by clear
+  _texture_units_in_use.clear();
+  _texture_units_in_use.resize(_render_textures.size());
   
   for (int i = 0; i < _render_textures.size(); ++i)
   {
@@ -57,7 +62,8 @@ void FrameBufferQuad::bindTextures()
 void FrameBufferQuad::bindTextures(
   const std::vector<RenderTextureInfo>& render_texture_info)
 {
-  _texture_units_in_use = std::vector<TextureUnit>(render_texture_info.size());
+  _texture_units_in_use.clear();
+  _texture_units_in_use.resize(render_texture_info.size());
   
   for (int i = 0; i < render_texture_info.size(); ++i)
   {
@@ -84,13 +90,31 @@ void FrameBufferQuad::generateMipMaps()
   for (auto render_texture : _render_textures)
   {
     auto texture = std::get<std::shared_ptr<Texture>>(render_texture);
-    texture->generateMipMap(); 
+    if (std::get<GLenum>(render_texture) != GL_DEPTH_ATTACHMENT)
+      texture->generateMipMap();
   }
 }
 
+void FrameBufferQuad::resize(int width, int height)
+{
+  if (width == _width && height == _height)
+    return;
+  _width = width;
+  _height = height;
+  // The attachments refer to the texture objects so they stay valid when the
+  // storage is reallocated
+  for (auto render_texture : _render_textures)
+  {
+    auto texture = std::get<std::shared_ptr<Texture>>(render_texture);
+    texture->resize(glm::uvec3(width, height, 1));
+  }
+  if (_depth_buffer)
+    _depth_buffer->resize(width, height);
+}
+
 void FrameBufferQuad::freeTextureUnits()
 {
-  _texture_units_in_use = std::vector<TextureUnit>();
+  _texture_units_in_use.clear();
 }
 
 void FrameBufferQuad::render()
@@ -2,17 +2,16 @@
 
 #include "elk/core/renderer.h"
 #include "elk/core/create_mesh.h"
-#include <glm/gtx/matrix_decompose.hpp>
+#include "elk/core/texture_unit.h"
 
 namespace elk { namespace core {
 
 PointLightSource::PointLightSource(glm::vec3 color, float radiant_flux) :
   Object3D(),
-  _color(color)
+  _color(color),
+  _casts_shadows(false)
 {
   setRadiantFlux(radiant_flux);
-  _quad_mesh = CreateMesh::quad();
-  _sphere_mesh = CreateMesh::lonLatSphere(16, 8);
 }
 
 void PointLightSource::submit(Renderer& renderer)
@@ -28,94 +27,25 @@ void PointLightSource::update(double dt)
   //  relativeTransform() * glm::rotate(float(dt) * 0.1f, glm::vec3(1.0f, 1.0f, 0.0f)) );
 }
 
-void PointLightSource::render(const UsefulRenderData& render_data)
-{
-  // If we are inside the sphere affected by the light source, render a full
-  // quad. Otherwize just render the light sphere
-  glm::vec4 position_world_space = glm::vec4(absoluteTransform()[3]);
-  glm::vec3 position_view_space =
-    glm::vec3(render_data.camera.viewTransform() * position_world_space);
-  float distance_to_light_source = glm::length(position_view_space);
-  
-  // Probably not the best way of handling rescaled light sources,
-  // but works for now..
-  glm::vec3 scale;
-  glm::quat rotation;
-  glm::vec3 translation;
-  glm::vec3 skew;
-  glm::vec4 perspective;
-  glm::decompose(
-    absoluteTransform(), scale, rotation, translation, skew,perspective);
-  float transform_scale = scale.x;
-
-  if (distance_to_light_source < _sphere_scale * transform_scale)
-    renderQuad(render_data);
-  else
-    renderSphere(render_data);
-}
-
-void PointLightSource::renderQuad(const UsefulRenderData& render_data)
+void PointLightSource::setRadiantFlux(float radiant_flux)
 {
-  setupLightSourceUniforms(render_data);
-  _quad_mesh->render();
-}
-
-void PointLightSource::renderSphere(const UsefulRenderData& render_data)
-{
-  glm::mat4 scaled_transform = absoluteTransform();
-  scaled_transform[0][0] *= _sphere_scale;
-  scaled_transform[1][1] *= _sphere_scale;
-  scaled_transform[2][2] *= _sphere_scale;
-
-  glUniformMatrix4fv(
-    glGetUniformLocation(ShaderProgram::currentProgramId(), "M"),
-    1,
-    GL_FALSE,
-    &scaled_transform[0][0]);
-  glUniformMatrix4fv(
-      glGetUniformLocation(ShaderProgram::currentProgramId(), "V"),
-      1,
-      GL_FALSE,
-      &render_data.camera.viewTransform()[0][0]);
-  glUniformMatrix4fv(
-      glGetUniformLocation(ShaderProgram::currentProgramId(), "P"),
-      1,
-      GL_FALSE,
-      &render_data.camera.projectionTransform()[0][0]);
-
-  setupLightSourceUniforms(render_data);
-
-  _sphere_mesh->render();
+  _radiant_flux = radiant_flux;
+  _sphere_scale = _radiant_flux * 16 / 2 * (M_PI * 2); // sqrt(256) / 2
 }
 
-void PointLightSource::setupLightSourceUniforms(const UsefulRenderData& render_data)
+void PointLightSource::setColor(glm::vec3 color)
 {
-  glm::vec4 position_world_space = glm::vec4(absoluteTransform()[3]);
-  glm::vec4 position_view_space = render_data.camera.viewTransform() * position_world_space;
-
-  glUniform3f(
-    glGetUniformLocation(ShaderProgram::currentProgramId(),
-      "light_source.position"),
-    position_view_space.x, position_view_space.y, position_view_space.z);
-  glUniform3f(
-    glGetUniformLocation(ShaderProgram::currentProgramId(),
-      "light_source.color"),
-    _color.r, _color.g, _color.b);
-  glUniform1f(
-    glGetUniformLocation(ShaderProgram::currentProgramId(),
-      "light_source.radiant_flux"),
-    _radiant_flux);
+  _color = color;
 }
 
-void PointLightSource::setRadiantFlux(float radiant_flux)
+glm::vec3 PointLightSource::position() const
 {
-  _radiant_flux = radiant_flux;
-  _sphere_scale = _radiant_flux * 16 / 2 * (M_PI * 2); // sqrt(256) / 2
+  return glm::vec3(absoluteTransform()[3]);
 }
 
-void PointLightSource::setColor(glm::vec3 color)
+float PointLightSource::radius() const
 {
-  _color = color;
+  return _sphere_scale * glm::length(glm::vec3(absoluteTransform()[0]));
 }
 
 DirectionalLightSource::DirectionalLightSource(glm::vec3 color, float radiance) :
@@ -142,16 +72,34 @@ void DirectionalLightSource::update(double dt)
 void DirectionalLightSource::render(const UsefulRenderData& render_data)
 {
   setupLightSourceUniforms(render_data);
+  TextureUnit tex_unit_shadow_map;
+  if (_shadow_map)
+  {
+    _shadow_map->setUniforms(render_data.camera, tex_unit_shadow_map);
+  }
+  else
+  {
+    // The sampler still needs a unit of its own
+    glUniform1i(
+      glGetUniformLocation(ShaderProgram::currentProgramId(), "shadow_map"),
+      tex_unit_shadow_map);
+    glUniform1i(
+      glGetUniformLocation(ShaderProgram::currentProgramId(), "number_of_cascades"),
+      0);
+  }
   _quad_mesh->render();
 }
 
-void DirectionalLightSource::setupLightSourceUniforms(const UsefulRenderData& render_data)
+glm::vec3 DirectionalLightSource::direction() const
 {
   glm::vec3 direction_model_space = glm::vec3(0.0f, -1.0f, 0.0f);
-  glm::vec3 direction_world_space =
-    glm::mat3(absoluteTransform()) * direction_model_space;
+  return glm::mat3(absoluteTransform()) * direction_model_space;
+}
+
+void DirectionalLightSource::setupLightSourceUniforms(const UsefulRenderData& render_data)
+{
   glm::vec3 direction_view_space =
-    glm::mat3(render_data.camera.viewTransform()) * direction_world_space;
+    glm::mat3(render_data.camera.viewTransform()) * direction();
 
   glUniform3f(
     glGetUniformLocation(ShaderProgram::currentProgramId(),
@@ -177,4 +125,13 @@ void DirectionalLightSource::setColor(glm::vec3 color)
   _color = color;
 }
 
+void DirectionalLightSource::setCastsShadows(
+  bool enabled, CascadedShadowMapSettings settings)
+{
+  if (enabled)
+    _shadow_map = std::make_unique<CascadedShadowMap>(settings);
+  else
+    _shadow_map.reset();
+}
+
 } }
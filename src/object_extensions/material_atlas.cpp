@@ -0,0 +1,687 @@
+#include "elk/object_extensions/material_atlas.h"
+#include "elk/core/texture_unit.h"
+#include "elk/core/camera.h"
+#include "elk/core/render_state.h"
+#include "elk/core/bounding_box.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <limits>
+#include <numeric>
+
+namespace elk { namespace core {
+
+std::shared_ptr<ShaderProgram> MaterialAtlas::_program = nullptr;
+std::shared_ptr<ShaderProgram> MaterialAtlas::_culling_program = nullptr;
+std::shared_ptr<ShaderProgram> MaterialAtlas::_shadow_program = nullptr;
+
+namespace {
+  // Attribute locations, 0 to 3 are the same as for Mesh
+  const GLuint instance_transform_location = 5;
+  const GLuint instance_material_location = 9;
+  const GLuint material_block_binding = 0;
+  // Shader storage bindings of the occlusion culling shader
+  enum CullingBinding {
+    instances_binding,
+    command_bounds_binding,
+    visibility_binding,
+    visible_commands_binding,
+    visible_instances_binding,
+    newly_visible_commands_binding,
+    newly_visible_instances_binding
+  };
+  const GLuint culling_group_size = 64;
+}
+
+MaterialAtlas::MaterialAtlas(glm::uvec2 layer_size, int max_number_of_layers) :
+  RenderableDeferred(),
+  _texture_array(layer_size, max_number_of_layers),
+  _min_position(0.0f),
+  _max_position(0.0f),
+  _geometry_dirty(false),
+  _instances_dirty(false),
+  _materials_dirty(false)
+{
+  glGenVertexArrays(1, &_vao);
+  glGenBuffers(4, _vertex_buffers);
+  glGenBuffers(1, &_element_buffer);
+  glGenBuffers(1, &_instance_buffer);
+  glGenBuffers(1, &_indirect_buffer);
+  glGenBuffers(1, &_material_buffer);
+  glGenBuffers(1, &_command_bounds_buffer);
+  glGenBuffers(1, &_visibility_buffer);
+  glGenBuffers(1, &_empty_commands_buffer);
+  for (DrawList* list : { &_visible, &_newly_visible })
+  {
+    glGenBuffers(1, &list->instance_buffer);
+    glGenBuffers(1, &list->indirect_buffer);
+  }
+
+  if (!_program)
+  {
+    _program = std::make_shared<ShaderProgram>(
+      "gbuffer_atlas_program",
+      (std::string(ELK_DIR) + "/shaders/deferred_shading/geometry_pass_atlas.vert").c_str(),
+      nullptr,
+      nullptr,
+      nullptr,
+      (std::string(ELK_DIR) + "/shaders/deferred_shading/geometry_pass_atlas.frag").c_str());
+  }
+  if (!_shadow_program)
+  {
+    _shadow_program = std::make_shared<ShaderProgram>(
+      "shadow_map_atlas_program",
+      (std::string(ELK_DIR) + "/shaders/deferred_shading/geometry_pass_atlas.vert").c_str(),
+      nullptr,
+      nullptr,
+      nullptr,
+      (std::string(ELK_DIR) + "/shaders/deferred_shading/shadow_map.frag").c_str());
+  }
+  if (!_culling_program && occlusionCullingSupported())
+  {
+    _culling_program = std::make_shared<ShaderProgram>(
+      "occlusion_culling_program",
+      (std::string(ELK_DIR) + "/shaders/deferred_shading/occlusion_culling.comp").c_str());
+  }
+}
+
+MaterialAtlas::~MaterialAtlas()
+{
+  glDeleteVertexArrays(1, &_vao);
+  glDeleteBuffers(4, _vertex_buffers);
+  glDeleteBuffers(1, &_element_buffer);
+  glDeleteBuffers(1, &_instance_buffer);
+  glDeleteBuffers(1, &_indirect_buffer);
+  glDeleteBuffers(1, &_material_buffer);
+  glDeleteBuffers(1, &_command_bounds_buffer);
+  glDeleteBuffers(1, &_visibility_buffer);
+  glDeleteBuffers(1, &_empty_commands_buffer);
+  for (DrawList* list : { &_visible, &_newly_visible })
+  {
+    glDeleteBuffers(1, &list->instance_buffer);
+    glDeleteBuffers(1, &list->indirect_buffer);
+  }
+}
+
+bool MaterialAtlas::multiDrawIndirectSupported()
+{
+  return GLEW_ARB_multi_draw_indirect && GLEW_ARB_base_instance;
+}
+
+bool MaterialAtlas::occlusionCullingSupported()
+{
+  // The culling shader is GLSL 4.10 with the extensions that OpenGL 4.3
+  // made core, binding points of buffer blocks come from 420pack
+  return multiDrawIndirectSupported() &&
+    GLEW_ARB_compute_shader && GLEW_ARB_shader_storage_buffer_object &&
+    GLEW_ARB_shading_language_420pack;
+}
+
+bool MaterialAtlas::supportsOcclusionCulling() const
+{
+  return occlusionCullingSupported();
+}
+
+int MaterialAtlas::addMaterial(std::shared_ptr<Material> material)
+{
+  const std::shared_ptr<Texture> textures[] = {
+    material->albedoTexture(),
+    material->roughnessTexture(),
+    material->R0Texture(),
+    material->metalnessTexture(),
+    material->normalTexture() };
+
+  if (_materials.size() >= max_number_of_materials)
+  {
+    fprintf(stderr, "ERROR : Material atlas is full\n");
+    return -1;
+  }
+  for (auto& texture : textures)
+  {
+    if (!_texture_array.accepts(*texture))
+    {
+      fprintf(stderr,
+        "ERROR : Material texture %u does not fit in the material atlas\n",
+        texture->id());
+      return -1;
+    }
+  }
+
+  int layers[5];
+  for (int i = 0; i < 5; ++i)
+  {
+    layers[i] = _texture_array.addLayer(*textures[i]);
+    if (layers[i] == -1)
+      return -1;
+  }
+  _material_layers.push_back(glm::ivec4(layers[0], layers[1], layers[2], layers[3]));
+  _material_layers.push_back(glm::ivec4(layers[4], 0, 0, 0));
+  _materials.push_back(material);
+  _materials_dirty = true;
+  return _materials.size() - 1;
+}
+
+int MaterialAtlas::addMesh(std::shared_ptr<Mesh> mesh)
+{
+  assert(mesh->elements());
+  _meshes.push_back(mesh);
+  _geometry_dirty = true;
+  return _meshes.size() - 1;
+}
+
+int MaterialAtlas::addInstance(
+  int mesh_index, int material_index, const glm::mat4& transform)
+{
+  assert(mesh_index >= 0 && mesh_index < _meshes.size());
+  assert(material_index >= 0 && material_index < _materials.size());
+  _instances.push_back({transform, mesh_index, material_index});
+  _instances_dirty = true;
+  return _instances.size() - 1;
+}
+
+void MaterialAtlas::setInstanceTransform(
+  int instance_index, const glm::mat4& transform)
+{
+  _instances[instance_index].transform = transform;
+  // Grouping and visibility only need to be rebuilt for added instances
+  if (!_instances_dirty)
+    _moved_instances.push_back(instance_index);
+}
+
+void MaterialAtlas::uploadGeometry()
+{
+  std::vector<glm::vec3> positions;
+  std::vector<glm::vec3> normals;
+  std::vector<glm::vec2> texture_coordinates;
+  std::vector<glm::vec3> tangents;
+  std::vector<GLushort> elements;
+
+  // Concatenate all meshes. Missing attributes are filled with zeros.
+  _mesh_ranges.clear();
+  for (auto& mesh : _meshes)
+  {
+    _mesh_ranges.push_back({
+      static_cast<GLuint>(elements.size()),
+      static_cast<GLuint>(mesh->elements()->size()),
+      static_cast<GLint>(positions.size()),
+      mesh->computeMinPosition(),
+      mesh->computeMaxPosition()});
+
+    elements.insert(
+      elements.end(), mesh->elements()->begin(), mesh->elements()->end());
+    positions.insert(
+      positions.end(), mesh->positions()->begin(), mesh->positions()->end());
+    if (mesh->normals())
+      normals.insert(normals.end(), mesh->normals()->begin(), mesh->normals()->end());
+    else
+      normals.resize(positions.size(), glm::vec3(0.0f));
+    if (mesh->textureCoordinates())
+      texture_coordinates.insert(texture_coordinates.end(),
+        mesh->textureCoordinates()->begin(), mesh->textureCoordinates()->end());
+    else
+      texture_coordinates.resize(positions.size(), glm::vec2(0.0f));
+    if (mesh->tangents())
+      tangents.insert(tangents.end(), mesh->tangents()->begin(), mesh->tangents()->end());
+    else
+      tangents.resize(positions.size(), glm::vec3(0.0f));
+    assert(normals.size() == positions.size() &&
+           texture_coordinates.size() == positions.size() &&
+           tangents.size() == positions.size());
+  }
+
+  glBindVertexArray(_vao);
+
+  const void* data[] = {
+    positions.data(), normals.data(), texture_coordinates.data(), tangents.data() };
+  const GLsizeiptr sizes[] = {
+    GLsizeiptr(positions.size() * sizeof(glm::vec3)),
+    GLsizeiptr(normals.size() * sizeof(glm::vec3)),
+    GLsizeiptr(texture_coordinates.size() * sizeof(glm::vec2)),
+    GLsizeiptr(tangents.size() * sizeof(glm::vec3)) };
+  const GLint n_components[] = { 3, 3, 2, 3 };
+  for (int i = 0; i < 4; ++i)
+  {
+    glBindBuffer(GL_ARRAY_BUFFER, _vertex_buffers[i]);
+    glBufferData(GL_ARRAY_BUFFER, sizes[i], data[i], GL_STATIC_DRAW);
+    glVertexAttribPointer(i, n_components[i], GL_FLOAT, GL_FALSE, 0, nullptr);
+    glEnableVertexAttribArray(i);
+  }
+
+  glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _element_buffer);
+  glBufferData(
+    GL_ELEMENT_ARRAY_BUFFER, elements.size() * sizeof(GLushort),
+    elements.data(), GL_STATIC_DRAW);
+
+  for (int i = 0; i < 4; ++i)
+  {
+    glEnableVertexAttribArray(instance_transform_location + i);
+    glVertexAttribDivisor(instance_transform_location + i, 1);
+  }
+  glEnableVertexAttribArray(instance_material_location);
+  glVertexAttribDivisor(instance_material_location, 1);
+
+  glBindVertexArray(0);
+  _geometry_dirty = false;
+  // Draw commands refer to the mesh ranges
+  _instances_dirty = true;
+}
+
+void MaterialAtlas::uploadInstances()
+{
+  // Group the instances per mesh so that each mesh is one draw command
+  std::vector<int> order(_instances.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    return _instances[a].mesh_index < _instances[b].mesh_index;
+  });
+
+  std::vector<InstanceData> instance_data;
+  instance_data.reserve(_instances.size());
+  std::vector<glm::vec4> command_bounds;
+  _draw_commands.clear();
+  _instance_slots.resize(_instances.size());
+  for (int i : order)
+  {
+    const Instance& instance = _instances[i];
+    const MeshRange& range = _mesh_ranges[instance.mesh_index];
+    GLuint base_instance = instance_data.size();
+    _instance_slots[i] = base_instance;
+
+    if (!_draw_commands.empty() &&
+        _draw_commands.back().first_index == range.first_index &&
+        _draw_commands.back().base_vertex == range.base_vertex)
+    {
+      _draw_commands.back().instance_count++;
+    }
+    else
+    {
+      _draw_commands.push_back(
+        {range.count, 1, range.first_index, range.base_vertex, base_instance});
+      command_bounds.push_back(glm::vec4(range.min_position, 1.0f));
+      command_bounds.push_back(glm::vec4(range.max_position, 1.0f));
+    }
+    GLint command_index = _draw_commands.size() - 1;
+    instance_data.push_back({
+      instance.transform, instance.material_index, command_index,
+      static_cast<GLint>(base_instance), 0});
+  }
+  computeBounds();
+
+  glBindBuffer(GL_ARRAY_BUFFER, _instance_buffer);
+  glBufferData(
+    GL_ARRAY_BUFFER, instance_data.size() * sizeof(InstanceData),
+    instance_data.data(), GL_DYNAMIC_DRAW);
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+  if (multiDrawIndirectSupported())
+  {
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, _indirect_buffer);
+    glBufferData(
+      GL_DRAW_INDIRECT_BUFFER,
+      _draw_commands.size() * sizeof(DrawElementsIndirectCommand),
+      _draw_commands.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  }
+  if (occlusionCullingSupported())
+    uploadCullingBuffers(command_bounds);
+  _instances_dirty = false;
+  _moved_instances.clear();
+}
+
+void MaterialAtlas::uploadTransforms()
+{
+  // The grouping is unchanged, so the instances keep their slots and the
+  // visibility of the last frame stays valid
+  glBindBuffer(GL_ARRAY_BUFFER, _instance_buffer);
+  for (int i : _moved_instances)
+  {
+    glBufferSubData(
+      GL_ARRAY_BUFFER,
+      _instance_slots[i] * sizeof(InstanceData) + offsetof(InstanceData, transform),
+      sizeof(glm::mat4), &_instances[i].transform[0][0]);
+  }
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+  computeBounds();
+  if (occlusionCullingSupported())
+    refreshVisibleTransforms();
+  _moved_instances.clear();
+}
+
+void MaterialAtlas::computeBounds()
+{
+  _min_position = glm::vec3(std::numeric_limits<float>::max());
+  _max_position = glm::vec3(-std::numeric_limits<float>::max());
+  for (const Instance& instance : _instances)
+  {
+    const MeshRange& range = _mesh_ranges[instance.mesh_index];
+    BoundingBox bounds = BoundingBox(range.min_position, range.max_position)
+      .transformed(instance.transform);
+    _min_position = glm::min(_min_position, bounds.min());
+    _max_position = glm::max(_max_position, bounds.max());
+  }
+}
+
+void MaterialAtlas::uploadCullingBuffers(
+  const std::vector<glm::vec4>& command_bounds)
+{
+  // Nothing counts as visible last frame, everything that passes the test is
+  // rendered in the second phase
+  std::vector<DrawElementsIndirectCommand> empty_commands(_draw_commands);
+  for (auto& command : empty_commands)
+    command.instance_count = 0;
+  std::vector<GLuint> visibility(_instances.size(), 0);
+  const GLsizeiptr commands_size =
+    empty_commands.size() * sizeof(DrawElementsIndirectCommand);
+  const GLsizeiptr instances_size = _instances.size() * sizeof(InstanceData);
+
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, _command_bounds_buffer);
+  glBufferData(
+    GL_SHADER_STORAGE_BUFFER, command_bounds.size() * sizeof(glm::vec4),
+    command_bounds.data(), GL_STATIC_DRAW);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, _visibility_buffer);
+  glBufferData(
+    GL_SHADER_STORAGE_BUFFER, visibility.size() * sizeof(GLuint),
+    visibility.data(), GL_DYNAMIC_COPY);
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, _empty_commands_buffer);
+  glBufferData(
+    GL_SHADER_STORAGE_BUFFER, commands_size, empty_commands.data(),
+    GL_STATIC_DRAW);
+  for (DrawList* list : { &_visible, &_newly_visible })
+  {
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, list->indirect_buffer);
+    glBufferData(
+      GL_SHADER_STORAGE_BUFFER, commands_size, empty_commands.data(),
+      GL_DYNAMIC_COPY);
+    glBindBuffer(GL_SHADER_STORAGE_BUFFER, list->instance_buffer);
+    glBufferData(
+      GL_SHADER_STORAGE_BUFFER, instances_size, nullptr, GL_DYNAMIC_COPY);
+  }
+  glBindBuffer(GL_SHADER_STORAGE_BUFFER, 0);
+}
+
+void MaterialAtlas::uploadMaterials()
+{
+  std::vector<glm::ivec4> data(2 * max_number_of_materials, glm::ivec4(0));
+  std::copy(_material_layers.begin(), _material_layers.end(), data.begin());
+  glBindBuffer(GL_UNIFORM_BUFFER, _material_buffer);
+  glBufferData(
+    GL_UNIFORM_BUFFER, data.size() * sizeof(glm::ivec4), data.data(),
+    GL_STATIC_DRAW);
+  glBindBuffer(GL_UNIFORM_BUFFER, 0);
+  _texture_array.updateMipMaps();
+  _materials_dirty = false;
+}
+
+void MaterialAtlas::setInstanceAttributePointers(
+  GLuint buffer, GLuint first_instance)
+{
+  glBindBuffer(GL_ARRAY_BUFFER, buffer);
+  size_t offset = first_instance * sizeof(InstanceData);
+  for (int i = 0; i < 4; ++i)
+  {
+    glVertexAttribPointer(
+      instance_transform_location + i, 4, GL_FLOAT, GL_FALSE,
+      sizeof(InstanceData),
+      reinterpret_cast<void*>(offset + i * sizeof(glm::vec4)));
+  }
+  glVertexAttribIPointer(
+    instance_material_location, 1, GL_INT, sizeof(InstanceData),
+    reinterpret_cast<void*>(offset + offsetof(InstanceData, material_index)));
+  glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void MaterialAtlas::update()
+{
+  if (_geometry_dirty)
+    uploadGeometry();
+  if (_instances_dirty)
+    uploadInstances();
+  else if (!_moved_instances.empty())
+    uploadTransforms();
+  if (_materials_dirty)
+    uploadMaterials();
+}
+
+void MaterialAtlas::beginDraw(
+  const UsefulRenderData& render_data, TextureUnit& material_unit)
+{
+  _program->pushUsage();
+
+  material_unit.activate();
+  _texture_array.bind();
+  glUniform1i(
+    glGetUniformLocation(_program->id(), "material_textures"),
+    material_unit);
+
+  glUniformBlockBinding(
+    _program->id(),
+    glGetUniformBlockIndex(_program->id(), "MaterialLayers"),
+    material_block_binding);
+  glBindBufferBase(GL_UNIFORM_BUFFER, material_block_binding, _material_buffer);
+
+  setTransforms(
+    _program->id(), render_data.camera.viewTransform(),
+    render_data.camera.projectionTransform());
+
+  glBindVertexArray(_vao);
+}
+
+void MaterialAtlas::setTransforms(
+  GLuint program, const glm::mat4& view, const glm::mat4& projection)
+{
+  glUniformMatrix4fv(
+    glGetUniformLocation(program, "M"),
+    1,
+    GL_FALSE,
+    &absoluteTransform()[0][0]);
+  glUniformMatrix4fv(
+    glGetUniformLocation(program, "V"),
+    1,
+    GL_FALSE,
+    &view[0][0]);
+  glUniformMatrix4fv(
+    glGetUniformLocation(program, "P"),
+    1,
+    GL_FALSE,
+    &projection[0][0]);
+}
+
+void MaterialAtlas::drawIndirect(GLuint instance_buffer, GLuint indirect_buffer)
+{
+  // base_instance of each command offsets the instance attributes
+  setInstanceAttributePointers(instance_buffer, 0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, indirect_buffer);
+  glMultiDrawElementsIndirect(
+    GL_TRIANGLES, GL_UNSIGNED_SHORT, nullptr, _draw_commands.size(), 0);
+  glBindBuffer(GL_DRAW_INDIRECT_BUFFER, 0);
+  RenderState::countDrawCall();
+}
+
+void MaterialAtlas::endDraw()
+{
+  glBindVertexArray(0);
+  _program->popUsage();
+}
+
+void MaterialAtlas::render(const UsefulRenderData& render_data)
+{
+  if (_instances.empty())
+    return;
+  update();
+
+  TextureUnit tex_unit_materials;
+  beginDraw(render_data, tex_unit_materials);
+  drawAll();
+  endDraw();
+}
+
+void MaterialAtlas::drawAll()
+{
+  if (multiDrawIndirectSupported())
+  {
+    drawIndirect(_instance_buffer, _indirect_buffer);
+  }
+  else
+  {
+    for (auto& command : _draw_commands)
+    {
+      setInstanceAttributePointers(_instance_buffer, command.base_instance);
+      glDrawElementsInstancedBaseVertex(
+        GL_TRIANGLES, command.count, GL_UNSIGNED_SHORT,
+        reinterpret_cast<void*>(command.first_index * sizeof(GLushort)),
+        command.instance_count, command.base_vertex);
+      RenderState::countDrawCall();
+    }
+  }
+}
+
+bool MaterialAtlas::shadowCasterBounds(glm::vec3& min, glm::vec3& max)
+{
+  if (_instances.empty())
+    return false;
+  update();
+  BoundingBox bounds =
+    BoundingBox(_min_position, _max_position).transformed(absoluteTransform());
+  min = bounds.min();
+  max = bounds.max();
+  return true;
+}
+
+void MaterialAtlas::renderShadowCaster(
+  const glm::mat4& view, const glm::mat4& projection)
+{
+  if (_instances.empty())
+    return;
+  update();
+
+  _shadow_program->pushUsage();
+  setTransforms(_shadow_program->id(), view, projection);
+  glBindVertexArray(_vao);
+  drawAll();
+  glBindVertexArray(0);
+  _shadow_program->popUsage();
+}
+
+void MaterialAtlas::renderVisible(const UsefulRenderData& render_data)
+{
+  if (_instances.empty())
+    return;
+  update();
+
+  TextureUnit tex_unit_materials;
+  beginDraw(render_data, tex_unit_materials);
+  drawIndirect(_visible.instance_buffer, _visible.indirect_buffer);
+  endDraw();
+}
+
+void MaterialAtlas::refreshVisibleTransforms()
+{
+  // The visible list was copied from the instances by the last culling pass,
+  // moved instances would be drawn where they were last frame
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, instances_binding, _instance_buffer);
+  glBindBufferBase(
+    GL_SHADER_STORAGE_BUFFER, visible_commands_binding, _visible.indirect_buffer);
+  glBindBufferBase(
+    GL_SHADER_STORAGE_BUFFER, visible_instances_binding, _visible.instance_buffer);
+
+  _culling_program->pushUsage();
+  glUniform1i(
+    glGetUniformLocation(_culling_program->id(), "refresh_visible_transforms"),
+    GL_TRUE);
+  glUniform1ui(
+    glGetUniformLocation(_culling_program->id(), "number_of_instances"),
+    _instances.size());
+  glDispatchCompute(
+    (_instances.size() + culling_group_size - 1) / culling_group_size, 1, 1);
+  glMemoryBarrier(GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+  _culling_program->popUsage();
+}
+
+void MaterialAtlas::cullOcclusion(
+  const UsefulRenderData& render_data, Texture& depth_pyramid)
+{
+  if (_instances.empty())
+    return;
+
+  // The draw lists were drawn by the first phase and are refilled. The
+  // visible list is drawn by the first phase of the next frame.
+  const GLsizeiptr commands_size =
+    _draw_commands.size() * sizeof(DrawElementsIndirectCommand);
+  glBindBuffer(GL_COPY_READ_BUFFER, _empty_commands_buffer);
+  for (DrawList* list : { &_visible, &_newly_visible })
+  {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, list->indirect_buffer);
+    glCopyBufferSubData(
+      GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, commands_size);
+  }
+  glBindBuffer(GL_COPY_READ_BUFFER, 0);
+  glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, instances_binding, _instance_buffer);
+  glBindBufferBase(
+    GL_SHADER_STORAGE_BUFFER, command_bounds_binding, _command_bounds_buffer);
+  glBindBufferBase(GL_SHADER_STORAGE_BUFFER, visibility_binding, _visibility_buffer);
+  glBindBufferBase(
+    GL_SHADER_STORAGE_BUFFER, visible_commands_binding, _visible.indirect_buffer);
+  glBindBufferBase(
+    GL_SHADER_STORAGE_BUFFER, visible_instances_binding, _visible.instance_buffer);
+  glBindBufferBase(
+    GL_SHADER_STORAGE_BUFFER, newly_visible_commands_binding,
+    _newly_visible.indirect_buffer);
+  glBindBufferBase(
+    GL_SHADER_STORAGE_BUFFER, newly_visible_instances_binding,
+    _newly_visible.instance_buffer);
+
+  _culling_program->pushUsage();
+
+  TextureUnit tex_unit_depth_pyramid;
+  tex_unit_depth_pyramid.activate();
+  depth_pyramid.bind();
+  glUniform1i(
+    glGetUniformLocation(_culling_program->id(), "depth_pyramid"),
+    tex_unit_depth_pyramid);
+  glUniform1i(
+    glGetUniformLocation(_culling_program->id(), "depth_pyramid_levels"),
+    depth_pyramid.mipMapLevels());
+  glUniform1i(
+    glGetUniformLocation(_culling_program->id(), "refresh_visible_transforms"),
+    GL_FALSE);
+  glUniform1ui(
+    glGetUniformLocation(_culling_program->id(), "number_of_instances"),
+    _instances.size());
+  glUniformMatrix4fv(
+    glGetUniformLocation(_culling_program->id(), "M"),
+    1,
+    GL_FALSE,
+    &absoluteTransform()[0][0]);
+  glUniformMatrix4fv(
+    glGetUniformLocation(_culling_program->id(), "V"),
+    1,
+    GL_FALSE,
+    &render_data.camera.viewTransform()[0][0]);
+  glUniformMatrix4fv(
+    glGetUniformLocation(_culling_program->id(), "P"),
+    1,
+    GL_FALSE,
+    &render_data.camera.projectionTransform()[0][0]);
+
+  glDispatchCompute(
+    (_instances.size() + culling_group_size - 1) / culling_group_size, 1, 1);
+  // The draw lists are read as draw commands and instance attributes
+  glMemoryBarrier(GL_COMMAND_BARRIER_BIT | GL_VERTEX_ATTRIB_ARRAY_BARRIER_BIT);
+
+  _culling_program->popUsage();
+}
+
+void MaterialAtlas::renderNewlyVisible(const UsefulRenderData& render_data)
+{
+  if (_instances.empty())
+    return;
+
+  TextureUnit tex_unit_materials;
+  beginDraw(render_data, tex_unit_materials);
+  drawIndirect(_newly_visible.instance_buffer, _newly_visible.indirect_buffer);
+  endDraw();
+}
+
+} }
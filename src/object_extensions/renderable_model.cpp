@@ -5,13 +5,16 @@
 #include "elk/core/shader_program.h"
 #include "elk/core/debug_input.h"
 #include "elk/core/camera.h"
+#include "elk/core/bounding_box.h"
 
 namespace elk { namespace core {
 
 RenderableModel::RenderableModel(
       std::shared_ptr<Mesh> mesh, std::shared_ptr<Material> material) :
   _mesh(mesh),
-  _material(material)
+  _material(material),
+  _min_position(mesh->computeMinPosition()),
+  _max_position(mesh->computeMaxPosition())
 { }
 
 void RenderableModel::render(const UsefulRenderData& render_data)
@@ -37,6 +40,49 @@ void RenderableModel::render(const UsefulRenderData& render_data)
   _mesh->render();
 }
 
+bool RenderableModel::recordCommands(
+  CommandBuffer& commands, const UsefulRenderData& render_data)
+{
+  // Meshes without elements have their own render()
+  if (!_mesh->elements())
+    return false;
+  _material->record(commands, absoluteTransform(), render_data.camera);
+  _mesh->recordDraw(commands);
+  return true;
+}
+
+bool RenderableModel::shadowCasterBounds(glm::vec3& min, glm::vec3& max)
+{
+  BoundingBox bounds =
+    BoundingBox(_min_position, _max_position).transformed(absoluteTransform());
+  min = bounds.min();
+  max = bounds.max();
+  return true;
+}
+
+void RenderableModel::renderShadowCaster(
+  const glm::mat4& view, const glm::mat4& projection)
+{
+  // The shadow map program is in use
+  glUniformMatrix4fv(
+    glGetUniformLocation(ShaderProgram::currentProgramId(), "M"),
+    1,
+    GL_FALSE,
+    &absoluteTransform()[0][0]);
+  glUniformMatrix4fv(
+      glGetUniformLocation(ShaderProgram::currentProgramId(), "V"),
+      1,
+      GL_FALSE,
+      &view[0][0]);
+  glUniformMatrix4fv(
+      glGetUniformLocation(ShaderProgram::currentProgramId(), "P"),
+      1,
+      GL_FALSE,
+      &projection[0][0]);
+
+  _mesh->render();
+}
+
 void RenderableModel::update(double dt)
 {
   Object3D::update(dt);
@@ -1,4 +1,5 @@
 #include "elk/texture_loading/texture_loading_freeimage.h"
+#include "elk/core/image_processing.h"
 
 #include <FreeImage.h>
 
@@ -25,22 +26,11 @@ std::pair<void*, glm::uvec2> loadTexture_freeimage(const char* path)
   int h = FreeImage_GetHeight(image);
  
   GLubyte* texture_data = new GLubyte[4*w*h];
-  char* image_pixels = (char*)FreeImage_GetBits(image);
+  const GLubyte* image_pixels = FreeImage_GetBits(image);
 
-  //FreeImage loads in BGR format, swap the bytes. 
-  for (int y = 0; y < h; ++y)
-  {
-    for (int x = 0; x < w; ++x)
-    {
-      int idx_read = x + y * w;
-      int idx_write = x + y * w;
-
-      texture_data[idx_write*4+0] = image_pixels[idx_read*4+2];
-      texture_data[idx_write*4+1] = image_pixels[idx_read*4+1];
-      texture_data[idx_write*4+2] = image_pixels[idx_read*4+0];
-      texture_data[idx_write*4+3] = image_pixels[idx_read*4+3];
-    }
-  }
+  // FreeImage loads in BGR format and owns its buffer, swap the bytes while
+  // copying to our own buffer.
+  swizzleBGRAToRGBA(image_pixels, texture_data, w * h);
   FreeImage_Unload(image);
   return {texture_data, glm::uvec2(w,h)};
 }
@@ -1,24 +1,31 @@
 #include "elk/window/application_window_glfw.h"
 
+#include <algorithm>
+#include <chrono>
 #include <sstream>
 #include <iostream>
+#include <thread>
 
 namespace elk { namespace window {
 
 std::vector<Controller*> ApplicationWindowGLFW::_controllers;
 
 ApplicationWindowGLFW::ApplicationWindowGLFW(std::string name, int width, int height) :
-  _name(name)
+  _name(name),
+  _frame_rate_limit(0.0),
+  _max_steps_per_frame(8)
 {
   _frame_counter = 0;
   _delay_counter = 0;
-  _time = glfwGetTime();
   // First an OpenGL context needs to be created
   if (!initOpenGLContext(width, height))
   {
     std::cout << "ERROR : Failed to initialize OpenGL" << std::endl;
   }
-  glfwSwapInterval(1);
+  _time = glfwGetTime();
+  _frame_start = _time;
+  _last_present = _time;
+  setSwapInterval(1);
   // Set callback functions
   glfwSetCursorPosCallback(_window, mousePosCallback);
   glfwSetMouseButtonCallback(_window, mouseButtonCallback);
@@ -61,32 +68,90 @@ void ApplicationWindowGLFW::run(std::function<void(double)> f)
   while (!glfwWindowShouldClose(_window))
   {
     double time_since_last = glfwGetTime() - _time;
-    _delay_counter += time_since_last;
-
-    if (_delay_counter >= 1.0) {
-      std::stringstream title;
-      title << _name << " " << _frame_counter << " FPS";
-      glfwSetWindowTitle(_window, title.str().c_str());
-      _frame_counter = 0;
-      _delay_counter = 0;
-    }
-    
+    _time = glfwGetTime();
+
     for (auto&& controller : _controllers)
     {
       controller->step(time_since_last);
     }
 
     f(time_since_last);
-    
-    _time = glfwGetTime();
-    _frame_counter++;
-    
-    glFlush();
-    glfwSwapBuffers(_window);
-    glfwPollEvents();
+
+    endFrame();
   }
 }
 
+void ApplicationWindowGLFW::run(
+  double dt,
+  std::function<void(double)> simulate,
+  std::function<void(double)> render)
+{
+  double accumulated_time = 0.0;
+  _time = glfwGetTime();
+  while (!glfwWindowShouldClose(_window))
+  {
+    const double now = glfwGetTime();
+    // Dropping time after a stall keeps the steps from piling up
+    accumulated_time = std::min(
+      accumulated_time + now - _time, _max_steps_per_frame * dt);
+    _time = now;
+
+    while (accumulated_time >= dt)
+    {
+      simulate(dt);
+      for (auto&& controller : _controllers)
+      {
+        controller->step(dt);
+      }
+      accumulated_time -= dt;
+    }
+
+    render(accumulated_time / dt);
+
+    endFrame();
+  }
+}
+
+void ApplicationWindowGLFW::endFrame()
+{
+  const double cpu_time = glfwGetTime() - _frame_start;
+  // Swapping flushes, the GPU is not waited for
+  glfwSwapBuffers(_window);
+  const double present = glfwGetTime();
+  _frame_statistics.record(cpu_time * 1000.0, (present - _last_present) * 1000.0);
+  if (_gpu_time_source)
+  {
+    for (const auto& result : _gpu_time_source())
+      _frame_statistics.recordGpuTime(result.index, result.milliseconds);
+  }
+  _last_present = present;
+  glfwPollEvents();
+  _frame_counter++;
+
+  if (_frame_rate_limit > 0.0)
+  {
+    const double remaining = _frame_start + 1.0 / _frame_rate_limit - glfwGetTime();
+    if (remaining > 0.0)
+      std::this_thread::sleep_for(std::chrono::duration<double>(remaining));
+  }
+  const double now = glfwGetTime();
+  _delay_counter += now - _frame_start;
+  _frame_start = now;
+
+  if (_delay_counter >= 1.0) {
+    std::stringstream title;
+    title << _name << " " << _frame_counter << " FPS";
+    glfwSetWindowTitle(_window, title.str().c_str());
+    _frame_counter = 0;
+    _delay_counter = 0;
+  }
+}
+
+void ApplicationWindowGLFW::setSwapInterval(int interval)
+{
+  glfwSwapInterval(interval);
+}
+
 void ApplicationWindowGLFW::addController(Controller& controller)
 {
   _controllers.push_back(&controller);
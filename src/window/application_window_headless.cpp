@@ -0,0 +1,205 @@
+#include "elk/window/application_window_headless.h"
+#include "elk/core/render_state.h"
+
+#include <gl/glew.h>
+
+#include <EGL/eglext.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+namespace elk { namespace window {
+
+ApplicationWindowHeadless::ApplicationWindowHeadless(
+  std::string name, int width, int height) :
+  _name(name),
+  _width(width),
+  _height(height),
+  _display(EGL_NO_DISPLAY),
+  _surface(EGL_NO_SURFACE),
+  _context(EGL_NO_CONTEXT),
+  _frame_limit(-1),
+  _fixed_time_step(0.0),
+  _should_close(false),
+  _frame_counter(0)
+{
+  if (!initOpenGLContext(width, height))
+  {
+    std::cout << "ERROR : Failed to initialize OpenGL" << std::endl;
+  }
+}
+
+ApplicationWindowHeadless::~ApplicationWindowHeadless()
+{
+  if (_display == EGL_NO_DISPLAY)
+    return;
+  eglMakeCurrent(_display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+  if (_context != EGL_NO_CONTEXT)
+    eglDestroyContext(_display, _context);
+  if (_surface != EGL_NO_SURFACE)
+    eglDestroySurface(_display, _surface);
+  eglTerminate(_display);
+}
+
+bool ApplicationWindowHeadless::initOpenGLContext(int width, int height)
+{
+  // Devices do not need a display server, the first one that can create
+  // the context is used
+  auto query_devices = reinterpret_cast<PFNEGLQUERYDEVICESEXTPROC>(
+    eglGetProcAddress("eglQueryDevicesEXT"));
+  auto get_platform_display = reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+    eglGetProcAddress("eglGetPlatformDisplayEXT"));
+  if (query_devices && get_platform_display)
+  {
+    EGLDeviceEXT devices[16];
+    EGLint number_of_devices = 0;
+    query_devices(16, devices, &number_of_devices);
+    for (int i = 0; i < number_of_devices; ++i)
+    {
+      EGLDisplay display =
+        get_platform_display(EGL_PLATFORM_DEVICE_EXT, devices[i], nullptr);
+      if (createContext(display))
+        return true;
+    }
+  }
+  return createContext(eglGetDisplay(EGL_DEFAULT_DISPLAY));
+}
+
+bool ApplicationWindowHeadless::createContext(EGLDisplay display)
+{
+  if (display == EGL_NO_DISPLAY || !eglInitialize(display, nullptr, nullptr))
+    return false;
+
+  const EGLint config_attributes[] = {
+    EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+    EGL_RED_SIZE, 8,
+    EGL_GREEN_SIZE, 8,
+    EGL_BLUE_SIZE, 8,
+    EGL_ALPHA_SIZE, 8,
+    EGL_DEPTH_SIZE, 24,
+    EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+    EGL_NONE };
+  // Modern OpenGL
+  const EGLint context_attributes[] = {
+    EGL_CONTEXT_MAJOR_VERSION_KHR, 4,
+    EGL_CONTEXT_MINOR_VERSION_KHR, 1,
+    EGL_CONTEXT_OPENGL_PROFILE_MASK_KHR, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT_KHR,
+    EGL_NONE };
+  const EGLint surface_attributes[] = {
+    EGL_WIDTH, _width,
+    EGL_HEIGHT, _height,
+    EGL_NONE };
+
+  EGLConfig config;
+  EGLint number_of_configs = 0;
+  if (!eglChooseConfig(display, config_attributes, &config, 1, &number_of_configs) ||
+      number_of_configs == 0 ||
+      !eglBindAPI(EGL_OPENGL_API))
+  {
+    eglTerminate(display);
+    return false;
+  }
+  EGLContext context =
+    eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+  if (context == EGL_NO_CONTEXT)
+  {
+    eglTerminate(display);
+    return false;
+  }
+  EGLSurface surface = eglCreatePbufferSurface(display, config, surface_attributes);
+  if (surface == EGL_NO_SURFACE || !eglMakeCurrent(display, surface, surface, context))
+  {
+    if (surface != EGL_NO_SURFACE)
+      eglDestroySurface(display, surface);
+    eglDestroyContext(display, context);
+    eglTerminate(display);
+    return false;
+  }
+
+  _display = display;
+  _surface = surface;
+  _context = context;
+  printf("%s\n", eglQueryString(display, EGL_VENDOR));
+  return true;
+}
+
+//! Starts the main loop
+void ApplicationWindowHeadless::run(std::function<void(double)> f)
+{
+  typedef std::chrono::steady_clock Clock;
+  typedef std::chrono::duration<double, std::milli> Milliseconds;
+  Clock::time_point time = Clock::now();
+  Clock::time_point last_present = time;
+  while (!_should_close && (_frame_limit < 0 || _frame_counter < _frame_limit))
+  {
+    Clock::time_point now = Clock::now();
+    double time_since_last = _fixed_time_step > 0.0 ?
+      _fixed_time_step : std::chrono::duration<double>(now - time).count();
+    time = now;
+
+    for (auto&& controller : _controllers)
+    {
+      controller->step(time_since_last);
+    }
+
+    f(time_since_last);
+
+    _frame_counter++;
+
+    const Milliseconds cpu_time = Clock::now() - now;
+    eglSwapBuffers(_display, _surface);
+    const Clock::time_point present = Clock::now();
+    _frame_statistics.record(cpu_time.count(), Milliseconds(present - last_present).count());
+    if (_gpu_time_source)
+    {
+      for (const auto& result : _gpu_time_source())
+        _frame_statistics.recordGpuTime(result.index, result.milliseconds);
+    }
+    last_present = present;
+  }
+}
+
+void ApplicationWindowHeadless::addController(Controller& controller)
+{
+  _controllers.push_back(&controller);
+  // The size never changes, controllers are told about it once
+  controller.windowSizeCallback(_width, _height);
+}
+
+std::vector<unsigned char> ApplicationWindowHeadless::readPixels() const
+{
+  std::vector<unsigned char> pixels(_width * _height * 3);
+  RenderState::bindFramebuffer(0);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, _width, _height, GL_RGB, GL_UNSIGNED_BYTE, pixels.data());
+  glPixelStorei(GL_PACK_ALIGNMENT, 4);
+
+  // OpenGL rows start at the bottom
+  const size_t row_size = _width * 3;
+  for (int y = 0; y < _height / 2; ++y)
+  {
+    std::swap_ranges(
+      pixels.begin() + y * row_size, pixels.begin() + (y + 1) * row_size,
+      pixels.begin() + (_height - 1 - y) * row_size);
+  }
+  return pixels;
+}
+
+bool ApplicationWindowHeadless::saveFrame(const std::string& path) const
+{
+  std::vector<unsigned char> pixels = readPixels();
+  FILE* file = fopen(path.c_str(), "wb");
+  if (!file)
+  {
+    fprintf(stderr, "ERROR : Could not write frame %s\n", path.c_str());
+    return false;
+  }
+  fprintf(file, "P6\n%d %d\n255\n", _width, _height);
+  bool written = fwrite(pixels.data(), 1, pixels.size(), file) == pixels.size();
+  fclose(file);
+  return written;
+}
+
+} }